@@ -0,0 +1,95 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        CutFlow.cc
+//////////////////////////////////////////////////////////////////////////
+
+#include "pdhdbsmdata/Algorithms/CutFlow.h"
+
+#include <cstdio>
+
+namespace pdhd {
+
+//-------------------------------------
+std::size_t LatencyHistogram::bucket(uint64_t ns) {
+  if (ns < kLinear) return ns;
+  const unsigned exponent = 63 - __builtin_clzll(ns);
+  const std::size_t sub = (ns >> (exponent - kSubBits)) & ((1 << kSubBits) - 1);
+  return kLinear + (exponent - kSubBits - 1) * (1 << kSubBits) + sub;
+}
+
+//-------------------------------------
+uint64_t LatencyHistogram::bucketLow(std::size_t bucket) {
+  if (bucket < kLinear) return bucket;
+  const unsigned exponent = (bucket - kLinear) / (1 << kSubBits) + kSubBits + 1;
+  const uint64_t sub = (bucket - kLinear) % (1 << kSubBits);
+  return ((uint64_t(1) << kSubBits) + sub) << (exponent - kSubBits);
+}
+
+//-------------------------------------
+void LatencyHistogram::record(uint64_t ns) {
+  fBuckets[bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+  fCount.fetch_add(1, std::memory_order_relaxed);
+  fSum.fetch_add(ns, std::memory_order_relaxed);
+  uint64_t max = fMax.load(std::memory_order_relaxed);
+  while (ns > max && !fMax.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {}
+}
+
+//-------------------------------------
+double LatencyHistogram::meanNs() const {
+  const uint64_t n = count();
+  return n == 0 ? 0. : double(fSum.load(std::memory_order_relaxed)) / n;
+}
+
+//-------------------------------------
+double LatencyHistogram::quantileNs(double q) const {
+  uint64_t total = 0;
+  for (const auto &b : fBuckets) total += b.load(std::memory_order_relaxed);
+  if (total == 0) return 0.;
+
+  // Smallest bucket whose cumulative count reaches q of the total
+  const double target = q * total;
+  uint64_t cumulative = 0;
+  for (std::size_t b = 0; b < kNBuckets; b++) {
+    cumulative += fBuckets[b].load(std::memory_order_relaxed);
+    if (cumulative > 0 && cumulative >= target) {
+      if (b < kLinear || b + 1 == kNBuckets) return bucketLow(b);
+      return 0.5 * (bucketLow(b) + bucketLow(b + 1));
+    }
+  }
+  return maxNs();
+}
+
+//-------------------------------------
+CutFlow::id_t CutFlow::addCounter(std::string name) {
+  fCounterNames.push_back(std::move(name));
+  fCounters.emplace_back(0);
+  return fCounterNames.size() - 1;
+}
+
+//-------------------------------------
+CutFlow::id_t CutFlow::addStage(std::string name) {
+  fStageNames.push_back(std::move(name));
+  fStages.emplace_back();
+  return fStageNames.size() - 1;
+}
+
+//-------------------------------------
+std::string CutFlow::json(std::string const& module) const {
+  std::string out = "{\n  \"module\": \"" + module + "\",\n  \"counters\": {";
+  for (id_t c = 0; c < nCounters(); c++) {
+    out += (c == 0 ? "\n    \"" : ",\n    \"") + fCounterNames[c] + "\": " + std::to_string(counter(c));
+  }
+  out += "\n  },\n  \"stages\": {";
+  char line[256];
+  for (id_t s = 0; s < nStages(); s++) {
+    LatencyHistogram const& h = fStages[s];
+    std::snprintf(line, sizeof(line),
+                  "\"n\": %llu, \"mean_us\": %.3f, \"p50_us\": %.3f, \"p90_us\": %.3f, \"p99_us\": %.3f, \"max_us\": %.3f",
+                  static_cast<unsigned long long>(h.count()), h.meanNs() * 1e-3, h.quantileNs(0.5) * 1e-3,
+                  h.quantileNs(0.9) * 1e-3, h.quantileNs(0.99) * 1e-3, h.maxNs() * 1e-3);
+    out += (s == 0 ? "\n    \"" : ",\n    \"") + fStageNames[s] + "\": {" + line + "}";
+  }
+  out += "\n  }\n}\n";
+  return out;
+}
+
+}
@@ -0,0 +1,102 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       LatencyHistogram, CutFlow
+//// File:        CutFlow.h
+////
+//// Cut-flow counters and per-stage latencies of a filter module, shared
+//// by all the threads running it. Counters and stages are registered in
+//// the module constructor and then updated with relaxed atomics only, so
+//// a shared module needs no lock to fill them.
+////
+//// LatencyHistogram keeps nanosecond durations in log-linear buckets
+//// (8 per power of two, exact below 16 ns), so the quantiles it gives
+//// are within about 6% of the true ones for any duration.
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_ALGORITHMS_CUTFLOW_H
+#define PDHDBSMDATA_ALGORITHMS_CUTFLOW_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace pdhd {
+
+class LatencyHistogram {
+  public:
+    static constexpr unsigned kSubBits = 3;                  // 8 buckets per power of two
+    static constexpr std::size_t kLinear = 2 << kSubBits;    // Exact buckets for 0..15 ns
+    static constexpr std::size_t kNBuckets = kLinear + (64 - kSubBits - 1) * (1 << kSubBits);
+
+    void record(uint64_t ns);
+
+    uint64_t count() const { return fCount.load(std::memory_order_relaxed); }
+    double meanNs() const;
+    uint64_t maxNs() const { return fMax.load(std::memory_order_relaxed); }
+    // Centre of the bucket holding the q-quantile, 0 if nothing was recorded
+    double quantileNs(double q) const;
+
+    static std::size_t bucket(uint64_t ns);
+    static uint64_t bucketLow(std::size_t bucket);
+
+  private:
+    std::array<std::atomic<uint64_t>, kNBuckets> fBuckets{};
+    std::atomic<uint64_t> fCount{0};
+    std::atomic<uint64_t> fSum{0};
+    std::atomic<uint64_t> fMax{0};
+};
+
+class CutFlow {
+  public:
+    using id_t = std::size_t;
+    using clock_type = std::chrono::steady_clock;
+
+    // Adds the time from construction to destruction to a stage
+    class StageTimer {
+      public:
+        StageTimer(CutFlow& cutFlow, id_t stage) : fCutFlow(cutFlow), fStage(stage), fStart(clock_type::now()) {}
+        StageTimer(StageTimer const&) = delete;
+        StageTimer& operator=(StageTimer const&) = delete;
+        ~StageTimer() { fCutFlow.record(fStage, clock_type::now() - fStart); }
+
+      private:
+        CutFlow &fCutFlow;
+        id_t fStage;
+        clock_type::time_point fStart;
+    };
+
+    // Registration, before any event
+    id_t addCounter(std::string name);
+    id_t addStage(std::string name);
+
+    void count(id_t counter, uint64_t n = 1) { fCounters[counter].fetch_add(n, std::memory_order_relaxed); }
+    void record(id_t stage, clock_type::duration elapsed) {
+      fStages[stage].record(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+    StageTimer time(id_t stage) { return StageTimer(*this, stage); }
+
+    std::size_t nCounters() const { return fCounterNames.size(); }
+    std::size_t nStages() const { return fStageNames.size(); }
+    std::string const& counterName(id_t counter) const { return fCounterNames[counter]; }
+    std::string const& stageName(id_t stage) const { return fStageNames[stage]; }
+    uint64_t counter(id_t counter) const { return fCounters[counter].load(std::memory_order_relaxed); }
+    LatencyHistogram const& stage(id_t stage) const { return fStages[stage]; }
+
+    // {"module": ..., "counters": {name: n, ...}, "stages": {name: {"n", "mean_us", "p50_us", "p90_us", "p99_us", "max_us"}, ...}}
+    std::string json(std::string const& module) const;
+
+  private:
+    // Deques, so registering does not move the atomics
+    std::vector<std::string> fCounterNames;
+    std::deque<std::atomic<uint64_t>> fCounters;
+    std::vector<std::string> fStageNames;
+    std::deque<LatencyHistogram> fStages;
+};
+
+}
+
+#endif
@@ -0,0 +1,227 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        DecisionCache.cc
+//////////////////////////////////////////////////////////////////////////
+
+#include "pdhdbsmdata/Algorithms/DecisionCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include "cetlib_except/exception.h"
+
+#include "pdhdbsmdata/Algorithms/MappedFile.h"
+#include "pdhdbsmdata/Algorithms/SpillTableIO.h"
+
+namespace pdhd {
+
+namespace {
+
+  // Advisory lock on a file next to the cache, held while a run is merged and written.
+  // File systems without flock, or a lock file that cannot be created, leave it unlocked.
+  class FileLock {
+    public:
+      explicit FileLock(std::string const& fileName) {
+        fFD = ::open(fileName.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fFD >= 0 && ::flock(fFD, LOCK_EX) != 0) {
+          ::close(fFD);
+          fFD = -1;
+        }
+      }
+      ~FileLock() {
+        if (fFD >= 0) ::close(fFD); // Releases the lock
+      }
+      FileLock(FileLock const&) = delete;
+      FileLock& operator=(FileLock const&) = delete;
+
+    private:
+      int fFD = -1;
+  };
+
+  // Temporary name no other job writing the same file uses
+  std::string tmpFileName(std::string const& fileName) {
+    char host[256] = {0};
+    if (::gethostname(host, sizeof(host) - 1) != 0) std::strcpy(host, "host");
+    return fileName + ".tmp." + host + "." + std::to_string(::getpid());
+  }
+
+}
+
+//-------------------------------------
+DecisionTable DecisionTable::read(std::string const& fileName) {
+  DecisionTable table;
+  table.fFile = std::make_shared<MappedFile>(fileName);
+  MappedFile const& file = *table.fFile;
+
+  if (file.size() < sizeof(DecisionCacheHeader)) {
+    throw cet::exception("DecisionCache") << fileName << " is too small to be a decision cache\n";
+  }
+  const DecisionCacheHeader *header = reinterpret_cast<const DecisionCacheHeader*>(file.data());
+  if (std::memcmp(header->magic, DecisionCacheHeader::kMagic, sizeof(header->magic)) != 0 || header->version != DecisionCacheHeader::kVersion) {
+    throw cet::exception("DecisionCache") << fileName << " is not a version " << DecisionCacheHeader::kVersion << " decision cache\n";
+  }
+  if (header->byte_order != DecisionCacheHeader::kByteOrder) {
+    throw cet::exception("DecisionCache") << fileName << " was written on a host of another byte order\n";
+  }
+
+  const std::size_t n = header->n_decisions;
+  const std::size_t expected = sizeof(DecisionCacheHeader) + n*(sizeof(DecisionKey) + sizeof(uint8_t));
+  if (file.size() != expected) {
+    throw cet::exception("DecisionCache") << fileName << " has " << file.size() << " bytes, expected "
+      << expected << " for " << n << " decisions\n";
+  }
+
+  const DecisionKey *keys = reinterpret_cast<const DecisionKey*>(file.data() + sizeof(DecisionCacheHeader));
+  const uint8_t *pass = reinterpret_cast<const uint8_t*>(keys + n);
+  if (fnv1a64(pass, n*sizeof(uint8_t), fnv1a64(keys, n*sizeof(DecisionKey))) != header->payload_checksum) {
+    throw cet::exception("DecisionCache") << fileName << " is corrupted, the payload checksum does not match\n";
+  }
+  if (std::adjacent_find(keys, keys + n, [] (DecisionKey const& a, DecisionKey const& b) { return !(a < b); }) != keys + n) {
+    throw cet::exception("DecisionCache") << fileName << " is corrupted, the decisions are not sorted\n";
+  }
+
+  table.fKeys = keys;
+  table.fPass = pass;
+  table.fSize = n;
+  table.fRun = header->run;
+  return table;
+}
+
+//-------------------------------------
+std::optional<bool> DecisionTable::find(DecisionKey const& key) const {
+  const DecisionKey *it = std::lower_bound(fKeys, fKeys + fSize, key);
+  if (it == fKeys + fSize || !(*it == key)) return std::nullopt;
+  return fPass[it - fKeys] != 0;
+}
+
+//-------------------------------------
+void writeDecisionTable(std::string const& fileName, uint32_t run,
+                        std::vector<std::pair<DecisionKey, bool>> const& decisions) {
+  const std::size_t n = decisions.size();
+  std::vector<DecisionKey> keys(n);
+  std::vector<uint8_t> pass(n);
+  for (std::size_t i = 0; i < n; i++) {
+    keys[i] = decisions[i].first;
+    pass[i] = decisions[i].second ? 1 : 0;
+  }
+
+  DecisionCacheHeader header;
+  std::memcpy(header.magic, DecisionCacheHeader::kMagic, sizeof(header.magic));
+  header.version = DecisionCacheHeader::kVersion;
+  header.byte_order = DecisionCacheHeader::kByteOrder;
+  header.run = run;
+  header.reserved = 0;
+  header.n_decisions = n;
+  header.payload_checksum = fnv1a64(pass.data(), n*sizeof(uint8_t), fnv1a64(keys.data(), n*sizeof(DecisionKey)));
+
+  // Each job writes its own temporary file, the rename is atomic
+  const std::string tmpName = tmpFileName(fileName);
+  {
+    std::ofstream out(tmpName, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(keys.data()), n*sizeof(DecisionKey));
+    out.write(reinterpret_cast<const char*>(pass.data()), n*sizeof(uint8_t));
+    out.close();
+    if (!out) {
+      std::remove(tmpName.c_str());
+      throw cet::exception("DecisionCache") << "Failed to write decision cache " << tmpName << "\n";
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(tmpName, fileName, ec);
+  if (ec) {
+    std::remove(tmpName.c_str());
+    throw cet::exception("DecisionCache") << "Failed to rename " << tmpName << " to " << fileName << ": " << ec.message() << "\n";
+  }
+}
+
+//-------------------------------------
+DecisionCacheMode parseDecisionCacheMode(std::string const& name) {
+  if (name == "readwrite") return DecisionCacheMode::kReadWrite;
+  if (name == "read") return DecisionCacheMode::kRead;
+  if (name == "write") return DecisionCacheMode::kWrite;
+  throw cet::exception("DecisionCache") << "Unknown DecisionCacheMode \"" << name
+    << "\", expected \"readwrite\", \"read\" or \"write\".\n";
+}
+
+//-------------------------------------
+DecisionCache::DecisionCache(std::string directory, DecisionCacheMode mode) :
+  fDirectory(std::move(directory)),
+  fMode(mode) {}
+
+//-------------------------------------
+std::string DecisionCache::fileName(std::string const& directory, uint32_t run) {
+  char name[64];
+  std::snprintf(name, sizeof(name), "decisionsrun%06u.pdhddec", run);
+  return (std::filesystem::path(directory) / name).string();
+}
+
+//-------------------------------------
+void DecisionCache::open(uint32_t run, std::string* error) {
+  flush();
+  fRun = run;
+  fTable = DecisionTable();
+  if (fMode == DecisionCacheMode::kWrite) return;
+
+  const std::string name = fileName(fDirectory, run);
+  if (!std::filesystem::exists(name)) return;
+  try {
+    fTable = DecisionTable::read(name);
+  }
+  catch (cet::exception const& e) {
+    if (error) *error = e.explain_self();
+  }
+}
+
+//-------------------------------------
+std::size_t DecisionCache::flush() {
+  std::lock_guard<std::mutex> flushLock(fFlushMutex);
+  std::vector<std::pair<DecisionKey, bool>> pending;
+  {
+    std::lock_guard<std::mutex> lock(fPendingMutex);
+    pending.swap(fPending);
+  }
+  if (!fRun || pending.empty()) return 0;
+
+  std::filesystem::create_directories(fDirectory);
+  const std::string name = fileName(fDirectory, *fRun);
+  const FileLock lock(name + ".lock");
+
+  // Merge with the file as it is now, another job may have added to it since the run was opened
+  std::vector<std::pair<DecisionKey, bool>> merged;
+  if (std::filesystem::exists(name)) {
+    try {
+      const DecisionTable current = DecisionTable::read(name);
+      merged.reserve(current.size() + pending.size());
+      for (std::size_t i = 0; i < current.size(); i++) merged.emplace_back(current.key(i), current.pass(i));
+    }
+    catch (cet::exception const&) {
+      // Unreadable, replaced by the new decisions
+    }
+  }
+  const std::size_t nStored = merged.size();
+  merged.insert(merged.end(), pending.begin(), pending.end());
+
+  // Stable, so of equal keys the new decision comes last and is the one kept
+  std::stable_sort(merged.begin(), merged.end(), [] (auto const& a, auto const& b) { return a.first < b.first; });
+  std::size_t out = 0;
+  for (std::size_t i = 0; i < merged.size(); i++) {
+    if (out > 0 && merged[out - 1].first == merged[i].first) merged[out - 1] = merged[i];
+    else merged[out++] = merged[i];
+  }
+  merged.resize(out);
+
+  writeDecisionTable(name, *fRun, merged);
+  return merged.size() > nStored ? merged.size() - nStored : 0;
+}
+
+}
@@ -0,0 +1,150 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       DecisionTable, DecisionCache
+//// File:        DecisionCache.h
+////
+//// On-disk cache of filter decisions, so a reprocessing of the same raw
+//// files can skip the filters. A decision is keyed by the subrun and
+//// event number and a hash of the filter configuration, and the
+//// decisions of one run are kept in one file, sorted by key:
+////
+////   DecisionCacheHeader             (40 bytes)
+////   DecisionKey keys[n_decisions]   sorted by config, subrun, event
+////   uint8_t pass[n_decisions]
+////
+//// Fields are in the byte order of the host that wrote the file, which
+//// the header records, so a file from a host of the other byte order is
+//// rejected rather than misread. The file is memory-mapped at the start
+//// of the run and looked up by binary search. New decisions are kept in
+//// memory and merged into the file at each flush, during or at the end
+//// of the run: the file on disk is read again, the merged table is
+//// written under a temporary name and renamed over it, so readers never
+//// see a partial file and lookups keep the table mapped at the start. An
+//// advisory lock serialises jobs updating the same run, where the file
+//// system supports it; without it a concurrent update can be lost, but
+//// the file is never corrupted.
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_ALGORITHMS_DECISIONCACHE_H
+#define PDHDBSMDATA_ALGORITHMS_DECISIONCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace pdhd {
+
+class MappedFile;
+
+struct DecisionCacheHeader {
+  static constexpr char kMagic[8] = {'P', 'D', 'H', 'D', 'D', 'E', 'C', 'S'};
+  static constexpr uint32_t kVersion = 2;
+  static constexpr uint32_t kByteOrder = 0x01020304; // Reads back the same on the host that wrote it
+
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t run;
+  uint32_t reserved;
+  uint64_t n_decisions;
+  uint64_t payload_checksum; // FNV-1a 64 of the keys and pass arrays
+};
+static_assert(sizeof(DecisionCacheHeader) == 40, "DecisionCacheHeader layout must not change");
+
+struct DecisionKey {
+  uint64_t config; // Hash of the filter configuration
+  uint32_t subrun;
+  uint32_t event;
+
+  bool operator<(DecisionKey const& other) const {
+    return std::tie(config, subrun, event) < std::tie(other.config, other.subrun, other.event);
+  }
+  bool operator==(DecisionKey const& other) const {
+    return config == other.config && subrun == other.subrun && event == other.event;
+  }
+};
+static_assert(sizeof(DecisionKey) == 16, "DecisionKey layout must not change");
+
+// Read-only decisions of one run, pointing into a mapped file
+class DecisionTable {
+  public:
+    DecisionTable() = default;
+
+    // Throws cet::exception if the file is not a valid decision cache
+    static DecisionTable read(std::string const& fileName);
+
+    std::optional<bool> find(DecisionKey const& key) const;
+    std::size_t size() const { return fSize; }
+    uint32_t run() const { return fRun; }
+    DecisionKey const& key(std::size_t i) const { return fKeys[i]; }
+    bool pass(std::size_t i) const { return fPass[i] != 0; }
+
+  private:
+    std::shared_ptr<MappedFile> fFile;
+    const DecisionKey *fKeys = nullptr;
+    const uint8_t *fPass = nullptr;
+    std::size_t fSize = 0;
+    uint32_t fRun = 0;
+};
+
+// Write the decisions, sorted by key with no duplicates, under a temporary name and rename
+void writeDecisionTable(std::string const& fileName, uint32_t run,
+                        std::vector<std::pair<DecisionKey, bool>> const& decisions);
+
+enum class DecisionCacheMode {
+  kReadWrite, // Use the stored decisions, store the new ones
+  kRead,      // Use the stored decisions, never write
+  kWrite      // Decide every event again and replace the stored decisions
+};
+
+// "readwrite", "read" or "write"; throws cet::exception otherwise
+DecisionCacheMode parseDecisionCacheMode(std::string const& name);
+
+// The cache of one filter in one job. Lookups, stores and flushes are
+// thread safe during a run; open is called between runs.
+class DecisionCache {
+  public:
+    DecisionCache(std::string directory, DecisionCacheMode mode);
+
+    static std::string fileName(std::string const& directory, uint32_t run);
+
+    // Flush the previous run and map the file of this run, if there is one. A file that
+    // cannot be read is ignored, and overwritten at the flush; the reason goes to error.
+    void open(uint32_t run, std::string* error = nullptr);
+    // Merge the new decisions of the run into its file, returns how many were added.
+    // Costs a read and a write of the whole file of the run.
+    std::size_t flush();
+
+    std::optional<bool> lookup(DecisionKey const& key) const {
+      if (fMode == DecisionCacheMode::kWrite) return std::nullopt;
+      return fTable.find(key);
+    }
+    // Returns how many decisions wait for the next flush
+    std::size_t store(DecisionKey const& key, bool pass) {
+      if (fMode == DecisionCacheMode::kRead) return 0;
+      std::lock_guard<std::mutex> lock(fPendingMutex);
+      fPending.emplace_back(key, pass);
+      return fPending.size();
+    }
+
+    DecisionCacheMode mode() const { return fMode; }
+    std::size_t loaded() const { return fTable.size(); }
+
+  private:
+    std::string fDirectory;
+    DecisionCacheMode fMode;
+    std::optional<uint32_t> fRun;
+    DecisionTable fTable;
+
+    std::mutex fPendingMutex;
+    std::vector<std::pair<DecisionKey, bool>> fPending;
+    std::mutex fFlushMutex; // The file lock may not be supported by the file system
+};
+
+}
+
+#endif
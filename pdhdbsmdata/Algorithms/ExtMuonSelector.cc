@@ -0,0 +1,192 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        ExtMuonSelector.cc
+//////////////////////////////////////////////////////////////////////////
+
+#include "pdhdbsmdata/Algorithms/ExtMuonSelector.h"
+
+#include <algorithm>
+
+#include "detdataformats/trigger/TriggerPrimitive.hpp"
+
+namespace pdhd {
+
+using timestamp_t = dunedaq::trgdataformats::timestamp_t;
+using channel_t = dunedaq::trgdataformats::channel_t;
+
+namespace {
+  // Main collection face of APA 3, the upstream face of the beam-side TPCs
+  constexpr chmap::ChannelRange pCollectionAPA3IDs = chmap::mainCollectionRange(3);
+}
+
+//-------------------------------------
+const char* extMuonCutName(ExtMuonCut cut) {
+  switch (cut) {
+    case ExtMuonCut::kNoTPs: return "tas_skipped_no_tps";
+    case ExtMuonCut::kPassedAPA12: return "tas_passed_apa_1_2";
+    case ExtMuonCut::kOutsideMainAPA: return "tas_skipped_outside_main_apa";
+    case ExtMuonCut::kUpstreamVeto: return "tas_failed_upstream_veto";
+    case ExtMuonCut::kPassedVeto: return "tas_passed_upstream_veto";
+    default: return "unknown";
+  }
+}
+
+//-------------------------------------
+ExtMuonDecision ExtMuonSelector::findShowers(TPIndex const& tpIndex, TraceSink const& log) const {
+  const TPColumns &taTPs = tpIndex.ta_tps;
+  ExtMuonDecision decision;
+
+  for (size_t ta = 0; ta < tpIndex.nTAs(); ta++) {
+    PDHD_TRACE(log, TraceLevel::kDebug) << "START TA " << ta << " out of " << tpIndex.nTAs();
+    decision.tasSeen++;
+    // TPs of this TA are rows [ta_begin, ta_end) of taTPs, in channel order
+    const size_t ta_begin = tpIndex.taBegin(ta);
+    const size_t n_tps = tpIndex.taSize(ta);
+
+    PDHD_TRACE(log, TraceLevel::kDebug) << "Found " << n_tps << " TPs in TA " << ta;
+    if (n_tps == 0) {
+      PDHD_TRACE(log, TraceLevel::kWarning) << " [WARNING] TA " << ta << " has no TPs, skipping.";
+      decision.count(ExtMuonCut::kNoTPs);
+      continue;
+    }
+
+    timestamp_t first_tick = tpIndex.ta_time_start[ta];
+    timestamp_t last_tick = tpIndex.ta_time_end[ta];
+
+    channel_t current_chan = taTPs.channel[ta_begin];
+
+    PDHD_TRACE(log, TraceLevel::kDebug) << "First tick = " << first_tick << ", last tick = " << last_tick;
+    PDHD_TRACE(log, TraceLevel::kDebug) << "First channel = " << current_chan;
+
+    // APA of the main collection face holding the first channel of the TA, 0 if none
+    const int apa_id = chmap::mainCollectionAPA(current_chan);
+
+    PDHD_TRACE(log, TraceLevel::kDebug) << "APA ID = " << apa_id;
+    if (apa_id == 3 || apa_id == 4) {
+      PDHD_TRACE(log, TraceLevel::kDebug) << "IS IN APA 3 OR 4";
+    } else if (apa_id == 1 || apa_id == 2) {
+      // No veto for these TAs, so this TA passes and with it the whole event
+      PDHD_TRACE(log, TraceLevel::kDebug) << "IS IN APA 1 OR 2 - don't do anything";
+      decision.count(ExtMuonCut::kPassedAPA12);
+      decision.passedTAs.push_back(ta);
+      decision.passedWindows.push_back({first_tick, last_tick});
+      decision.decided = true;
+      decision.pass = true;
+      return decision;
+    } else {
+      PDHD_TRACE(log, TraceLevel::kInfo) << " Not in any of the main TPCs, removing TA.";
+      decision.count(ExtMuonCut::kOutsideMainAPA);
+      continue;
+    }
+
+    uint32_t adc_integral_sum(0);
+    uint32_t tp_mult_sum(0);
+    std::vector<uint32_t> v_adc_integral_sum_perchan;
+    std::vector<uint32_t> v_tp_mult_sum_perchan;
+    for (size_t tp = 0; tp < n_tps; tp++) {
+      channel_t new_chan = taTPs.channel[ta_begin + tp];
+      if (new_chan != current_chan) {
+        current_chan = new_chan;
+        v_adc_integral_sum_perchan.push_back(adc_integral_sum);
+        v_tp_mult_sum_perchan.push_back(tp_mult_sum);
+        adc_integral_sum = 0;
+        tp_mult_sum = 0;
+      } else if (new_chan == current_chan) {
+        adc_integral_sum += taTPs.adc_integral[ta_begin + tp];
+        tp_mult_sum++;
+      }
+    }
+
+    PDHD_TRACE(log, TraceLevel::kDebug) << "TP multiplicity of " << tp_mult_sum << " reached at channel " << current_chan;
+
+    PDHD_TRACE(log, TraceLevel::kDebug) << "tp_mult_sum vector has size " << v_tp_mult_sum_perchan.size();
+    // Get the channel that is definitely in the shower
+    uint32_t tp_thresh(200);
+    uint32_t tp_counter(0);
+    channel_t th_chan = dunedaq::trgdataformats::INVALID_CHANNEL;
+    for (size_t ch = 0; ch < v_tp_mult_sum_perchan.size(); ch++) {
+      tp_counter += v_tp_mult_sum_perchan.at(ch);
+      if (tp_counter > tp_thresh) {
+        th_chan = taTPs.channel[ta_begin + ch];
+        break;
+      } else {
+        th_chan = taTPs.channel[ta_begin + ch];
+      }
+    }
+    PDHD_TRACE(log, TraceLevel::kDebug) << "Threshold channel = " << th_chan;
+
+    std::vector<timestamp_t> fTPTimeStampsToThresh;
+    for (size_t tp = 0; tp < n_tps; tp++) {
+      if (taTPs.channel[ta_begin + tp] <= th_chan) {
+        timestamp_t norm_time = taTPs.time_peak[ta_begin + tp] - first_tick;
+        fTPTimeStampsToThresh.push_back(norm_time);
+      }
+    }
+    // Calculate average timestamp up to threshold
+    timestamp_t sum_time = 0;
+    int N(0);
+    for (const auto &time : fTPTimeStampsToThresh) {
+      sum_time += time;
+      N++;
+    }
+    timestamp_t average_timestamps = sum_time / N;
+
+    PDHD_TRACE(log, TraceLevel::kDebug) << "time sum = " << sum_time << "; average time = " << average_timestamps;
+
+    double shower_stddev = 5000.;
+
+    timestamp_t shower_centre = static_cast<timestamp_t>(first_tick + average_timestamps);
+    timestamp_t shower_upper_bound = static_cast<timestamp_t>(first_tick + average_timestamps + shower_stddev);
+    timestamp_t shower_lower_bound = static_cast<timestamp_t>(first_tick + average_timestamps - shower_stddev);
+
+    PDHD_TRACE(log, TraceLevel::kDebug) << "TA: " << ta << "... Shower centre = " << shower_lower_bound << " < " << shower_centre << " < " << shower_upper_bound;
+
+    decision.windows.push_back({shower_lower_bound, shower_upper_bound});
+    decision.windowTAs.push_back(ta);
+  }
+
+  if (decision.windows.empty()) {
+    PDHD_TRACE(log, TraceLevel::kInfo) << "No TA in APA 3 or 4 to check, removing.";
+    decision.decided = true;
+    decision.pass = false;
+  }
+  return decision;
+}
+
+//-------------------------------------
+void ExtMuonSelector::applyVeto(TPIndex const& tpIndex, ExtMuonDecision& decision, TraceSink const& log) const {
+  const TPColumns &detTPs = tpIndex.detector;
+
+  // Look at all TPs in APA 3 and look for track in small time window
+  // Events in with trigger APA 1 or 2 should already have passed filter
+  // The APA 3 collection plane partition of the index is already in channel order
+  channel_t start_chan = pCollectionAPA3IDs.first;
+  // Look at first 40 channels
+  channel_t end_chan = pCollectionAPA3IDs.first + fUpstreamVetoChannels;
+  channel_t veto_threshold = 0.9 * fUpstreamVetoChannels;
+
+  const auto chan_begin = detTPs.channel.begin();
+  const size_t veto_begin = std::lower_bound(chan_begin + tpIndex.partitionBegin(3, chmap::kX), chan_begin + tpIndex.partitionEnd(3, chmap::kX), start_chan) - chan_begin;
+  const size_t veto_end = std::upper_bound(chan_begin + veto_begin, chan_begin + tpIndex.partitionEnd(3, chmap::kX), end_chan) - chan_begin;
+
+  const std::vector<size_t> window_counts = sweepVetoWindows(fVetoCountMode, {start_chan, end_chan},
+      detTPs.channel.data() + veto_begin, detTPs.time_peak.data() + veto_begin, veto_end - veto_begin, decision.windows);
+
+  decision.pass = false;
+  for (size_t w = 0; w < decision.windows.size(); w++) {
+    int number_hits_window = window_counts[w];
+    // Fail TA if more than 90% of channels in the first fUpstreamVetoChannels on APA 3 collection plane have TP hits
+    if (number_hits_window >= static_cast<int>(veto_threshold)) {
+      PDHD_TRACE(log, TraceLevel::kInfo) << "TA " << decision.windowTAs[w] << ": There are " << number_hits_window << " hits in first " << fUpstreamVetoChannels << " APA 3 collection plane channels so remove.";
+      decision.count(ExtMuonCut::kUpstreamVeto);
+    } else {
+      PDHD_TRACE(log, TraceLevel::kInfo) << "TA " << decision.windowTAs[w] << ": There are " << number_hits_window << " hits in first " << fUpstreamVetoChannels <<  " collection plane. No external muon so pass filter!";
+      decision.count(ExtMuonCut::kPassedVeto);
+      decision.passedTAs.push_back(decision.windowTAs[w]);
+      decision.passedWindows.push_back(decision.windows[w]);
+      decision.pass = true;
+    }
+  }
+  decision.decided = true;
+}
+
+}
@@ -0,0 +1,85 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       ExtMuonSelector
+//// File:        ExtMuonSelector.h
+////
+//// External muon cut of PDHDExtMuonFilter, kept free of art so the
+//// fused PDHDBSMSelection module makes the same decision. A TA on
+//// APA 1 or 2 passes the event. A TA on APA 3 or 4 gets a shower time
+//// window, and passes if the first veto channels of the APA 3 collection
+//// face are quiet in it. The event passes if any TA passes.
+////
+//// The decision is made in two steps, so the caller can time the sweep:
+//// findShowers() walks the TAs and may already decide the event, and
+//// applyVeto() counts all shower windows in one sweep.
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_ALGORITHMS_EXTMUONSELECTOR_H
+#define PDHDBSMDATA_ALGORITHMS_EXTMUONSELECTOR_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "pdhdbsmdata/Algorithms/PDHDChannelMap.h"
+#include "pdhdbsmdata/Algorithms/TPOccupancyIndex.h"
+#include "pdhdbsmdata/Algorithms/TraceBuffer.h"
+#include "pdhdbsmdata/Algorithms/VetoWindowSweep.h"
+#include "pdhdbsmdata/DataProducts/TPIndex.h"
+
+namespace pdhd {
+
+// What happened to each TA, the cut-flow counters of the filter
+enum class ExtMuonCut : uint8_t {
+  kNoTPs,
+  kPassedAPA12,
+  kOutsideMainAPA,
+  kUpstreamVeto,
+  kPassedVeto,
+  kNCuts
+};
+
+// Counter name of a cut, e.g. "tas_failed_upstream_veto"
+const char* extMuonCutName(ExtMuonCut cut);
+
+struct ExtMuonDecision {
+  bool decided = false;
+  bool pass = false;
+  std::size_t tasSeen = 0;
+  std::array<std::size_t, static_cast<std::size_t>(ExtMuonCut::kNCuts)> tas{}; // TAs per cut
+  std::vector<VetoWindow> windows; // Shower window of each TA on APA 3 or 4
+  std::vector<std::size_t> windowTAs;
+  std::vector<std::size_t> passedTAs;    // TAs that passed the event
+  std::vector<VetoWindow> passedWindows; // ... and their shower window, the TA time range on APA 1 or 2
+
+  void count(ExtMuonCut cut) { tas[static_cast<std::size_t>(cut)]++; }
+};
+
+class ExtMuonSelector {
+  public:
+    ExtMuonSelector(uint32_t upstreamVetoChannels, VetoCountMode vetoCountMode) :
+      fUpstreamVetoChannels(upstreamVetoChannels),
+      fVetoCountMode(vetoCountMode) {}
+
+    // Shower windows of the TAs, deciding the event if a TA is on APA 1 or 2 or none is on APA 3 or 4
+    ExtMuonDecision findShowers(TPIndex const& tpIndex, TraceSink const& log) const;
+    // Upstream veto of the shower windows, deciding the event
+    void applyVeto(TPIndex const& tpIndex, ExtMuonDecision& decision, TraceSink const& log) const;
+
+    ExtMuonDecision select(TPIndex const& tpIndex, TraceSink const& log) const {
+      ExtMuonDecision decision = findShowers(tpIndex, log);
+      if (!decision.decided) applyVeto(tpIndex, decision, log);
+      return decision;
+    }
+
+    uint32_t upstreamVetoChannels() const { return fUpstreamVetoChannels; }
+    VetoCountMode vetoCountMode() const { return fVetoCountMode; }
+
+  private:
+    uint32_t fUpstreamVetoChannels;
+    VetoCountMode fVetoCountMode;
+};
+
+}
+
+#endif
@@ -0,0 +1,151 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       FixedAxis, FixedHist1D, FixedHist2D
+//// File:        FixedHist.h
+////
+//// Small fixed-bin histograms kept on the stack or in a member, used by
+//// the filters instead of booking ROOT histograms for every TA.
+//// Bin numbering, under/overflow, bin lookup, GetBinContent clamping,
+//// GetBinCenter outside the axis, GetMaximumBin and the TH2 projections
+//// follow ROOT's TH1D/TH2D exactly, so code written against the ROOT
+//// histograms makes the same decisions on these.
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_ALGORITHMS_FIXEDHIST_H
+#define PDHDBSMDATA_ALGORITHMS_FIXEDHIST_H
+
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+namespace pdhd {
+
+class FixedAxis {
+  public:
+    FixedAxis(int nbins, double xmin, double xmax) : fNbins(nbins), fXmin(xmin), fXmax(xmax) {}
+
+    int nBins() const { return fNbins; }
+    double xMin() const { return fXmin; }
+    double xMax() const { return fXmax; }
+    double binWidth() const { return (fXmax - fXmin) / double(fNbins); }
+
+    // 0 below the axis, nBins()+1 above it or for NaN, as TAxis::FindFixBin
+    int findBin(double x) const {
+      if (x < fXmin) return 0;
+      if (!(x < fXmax)) return fNbins + 1;
+      return 1 + int(fNbins * (x - fXmin) / (fXmax - fXmin));
+    }
+    // Extrapolated for bins outside 1..nBins(), as TAxis::GetBinCenter
+    double binCenter(int bin) const { return fXmin + (bin - 1) * binWidth() + 0.5 * binWidth(); }
+    double binLowEdge(int bin) const { return fXmin + (bin - 1) * binWidth(); }
+
+  private:
+    int fNbins;
+    double fXmin;
+    double fXmax;
+};
+
+class FixedHist1D {
+  public:
+    FixedHist1D(int nbins, double xmin, double xmax) : FixedHist1D(FixedAxis(nbins, xmin, xmax)) {}
+    explicit FixedHist1D(FixedAxis const& axis) :
+      fAxis(axis),
+      fSumW(axis.nBins() + 2, 0.),
+      fSumW2(axis.nBins() + 2, 0.) {}
+
+    FixedAxis const& axis() const { return fAxis; }
+    int nBins() const { return fAxis.nBins(); }
+    int nCells() const { return fAxis.nBins() + 2; }
+
+    void fill(double x, double w = 1.) { addBinContent(fAxis.findBin(x), w, w * w); }
+    void addBinContent(int bin, double w, double w2) {
+      fSumW[bin] += w;
+      fSumW2[bin] += w2;
+    }
+
+    // Bins below 0 read the underflow and bins past the overflow read the overflow, as TH1::GetBinContent
+    double binContent(int bin) const { return fSumW[clamp(bin)]; }
+    double binError(int bin) const { return std::sqrt(fSumW2[clamp(bin)]); }
+    double binSumW2(int bin) const { return fSumW2[clamp(bin)]; }
+    double binCenter(int bin) const { return fAxis.binCenter(bin); }
+    int findBin(double x) const { return fAxis.findBin(x); }
+
+    // First bin in 1..nBins() with the largest content, as TH1::GetMaximumBin
+    int maximumBin() const {
+      double maximum = -FLT_MAX;
+      int bin = 0;
+      for (int b = 1; b <= nBins(); b++) {
+        if (fSumW[b] > maximum) {
+          maximum = fSumW[b];
+          bin = b;
+        }
+      }
+      return bin;
+    }
+
+  private:
+    int clamp(int bin) const { return bin < 0 ? 0 : (bin >= nCells() ? nCells() - 1 : bin); }
+
+    FixedAxis fAxis;
+    std::vector<double> fSumW;
+    std::vector<double> fSumW2;
+};
+
+class FixedHist2D {
+  public:
+    FixedHist2D(int nx, double xmin, double xmax, int ny, double ymin, double ymax) :
+      fXaxis(nx, xmin, xmax),
+      fYaxis(ny, ymin, ymax),
+      fSumW((nx + 2) * (ny + 2), 0.),
+      fSumW2((nx + 2) * (ny + 2), 0.) {}
+
+    FixedAxis const& xAxis() const { return fXaxis; }
+    FixedAxis const& yAxis() const { return fYaxis; }
+
+    // Global bin as TH2::GetBin, including under/overflow
+    int bin(int binx, int biny) const { return binx + (fXaxis.nBins() + 2) * biny; }
+
+    void fill(double x, double y, double w = 1.) {
+      const int b = bin(fXaxis.findBin(x), fYaxis.findBin(y));
+      fSumW[b] += w;
+      fSumW2[b] += w * w;
+    }
+
+    double binContent(int binx, int biny) const { return fSumW[bin(binx, biny)]; }
+    double binSumW2(int binx, int biny) const { return fSumW2[bin(binx, biny)]; }
+
+    // Sum over the x bins firstXBin..lastXBin, by default all of them including
+    // under/overflow, with the range clamping of TH2::ProjectionY
+    FixedHist1D projectionY(int firstXBin = 0, int lastXBin = -1) const {
+      return project(fYaxis, fXaxis, firstXBin, lastXBin, false);
+    }
+    FixedHist1D projectionX(int firstYBin = 0, int lastYBin = -1) const {
+      return project(fXaxis, fYaxis, firstYBin, lastYBin, true);
+    }
+
+  private:
+    FixedHist1D project(FixedAxis const& outAxis, FixedAxis const& inAxis, int first, int last, bool outIsX) const {
+      if (first < 0) first = 0;
+      if (last < 0 || last > inAxis.nBins() + 1) last = inAxis.nBins() + 1;
+
+      FixedHist1D projection(outAxis);
+      for (int out = 0; out <= outAxis.nBins() + 1; out++) {
+        double sumw = 0., sumw2 = 0.;
+        for (int in = first; in <= last; in++) {
+          const int b = outIsX ? bin(out, in) : bin(in, out);
+          sumw += fSumW[b];
+          sumw2 += fSumW2[b];
+        }
+        projection.addBinContent(out, sumw, sumw2);
+      }
+      return projection;
+    }
+
+    FixedAxis fXaxis;
+    FixedAxis fYaxis;
+    std::vector<double> fSumW;
+    std::vector<double> fSumW2;
+};
+
+}
+
+#endif
@@ -0,0 +1,175 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        GaussianEstimator.cc
+//////////////////////////////////////////////////////////////////////////
+
+#include "pdhdbsmdata/Algorithms/GaussianEstimator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace pdhd {
+
+namespace {
+
+  struct Point {
+    double u;  // Bin centre, shifted and scaled
+    double y;  // Bin content
+    double e2; // Bin error squared
+  };
+
+  // Solve the 3x3 symmetric system a.x = b by Cramer's rule
+  bool solve3(const double a[3][3], const double b[3], double x[3]) {
+    const double det = a[0][0] * (a[1][1] * a[2][2] - a[1][2] * a[2][1])
+                     - a[0][1] * (a[1][0] * a[2][2] - a[1][2] * a[2][0])
+                     + a[0][2] * (a[1][0] * a[2][1] - a[1][1] * a[2][0]);
+    if (!std::isfinite(det) || det == 0.) return false;
+    for (int k = 0; k < 3; k++) {
+      double m[3][3];
+      for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) m[i][j] = (j == k) ? b[i] : a[i][j];
+      }
+      x[k] = (m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+            - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+            + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0])) / det;
+    }
+    return true;
+  }
+
+}
+
+//-------------------------------------
+GaussianEstimate estimateGaussian(FixedHist1D const& hist, double xmin, double xmax, int iterations) {
+  GaussianEstimate estimate;
+
+  // Work in u = (x - centre) / scale so that the normal equations stay well conditioned
+  const double centre = 0.5 * (xmin + xmax);
+  const double scale = xmax > xmin ? 0.5 * (xmax - xmin) : 1.;
+
+  std::vector<Point> points;
+  for (int b = 1; b <= hist.nBins(); b++) {
+    const double x = hist.binCenter(b);
+    if (x < xmin || x > xmax || hist.binContent(b) <= 0.) continue;
+    const double e2 = hist.binSumW2(b) > 0. ? hist.binSumW2(b) : hist.binContent(b);
+    points.push_back({(x - centre) / scale, hist.binContent(b), e2});
+  }
+  estimate.nBins = points.size();
+  if (points.size() < 3) return estimate;
+
+  // Seed: log-parabola by weighted least squares, model value at each point used in the weights
+  std::vector<double> model(points.size());
+  for (size_t i = 0; i < points.size(); i++) model[i] = points[i].y;
+
+  double coef[3] = {0., 0., 0.};
+  bool seeded = true;
+  for (int it = 0; it < (iterations < 1 ? 1 : iterations) && seeded; it++) {
+    double a[3][3] = {{0., 0., 0.}, {0., 0., 0.}, {0., 0., 0.}};
+    double rhs[3] = {0., 0., 0.};
+    for (size_t i = 0; i < points.size(); i++) {
+      // var(ln y) = e^2 / y^2, evaluated at the model
+      const double w = model[i] * model[i] / points[i].e2;
+      const double u = points[i].u;
+      const double basis[3] = {1., u, u * u};
+      const double ly = std::log(points[i].y);
+      for (int r = 0; r < 3; r++) {
+        rhs[r] += w * basis[r] * ly;
+        for (int c = 0; c < 3; c++) a[r][c] += w * basis[r] * basis[c];
+      }
+    }
+    seeded = solve3(a, rhs, coef) && coef[2] < 0.;
+    for (size_t i = 0; seeded && i < points.size(); i++) {
+      const double u = points[i].u;
+      model[i] = std::exp(coef[0] + coef[1] * u + coef[2] * u * u);
+      seeded = std::isfinite(model[i]) && model[i] > 0.;
+    }
+  }
+
+  // Gaussian parameters (amplitude, mean, sigma) in u. Without a seed, the start values of the
+  // Minuit fit the filter used: the highest bin and a sigma of 1000 in x
+  double p[3];
+  if (seeded) {
+    p[0] = std::exp(coef[0] - coef[1] * coef[1] / (4. * coef[2]));
+    p[1] = -coef[1] / (2. * coef[2]);
+    p[2] = std::sqrt(-1. / (2. * coef[2]));
+  } else {
+    const Point *peak = &points[0];
+    for (const auto &point : points) if (point.y > peak->y) peak = &point;
+    p[0] = peak->y;
+    p[1] = peak->u;
+    p[2] = 1000. / scale;
+  }
+  if (!(std::isfinite(p[0]) && std::isfinite(p[1]) && std::isfinite(p[2]))) {
+    estimate.status = GaussianEstimate::kNumerical;
+    return estimate;
+  }
+
+  // Levenberg-Marquardt on the chi2 of the Gaussian, the function the Minuit fit minimised
+  auto chi2 = [&] (const double q[3]) {
+    double sum = 0.;
+    for (const auto &point : points) {
+      const double z = (point.u - q[1]) / q[2];
+      const double r = point.y - q[0] * std::exp(-0.5 * z * z);
+      sum += r * r / point.e2;
+    }
+    return sum;
+  };
+
+  double current = chi2(p);
+  double lambda = 1e-3;
+  bool converged = false;
+  for (int it = 0; it < kMaxFitIterations && !converged; it++) {
+    double jtj[3][3] = {{0., 0., 0.}, {0., 0., 0.}, {0., 0., 0.}};
+    double jtr[3] = {0., 0., 0.};
+    for (const auto &point : points) {
+      const double z = (point.u - p[1]) / p[2];
+      const double g = std::exp(-0.5 * z * z);
+      const double value = p[0] * g;
+      const double d[3] = {g, value * z / p[2], value * z * z / p[2]};
+      const double w = 1. / point.e2;
+      for (int r = 0; r < 3; r++) {
+        jtr[r] += w * d[r] * (point.y - value);
+        for (int c = 0; c < 3; c++) jtj[r][c] += w * d[r] * d[c];
+      }
+    }
+
+    // Steps that do not lower the chi2 raise lambda, towards a short gradient step
+    while (true) {
+      double a[3][3];
+      for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 3; c++) a[r][c] = jtj[r][c] + (r == c ? lambda * jtj[r][r] : 0.);
+      }
+      double dp[3];
+      if (!solve3(a, jtr, dp)) {
+        estimate.status = GaussianEstimate::kNumerical;
+        return estimate;
+      }
+      const double trial[3] = {p[0] + dp[0], p[1] + dp[1], p[2] + dp[2]};
+      const double next = chi2(trial);
+      if (std::isfinite(next) && next <= current) {
+        converged = current - next < 1e-9 * (1. + current);
+        std::copy(trial, trial + 3, p);
+        current = next;
+        lambda = std::max(lambda / 10., 1e-12);
+        break;
+      }
+      lambda *= 10.;
+      if (lambda > 1e12) {
+        // No step lowers the chi2: at the minimum
+        converged = true;
+        break;
+      }
+    }
+  }
+
+  estimate.amplitude = p[0];
+  estimate.mean = centre + scale * p[1];
+  estimate.sigma = scale * std::abs(p[2]);
+  estimate.chi2 = current;
+
+  const bool finite = std::isfinite(estimate.mean) && std::isfinite(estimate.sigma) && std::isfinite(estimate.amplitude);
+  if (!finite) estimate.status = GaussianEstimate::kNumerical;
+  else estimate.status = converged ? GaussianEstimate::kOK : GaussianEstimate::kNotConverged;
+  return estimate;
+}
+
+}
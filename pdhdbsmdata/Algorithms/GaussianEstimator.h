@@ -0,0 +1,45 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        GaussianEstimator.h
+////
+//// Gaussian peak fit of a FixedHist1D without Minuit. It minimises the
+//// same chi2 as TH1::Fit(gaus, "R") with Levenberg-Marquardt steps. The
+//// start values come from a parabola fitted to the log of the bin
+//// contents by weighted linear least squares (Caruana's method), with
+//// the weights (model / bin error)^2 refined for a few passes, so the
+//// fit usually converges in a handful of steps. If the log-parabola has
+//// no peak, the fit starts from the highest bin instead, as the Minuit
+//// fit of PDHDVertexFilter did. As in the "R" fit, only bins 1..N whose
+//// centre is inside the range and that have a non-zero content are used.
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_ALGORITHMS_GAUSSIANESTIMATOR_H
+#define PDHDBSMDATA_ALGORITHMS_GAUSSIANESTIMATOR_H
+
+#include "pdhdbsmdata/Algorithms/FixedHist.h"
+
+namespace pdhd {
+
+struct GaussianEstimate {
+  enum Status {
+    kOK = 0,
+    kTooFewBins = 1,  // Fewer than 3 bins with content in the range
+    kNumerical = 3,   // Singular system or non-finite result
+    kNotConverged = 4 // The chi2 still fell after kMaxFitIterations steps
+  };
+
+  double amplitude = 0.;
+  double mean = 0.;
+  double sigma = 0.;
+  double chi2 = 0.; // Of the Gaussian against the bins used, the minimum
+  int nBins = 0;    // Bins used
+  int status = kTooFewBins;
+};
+
+constexpr int kMaxFitIterations = 200;
+
+// Fit in [xmin, xmax]; iterations >= 1 weighted least squares passes for the start values
+GaussianEstimate estimateGaussian(FixedHist1D const& hist, double xmin, double xmax, int iterations = 3);
+
+}
+
+#endif
@@ -0,0 +1,58 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        MappedFile.cc
+//////////////////////////////////////////////////////////////////////////
+
+#include "pdhdbsmdata/Algorithms/MappedFile.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cetlib_except/exception.h"
+
+namespace pdhd {
+
+//-------------------------------------
+MappedFile::MappedFile(std::string const& fileName) :
+  fFileName(fileName) {
+
+  int fd = ::open(fileName.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw cet::exception("MappedFile") << "Cannot open " << fileName << ": " << std::strerror(errno) << "\n";
+  }
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    const int err = errno;
+    ::close(fd);
+    throw cet::exception("MappedFile") << "Cannot stat " << fileName << ": " << std::strerror(err) << "\n";
+  }
+
+  fSize = static_cast<std::size_t>(st.st_size);
+  if (fSize > 0) {
+    void *addr = ::mmap(nullptr, fSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      const int err = errno;
+      ::close(fd);
+      throw cet::exception("MappedFile") << "Cannot map " << fileName << ": " << std::strerror(err) << "\n";
+    }
+    // The whole file is read front to back
+    ::madvise(addr, fSize, MADV_SEQUENTIAL);
+    fData = static_cast<const char*>(addr);
+  }
+  // The mapping stays valid after the descriptor is closed
+  ::close(fd);
+}
+
+//-------------------------------------
+MappedFile::~MappedFile() {
+  if (fData) {
+    ::munmap(const_cast<char*>(fData), fSize);
+  }
+}
+
+}
@@ -0,0 +1,41 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       MappedFile
+//// File:        MappedFile.h
+////
+//// Read-only memory mapping of a whole file. The mapping is released
+//// when the object is destroyed, so hold it in a shared_ptr for as long
+//// as any view into the data is in use.
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_ALGORITHMS_MAPPEDFILE_H
+#define PDHDBSMDATA_ALGORITHMS_MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace pdhd {
+
+class MappedFile {
+  public:
+    // Throws cet::exception if the file cannot be opened or mapped
+    explicit MappedFile(std::string const& fileName);
+    ~MappedFile();
+
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+
+    const char* data() const { return fData; }
+    std::size_t size() const { return fSize; }
+    std::string_view view() const { return std::string_view(fData, fSize); }
+    std::string const& fileName() const { return fFileName; }
+
+  private:
+    std::string fFileName;
+    const char* fData = nullptr;
+    std::size_t fSize = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,135 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       PDHDChannelMap
+//// File:        PDHDChannelMap.h
+////
+//// Compile-time table of the ProtoDUNE-HD offline channel layout, the
+//// one place where the filters get APA, plane, face and local wire of a
+//// channel. Lookups are a clamped array access, so the per-TP
+//// classification has no range checks.
+////
+//// Channels come in four blocks of 2560, one per APA, in the order
+//// APA 1, 3, 2, 4 (the APA numbering used by the filters). Inside a
+//// block the U plane is 0-799, the V plane 800-1599 and the collection
+//// plane 1600-2559, with 480 channels on each face. The induction wires
+//// wrap around the APA, so U and V channels have no single face.
+////
+//// The "main" collection face of an APA is the one reading out the
+//// beam-side drift volume (TPCs 1, 2, 5 and 6); it is the face used by
+//// the TP-based filters.
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_ALGORITHMS_PDHDCHANNELMAP_H
+#define PDHDBSMDATA_ALGORITHMS_PDHDCHANNELMAP_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+namespace pdhd {
+
+namespace chmap {
+
+  constexpr uint32_t kNAPAs = 4;
+  constexpr uint32_t kChannelsPerAPA = 2560;
+  constexpr uint32_t kNChannels = kNAPAs * kChannelsPerAPA;
+  constexpr uint32_t kChannelsPerInductionPlane = 800;
+  constexpr uint32_t kChannelsPerCollectionFace = 480;
+  constexpr uint32_t kFirstCollectionChannel = 2 * kChannelsPerInductionPlane;
+
+  enum Plane : uint8_t { kU = 0, kV = 1, kX = 2, kNoPlane = 3 };
+  constexpr uint8_t kNoFace = 2;  // Induction channels and channels outside the detector
+  constexpr uint8_t kNoAPA = 0;
+
+  // APA number of each channel block and the inverse
+  constexpr uint8_t kAPAOfBlock[kNAPAs] = {1, 3, 2, 4};
+  constexpr uint8_t kBlockOfAPA[kNAPAs + 1] = {0, 0, 2, 1, 3};
+  // Main (beam-side) collection face of APA 1-4, and the TPC it reads out in the geometry
+  constexpr uint8_t kMainFaceOfAPA[kNAPAs + 1] = {0, 1, 1, 0, 0};
+  constexpr uint8_t kMainTPCOfAPA[kNAPAs + 1] = {0, 1, 5, 2, 6};
+
+  struct ChannelInfo {
+    uint8_t apa = kNoAPA;     // 1-4, kNoAPA outside the detector
+    uint8_t plane = kNoPlane; // kU, kV or kX
+    uint8_t face = kNoFace;   // 0 or 1 for collection channels
+    bool mainCollection = false;
+    uint16_t wire = 0;        // Position of the channel in its plane (face for collection)
+
+    constexpr bool valid() const { return apa != kNoAPA; }
+    constexpr bool isCollection() const { return plane == kX; }
+  };
+
+  struct ChannelRange {
+    uint32_t first;
+    uint32_t last; // Inclusive
+    constexpr bool contains(uint32_t channel) const { return channel >= first && channel <= last; }
+    constexpr uint32_t size() const { return last - first + 1; }
+  };
+
+  constexpr ChannelInfo makeChannelInfo(uint32_t channel) {
+    ChannelInfo info;
+    if (channel >= kNChannels) return info;
+
+    const uint32_t local = channel % kChannelsPerAPA;
+    info.apa = kAPAOfBlock[channel / kChannelsPerAPA];
+    if (local < kFirstCollectionChannel) {
+      info.plane = local < kChannelsPerInductionPlane ? kU : kV;
+      info.wire = local % kChannelsPerInductionPlane;
+    } else {
+      info.plane = kX;
+      info.face = (local - kFirstCollectionChannel) / kChannelsPerCollectionFace;
+      info.wire = (local - kFirstCollectionChannel) % kChannelsPerCollectionFace;
+      info.mainCollection = (info.face == kMainFaceOfAPA[info.apa]);
+    }
+    return info;
+  }
+
+  // One entry per channel plus an invalid entry that every channel past the end maps to
+  constexpr std::array<ChannelInfo, kNChannels + 1> makeChannelTable() {
+    std::array<ChannelInfo, kNChannels + 1> table{};
+    for (uint32_t channel = 0; channel <= kNChannels; channel++) {
+      table[channel] = makeChannelInfo(channel);
+    }
+    return table;
+  }
+
+  inline constexpr std::array<ChannelInfo, kNChannels + 1> kChannelTable = makeChannelTable();
+
+  constexpr ChannelInfo const& channelInfo(uint32_t channel) {
+    return kChannelTable[std::min(channel, kNChannels)];
+  }
+
+  // APA (1-4) whose main collection face holds the channel, kNoAPA otherwise
+  constexpr uint8_t mainCollectionAPA(uint32_t channel) {
+    ChannelInfo const& info = channelInfo(channel);
+    return info.mainCollection ? info.apa : kNoAPA;
+  }
+
+  constexpr ChannelRange planeRange(uint8_t apa, uint8_t plane) {
+    const uint32_t base = kBlockOfAPA[apa] * kChannelsPerAPA + plane * kChannelsPerInductionPlane;
+    return {base, base + (plane == kX ? 2 * kChannelsPerCollectionFace : kChannelsPerInductionPlane) - 1};
+  }
+
+  constexpr ChannelRange collectionFaceRange(uint8_t apa, uint8_t face) {
+    const uint32_t base = kBlockOfAPA[apa] * kChannelsPerAPA + kFirstCollectionChannel + face * kChannelsPerCollectionFace;
+    return {base, base + kChannelsPerCollectionFace - 1};
+  }
+
+  constexpr ChannelRange mainCollectionRange(uint8_t apa) {
+    return collectionFaceRange(apa, kMainFaceOfAPA[apa]);
+  }
+
+  static_assert(mainCollectionRange(1).first == 2080 && mainCollectionRange(1).last == 2559);
+  static_assert(mainCollectionRange(3).first == 4160 && mainCollectionRange(3).last == 4639);
+  static_assert(mainCollectionRange(2).first == 7200 && mainCollectionRange(2).last == 7679);
+  static_assert(mainCollectionRange(4).first == 9280 && mainCollectionRange(4).last == 9759);
+  // The TPCs of a block are 2 * block and 2 * block + 1
+  static_assert(kMainTPCOfAPA[1] / 2 == kBlockOfAPA[1] && kMainTPCOfAPA[2] / 2 == kBlockOfAPA[2] &&
+                kMainTPCOfAPA[3] / 2 == kBlockOfAPA[3] && kMainTPCOfAPA[4] / 2 == kBlockOfAPA[4]);
+  static_assert(mainCollectionAPA(7680) == kNoAPA && channelInfo(7680).apa == 4 && channelInfo(7680).plane == kU);
+  static_assert(!channelInfo(kNChannels).valid() && !channelInfo(0xFFFFFFFF).valid());
+
+}
+
+}
+
+#endif
@@ -0,0 +1,67 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        SpillDataDirectory.cc
+//////////////////////////////////////////////////////////////////////////
+
+#include "pdhdbsmdata/Algorithms/SpillDataDirectory.h"
+
+#include <filesystem>
+#include <system_error>
+
+#include "cetlib_except/exception.h"
+
+#include "pdhdbsmdata/Algorithms/SpillTableIO.h"
+
+namespace pdhd {
+
+//-------------------------------------
+SpillDataDirectory::SpillDataDirectory(std::string const& path, std::string const& filePrefix, bool useBinaryCache) :
+  fPath(path) {
+
+  namespace fs = std::filesystem;
+
+  std::error_code ec;
+  fs::directory_iterator dir(fPath, ec);
+  if (ec) {
+    throw cet::exception("SpillDataDirectory") << "Cannot read SPS spill data directory " << fPath << ": " << ec.message() << "\n";
+  }
+
+  for (const auto &entry : dir) {
+    if (!entry.is_regular_file()) continue;
+    const std::string stem = entry.path().stem().string();
+    const bool is_csv = entry.path().extension() == ".csv";
+    const bool is_bin = entry.path().extension() == ".spillbin";
+    if ((!is_csv && !is_bin) || stem.rfind(filePrefix, 0) != 0) continue;
+    if (is_bin && !useBinaryCache) continue;
+
+    const std::string run_str = stem.substr(filePrefix.size());
+    if (run_str.empty() || run_str.find_first_not_of("0123456789") != std::string::npos) continue;
+
+    Files &files = fRunFiles[static_cast<uint32_t>(std::stoul(run_str))];
+    (is_csv ? files.csv : files.bin) = entry.path().string();
+  }
+}
+
+//-------------------------------------
+const SpillDataDirectory::Files* SpillDataDirectory::files(uint32_t run) const {
+  auto it = fRunFiles.find(run);
+  return it == fRunFiles.end() ? nullptr : &it->second;
+}
+
+//-------------------------------------
+std::vector<uint32_t> SpillDataDirectory::runs() const {
+  std::vector<uint32_t> run_numbers;
+  run_numbers.reserve(fRunFiles.size());
+  for (const auto &run : fRunFiles) run_numbers.push_back(run.first);
+  return run_numbers;
+}
+
+//-------------------------------------
+SpillTimeline SpillDataDirectory::load(uint32_t run, bool verifySource, std::string* cacheError) const {
+  const Files *run_files = files(run);
+  if (!run_files) {
+    throw cet::exception("SpillDataDirectory") << "No SPS spill data for run " << run << " in " << fPath << "\n";
+  }
+  return readSpillTable(run_files->csv, run_files->bin, verifySource, cacheError);
+}
+
+}
@@ -0,0 +1,52 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       SpillDataDirectory
+//// File:        SpillDataDirectory.h
+////
+//// Index of a directory of SPS spill tables, spillrunNNNNNN.csv and
+//// optional spillrunNNNNNN.spillbin caches, by run number. Nothing is
+//// read until a run is loaded.
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_ALGORITHMS_SPILLDATADIRECTORY_H
+#define PDHDBSMDATA_ALGORITHMS_SPILLDATADIRECTORY_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "pdhdbsmdata/Algorithms/SpillTimeline.h"
+
+namespace pdhd {
+
+class SpillDataDirectory {
+  public:
+    struct Files {
+      std::string csv;
+      std::string bin;
+    };
+
+    // Throws cet::exception if the directory cannot be read
+    SpillDataDirectory(std::string const& path, std::string const& filePrefix = "spillrun", bool useBinaryCache = true);
+
+    bool hasRun(uint32_t run) const { return fRunFiles.count(run) != 0; }
+    // Spill files of the run, nullptr if there are none
+    const Files* files(uint32_t run) const;
+    std::vector<uint32_t> runs() const;
+    std::string const& path() const { return fPath; }
+
+    // Load the spill table of the run, preferring the .spillbin cache.
+    // A cache whose .csv changed size is ignored, and with verifySource
+    // one whose .csv changed checksum. A cache that cannot be read is
+    // ignored when there is a .csv, and the reason goes to cacheError.
+    // Throws cet::exception if the run is not in the directory.
+    SpillTimeline load(uint32_t run, bool verifySource = true, std::string* cacheError = nullptr) const;
+
+  private:
+    std::string fPath;
+    std::map<uint32_t, Files> fRunFiles;
+};
+
+}
+
+#endif
@@ -0,0 +1,24 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        SpillSelector.cc
+//////////////////////////////////////////////////////////////////////////
+
+#include "pdhdbsmdata/Algorithms/SpillSelector.h"
+
+#include <charconv>
+#include <cmath>
+
+namespace pdhd {
+
+//-------------------------------------
+bool parsePoT(std::string const& arg, uint64_t& pot) {
+  double value(0);
+  const auto result = std::from_chars(arg.data(), arg.data() + arg.size(), value);
+  if (result.ec != std::errc() || result.ptr != arg.data() + arg.size() || !std::isfinite(value) ||
+      value < 0 || value >= 18446744073709551616.) {
+    return false;
+  }
+  pot = static_cast<uint64_t>(value);
+  return true;
+}
+
+}
@@ -0,0 +1,61 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       SpillSelector
+//// File:        SpillSelector.h
+////
+//// Spill ON/OFF event selection of PDHDSPSSpillFilter, kept free of art
+//// so that tools running before the decoder make the same decision.
+//// An event is ON if it is inside the window of a spill with at least
+//// the PoT threshold.
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_ALGORITHMS_SPILLSELECTOR_H
+#define PDHDBSMDATA_ALGORITHMS_SPILLSELECTOR_H
+
+#include <cstdint>
+#include <string>
+
+#include "pdhdbsmdata/Algorithms/SpillTimeline.h"
+
+namespace pdhd {
+
+// DAQ timestamps count 62.5 MHz clock ticks, i.e. 16 ns per tick
+constexpr spilltime_t daqTicksToMs(uint64_t ticks) { return ticks * 16 / 1000000; }
+
+// A PoT threshold given on a command line, such as 1e12 or 3.5e11. The whole argument must be a
+// finite number from 0 to 2^64, otherwise false is returned and pot is left unchanged.
+bool parsePoT(std::string const& arg, uint64_t& pot);
+
+struct SpillDecision {
+  SpillTimeline::Lookup spill;
+  bool on = false;   // Inside a spill above the PoT threshold
+  bool pass = false; // Matches the requested spill state
+};
+
+class SpillSelector {
+  public:
+    SpillSelector(bool spillOn, uint64_t potThreshold) :
+      fSpillOn(spillOn),
+      fPoTThreshold(potThreshold) {}
+
+    SpillDecision decide(SpillTimeline const& timeline, SpillTimeline::Lookup const& spill) const {
+      SpillDecision decision;
+      decision.spill = spill;
+      decision.on = spill.on && timeline.pot(spill.spill) >= fPoTThreshold;
+      decision.pass = (decision.on == fSpillOn);
+      return decision;
+    }
+    SpillDecision decide(SpillTimeline const& timeline, spilltime_t t_ms) const {
+      return decide(timeline, timeline.lookup(t_ms));
+    }
+
+    bool spillOn() const { return fSpillOn; }
+    uint64_t potThreshold() const { return fPoTThreshold; }
+
+  private:
+    bool fSpillOn; // Select events during (true) or outside (false) the spills
+    uint64_t fPoTThreshold;
+};
+
+}
+
+#endif
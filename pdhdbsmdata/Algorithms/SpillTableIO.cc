@@ -0,0 +1,241 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        SpillTableIO.cc
+//////////////////////////////////////////////////////////////////////////
+
+#include "pdhdbsmdata/Algorithms/SpillTableIO.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "cetlib_except/exception.h"
+
+#include "pdhdbsmdata/Algorithms/MappedFile.h"
+
+namespace pdhd {
+
+namespace {
+
+  // Parse one csv cell as a double, the whole cell must be consumed
+  bool parseCell(std::string_view cell, double &value) {
+    while (!cell.empty() && cell.front() == ' ') cell.remove_prefix(1);
+    while (!cell.empty() && cell.back() == ' ') cell.remove_suffix(1);
+    if (cell.empty()) return false;
+    auto result = std::from_chars(cell.data(), cell.data() + cell.size(), value);
+    return result.ec == std::errc() && result.ptr == cell.data() + cell.size() && std::isfinite(value);
+  }
+
+  // Next comma separated cell of a line, line is advanced past the comma
+  std::string_view nextCell(std::string_view &line) {
+    std::size_t comma = line.find(',');
+    std::string_view cell = line.substr(0, comma);
+    line.remove_prefix(comma == std::string_view::npos ? line.size() : comma + 1);
+    return cell;
+  }
+
+  void checkSpillBinHeader(SpillBinHeader const& header, std::string const& fileName) {
+    if (std::memcmp(header.magic, SpillBinHeader::kMagic, sizeof(header.magic)) != 0 || header.version != SpillBinHeader::kVersion) {
+      throw cet::exception("SpillTableIO") << fileName << " is not a version " << SpillBinHeader::kVersion << " spill cache\n";
+    }
+    if (header.byte_order != SpillBinHeader::kByteOrder) {
+      throw cet::exception("SpillTableIO") << fileName << " was written on a host of another byte order, remake it with pdhd_spillcsv2bin\n";
+    }
+  }
+
+}
+
+//-------------------------------------
+uint64_t fnv1a64(const void* data, std::size_t size, uint64_t seed) {
+  const unsigned char *bytes = static_cast<const unsigned char*>(data);
+  uint64_t hash = seed;
+  for (std::size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+//-------------------------------------
+SpillTimeline parseSpillCSV(std::string_view text, std::string const& fileName, std::size_t* skipped) {
+  std::vector<std::pair<spilltime_t, uint64_t>> spills; // Spill clock times and PoT values
+  // One spill per line, the header line is not counted
+  spills.reserve(std::count(text.begin(), text.end(), '\n'));
+
+  std::size_t line_number = 0;
+  while (!text.empty()) {
+    std::size_t eol = text.find('\n');
+    std::string_view line = text.substr(0, eol);
+    text.remove_prefix(eol == std::string_view::npos ? text.size() : eol + 1);
+    line_number++;
+
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+    // Skip the header line and blank lines
+    if (line_number == 1 || line.empty()) continue;
+
+    std::string_view cells = line;
+    std::string_view clock_cell = nextCell(cells);
+    // IFBeam writes intensity readings without a logging time when it
+    // misses the spill clock. They cannot be placed in time, so skip them
+    if (clock_cell.empty()) {
+      if (skipped) (*skipped)++;
+      continue;
+    }
+
+    double clock_s(0), PoT(0);
+    if (!parseCell(clock_cell, clock_s) || !parseCell(nextCell(cells), PoT) || clock_s < 0 || PoT < 0) {
+      throw cet::exception("SpillTableIO") << fileName << ":" << line_number << ": cannot parse spill time and PoT from \"" << line << "\"\n";
+    }
+
+    spilltime_t clock = static_cast<spilltime_t>(clock_s*1e3); // Convert the time in s to ms
+    spills.emplace_back(clock, static_cast<uint64_t>(PoT));
+  }
+
+  return SpillTimeline(std::move(spills));
+}
+
+//-------------------------------------
+SpillTimeline readSpillCSV(std::string const& fileName, std::size_t* skipped) {
+  MappedFile file(fileName);
+  return parseSpillCSV(file.view(), fileName, skipped);
+}
+
+//-------------------------------------
+SpillSourceStamp spillSourceStamp(std::string const& csvFileName) {
+  MappedFile file(csvFileName);
+  SpillSourceStamp stamp;
+  stamp.size = file.size();
+  stamp.checksum = fnv1a64(file.data(), file.size());
+  return stamp;
+}
+
+//-------------------------------------
+uint64_t spillTimelineChecksum(SpillTimeline const& timeline) {
+  const std::size_t n = timeline.size();
+  std::vector<uint64_t> start(n), pot(n);
+  for (std::size_t i = 0; i < n; i++) {
+    start[i] = timeline.start(i);
+    pot[i] = timeline.pot(i);
+  }
+  return fnv1a64(pot.data(), n*sizeof(uint64_t), fnv1a64(start.data(), n*sizeof(uint64_t)));
+}
+
+//-------------------------------------
+void writeSpillBin(SpillTimeline const& timeline, SpillSourceStamp const& source, std::string const& fileName) {
+  const std::size_t n = timeline.size();
+  std::vector<uint64_t> start(n), pot(n);
+  for (std::size_t i = 0; i < n; i++) {
+    start[i] = timeline.start(i);
+    pot[i] = timeline.pot(i);
+  }
+
+  SpillBinHeader header;
+  std::memcpy(header.magic, SpillBinHeader::kMagic, sizeof(header.magic));
+  header.version = SpillBinHeader::kVersion;
+  header.byte_order = SpillBinHeader::kByteOrder;
+  header.n_spills = n;
+  header.duration_ms = timeline.duration();
+  header.source_size = source.size;
+  header.source_checksum = source.checksum;
+  header.payload_checksum = spillTimelineChecksum(timeline);
+
+  const std::string tmpName = fileName + ".tmp";
+  {
+    std::ofstream out(tmpName, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(start.data()), n*sizeof(uint64_t));
+    out.write(reinterpret_cast<const char*>(pot.data()), n*sizeof(uint64_t));
+    out.close();
+    if (!out) {
+      std::remove(tmpName.c_str());
+      throw cet::exception("SpillTableIO") << "Failed to write spill cache " << tmpName << "\n";
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(tmpName, fileName, ec);
+  if (ec) {
+    std::remove(tmpName.c_str());
+    throw cet::exception("SpillTableIO") << "Failed to rename " << tmpName << " to " << fileName << ": " << ec.message() << "\n";
+  }
+}
+
+//-------------------------------------
+SpillBinHeader readSpillBinHeader(std::string const& fileName) {
+  SpillBinHeader header;
+  std::ifstream in(fileName, std::ios::binary);
+  if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+    throw cet::exception("SpillTableIO") << "Cannot read spill cache header from " << fileName << "\n";
+  }
+  checkSpillBinHeader(header, fileName);
+  return header;
+}
+
+//-------------------------------------
+SpillTimeline readSpillBin(std::string const& fileName) {
+  auto file = std::make_shared<MappedFile>(fileName);
+
+  if (file->size() < sizeof(SpillBinHeader)) {
+    throw cet::exception("SpillTableIO") << fileName << " is too small to be a spill cache\n";
+  }
+  const SpillBinHeader *header = reinterpret_cast<const SpillBinHeader*>(file->data());
+  checkSpillBinHeader(*header, fileName);
+
+  // Bounded first, a damaged count would overflow the expected size
+  const uint64_t maxSpills = (file->size() - sizeof(SpillBinHeader)) / (2*sizeof(uint64_t));
+  if (header->n_spills > maxSpills) {
+    throw cet::exception("SpillTableIO") << fileName << " has " << header->n_spills << " spills in its header, "
+      << "but room for at most " << maxSpills << "\n";
+  }
+  const std::size_t n = header->n_spills;
+  if (file->size() != sizeof(SpillBinHeader) + 2*n*sizeof(uint64_t)) {
+    throw cet::exception("SpillTableIO") << fileName << " has " << file->size() << " bytes, expected "
+      << sizeof(SpillBinHeader) + 2*n*sizeof(uint64_t) << " for " << n << " spills\n";
+  }
+
+  const uint64_t *start = reinterpret_cast<const uint64_t*>(file->data() + sizeof(SpillBinHeader));
+  const uint64_t *pot = start + n;
+  if (fnv1a64(pot, n*sizeof(uint64_t), fnv1a64(start, n*sizeof(uint64_t))) != header->payload_checksum) {
+    throw cet::exception("SpillTableIO") << fileName << " is corrupted, the payload checksum does not match\n";
+  }
+  if (!std::is_sorted(start, start + n)) {
+    throw cet::exception("SpillTableIO") << fileName << " is corrupted, the spills are not in time order\n";
+  }
+
+  const spilltime_t duration = header->duration_ms;
+  return SpillTimeline(std::move(file), start, pot, n, duration);
+}
+
+//-------------------------------------
+SpillTimeline readSpillTable(std::string const& csvFileName, std::string const& binFileName, bool verifySource,
+                             std::string* cacheError) {
+  namespace fs = std::filesystem;
+
+  if (!binFileName.empty() && fs::exists(binFileName)) {
+    if (csvFileName.empty() || !fs::exists(csvFileName)) {
+      return readSpillBin(binFileName);
+    }
+    // A stale cache is ignored, the csv is the reference. Comparing the size only costs a stat.
+    // So is a cache that cannot be read: of an older version, another byte order, or truncated
+    try {
+      const SpillBinHeader header = readSpillBinHeader(binFileName);
+      if (header.source_size == fs::file_size(csvFileName) &&
+          (!verifySource || header.source_checksum == spillSourceStamp(csvFileName).checksum)) {
+        return readSpillBin(binFileName);
+      }
+    }
+    catch (cet::exception const& e) {
+      if (cacheError) *cacheError = e.explain_self();
+    }
+  }
+  return readSpillCSV(csvFileName);
+}
+
+}
@@ -0,0 +1,92 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        SpillTableIO.h
+////
+//// Readers and writers for the SPS spill tables in sps_data/.
+////
+//// The .csv files are the IFBeam dumps: a header line followed by one
+//// spill per line with the spill time in seconds and the intensity
+//// (PoT) in the first two columns. They are memory-mapped and parsed
+//// in place with std::from_chars; malformed lines are an error.
+////
+//// The .spillbin files are the same table in a binary layout that is
+//// memory-mapped and used directly, without any parsing:
+////
+////   SpillBinHeader                  (56 bytes)
+////   uint64_t start_ms[n_spills]     sorted spill start times
+////   uint64_t pot[n_spills]
+////
+//// Fields are in the byte order of the host that wrote the file, which
+//// the header records, so a file written on a host of the other byte
+//// order is rejected rather than misread. The header also records the
+//// size and the FNV-1a checksum of the source .csv, so a stale cache can
+//// be detected, and a checksum of the two arrays, so a truncated or
+//// corrupted file is rejected.
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_ALGORITHMS_SPILLTABLEIO_H
+#define PDHDBSMDATA_ALGORITHMS_SPILLTABLEIO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "pdhdbsmdata/Algorithms/SpillTimeline.h"
+
+namespace pdhd {
+
+struct SpillBinHeader {
+  static constexpr char kMagic[8] = {'P', 'D', 'H', 'D', 'S', 'P', 'L', 'B'};
+  static constexpr uint32_t kVersion = 2;
+  static constexpr uint32_t kByteOrder = 0x01020304; // Reads back the same on the host that wrote it
+
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t n_spills;
+  uint64_t duration_ms;
+  uint64_t source_size;      // Size in bytes of the source .csv
+  uint64_t source_checksum;  // FNV-1a 64 of the source .csv
+  uint64_t payload_checksum; // FNV-1a 64 of the start_ms and pot arrays
+};
+static_assert(sizeof(SpillBinHeader) == 56, "SpillBinHeader layout must not change");
+
+// Size and checksum that tie a .spillbin file to its source .csv
+struct SpillSourceStamp {
+  uint64_t size = 0;
+  uint64_t checksum = 0;
+};
+
+// 64-bit FNV-1a hash, chain calls by passing the previous hash as seed
+constexpr uint64_t kFNV1aOffset = 14695981039346656037ULL;
+uint64_t fnv1a64(const void* data, std::size_t size, uint64_t seed = kFNV1aOffset);
+
+// Parse an in-memory csv table. fileName is only used in error messages.
+// Rows without a logging time are skipped and counted in skipped, if given.
+// Throws cet::exception on the first malformed line.
+SpillTimeline parseSpillCSV(std::string_view text, std::string const& fileName = "<memory>", std::size_t* skipped = nullptr);
+// Read every spill in the csv file. Throws cet::exception if the file cannot be read or parsed.
+SpillTimeline readSpillCSV(std::string const& fileName, std::size_t* skipped = nullptr);
+SpillSourceStamp spillSourceStamp(std::string const& csvFileName);
+// FNV-1a 64 of the start times and PoT of the spills, the payload_checksum of its .spillbin.
+// The same whether the table was read from the csv or the cache.
+uint64_t spillTimelineChecksum(SpillTimeline const& timeline);
+
+// Write the timeline as a .spillbin file. The file is written under a
+// temporary name and renamed, so readers never see a partial file.
+void writeSpillBin(SpillTimeline const& timeline, SpillSourceStamp const& source, std::string const& fileName);
+// Map a .spillbin file; the returned timeline points into the mapping.
+// Throws cet::exception if the file is not a valid spill cache.
+SpillTimeline readSpillBin(std::string const& fileName);
+SpillBinHeader readSpillBinHeader(std::string const& fileName);
+
+// Read the .spillbin if it exists and matches the csv, otherwise parse the csv. The cache
+// matches if the csv has the size it records and, with verifySource, the same checksum.
+// A cache that cannot be read is only an error without the csv; otherwise the csv is
+// parsed and the reason goes to cacheError.
+SpillTimeline readSpillTable(std::string const& csvFileName, std::string const& binFileName, bool verifySource,
+                             std::string* cacheError = nullptr);
+
+}
+
+#endif
@@ -0,0 +1,102 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        SpillTimeline.cc
+//////////////////////////////////////////////////////////////////////////
+
+#include "pdhdbsmdata/Algorithms/SpillTimeline.h"
+
+#include <algorithm>
+
+namespace pdhd {
+
+namespace {
+  struct OwnedSpills {
+    std::vector<spilltime_t> start;
+    std::vector<uint64_t> pot;
+  };
+}
+
+//-------------------------------------
+SpillTimeline::SpillTimeline(std::vector<std::pair<spilltime_t, uint64_t>> spills, spilltime_t duration_ms) :
+  fDuration(duration_ms) {
+
+  std::stable_sort(spills.begin(), spills.end(),
+      [] (const std::pair<spilltime_t, uint64_t> &lh, const std::pair<spilltime_t, uint64_t> &rh) -> bool { return lh.first < rh.first; });
+
+  auto owned = std::make_shared<OwnedSpills>();
+  owned->start.reserve(spills.size());
+  owned->pot.reserve(spills.size());
+  for (const auto &spill : spills) {
+    owned->start.push_back(spill.first);
+    owned->pot.push_back(spill.second);
+  }
+
+  fStart = owned->start.data();
+  fPoT = owned->pot.data();
+  fSize = spills.size();
+  fStorage = std::move(owned);
+}
+
+//-------------------------------------
+SpillTimeline::SpillTimeline(std::shared_ptr<const void> storage, const spilltime_t* start, const uint64_t* pot,
+                             std::size_t n, spilltime_t duration_ms) :
+  fStorage(std::move(storage)),
+  fStart(start),
+  fPoT(pot),
+  fSize(n),
+  fDuration(duration_ms) {}
+
+//-------------------------------------
+std::size_t SpillTimeline::upperBound(spilltime_t t_ms, std::size_t first, std::size_t last) const {
+  return std::upper_bound(fStart + first, fStart + last, t_ms) - fStart;
+}
+
+//-------------------------------------
+std::size_t SpillTimeline::findSpill(spilltime_t t_ms) const {
+  std::size_t upper = upperBound(t_ms, 0, fSize);
+  return upper == 0 ? npos : upper - 1;
+}
+
+//-------------------------------------
+SpillTimeline::Lookup SpillTimeline::makeLookup(std::size_t spill, spilltime_t t_ms) const {
+  Lookup result;
+  result.spill = spill;
+  // Events before the first spill are OFF; after the last spill they are
+  // ON only while still inside the last spill window
+  result.on = (spill != npos) && (t_ms < end(spill));
+  return result;
+}
+
+//-------------------------------------
+std::size_t SpillTimeline::Cursor::findSpill(spilltime_t t_ms) {
+  const spilltime_t *starts = fTimeline->fStart;
+  const std::size_t n = fTimeline->fSize;
+
+  const bool lower_ok = (fUpper == 0) || (starts[fUpper - 1] <= t_ms);
+  if (lower_ok) {
+    if (fUpper == n || t_ms < starts[fUpper]) {
+      // Same interval as the previous event
+      return fUpper == 0 ? npos : fUpper - 1;
+    }
+    // Moved forward: gallop from the previous position, then bisect
+    std::size_t lo = fUpper + 1;
+    std::size_t step = 1;
+    while (lo < n && starts[lo] <= t_ms) {
+      fUpper = lo;
+      lo += step;
+      step *= 2;
+    }
+    fUpper = fTimeline->upperBound(t_ms, fUpper, std::min(lo, n));
+  } else {
+    // Out of order event, the answer is before the previous position: gallop back, then bisect
+    std::size_t hi = fUpper - 1;
+    std::size_t step = 1;
+    while (hi >= step && starts[hi - step] > t_ms) {
+      hi -= step;
+      step *= 2;
+    }
+    fUpper = fTimeline->upperBound(t_ms, hi >= step ? hi - step : 0, hi);
+  }
+  return fUpper == 0 ? npos : fUpper - 1;
+}
+
+}
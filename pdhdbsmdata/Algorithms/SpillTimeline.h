@@ -0,0 +1,95 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       SpillTimeline
+//// File:        SpillTimeline.h
+////
+//// Sorted table of SPS spill start times (ms since epoch) and PoT,
+//// stored as parallel arrays so the binary search only touches the
+//// start times. A spill is ON in [start, start + duration).
+////
+//// The arrays are either owned by the timeline or are views into
+//// external storage (e.g. a memory-mapped .spillbin file) that the
+//// timeline keeps alive.
+////
+//// SpillTimeline::Cursor remembers where the previous lookup ended, so
+//// events arriving in (roughly) increasing time order are found in
+//// amortised O(1). It gallops from there, forward or back, and bisects
+//// the last step, so a jump of k spills costs O(log k).
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_ALGORITHMS_SPILLTIMELINE_H
+#define PDHDBSMDATA_ALGORITHMS_SPILLTIMELINE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace pdhd {
+
+using spilltime_t = uint64_t; // ms since epoch
+
+class SpillTimeline {
+  public:
+    static constexpr spilltime_t kSpillDurationMs = 4785; // 4785 ms is the duration of a spill
+    static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+    // Result of a lookup: the last spill that started at or before the
+    // requested time (npos if there is none) and whether it is still ON.
+    struct Lookup {
+      std::size_t spill = npos;
+      bool on = false;
+    };
+
+    class Cursor;
+
+    SpillTimeline() = default;
+    // Spills are given as (start time in ms, PoT) and sorted by start time
+    explicit SpillTimeline(std::vector<std::pair<spilltime_t, uint64_t>> spills,
+                           spilltime_t duration_ms = kSpillDurationMs);
+    // View of n spills in external storage, which must already be sorted by
+    // start time. The storage is kept alive by the timeline.
+    SpillTimeline(std::shared_ptr<const void> storage, const spilltime_t* start, const uint64_t* pot,
+                  std::size_t n, spilltime_t duration_ms = kSpillDurationMs);
+
+    std::size_t size() const { return fSize; }
+    bool empty() const { return fSize == 0; }
+    spilltime_t duration() const { return fDuration; }
+
+    spilltime_t start(std::size_t spill) const { return fStart[spill]; }
+    spilltime_t end(std::size_t spill) const { return fStart[spill] + fDuration; }
+    uint64_t pot(std::size_t spill) const { return fPoT[spill]; }
+
+    // Index of the last spill starting at or before t_ms, npos if t_ms
+    // precedes the first spill. O(log n).
+    std::size_t findSpill(spilltime_t t_ms) const;
+    Lookup lookup(spilltime_t t_ms) const { return makeLookup(findSpill(t_ms), t_ms); }
+
+  private:
+    // Position of the first spill starting after t_ms in [first, last)
+    std::size_t upperBound(spilltime_t t_ms, std::size_t first, std::size_t last) const;
+    Lookup makeLookup(std::size_t spill, spilltime_t t_ms) const;
+
+    std::shared_ptr<const void> fStorage; // Owner of the arrays below
+    const spilltime_t* fStart = nullptr;
+    const uint64_t* fPoT = nullptr;
+    std::size_t fSize = 0;
+    spilltime_t fDuration = kSpillDurationMs;
+};
+
+class SpillTimeline::Cursor {
+  public:
+    explicit Cursor(SpillTimeline const& timeline) : fTimeline(&timeline) {}
+
+    std::size_t findSpill(spilltime_t t_ms);
+    Lookup lookup(spilltime_t t_ms) { return fTimeline->makeLookup(findSpill(t_ms), t_ms); }
+
+  private:
+    SpillTimeline const* fTimeline;
+    std::size_t fUpper = 0; // upper bound position returned by the previous lookup
+};
+
+}
+
+#endif
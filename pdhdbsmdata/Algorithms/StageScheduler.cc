@@ -0,0 +1,128 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        StageScheduler.cc
+//////////////////////////////////////////////////////////////////////////
+
+#include "pdhdbsmdata/Algorithms/StageScheduler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "cetlib_except/exception.h"
+
+namespace pdhd {
+
+//-------------------------------------
+StageScheduler::StageScheduler(std::size_t nStages, Config const& config) :
+  fNStages(nStages),
+  fConfig(config),
+  fCounters(nStages),
+  fTotals(nStages) {
+
+  if (nStages == 0 || nStages > kMaxStages) {
+    throw cet::exception("StageScheduler") << nStages << " stages, between 1 and " << kMaxStages << " are supported.\n";
+  }
+  if (fConfig.reorderEvery == 0) fConfig.adaptive = false;
+  fConfig.decay = std::clamp(fConfig.decay, 0., 1.);
+
+  Order order{};
+  for (std::size_t s = 0; s < nStages; s++) order[s] = s;
+  fOrder = pack(order);
+}
+
+//-------------------------------------
+uint32_t StageScheduler::pack(Order const& order) {
+  uint32_t word = 0;
+  for (std::size_t i = 0; i < kMaxStages; i++) word |= uint32_t(order[i] & 0xF) << (4 * i);
+  return word;
+}
+
+//-------------------------------------
+StageScheduler::Order StageScheduler::unpack(uint32_t word) {
+  Order order{};
+  for (std::size_t i = 0; i < kMaxStages; i++) order[i] = (word >> (4 * i)) & 0xF;
+  return order;
+}
+
+//-------------------------------------
+StageScheduler::Ticket StageScheduler::begin() {
+  Ticket ticket;
+  ticket.event = fEvents.fetch_add(1, std::memory_order_relaxed);
+  ticket.explore = fConfig.adaptive && fConfig.exploreEvery > 0 && ticket.event % fConfig.exploreEvery == 0;
+  ticket.order = order();
+  return ticket;
+}
+
+//-------------------------------------
+void StageScheduler::end(Ticket const& ticket) {
+  if (!fConfig.adaptive || (ticket.event + 1) % fConfig.reorderEvery != 0) return;
+  reorder();
+}
+
+//-------------------------------------
+void StageScheduler::reorder() {
+  std::lock_guard<std::mutex> lock(fReorderMutex);
+
+  // Fold the counts of the window into the decayed totals
+  for (std::size_t s = 0; s < fNStages; s++) {
+    Counters &c = fCounters[s];
+    Totals &t = fTotals[s];
+    t.ns = fConfig.decay * t.ns + c.ns.exchange(0, std::memory_order_relaxed);
+    t.evaluated = fConfig.decay * t.evaluated + c.evaluated.exchange(0, std::memory_order_relaxed);
+    t.rejected = fConfig.decay * t.rejected + c.rejected.exchange(0, std::memory_order_relaxed);
+    t.explored = fConfig.decay * t.explored + c.explored.exchange(0, std::memory_order_relaxed);
+    t.exploredRejected = fConfig.decay * t.exploredRejected + c.exploredRejected.exchange(0, std::memory_order_relaxed);
+  }
+
+  const Order current = order();
+  std::vector<std::size_t> currentOrder(current.begin(), current.begin() + fNStages);
+  const std::vector<std::size_t> best = bestOrder(statsLocked(), currentOrder);
+  if (best == currentOrder) return;
+
+  Order next{};
+  std::copy(best.begin(), best.end(), next.begin());
+  fOrder.store(pack(next), std::memory_order_release);
+  fReorders.fetch_add(1, std::memory_order_relaxed);
+}
+
+//-------------------------------------
+std::vector<StageScheduler::StageStats> StageScheduler::stats() const {
+  std::lock_guard<std::mutex> lock(fReorderMutex);
+  return statsLocked();
+}
+
+//-------------------------------------
+std::vector<StageScheduler::StageStats> StageScheduler::statsLocked() const {
+  std::vector<StageStats> stats(fNStages);
+  for (std::size_t s = 0; s < fNStages; s++) {
+    Totals const& t = fTotals[s];
+    stats[s].evaluated = static_cast<uint64_t>(t.evaluated + 0.5);
+    stats[s].rejected = static_cast<uint64_t>(t.rejected + 0.5);
+    stats[s].meanNs = t.evaluated > 0 ? t.ns / t.evaluated : 0;
+    // Unbiased from the exploration events if there are any, else conditional on the stages in front
+    if (t.explored > 0) stats[s].rejection = t.exploredRejected / t.explored;
+    else if (t.evaluated > 0) stats[s].rejection = t.rejected / t.evaluated;
+  }
+  return stats;
+}
+
+//-------------------------------------
+std::vector<std::size_t> StageScheduler::bestOrder(std::vector<StageStats> const& stats, std::vector<std::size_t> const& current) {
+  // Swapping two neighbours a, b lowers the expected cost when cost_b * p_a > cost_a * p_b,
+  // so sort by cost / p; stages that never reject go last, cheapest first
+  const auto rank = [&stats] (std::size_t s) {
+    if (stats[s].evaluated == 0) return std::numeric_limits<double>::quiet_NaN();
+    return stats[s].rejection > 0 ? stats[s].meanNs / stats[s].rejection : std::numeric_limits<double>::infinity();
+  };
+  std::vector<std::size_t> order = current;
+  // Stages not measured yet keep their place relative to each other, after the measured ones
+  std::stable_sort(order.begin(), order.end(), [&] (std::size_t a, std::size_t b) {
+    const double ra = rank(a), rb = rank(b);
+    if (std::isnan(ra) || std::isnan(rb)) return !std::isnan(ra) && std::isnan(rb);
+    if (ra == rb) return ra == std::numeric_limits<double>::infinity() && stats[a].meanNs < stats[b].meanNs;
+    return ra < rb;
+  });
+  return order;
+}
+
+}
@@ -0,0 +1,142 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       StageScheduler
+//// File:        StageScheduler.h
+////
+//// Order of the cuts of PDHDBSMSelection. An event is kept only if all
+//// stages pass it, so the stages can run in any order and stop at the
+//// first rejection without changing the decision. The scheduler picks
+//// the order with the lowest expected cost per event: for independent
+//// stages, ascending cost / rejection probability.
+////
+//// The cost of each stage is measured on every event that runs it. The
+//// rejection probability is measured on exploration events, one in
+//// ExploreEvery, which run all stages, so it is not biased by the stages
+//// in front. Every ReorderEvery events the new measurements are added to
+//// the old ones scaled by Decay, and the order is recomputed. The order
+//// is one atomic word, read once per event by every thread.
+////
+//// The decision does not depend on the order only if every stage decides
+//// every event. A stage that cannot, e.g. its input is missing, throws
+//// from its check, and run() checks all the stages before running any.
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_ALGORITHMS_STAGESCHEDULER_H
+#define PDHDBSMDATA_ALGORITHMS_STAGESCHEDULER_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace pdhd {
+
+class StageScheduler {
+  public:
+    static constexpr std::size_t kMaxStages = 8; // 4 bits per stage in the order word
+
+    struct Config {
+      bool adaptive = true;       // Reorder at all, otherwise keep the configured order
+      uint64_t reorderEvery = 1000;
+      uint64_t exploreEvery = 50; // 0: never run all stages, rejections are then conditional on the order
+      double decay = 0.5;         // Weight of the old measurements at each reorder
+    };
+
+    using Order = std::array<uint8_t, kMaxStages>;
+
+    // What one event runs
+    struct Ticket {
+      Order order;
+      bool explore; // Run all stages, even after a rejection
+      uint64_t event;
+    };
+
+    // Expected cost model of a stage after the last reorder
+    struct StageStats {
+      double meanNs = 0;    // Per evaluation
+      double rejection = 0; // Probability to reject an event
+      uint64_t evaluated = 0;
+      uint64_t rejected = 0;
+    };
+
+    // Stages start in the order 0, 1, ..., nStages - 1
+    StageScheduler(std::size_t nStages, Config const& config);
+
+    std::size_t nStages() const { return fNStages; }
+
+    Ticket begin();
+    void record(std::size_t stage, uint64_t ns, bool rejected, bool explore) {
+      Counters &c = fCounters[stage];
+      c.ns.fetch_add(ns, std::memory_order_relaxed);
+      c.evaluated.fetch_add(1, std::memory_order_relaxed);
+      if (rejected) c.rejected.fetch_add(1, std::memory_order_relaxed);
+      if (explore) {
+        c.explored.fetch_add(1, std::memory_order_relaxed);
+        if (rejected) c.exploredRejected.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    // Reorders when the event closes a ReorderEvery window
+    void end(Ticket const& ticket);
+
+    Order order() const { return unpack(fOrder.load(std::memory_order_acquire)); }
+    uint64_t reorders() const { return fReorders.load(std::memory_order_relaxed); }
+    std::vector<StageStats> stats() const;
+
+    // Recompute the order now
+    void reorder();
+
+    // One event: check(s) for every stage, then select(s) in the given order until a stage rejects,
+    // or for all stages with runAll. Whether the event passes, and whether it throws, are the same
+    // for every order.
+    template <typename Check, typename Select>
+    static bool run(Order const& order, std::size_t nStages, bool runAll, Check&& check, Select&& select) {
+      for (std::size_t s = 0; s < nStages; s++) check(s);
+      bool pass = true;
+      for (std::size_t i = 0; i < nStages; i++) {
+        if (select(static_cast<std::size_t>(order[i]))) continue;
+        pass = false;
+        if (!runAll) break;
+      }
+      return pass;
+    }
+
+    // Cheapest order for the given stats, ties kept in the current order
+    static std::vector<std::size_t> bestOrder(std::vector<StageStats> const& stats, std::vector<std::size_t> const& current);
+
+  private:
+    struct Counters {
+      std::atomic<uint64_t> ns{0};
+      std::atomic<uint64_t> evaluated{0};
+      std::atomic<uint64_t> rejected{0};
+      std::atomic<uint64_t> explored{0};
+      std::atomic<uint64_t> exploredRejected{0};
+    };
+    // Decayed sums, kept under fReorderMutex
+    struct Totals {
+      double ns = 0;
+      double evaluated = 0;
+      double rejected = 0;
+      double explored = 0;
+      double exploredRejected = 0;
+    };
+
+    std::vector<StageStats> statsLocked() const;
+    static uint32_t pack(Order const& order);
+    static Order unpack(uint32_t word);
+
+    std::size_t fNStages;
+    Config fConfig;
+    std::atomic<uint32_t> fOrder;
+    std::atomic<uint64_t> fEvents{0};
+    std::atomic<uint64_t> fReorders{0};
+    std::deque<Counters> fCounters; // Deque, the atomics do not move
+
+    mutable std::mutex fReorderMutex;
+    std::vector<Totals> fTotals;
+};
+
+}
+
+#endif
@@ -0,0 +1,201 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        SyntheticEvents.cc
+//////////////////////////////////////////////////////////////////////////
+
+#include "pdhdbsmdata/Algorithms/SyntheticEvents.h"
+
+#include <algorithm>
+
+namespace pdhd {
+
+using triggerprimitive_t = dunedaq::trgdataformats::TriggerPrimitive;
+using triggeractivity_t = dunedaq::trgdataformats::TriggerActivityData;
+using triggercandidate_t = dunedaq::trgdataformats::TriggerCandidateData;
+
+namespace {
+
+  constexpr chmap::ChannelRange kAPA3 = chmap::mainCollectionRange(3);
+
+  constexpr uint32_t kVetoChannels = 40;           // Default fUpstreamVetoChannels of the filters
+  constexpr uint64_t kShowerWindow = 20000;        // Shower centres within this of the trigger
+  constexpr uint64_t kGroundShakeWindow = 60000;
+
+}
+
+//-------------------------------------
+const char* syntheticTopologyName(SyntheticTopology topology) {
+  switch (topology) {
+    case SyntheticTopology::kShower: return "shower";
+    case SyntheticTopology::kUpstreamMuon: return "upstream_muon";
+    case SyntheticTopology::kGroundShake: return "ground_shake";
+    case SyntheticTopology::kPileUp: return "pile_up";
+    default: return "unknown";
+  }
+}
+
+//-------------------------------------
+int64_t SyntheticRandom::gauss(int64_t sigma) {
+  // Four uniforms in [-a, a] with a = sqrt(3)/2 sigma have a standard deviation of sigma
+  const uint64_t a = static_cast<uint64_t>(sigma) * 866 / 1000;
+  int64_t sum(0);
+  for (int i = 0; i < 4; i++) sum += static_cast<int64_t>(uniform(0, 2 * a)) - static_cast<int64_t>(a);
+  return sum;
+}
+
+//-------------------------------------
+void SyntheticEventGenerator::addTP(TPs& tps, uint32_t channel, uint64_t timePeak) {
+  triggerprimitive_t tp;
+  tp.channel = channel;
+  tp.time_peak = timePeak;
+  tp.time_start = timePeak - fRandom.uniform(4, 32);
+  tp.time_over_threshold = (timePeak - tp.time_start) + fRandom.uniform(4, 64);
+  tp.adc_integral = fRandom.uniform(100, 3000);
+  tp.adc_peak = tp.adc_integral / 8;
+  tp.type = triggerprimitive_t::Type::kTPC;
+  tp.algorithm = triggerprimitive_t::Algorithm::kSimpleThreshold;
+  tps.push_back(tp);
+}
+
+//-------------------------------------
+void SyntheticEventGenerator::addNoise(SyntheticEvent& event) {
+  const uint64_t begin = event.timestamp - fConfig.readoutTicks / 2;
+  for (std::size_t i = 0; i < fConfig.noiseTPs; i++) {
+    addTP(event.tps, fRandom.uniform(0, chmap::kNChannels - 1), begin + fRandom.uniform(0, fConfig.readoutTicks - 1));
+  }
+}
+
+//-------------------------------------
+std::vector<uint32_t> SyntheticEventGenerator::addShower(SyntheticEvent& event, uint32_t vertex, uint64_t centre, uint64_t sigma) {
+  const chmap::ChannelRange face = chmap::mainCollectionRange(chmap::mainCollectionAPA(vertex));
+  const uint32_t length = std::min<uint32_t>(fRandom.uniform(60, 150), face.last - vertex);
+
+  std::vector<uint32_t> positions;
+  for (std::size_t i = 0; i < fConfig.showerTPs; i++) {
+    // Triangular profile along the channels, most TPs a third of the way in
+    const uint64_t u = fRandom.uniform(0, length) + fRandom.uniform(0, length / 2);
+    const uint32_t channel = vertex + static_cast<uint32_t>(std::min<uint64_t>(u, length));
+    positions.push_back(event.tps.size());
+    addTP(event.tps, channel, centre + fRandom.gauss(sigma));
+  }
+  return positions;
+}
+
+//-------------------------------------
+std::vector<uint32_t> SyntheticEventGenerator::addTrack(SyntheticEvent& event, chmap::ChannelRange channels, uint64_t start, int64_t slope) {
+  std::vector<uint32_t> positions;
+  for (uint32_t channel = channels.first; channel <= channels.last; channel++) {
+    positions.push_back(event.tps.size());
+    addTP(event.tps, channel, start + slope * static_cast<int64_t>(channel - channels.first) + fRandom.gauss(8));
+  }
+  return positions;
+}
+
+//-------------------------------------
+void SyntheticEventGenerator::addTA(SyntheticEvent& event, std::vector<uint32_t> const& tps) {
+  triggeractivity_t ta;
+  ta.time_start = dunedaq::trgdataformats::INVALID_TIMESTAMP;
+  ta.time_end = 0;
+  ta.channel_start = dunedaq::trgdataformats::INVALID_CHANNEL;
+  ta.channel_end = 0;
+  uint32_t peak_adc(0);
+  for (const auto &pos : tps) {
+    triggerprimitive_t const& tp = event.tps[pos];
+    ta.time_start = std::min(ta.time_start, tp.time_start);
+    ta.time_end = std::max(ta.time_end, tp.time_start + tp.time_over_threshold);
+    ta.channel_start = std::min(ta.channel_start, tp.channel);
+    ta.channel_end = std::max(ta.channel_end, tp.channel);
+    ta.adc_integral += tp.adc_integral;
+    if (tp.adc_integral > peak_adc) {
+      peak_adc = tp.adc_integral;
+      ta.time_peak = tp.time_peak;
+      ta.channel_peak = tp.channel;
+    }
+  }
+  ta.time_activity = ta.time_peak;
+  ta.adc_peak = peak_adc / 8;
+  ta.type = triggeractivity_t::Type::kTPC;
+  ta.algorithm = triggeractivity_t::Algorithm::kADCSimpleWindow;
+  event.addTA(ta, tps);
+}
+
+//-------------------------------------
+SyntheticEvent SyntheticEventGenerator::generate(SyntheticTopology topology, uint64_t timestamp) {
+  SyntheticEvent event;
+  event.topology = topology;
+  event.timestamp = timestamp;
+  event.time_ns = timestamp * 16;
+  addNoise(event);
+
+  // The shower of every topology but the ground shake: vertex downstream of the veto channels
+  const uint32_t vertex = kAPA3.first + fRandom.uniform(3 * kVetoChannels, 300);
+  const uint64_t centre = timestamp - kShowerWindow + fRandom.uniform(0, 2 * kShowerWindow);
+  const uint64_t sigma = fRandom.uniform(800, 2500);
+
+  switch (topology) {
+    case SyntheticTopology::kShower:
+      addTA(event, addShower(event, vertex, centre, sigma));
+      break;
+
+    case SyntheticTopology::kUpstreamMuon: {
+      addTA(event, addShower(event, vertex, centre, sigma));
+      // Crosses the veto channels well inside the shower time window
+      const uint64_t start = centre - sigma / 8 + fRandom.uniform(0, sigma / 4);
+      addTrack(event, kAPA3, start, static_cast<int64_t>(fRandom.uniform(0, 4)) - 2);
+      break;
+    }
+
+    case SyntheticTopology::kGroundShake: {
+      std::vector<uint32_t> apa3;
+      for (std::size_t i = 0; i < fConfig.groundShakeTPs; i++) {
+        const uint32_t channel = fRandom.uniform(0, chmap::kNChannels - 1);
+        if (kAPA3.contains(channel)) apa3.push_back(event.tps.size());
+        addTP(event.tps, channel, timestamp - kGroundShakeWindow / 2 + fRandom.uniform(0, kGroundShakeWindow));
+      }
+      addTA(event, apa3);
+      break;
+    }
+
+    case SyntheticTopology::kPileUp: {
+      std::vector<std::vector<uint32_t>> tracks;
+      for (std::size_t t = 0; t < fConfig.pileUpTracks; t++) {
+        const uint8_t apa = fRandom.uniform(1, chmap::kNAPAs);
+        // Away from the shower: before it in the first half of the readout, after it in the second
+        const uint64_t spread = fConfig.readoutTicks / 2 > 6 * kShowerWindow ? fConfig.readoutTicks / 2 - 6 * kShowerWindow : 0;
+        const uint64_t offset = 4 * kShowerWindow + fRandom.uniform(0, spread);
+        const uint64_t start = (t % 2 == 0) ? centre - offset : centre + offset;
+        auto track = addTrack(event, chmap::mainCollectionRange(apa), start, static_cast<int64_t>(fRandom.uniform(5, 40)));
+        if (t % 2 == 0 && apa != 3) tracks.push_back(std::move(track));
+      }
+      // TAs in time order: the earlier tracks come first
+      for (const auto &track : tracks) addTA(event, track);
+      addTA(event, addShower(event, vertex, centre, sigma));
+      break;
+    }
+
+    default:
+      break;
+  }
+
+  triggercandidate_t tc;
+  tc.time_start = timestamp - 1000;
+  tc.time_end = timestamp + 1000;
+  tc.time_candidate = timestamp;
+  tc.type = topology == SyntheticTopology::kGroundShake ? triggercandidate_t::Type::kADCSimpleWindow : triggercandidate_t::Type::kPrescale;
+  tc.algorithm = topology == SyntheticTopology::kGroundShake ? triggercandidate_t::Algorithm::kADCSimpleWindow : triggercandidate_t::Algorithm::kPrescale;
+  event.tcs.push_back(tc);
+  return event;
+}
+
+//-------------------------------------
+std::vector<std::pair<spilltime_t, uint64_t>> makeSyntheticSpills(SyntheticRandom& random, std::size_t n, spilltime_t first) {
+  std::vector<std::pair<spilltime_t, uint64_t>> spills;
+  spilltime_t start = first;
+  for (std::size_t i = 0; i < n; i++) {
+    const uint64_t pot = random.uniform(0, 9) == 0 ? 0 : random.uniform(1, 40) * 1000000000000ULL;
+    spills.emplace_back(start, pot);
+    start += random.uniform(10000, 40000);
+  }
+  return spills;
+}
+
+}
@@ -0,0 +1,114 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       SyntheticEventGenerator
+//// File:        SyntheticEvents.h
+////
+//// Synthetic trigger primitives and trigger activities for timing and
+//// checking the filter algorithms without raw data. Each event has
+//// radiological noise TPs over all channels and the readout window
+//// (SyntheticConfig::noiseTPs, the TP multiplicity of the event) and
+//// one of the topologies:
+////   - shower:        an APA 3 shower starting downstream of the veto
+////                    channels, the TA of the event;
+////   - upstream muon: the same shower with a through-going muon on the
+////                    whole APA 3 collection face at the shower time;
+////   - ground shake:  TPs on every plane of every APA spread over a
+////                    wide time window, with a TA on APA 3;
+////   - pile-up:       the shower with cosmic tracks at other times, some
+////                    of them with a TA of their own on APA 1, 2 or 4.
+//// Each event has one TC, of type kADCSimpleWindow for the ground
+//// shake and kPrescale otherwise. The generator uses its own random
+//// number engine and integer arithmetic for the draws, so a seed gives
+//// the same events on every platform and the decisions of a run can be
+//// kept as a reference.
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_ALGORITHMS_SYNTHETICEVENTS_H
+#define PDHDBSMDATA_ALGORITHMS_SYNTHETICEVENTS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "pdhdbsmdata/Algorithms/PDHDChannelMap.h"
+#include "pdhdbsmdata/Algorithms/SpillTimeline.h"
+#include "pdhdbsmdata/Algorithms/TriggerEvent.h"
+
+namespace pdhd {
+
+enum class SyntheticTopology : uint8_t {
+  kShower,
+  kUpstreamMuon,
+  kGroundShake,
+  kPileUp,
+  kNTopologies
+};
+
+// "shower", "upstream_muon", "ground_shake" or "pile_up"
+const char* syntheticTopologyName(SyntheticTopology topology);
+
+struct SyntheticConfig {
+  std::size_t noiseTPs = 2000;        // Radiological TPs per event
+  std::size_t showerTPs = 400;
+  std::size_t groundShakeTPs = 20000;
+  std::size_t pileUpTracks = 4;       // Cosmic tracks per pile-up event, every other one with a TA
+  uint64_t readoutTicks = 500000;     // TPs in [timestamp - readoutTicks/2, timestamp + readoutTicks/2)
+};
+
+struct SyntheticEvent : TriggerEvent {
+  SyntheticTopology topology = SyntheticTopology::kShower;
+  uint64_t timestamp = 0; // DAQ ticks of the trigger, time_ns is 16 ns per tick
+};
+
+// SplitMix64, the same sequence on every platform unlike the std distributions
+class SyntheticRandom {
+  public:
+    explicit SyntheticRandom(uint64_t seed) : fState(seed) {}
+
+    uint64_t next() {
+      uint64_t z = (fState += 0x9E3779B97F4A7C15ULL);
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+      return z ^ (z >> 31);
+    }
+    // Uniform in [lo, hi]
+    uint64_t uniform(uint64_t lo, uint64_t hi) { return lo + next() % (hi - lo + 1); }
+    // Approximately normal, sum of four uniforms in integer arithmetic, rounded to an integer
+    int64_t gauss(int64_t sigma);
+
+  private:
+    uint64_t fState;
+};
+
+class SyntheticEventGenerator {
+  public:
+    explicit SyntheticEventGenerator(uint64_t seed, SyntheticConfig const& config = SyntheticConfig()) :
+      fRandom(seed),
+      fConfig(config) {}
+
+    SyntheticEvent generate(SyntheticTopology topology, uint64_t timestamp);
+
+    SyntheticConfig const& config() const { return fConfig; }
+
+  private:
+    using TPs = std::vector<dunedaq::trgdataformats::TriggerPrimitive>;
+
+    void addTP(TPs& tps, uint32_t channel, uint64_t timePeak);
+    void addNoise(SyntheticEvent& event);
+    // Shower on the main collection face of apa starting at vertex, returns the positions of its TPs
+    std::vector<uint32_t> addShower(SyntheticEvent& event, uint32_t vertex, uint64_t centre, uint64_t sigma);
+    // Track over the channels with the time changing by slope ticks per channel
+    std::vector<uint32_t> addTrack(SyntheticEvent& event, chmap::ChannelRange channels, uint64_t start, int64_t slope);
+    void addTA(SyntheticEvent& event, std::vector<uint32_t> const& tps);
+
+    SyntheticRandom fRandom;
+    SyntheticConfig fConfig;
+};
+
+// n spills as (start in ms, PoT), sorted, every 10 to 40 s from first with one in ten at zero PoT
+std::vector<std::pair<spilltime_t, uint64_t>> makeSyntheticSpills(SyntheticRandom& random, std::size_t n,
+                                                                   spilltime_t first);
+
+}
+
+#endif
@@ -0,0 +1,53 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        TCFragmentDecoder.cc
+//////////////////////////////////////////////////////////////////////////
+
+#include "pdhdbsmdata/Algorithms/TCFragmentDecoder.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "cetlib_except/exception.h"
+#include "detdataformats/trigger/TriggerObjectOverlay.hpp"
+
+namespace pdhd {
+
+using dunedaq::trgdataformats::TriggerActivityData;
+using dunedaq::trgdataformats::TriggerCandidate;
+using dunedaq::trgdataformats::TriggerCandidateData;
+
+//-------------------------------------
+std::size_t decodeTCFragment(void const* payload, std::size_t size, std::vector<TriggerCandidateData>& tcs) {
+  const unsigned char *bytes = static_cast<const unsigned char*>(payload);
+  std::size_t offset = 0;
+  std::size_t n = 0;
+  // Fields are copied out, the overlays in the payload need not be aligned
+  while (offset < size) {
+    if (size - offset < sizeof(TriggerCandidate)) {
+      throw cet::exception("TCFragmentDecoder") << "Truncated TC " << n << ": " << size - offset
+        << " bytes left of the payload, the TC header needs " << sizeof(TriggerCandidate) << ".\n";
+    }
+    uint64_t nInputs(0);
+    std::memcpy(&nInputs, bytes + offset + offsetof(TriggerCandidate, n_inputs), sizeof(nInputs));
+    const std::size_t inputBytes = size - offset - sizeof(TriggerCandidate);
+    if (nInputs > inputBytes / sizeof(TriggerActivityData)) {
+      throw cet::exception("TCFragmentDecoder") << "Truncated TC " << n << ": " << nInputs
+        << " input TAs do not fit in the " << inputBytes << " bytes left of the payload.\n";
+    }
+
+    TriggerCandidateData &tc = tcs.emplace_back();
+    std::memcpy(&tc, bytes + offset + offsetof(TriggerCandidate, data), sizeof(TriggerCandidateData));
+    offset += sizeof(TriggerCandidate) + nInputs * sizeof(TriggerActivityData);
+    n++;
+  }
+  return n;
+}
+
+//-------------------------------------
+bool sameTriggerCandidate(TriggerCandidateData const& a, TriggerCandidateData const& b) {
+  return a.version == b.version && a.time_start == b.time_start && a.time_end == b.time_end &&
+    a.time_candidate == b.time_candidate && a.detid == b.detid && a.type == b.type && a.algorithm == b.algorithm;
+}
+
+}
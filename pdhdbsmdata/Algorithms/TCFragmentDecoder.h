@@ -0,0 +1,32 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        TCFragmentDecoder.h
+////
+//// Decoding of the payload of a DAQ trigger candidate fragment, i.e.
+//// the bytes after the FragmentHeader: a sequence of TriggerCandidate
+//// overlays, each a TriggerCandidateData, a uint64 n_inputs and its
+//// n_inputs TriggerActivityData. Only the TriggerCandidateData are
+//// kept, as by the full trigger decoder; the input TAs are skipped.
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_ALGORITHMS_TCFRAGMENTDECODER_H
+#define PDHDBSMDATA_ALGORITHMS_TCFRAGMENTDECODER_H
+
+#include <cstddef>
+#include <vector>
+
+#include "detdataformats/trigger/TriggerCandidateData.hpp"
+
+namespace pdhd {
+
+// Append the TCs of the payload to tcs and return how many there were.
+// Throws cet::exception if the last TC runs past the end of the payload.
+std::size_t decodeTCFragment(void const* payload, std::size_t size,
+                             std::vector<dunedaq::trgdataformats::TriggerCandidateData>& tcs);
+
+// Field-by-field equality, the padding of the struct is not compared
+bool sameTriggerCandidate(dunedaq::trgdataformats::TriggerCandidateData const& a,
+                          dunedaq::trgdataformats::TriggerCandidateData const& b);
+
+}
+
+#endif
@@ -0,0 +1,117 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        TCTypeSelector.cc
+//////////////////////////////////////////////////////////////////////////
+
+#include "pdhdbsmdata/Algorithms/TCTypeSelector.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <map>
+
+#include "cetlib_except/exception.h"
+
+namespace pdhd {
+
+namespace {
+
+  using tc_t = TCTypeSelector::tc_t;
+
+  // trgdataformats only names the types, so the algorithms are listed here
+  std::map<std::size_t, std::string> algorithmNames() {
+    using A = tc_t::Algorithm;
+    std::map<std::size_t, std::string> names;
+    for (const auto &[algorithm, name] : std::map<A, std::string>{
+           {A::kUnknown, "kUnknown"}, {A::kSupernova, "kSupernova"},
+           {A::kHSIEventToTriggerCandidate, "kHSIEventToTriggerCandidate"}, {A::kPrescale, "kPrescale"},
+           {A::kADCSimpleWindow, "kADCSimpleWindow"}, {A::kHorizontalMuon, "kHorizontalMuon"},
+           {A::kMichelElectron, "kMichelElectron"}, {A::kPlaneCoincidence, "kPlaneCoincidence"},
+           {A::kCustom, "kCustom"}, {A::kDBSCAN, "kDBSCAN"}, {A::kChannelDistribution, "kChannelDistribution"},
+           {A::kBundle, "kBundle"}}) {
+      names[static_cast<std::size_t>(algorithm)] = name;
+    }
+    return names;
+  }
+
+  std::map<std::size_t, std::string> typeNames() {
+    std::map<std::size_t, std::string> names;
+    for (const auto &[type, name] : dunedaq::trgdataformats::get_trigger_candidate_type_names()) {
+      names[static_cast<std::size_t>(type)] = name;
+    }
+    return names;
+  }
+
+  std::map<std::size_t, std::string> const& names(bool types) {
+    static const std::map<std::size_t, std::string> types_ = typeNames();
+    static const std::map<std::size_t, std::string> algorithms_ = algorithmNames();
+    return types ? types_ : algorithms_;
+  }
+
+  // Bits of the codes in a list of names or numbers
+  std::bitset<TCTypeSelector::kMaxCode> parseCodes(std::vector<std::string> const& list, bool types) {
+    std::bitset<TCTypeSelector::kMaxCode> codes;
+    for (const auto &entry : list) {
+      std::size_t code = TCTypeSelector::kMaxCode;
+      if (!entry.empty() && std::isdigit(static_cast<unsigned char>(entry[0]))) {
+        const auto [end, error] = std::from_chars(entry.data(), entry.data() + entry.size(), code);
+        if (error != std::errc() || end != entry.data() + entry.size()) code = TCTypeSelector::kMaxCode;
+      } else {
+        for (const auto &[c, name] : names(types)) {
+          if (name == entry) code = c;
+        }
+      }
+      if (code >= TCTypeSelector::kMaxCode - 1) {
+        throw cet::exception("TCTypeSelector") << "Unknown TC " << (types ? "type" : "algorithm") << " \"" << entry << "\".\n";
+      }
+      codes.set(code);
+    }
+    return codes;
+  }
+
+}
+
+//-------------------------------------
+TCVetoPolicy parseTCVetoPolicy(std::string const& policy) {
+  if (policy == "any") return TCVetoPolicy::kAny;
+  if (policy == "all") return TCVetoPolicy::kAll;
+  if (policy == "count") return TCVetoPolicy::kCount;
+  throw cet::exception("TCTypeSelector") << "Unknown Policy \"" << policy
+    << "\", expected \"any\", \"all\" or \"count\".\n";
+}
+
+//-------------------------------------
+TCTypeSelector::TCTypeSelector(Config const& config) :
+  fPolicy(config.policy),
+  fMinVetoed(config.policy == TCVetoPolicy::kCount ? std::max<std::size_t>(config.minVetoed, 1) : 1) {
+
+  const auto acceptTypes = parseCodes(config.acceptTypes, true);
+  const auto rejectTypes = parseCodes(config.rejectTypes, true);
+  const auto acceptAlgorithms = parseCodes(config.acceptAlgorithms, false);
+  const auto rejectAlgorithms = parseCodes(config.rejectAlgorithms, false);
+
+  // Codes past the named ones (the shared last slot) are only accepted without an accept list
+  std::bitset<kMaxCode> vetoTypes = rejectTypes;
+  if (acceptTypes.any()) vetoTypes |= ~acceptTypes;
+  std::bitset<kMaxCode> vetoAlgorithms = rejectAlgorithms;
+  if (acceptAlgorithms.any()) vetoAlgorithms |= ~acceptAlgorithms;
+
+  for (std::size_t t = 0; t < kMaxCode; t++) {
+    for (std::size_t a = 0; a < kMaxCode; a++) {
+      fVeto[t * kMaxCode + a] = vetoTypes[t] || vetoAlgorithms[a];
+    }
+  }
+}
+
+//-------------------------------------
+std::string TCTypeSelector::typeName(std::size_t code) {
+  const auto name = names(true).find(code);
+  return name == names(true).end() ? std::to_string(code) : name->second;
+}
+
+//-------------------------------------
+std::string TCTypeSelector::algorithmName(std::size_t code) {
+  const auto name = names(false).find(code);
+  return name == names(false).end() ? std::to_string(code) : name->second;
+}
+
+}
@@ -0,0 +1,104 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       TCTypeSelector
+//// File:        TCTypeSelector.h
+////
+//// Trigger candidate veto of PDHDTriggerTypeFilter, kept free of art.
+//// Accept and reject lists of TC types and algorithms are compiled at
+//// construction into one bit per (type, algorithm) pair, so checking a
+//// TC is a single bit test. A TC is vetoed if its type or algorithm is
+//// rejected, or is missing from a non-empty accept list.
+////
+//// The policy turns the vetoed TCs into the event decision:
+////   "any"   reject the event at the first vetoed TC
+////   "all"   reject it if it has TCs and all of them are vetoed
+////   "count" reject it once MinVetoed TCs are vetoed
+//// Each scan stops as soon as the decision is known.
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_ALGORITHMS_TCTYPESELECTOR_H
+#define PDHDBSMDATA_ALGORITHMS_TCTYPESELECTOR_H
+
+#include <bitset>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "detdataformats/trigger/TriggerCandidateData.hpp"
+
+namespace pdhd {
+
+enum class TCVetoPolicy { kAny, kAll, kCount };
+
+// "any", "all" or "count", throws cet::exception otherwise
+TCVetoPolicy parseTCVetoPolicy(std::string const& policy);
+
+class TCTypeSelector {
+  public:
+    using tc_t = dunedaq::trgdataformats::TriggerCandidateData;
+    using type_t = tc_t::Type;
+    using algorithm_t = tc_t::Algorithm;
+
+    // Type and algorithm codes from 0 to kMaxCode - 1 can be configured;
+    // larger codes found in the data share the last slot
+    static constexpr std::size_t kMaxCode = 64;
+
+    struct Config {
+      // Names as "kADCSimpleWindow" or numeric codes as "6"
+      std::vector<std::string> acceptTypes;
+      std::vector<std::string> rejectTypes;
+      std::vector<std::string> acceptAlgorithms;
+      std::vector<std::string> rejectAlgorithms;
+      TCVetoPolicy policy = TCVetoPolicy::kAny;
+      std::size_t minVetoed = 1; // For kCount
+    };
+
+    struct Decision {
+      bool reject = false;
+      std::size_t checked = 0; // TCs looked at before the decision was known
+      std::size_t vetoed = 0;  // Of which vetoed
+    };
+
+    explicit TCTypeSelector(Config const& config);
+
+    static std::size_t slot(type_t type) { return clampCode(static_cast<std::size_t>(type)); }
+    static std::size_t slot(algorithm_t algorithm) { return clampCode(static_cast<std::size_t>(algorithm)); }
+
+    bool vetoed(tc_t const& tc) const { return fVeto[slot(tc.type) * kMaxCode + slot(tc.algorithm)]; }
+
+    // Event decision over the TCs [first, last)
+    Decision decide(tc_t const* first, tc_t const* last) const {
+      Decision decision;
+      for (tc_t const* tc = first; tc != last; ++tc) {
+        decision.checked++;
+        if (!vetoed(*tc)) {
+          if (fPolicy == TCVetoPolicy::kAll) return decision;
+          continue;
+        }
+        decision.vetoed++;
+        if (fPolicy != TCVetoPolicy::kAll && decision.vetoed >= fMinVetoed) {
+          decision.reject = true;
+          return decision;
+        }
+      }
+      decision.reject = fPolicy == TCVetoPolicy::kAll && decision.checked > 0;
+      return decision;
+    }
+
+    TCVetoPolicy policy() const { return fPolicy; }
+    std::size_t minVetoed() const { return fMinVetoed; }
+
+    // Configured name of a code: the dunedaq name if it has one, else the number
+    static std::string typeName(std::size_t code);
+    static std::string algorithmName(std::size_t code);
+
+  private:
+    static std::size_t clampCode(std::size_t code) { return code < kMaxCode ? code : kMaxCode - 1; }
+
+    std::bitset<kMaxCode * kMaxCode> fVeto; // Bit type * kMaxCode + algorithm
+    TCVetoPolicy fPolicy;
+    std::size_t fMinVetoed;
+};
+
+}
+
+#endif
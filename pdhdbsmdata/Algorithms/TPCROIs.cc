@@ -0,0 +1,118 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        TPCROIs.cc
+//////////////////////////////////////////////////////////////////////////
+
+#include "pdhdbsmdata/Algorithms/TPCROIs.h"
+
+#include <algorithm>
+
+#include "cetlib_except/exception.h"
+
+namespace pdhd {
+
+//-------------------------------------
+void addTAROIs(TPIndex const& tpIndex, std::size_t ta, uint64_t start, uint64_t end,
+               ROIPadding const& padding, std::vector<TPCROI>& rois) {
+  // TPs of this TA are rows [ta_begin, ta_end) of ta_tps, in channel order
+  const std::size_t ta_begin = tpIndex.taBegin(ta);
+  const std::size_t ta_end = tpIndex.taEnd(ta);
+  if (ta_begin == ta_end) return;
+
+  const uint8_t apa = chmap::mainCollectionAPA(tpIndex.ta_tps.channel[ta_begin]);
+  if (apa == chmap::kNoAPA) return;
+
+  // The TPs past the face are those of another face or APA, the filters only look at the first one
+  const chmap::ChannelRange face = chmap::mainCollectionRange(apa);
+  const uint32_t first = tpIndex.ta_tps.channel[ta_begin];
+  const uint32_t last = std::min(tpIndex.ta_tps.channel[ta_end - 1], face.last);
+  const uint64_t time_start = start > padding.ticks ? start - padding.ticks : 0;
+  const uint64_t time_end = end < std::numeric_limits<uint64_t>::max() - padding.ticks ? end + padding.ticks
+                                                                                        : std::numeric_limits<uint64_t>::max();
+
+  rois.push_back({apa, first - std::min(first - face.first, padding.channels),
+                  last + std::min(face.last - last, padding.channels), time_start, time_end});
+  if (padding.inductionPlanes) {
+    for (uint8_t plane : {chmap::kU, chmap::kV}) {
+      const chmap::ChannelRange range = chmap::planeRange(apa, plane);
+      rois.push_back({apa, range.first, range.last, time_start, time_end});
+    }
+  }
+}
+
+//-------------------------------------
+void completeEventROIs(bool pass, std::vector<TPCROI>& rois) {
+  if (!pass) {
+    rois.clear();
+    return;
+  }
+  if (!rois.empty()) return;
+  for (uint32_t block = 0; block < chmap::kNAPAs; block++) {
+    rois.push_back({chmap::kAPAOfBlock[block], block * chmap::kChannelsPerAPA, (block + 1) * chmap::kChannelsPerAPA - 1,
+                    0, std::numeric_limits<uint64_t>::max()});
+  }
+}
+
+//-------------------------------------
+ROITickMode parseROITickMode(std::string const& mode) {
+  if (mode == "roi") return ROITickMode::kROI;
+  if (mode == "event") return ROITickMode::kEvent;
+  if (mode == "readout") return ROITickMode::kReadout;
+  throw cet::exception("TPCROIs") << "Unknown tick window \"" << mode
+    << "\", expected \"roi\", \"event\" or \"readout\".\n";
+}
+
+//-------------------------------------
+SampleRange samplesInWindow(uint64_t timestamp, std::size_t nSamples, TickWindow const& window) {
+  if (nSamples == 0 || window.empty()) return {};
+  const uint64_t last = timestamp + (nSamples - 1) * kTicksPerSample;
+  if (!window.overlaps(timestamp, last)) return {};
+  const std::size_t first = window.start > timestamp ? (window.start - timestamp + kTicksPerSample - 1) / kTicksPerSample : 0;
+  const std::size_t end = std::min<uint64_t>(nSamples - 1, (window.end - timestamp) / kTicksPerSample);
+  if (first > end) return {};
+  return {first, end - first + 1};
+}
+
+//-------------------------------------
+ROIChannelWindows::ROIChannelWindows(std::vector<TPCROI> const& rois, ROITickMode mode, uint64_t padTicks) :
+  ROIChannelWindows() {
+  constexpr uint64_t kMaxTick = std::numeric_limits<uint64_t>::max();
+  TickWindow common{0, kMaxTick};
+  if (mode == ROITickMode::kEvent) {
+    common = TickWindow();
+    for (const auto &roi : rois) common.merge(roi.time_start, roi.time_end);
+  }
+  std::vector<TPCROI> padded(rois);
+  for (auto &roi : padded) {
+    if (mode != ROITickMode::kROI) {
+      roi.time_start = common.start;
+      roi.time_end = common.end;
+    }
+    roi.time_start = roi.time_start > padTicks ? roi.time_start - padTicks : 0;
+    roi.time_end = roi.time_end < kMaxTick - padTicks ? roi.time_end + padTicks : kMaxTick;
+  }
+  add(padded);
+}
+
+//-------------------------------------
+void ROIChannelWindows::add(std::vector<TPCROI> const& rois) {
+  for (const auto &roi : rois) {
+    if (roi.time_start > roi.time_end) continue;
+    const uint32_t last = std::min<uint32_t>(roi.channel_last, chmap::kNChannels - 1);
+    for (uint32_t channel = roi.channel_first; channel <= last; channel++) {
+      TickWindow &window = fWindows[channel];
+      if (window.empty()) fNChannels++;
+      window.merge(roi.time_start, roi.time_end);
+    }
+    if (roi.channel_first <= last) fSpan.merge(roi.time_start, roi.time_end);
+  }
+}
+
+//-------------------------------------
+void ROIChannelWindows::keepReadoutStart() {
+  for (auto &window : fWindows) {
+    if (!window.empty()) window.start = 0;
+  }
+  if (!fSpan.empty()) fSpan.start = 0;
+}
+
+}
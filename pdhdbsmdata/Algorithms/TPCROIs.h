@@ -0,0 +1,115 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       ROIChannelWindows
+//// File:        TPCROIs.h
+////
+//// The pdhd::TPCROIs of the TP-based filters. addTAROIs() makes the
+//// ROIs of a TA that passed the event: the channels of its TPs on the
+//// main collection face of its APA and, since the induction wires wrap
+//// around the APA and no narrower range of them covers a collection
+//// range, optionally the whole U and V planes of the APA, all over one
+//// time window and padded. ROIChannelWindows gives the decoders the
+//// time window of each channel over all the ROIs of an event, and
+//// samplesInWindow() the samples of a waveform inside a window. An
+//// event passed without the ROIs of a TA gets the whole detector
+//// (completeEventROIs), never an empty decoding. The
+//// signal processing counts ticks from the first sample of a RawDigit
+//// and ignores its RDTimeStamp, so digits cut to the windows keep the
+//// readout start unless told otherwise (keepReadoutStart).
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_ALGORITHMS_TPCROIS_H
+#define PDHDBSMDATA_ALGORITHMS_TPCROIS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "pdhdbsmdata/Algorithms/PDHDChannelMap.h"
+#include "pdhdbsmdata/DataProducts/TPCROI.h"
+#include "pdhdbsmdata/DataProducts/TPIndex.h"
+
+namespace pdhd {
+
+constexpr uint64_t kTicksPerSample = 32; // 512 ns ADC samples in 16 ns DAQ ticks
+
+struct ROIPadding {
+  uint32_t channels = 0;        // On each side of the TPs, within the collection face
+  uint64_t ticks = 0;           // DAQ ticks on each side of the time window
+  bool inductionPlanes = false; // Also the U and V planes of the APA
+};
+
+// Appends the ROIs of TA ta over the time window [start, end] (DAQ ticks, inclusive) to rois.
+// A TA without TPs or whose first TP is not on a main collection face has none.
+void addTAROIs(TPIndex const& tpIndex, std::size_t ta, uint64_t start, uint64_t end,
+               ROIPadding const& padding, std::vector<TPCROI>& rois);
+
+// The ROIs a filter writes for an event, given those of the TAs that passed it. An event passed
+// without any (no TAs, only skipped TAs, simulation) gets every channel of every APA over all
+// ticks, so the decoders keep all of its waveforms as a full decoding; a rejected event none.
+void completeEventROIs(bool pass, std::vector<TPCROI>& rois);
+
+struct TickWindow {
+  uint64_t start = std::numeric_limits<uint64_t>::max(); // DAQ ticks, both ends inclusive; empty if start > end
+  uint64_t end = 0;
+
+  bool empty() const { return start > end; }
+  bool overlaps(uint64_t first, uint64_t last) const { return start <= last && first <= end; }
+  void merge(uint64_t first, uint64_t last) {
+    if (first < start) start = first;
+    if (last > end) end = last;
+  }
+};
+
+// Ticks a decoder keeps of each ROI channel
+enum class ROITickMode {
+  kROI,    // The windows of the channel's own ROIs
+  kEvent,  // The span of all ROIs of the event, the same for every channel
+  kReadout // All
+};
+
+// "roi", "event" or "readout"; throws cet::exception otherwise
+ROITickMode parseROITickMode(std::string const& mode);
+
+// Samples [first, first + count) of a waveform of nSamples samples from timestamp that are in the window
+struct SampleRange {
+  std::size_t first = 0;
+  std::size_t count = 0;
+};
+SampleRange samplesInWindow(uint64_t timestamp, std::size_t nSamples, TickWindow const& window);
+
+class ROIChannelWindows {
+  public:
+    ROIChannelWindows() : fWindows(chmap::kNChannels) {}
+    explicit ROIChannelWindows(std::vector<TPCROI> const& rois) : ROIChannelWindows() { add(rois); }
+
+    // The windows of the ROIs as set by mode, padded by padTicks on each side
+    ROIChannelWindows(std::vector<TPCROI> const& rois, ROITickMode mode, uint64_t padTicks = 0);
+
+    // A channel in several ROIs gets the smallest window holding all of theirs
+    void add(std::vector<TPCROI> const& rois);
+
+    // Start every window at tick 0, so a waveform cut to it keeps the readout start as its first
+    // sample and its sample numbers stay those of the full readout; only the ticks after are dropped
+    void keepReadoutStart();
+
+    // Window of the channel, empty if no ROI holds it
+    TickWindow const& window(uint32_t channel) const {
+      return channel < fWindows.size() ? fWindows[channel] : fNoWindow;
+    }
+    // Smallest window holding those of every channel
+    TickWindow const& span() const { return fSpan; }
+    std::size_t nChannels() const { return fNChannels; }
+    bool empty() const { return fNChannels == 0; }
+
+  private:
+    std::vector<TickWindow> fWindows; // By offline channel
+    TickWindow fSpan;
+    TickWindow fNoWindow;
+    std::size_t fNChannels = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,75 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        TPIndexBuilder.cc
+//////////////////////////////////////////////////////////////////////////
+
+#include "pdhdbsmdata/Algorithms/TPIndexBuilder.h"
+#include "pdhdbsmdata/Algorithms/PDHDChannelMap.h"
+
+#include <algorithm>
+#include <numeric>
+#include <tuple>
+
+namespace pdhd {
+
+using channel_t = dunedaq::trgdataformats::channel_t;
+using triggerprimitive_t = dunedaq::trgdataformats::TriggerPrimitive;
+
+namespace {
+
+  // Order of the rows inside a partition
+  bool channelTimeLess(const triggerprimitive_t &lh, const triggerprimitive_t &rh) {
+    return std::tie(lh.channel, lh.time_peak) < std::tie(rh.channel, rh.time_peak);
+  }
+
+}
+
+//-------------------------------------
+unsigned tpIndexPartition(channel_t channel) {
+  chmap::ChannelInfo const& info = chmap::channelInfo(channel);
+  return info.valid() ? TPIndex::partition(info.apa, info.plane) : TPIndex::kOtherPartition;
+}
+
+//-------------------------------------
+void fillDetectorTPs(triggerprimitive_t const* tps, size_t nTPs, TPIndex& index) {
+  std::vector<unsigned> partition(nTPs);
+  std::vector<uint32_t> order(nTPs);
+  std::iota(order.begin(), order.end(), 0);
+  for (size_t tp = 0; tp < nTPs; tp++) {
+    partition[tp] = tpIndexPartition(tps[tp].channel);
+  }
+
+  std::sort(order.begin(), order.end(),
+      [&] (uint32_t lh, uint32_t rh) -> bool {
+        if (partition[lh] != partition[rh]) return partition[lh] < partition[rh];
+        return channelTimeLess(tps[lh], tps[rh]); });
+
+  index.detector = TPColumns();
+  index.detector.reserve(nTPs);
+  std::fill(index.partition_offsets.begin(), index.partition_offsets.end(), 0);
+
+  for (const auto &tp : order) {
+    index.detector.push_back(tps[tp].channel, tps[tp].time_peak, tps[tp].time_start, tps[tp].adc_integral, tp);
+    index.partition_offsets[partition[tp] + 1]++;
+  }
+  std::partial_sum(index.partition_offsets.begin(), index.partition_offsets.end(), index.partition_offsets.begin());
+}
+
+//-------------------------------------
+void appendTA(dunedaq::trgdataformats::TriggerActivityData const& ta,
+              std::vector<triggerprimitive_t const*> const& tps,
+              std::vector<uint32_t> const& source,
+              TPIndex& index) {
+  std::vector<uint32_t> order(tps.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(),
+      [&] (uint32_t lh, uint32_t rh) -> bool { return channelTimeLess(*tps[lh], *tps[rh]); });
+
+  for (const auto &tp : order) {
+    index.ta_tps.push_back(tps[tp]->channel, tps[tp]->time_peak, tps[tp]->time_start, tps[tp]->adc_integral, source[tp]);
+  }
+  index.ta_offsets.push_back(index.ta_tps.size());
+  index.ta_time_start.push_back(ta.time_start);
+  index.ta_time_end.push_back(ta.time_end);
+}
+
+}
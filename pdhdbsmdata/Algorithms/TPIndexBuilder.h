@@ -0,0 +1,39 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        TPIndexBuilder.h
+////
+//// Fill a pdhd::TPIndex from the decoded trigger primitives and the TPs
+//// associated to each trigger activity.
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_ALGORITHMS_TPINDEXBUILDER_H
+#define PDHDBSMDATA_ALGORITHMS_TPINDEXBUILDER_H
+
+#include <cstddef>
+#include <vector>
+
+#include "detdataformats/trigger/TriggerActivityData.hpp"
+#include "detdataformats/trigger/TriggerPrimitive.hpp"
+
+#include "pdhdbsmdata/DataProducts/TPIndex.h"
+
+namespace pdhd {
+
+// Partition of the channel in TPIndex::detector, TPIndex::kOtherPartition
+// for channels outside the four APAs
+unsigned tpIndexPartition(dunedaq::trgdataformats::channel_t channel);
+
+// Replace the detector columns with the given TPs
+void fillDetectorTPs(dunedaq::trgdataformats::TriggerPrimitive const* tps, std::size_t nTPs, TPIndex& index);
+inline void fillDetectorTPs(std::vector<dunedaq::trgdataformats::TriggerPrimitive> const& tps, TPIndex& index) {
+  fillDetectorTPs(tps.data(), tps.size(), index);
+}
+
+// Append a TA and its TPs; source holds the position of each TP in the input collection
+void appendTA(dunedaq::trgdataformats::TriggerActivityData const& ta,
+              std::vector<dunedaq::trgdataformats::TriggerPrimitive const*> const& tps,
+              std::vector<uint32_t> const& source,
+              TPIndex& index);
+
+}
+
+#endif
@@ -0,0 +1,145 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        TPOccupancyIndex.cc
+//////////////////////////////////////////////////////////////////////////
+
+#include "pdhdbsmdata/Algorithms/TPOccupancyIndex.h"
+
+#include <numeric>
+
+#include "cetlib_except/exception.h"
+
+namespace pdhd {
+
+//-------------------------------------
+VetoCountMode parseVetoCountMode(std::string const& mode) {
+  if (mode == "hits") return VetoCountMode::kHits;
+  if (mode == "channels") return VetoCountMode::kChannels;
+  throw cet::exception("TPOccupancyIndex") << "Unknown VetoCountMode \"" << mode
+    << "\", expected \"hits\" or \"channels\".\n";
+}
+
+//-------------------------------------
+TPOccupancyIndex::TPOccupancyIndex(chmap::ChannelRange channels, channel_t const* channel, tick_t const* time, std::size_t n,
+                                   unsigned timeBinShift) :
+  fChannels(channels),
+  fNChannels(channels.size()),
+  fShift(timeBinShift) {
+
+  // TPs inside the channel range, in channel order
+  std::vector<uint32_t> rows;
+  rows.reserve(n);
+  tick_t tmin = ~tick_t(0);
+  tick_t tmax = 0;
+  bool channelOrdered = true;
+  for (std::size_t i = 0; i < n; i++) {
+    if (!channels.contains(channel[i])) continue;
+    channelOrdered = channelOrdered && (rows.empty() || channel[rows.back()] <= channel[i]);
+    rows.push_back(i);
+    tmin = std::min(tmin, time[i]);
+    tmax = std::max(tmax, time[i]);
+  }
+  if (rows.empty()) return;
+
+  if (!channelOrdered) {
+    // Stable counting sort by channel; not needed for a TPIndex partition
+    std::vector<uint32_t> channelOffsets(fNChannels + 1, 0);
+    for (const auto &i : rows) channelOffsets[channel[i] - fChannels.first + 1]++;
+    std::partial_sum(channelOffsets.begin(), channelOffsets.end(), channelOffsets.begin());
+    std::vector<uint32_t> byChannel(rows.size());
+    for (const auto &i : rows) byChannel[channelOffsets[channel[i] - fChannels.first]++] = i;
+    rows.swap(byChannel);
+  }
+
+  while (((tmax - tmin) >> fShift) + 1 > kMaxTimeBins) fShift++;
+  fTimeOrigin = tmin;
+  fNBins = ((tmax - tmin) >> fShift) + 1;
+
+  const std::size_t width = fNBins + 1;
+  std::vector<uint16_t> bins(rows.size());
+  fBinOffsets.assign(width, 0);
+  fSAT.assign((fNChannels + 1) * width, 0);
+  for (std::size_t r = 0; r < rows.size(); r++) {
+    const uint32_t i = rows[r];
+    bins[r] = (time[i] - fTimeOrigin) >> fShift;
+    fBinOffsets[bins[r] + 1]++;
+    fSAT[(channel[i] - fChannels.first + 1) * width + bins[r] + 1]++;
+  }
+  std::partial_sum(fBinOffsets.begin(), fBinOffsets.end(), fBinOffsets.begin());
+
+  // Stable counting sort of the channel-ordered TPs by bin gives (bin, channel) order
+  std::vector<uint32_t> next(fBinOffsets.begin(), fBinOffsets.end() - 1);
+  fLocalChannel.resize(rows.size());
+  fTime.resize(rows.size());
+  for (std::size_t r = 0; r < rows.size(); r++) {
+    const uint32_t row = next[bins[r]]++;
+    fLocalChannel[row] = channel[rows[r]] - fChannels.first;
+    fTime[row] = time[rows[r]];
+  }
+
+  // Cell counts to summed-area table: prefix sums along each channel, then across channels
+  for (std::size_t c = 1; c <= fNChannels; c++) {
+    uint32_t *row = &fSAT[c * width];
+    std::partial_sum(row, row + width, row);
+    const uint32_t *previous = row - width;
+    for (std::size_t b = 0; b < width; b++) row[b] += previous[b];
+  }
+}
+
+//-------------------------------------
+bool TPOccupancyIndex::window(channel_t c0, channel_t c1, tick_t t0, tick_t t1, Window& w) const {
+  if (fNBins == 0 || t0 > t1) return false;
+  c0 = std::max(c0, fChannels.first);
+  c1 = std::min(c1, fChannels.last);
+  if (c0 > c1) return false;
+
+  const tick_t tlast = fTimeOrigin + (tick_t(fNBins) << fShift) - 1;
+  if (t1 < fTimeOrigin || t0 > tlast) return false;
+
+  w.c0 = c0 - fChannels.first;
+  w.c1 = c1 - fChannels.first;
+  w.b0 = t0 < fTimeOrigin ? 0 : (t0 - fTimeOrigin) >> fShift;
+  w.b1 = std::min<std::size_t>(fNBins - 1, (t1 - fTimeOrigin) >> fShift);
+  w.t0 = t0;
+  w.t1 = t1;
+  return true;
+}
+
+//-------------------------------------
+uint32_t TPOccupancyIndex::rect(std::size_t c0, std::size_t c1, std::size_t b0, std::size_t b1) const {
+  if (b0 > b1) return 0;
+  const std::size_t width = fNBins + 1;
+  return fSAT[(c1 + 1) * width + b1 + 1] - fSAT[c0 * width + b1 + 1] - fSAT[(c1 + 1) * width + b0] + fSAT[c0 * width + b0];
+}
+
+//-------------------------------------
+std::size_t TPOccupancyIndex::countHits(channel_t c0, channel_t c1, tick_t t0, tick_t t1) const {
+  Window w;
+  if (!window(c0, c1, t0, t1, w)) return 0;
+
+  std::size_t hits = 0;
+  auto count = [&] (std::size_t) { hits++; };
+  scanBin(w.b0, w, count);
+  if (w.b1 == w.b0) return hits;
+
+  // Bins strictly inside the window come from the table, the two edge bins are scanned
+  scanBin(w.b1, w, count);
+  return hits + rect(w.c0, w.c1, w.b0 + 1, w.b1 - 1);
+}
+
+//-------------------------------------
+std::size_t TPOccupancyIndex::countChannels(channel_t c0, channel_t c1, tick_t t0, tick_t t1) const {
+  Window w;
+  if (!window(c0, c1, t0, t1, w)) return 0;
+
+  std::vector<uint8_t> hit(w.c1 - w.c0 + 1, 0);
+  for (std::size_t c = w.c0; w.b1 > w.b0 + 1 && c <= w.c1; c++) {
+    hit[c - w.c0] = rect(c, c, w.b0 + 1, w.b1 - 1) > 0;
+  }
+  auto mark = [&] (std::size_t row) { hit[fLocalChannel[row] - w.c0] = 1; };
+  scanBin(w.b0, w, mark);
+  if (w.b1 != w.b0) scanBin(w.b1, w, mark);
+
+  return std::count(hit.begin(), hit.end(), 1);
+}
+
+}
@@ -0,0 +1,121 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       TPOccupancyIndex
+//// File:        TPOccupancyIndex.h
+////
+//// Per-event (channel x time bin) occupancy of the TPs of one channel
+//// range, for the upstream veto windows of the TP-based filters.
+////
+//// The TPs are bucketed in time bins of 2^shift ticks, widened until at
+//// most kMaxTimeBins bins cover the event, and a summed-area table
+//// holds the hit counts per (channel, bin). A window query takes the
+//// bins fully inside the window from the table and scans the TPs of its
+//// first and last bin, so the counts are exact for any tick window, not
+//// just bin-aligned ones. The index is built in linear time with two
+//// counting sorts.
+////
+//// Queries are not constant time. The TPs of a bin are sorted by
+//// channel, so countHits costs a binary search in each edge bin plus
+//// the TPs of the window's channels in those two bins, and the table
+//// lookup of the interior bins. Wide bins, of a long event, make the
+//// edge scans longer. countChannels adds one table lookup per channel
+//// of the window.
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_ALGORITHMS_TPOCCUPANCYINDEX_H
+#define PDHDBSMDATA_ALGORITHMS_TPOCCUPANCYINDEX_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "pdhdbsmdata/Algorithms/PDHDChannelMap.h"
+
+namespace pdhd {
+
+// What the upstream veto counts in its window
+enum class VetoCountMode {
+  kHits,    // Every TP, as the filters always did
+  kChannels // Channels with at least one TP
+};
+
+// "hits" or "channels", throws cet::exception otherwise
+VetoCountMode parseVetoCountMode(std::string const& mode);
+
+class TPOccupancyIndex {
+  public:
+    using channel_t = uint32_t;
+    using tick_t = uint64_t;
+
+    // Bins of 4096 ticks (65.5 us), a bit under the shower windows of the filters
+    static constexpr unsigned kDefaultTimeBinShift = 12;
+    static constexpr std::size_t kMaxTimeBins = 256;     // Bins are widened beyond this
+
+    TPOccupancyIndex() = default;
+    // Index the TPs (channel[i], time[i]) with a channel inside channels
+    TPOccupancyIndex(chmap::ChannelRange channels, channel_t const* channel, tick_t const* time, std::size_t n,
+                     unsigned timeBinShift = kDefaultTimeBinShift);
+
+    std::size_t size() const { return fTime.size(); }
+    bool empty() const { return fTime.empty(); }
+    std::size_t nTimeBins() const { return fNBins; }
+    tick_t timeBinWidth() const { return tick_t(1) << fShift; }
+    chmap::ChannelRange channels() const { return fChannels; }
+
+    // Number of TPs with channel in [c0, c1] and time in [t0, t1], bounds inclusive
+    std::size_t countHits(channel_t c0, channel_t c1, tick_t t0, tick_t t1) const;
+    // Number of channels in [c0, c1] with at least one TP with time in [t0, t1]
+    std::size_t countChannels(channel_t c0, channel_t c1, tick_t t0, tick_t t1) const;
+    std::size_t count(VetoCountMode mode, channel_t c0, channel_t c1, tick_t t0, tick_t t1) const {
+      return mode == VetoCountMode::kChannels ? countChannels(c0, c1, t0, t1) : countHits(c0, c1, t0, t1);
+    }
+
+    // Call f(channel, time) for every TP in the window, in time bin then channel order
+    template <typename F>
+    void forEachHit(channel_t c0, channel_t c1, tick_t t0, tick_t t1, F&& f) const {
+      Window w;
+      if (!window(c0, c1, t0, t1, w)) return;
+      for (std::size_t b = w.b0; b <= w.b1; b++) {
+        scanBin(b, w, [&] (std::size_t row) { f(fChannels.first + fLocalChannel[row], fTime[row]); });
+      }
+    }
+
+  private:
+    // Query clamped to the indexed channels and bins, channels local to fChannels.first
+    struct Window {
+      std::size_t c0, c1, b0, b1;
+      tick_t t0, t1;
+    };
+
+    bool window(channel_t c0, channel_t c1, tick_t t0, tick_t t1, Window& w) const;
+    // Hits in local channels [c0, c1] and bins [b0, b1], zero if b0 > b1
+    uint32_t rect(std::size_t c0, std::size_t c1, std::size_t b0, std::size_t b1) const;
+
+    template <typename F>
+    void scanBin(std::size_t b, Window const& w, F&& f) const {
+      const auto first = fLocalChannel.begin() + fBinOffsets[b];
+      const auto last = fLocalChannel.begin() + fBinOffsets[b + 1];
+      for (auto it = std::lower_bound(first, last, w.c0); it != last && *it <= w.c1; ++it) {
+        const std::size_t row = it - fLocalChannel.begin();
+        if (fTime[row] >= w.t0 && fTime[row] <= w.t1) f(row);
+      }
+    }
+
+    chmap::ChannelRange fChannels{0, 0};
+    std::size_t fNChannels = 0;
+    tick_t fTimeOrigin = 0;
+    unsigned fShift = kDefaultTimeBinShift;
+    std::size_t fNBins = 0;
+
+    // TPs sorted by (bin, channel); bin b is rows [fBinOffsets[b], fBinOffsets[b+1])
+    std::vector<uint32_t> fBinOffsets;
+    std::vector<uint16_t> fLocalChannel;
+    std::vector<tick_t> fTime;
+    // fSAT[c * (fNBins + 1) + b] = hits in local channels < c and bins < b
+    std::vector<uint32_t> fSAT;
+};
+
+}
+
+#endif
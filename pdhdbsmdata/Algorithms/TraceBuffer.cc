@@ -0,0 +1,61 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        TraceBuffer.cc
+//////////////////////////////////////////////////////////////////////////
+
+#include "pdhdbsmdata/Algorithms/TraceBuffer.h"
+
+#include <algorithm>
+
+#include "cetlib_except/exception.h"
+
+namespace pdhd {
+
+namespace {
+  constexpr const char* kLevelNames[] = {"off", "error", "warning", "info", "debug"};
+}
+
+//-------------------------------------
+TraceLevel parseTraceLevel(std::string const& level) {
+  for (uint8_t l = 0; l <= static_cast<uint8_t>(TraceLevel::kDebug); l++) {
+    if (level == kLevelNames[l]) return static_cast<TraceLevel>(l);
+  }
+  throw cet::exception("TraceBuffer") << "Unknown TraceLevel \"" << level
+    << "\", expected \"off\", \"error\", \"warning\", \"info\" or \"debug\".\n";
+}
+
+//-------------------------------------
+const char* traceLevelName(TraceLevel level) {
+  return kLevelNames[static_cast<uint8_t>(level)];
+}
+
+//-------------------------------------
+TraceBuffer::TraceBuffer(std::size_t capacity) :
+  fText(std::max<std::size_t>(capacity, 1) * kLineSize),
+  fLength(std::max<std::size_t>(capacity, 1)),
+  fLevel(std::max<std::size_t>(capacity, 1)) {}
+
+//-------------------------------------
+void TraceBuffer::append(TraceLevel level, std::string_view text) {
+  const std::size_t n = std::min(text.size(), kLineSize);
+  std::memcpy(&fText[fHead * kLineSize], text.data(), n);
+  fLength[fHead] = n;
+  fLevel[fHead] = level;
+  fHead = (fHead + 1) % capacity();
+  if (fSize == capacity()) {
+    fDropped++;
+  } else {
+    fSize++;
+  }
+}
+
+//-------------------------------------
+void TraceBuffer::append(TraceBuffer const& other) {
+  const std::size_t first = (other.fHead + other.capacity() - other.fSize) % other.capacity();
+  for (std::size_t i = 0; i < other.fSize; i++) {
+    const std::size_t slot = (first + i) % other.capacity();
+    append(other.fLevel[slot], std::string_view(&other.fText[slot * kLineSize], other.fLength[slot]));
+  }
+  fDropped += other.fDropped;
+}
+
+}
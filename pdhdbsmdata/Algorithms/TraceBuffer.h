@@ -0,0 +1,148 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       TraceBuffer, TraceLine
+//// File:        TraceBuffer.h
+////
+//// Fixed-size ring of trace lines for the filter printout. A TraceLine
+//// formats one message straight into a stack buffer (no ostream, no
+//// allocation) and appends it to the ring when it goes out of scope.
+//// When the ring is full the oldest lines are overwritten and counted
+//// as dropped. Levels above PDHD_TRACE_MAX_LEVEL are removed at compile
+//// time by the PDHD_TRACE macro.
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_ALGORITHMS_TRACEBUFFER_H
+#define PDHDBSMDATA_ALGORITHMS_TRACEBUFFER_H
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Highest TraceLevel compiled in, e.g. -DPDHD_TRACE_MAX_LEVEL=2 drops info and debug messages
+#ifndef PDHD_TRACE_MAX_LEVEL
+#define PDHD_TRACE_MAX_LEVEL 4
+#endif
+
+// tracer is anything with enabled(level) and buffer(): a Tracer (PDHDTrace.h) or a TraceSink
+// Into a given buffer, e.g. one collected apart and appended later
+#define PDHD_TRACE_TO(tracer, buffer, level) \
+  if (static_cast<int>(level) > PDHD_TRACE_MAX_LEVEL || !(tracer).enabled(level)) {} \
+  else ::pdhd::TraceLine((buffer), (level))
+#define PDHD_TRACE(tracer, level) PDHD_TRACE_TO(tracer, (tracer).buffer(), level)
+
+namespace pdhd {
+
+enum class TraceLevel : uint8_t {
+  kOff = 0,
+  kError = 1,
+  kWarning = 2,
+  kInfo = 3,
+  kDebug = 4
+};
+
+// "off", "error", "warning", "info" or "debug", throws cet::exception otherwise
+TraceLevel parseTraceLevel(std::string const& level);
+const char* traceLevelName(TraceLevel level);
+
+class TraceBuffer {
+  public:
+    static constexpr std::size_t kLineSize = 240; // Longer lines are truncated
+
+    explicit TraceBuffer(std::size_t capacity = 1024);
+
+    std::size_t capacity() const { return fLevel.size(); }
+    std::size_t size() const { return fSize; }
+    bool empty() const { return fSize == 0; }
+    // Lines overwritten before they were read
+    std::size_t dropped() const { return fDropped; }
+
+    void append(TraceLevel level, std::string_view text);
+    // Append the lines of other, oldest first
+    void append(TraceBuffer const& other);
+
+    // Call f(level, text) for each line, oldest first, then empty the ring
+    template <typename F>
+    void drain(F&& f) {
+      const std::size_t first = (fHead + capacity() - fSize) % capacity();
+      for (std::size_t i = 0; i < fSize; i++) {
+        const std::size_t slot = (first + i) % capacity();
+        f(fLevel[slot], std::string_view(&fText[slot * kLineSize], fLength[slot]));
+      }
+      clear();
+    }
+    void clear() {
+      fSize = 0;
+      fDropped = 0;
+    }
+
+  private:
+    std::vector<char> fText;
+    std::vector<uint16_t> fLength;
+    std::vector<TraceLevel> fLevel;
+    std::size_t fHead = 0; // Next slot to write
+    std::size_t fSize = 0;
+    std::size_t fDropped = 0;
+};
+
+// One message, appended to the buffer by the destructor
+class TraceLine {
+  public:
+    TraceLine(TraceBuffer& buffer, TraceLevel level) : fBuffer(buffer), fLevel(level) {}
+    TraceLine(TraceLine const&) = delete;
+    TraceLine& operator=(TraceLine const&) = delete;
+    ~TraceLine() { fBuffer.append(fLevel, std::string_view(fText, fLength)); }
+
+    TraceLine& operator<<(std::string_view text) {
+      const std::size_t n = std::min(text.size(), TraceBuffer::kLineSize - fLength);
+      std::memcpy(fText + fLength, text.data(), n);
+      fLength += n;
+      return *this;
+    }
+    TraceLine& operator<<(const char *text) { return *this << std::string_view(text); }
+    TraceLine& operator<<(std::string const& text) { return *this << std::string_view(text); }
+    TraceLine& operator<<(char c) { return *this << std::string_view(&c, 1); }
+    TraceLine& operator<<(bool b) { return *this << (b ? '1' : '0'); }
+
+    // Integers as std::to_chars, floating point as %g (the std::ostream default)
+    template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T>>>
+    TraceLine& operator<<(T value) {
+      char number[32];
+      if constexpr (std::is_floating_point_v<T>) {
+        const int n = std::snprintf(number, sizeof(number), "%g", static_cast<double>(value));
+        return *this << std::string_view(number, n > 0 ? n : 0);
+      } else {
+        const auto result = std::to_chars(number, number + sizeof(number), +value);
+        return *this << std::string_view(number, result.ptr - number);
+      }
+    }
+
+  private:
+    TraceBuffer &fBuffer;
+    TraceLevel fLevel;
+    std::size_t fLength = 0;
+    char fText[TraceBuffer::kLineSize];
+};
+
+// Buffer and level of the printout of code outside the modules, e.g. the
+// selectors in this directory: PDHD_TRACE(log, TraceLevel::kDebug) << ...
+class TraceSink {
+  public:
+    TraceSink(TraceBuffer& buffer, TraceLevel level) : fBuffer(&buffer), fLevel(level) {}
+
+    bool enabled(TraceLevel level) const { return level <= fLevel; }
+    TraceBuffer& buffer() const { return *fBuffer; }
+
+  private:
+    TraceBuffer *fBuffer;
+    TraceLevel fLevel;
+};
+
+}
+
+#endif
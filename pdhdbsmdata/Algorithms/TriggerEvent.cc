@@ -0,0 +1,26 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        TriggerEvent.cc
+//////////////////////////////////////////////////////////////////////////
+
+#include "pdhdbsmdata/Algorithms/TriggerEvent.h"
+#include "pdhdbsmdata/Algorithms/TPIndexBuilder.h"
+
+namespace pdhd {
+
+//-------------------------------------
+TPIndex makeTPIndex(TriggerEventView const& event) {
+  TPIndex index;
+  fillDetectorTPs(event.tps.data(), event.tps.size(), index);
+  std::vector<dunedaq::trgdataformats::TriggerPrimitive const*> tps;
+  std::vector<uint32_t> source;
+  for (size_t ta = 0; ta < event.tas.size(); ta++) {
+    const ConstSpan<uint32_t> positions = event.tpsOfTA(ta);
+    tps.clear();
+    for (const auto &pos : positions) tps.push_back(&event.tps[pos]);
+    source.assign(positions.begin(), positions.end());
+    appendTA(event.tas[ta], tps, source, index);
+  }
+  return index;
+}
+
+}
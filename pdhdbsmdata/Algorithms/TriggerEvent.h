@@ -0,0 +1,100 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       TriggerEvent, TriggerEventView
+//// File:        TriggerEvent.h
+////
+//// The trigger objects of one event without art: the TPs, the TAs with
+//// the positions in the TP list of the TPs of each TA, and the TCs, as
+//// the filters read them from the decoder products. TriggerEvent owns
+//// them (SyntheticEvents.h, the snapshot writer) and TriggerEventView
+//// points to them, in a TriggerEvent or in a mapped snapshot file
+//// (TriggerSnapshot.h).
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_ALGORITHMS_TRIGGEREVENT_H
+#define PDHDBSMDATA_ALGORITHMS_TRIGGEREVENT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "detdataformats/trigger/TriggerActivityData.hpp"
+#include "detdataformats/trigger/TriggerCandidateData.hpp"
+#include "detdataformats/trigger/TriggerPrimitive.hpp"
+
+#include "pdhdbsmdata/DataProducts/TPIndex.h"
+
+namespace pdhd {
+
+// Read-only view of n contiguous objects
+template <typename T>
+class ConstSpan {
+  public:
+    ConstSpan() = default;
+    ConstSpan(T const* data, std::size_t size) : fData(data), fSize(size) {}
+    ConstSpan(std::vector<T> const& v) : fData(v.data()), fSize(v.size()) {}
+
+    T const* data() const { return fData; }
+    std::size_t size() const { return fSize; }
+    bool empty() const { return fSize == 0; }
+    T const* begin() const { return fData; }
+    T const* end() const { return fData + fSize; }
+    T const& operator[](std::size_t i) const { return fData[i]; }
+
+  private:
+    T const* fData = nullptr;
+    std::size_t fSize = 0;
+};
+
+struct TriggerEventID {
+  uint32_t run = 0;
+  uint32_t subrun = 0;
+  uint32_t event = 0;
+  uint64_t time_ns = 0; // art::Event time, ns since the epoch
+};
+
+struct TriggerEventView : TriggerEventID {
+  ConstSpan<dunedaq::trgdataformats::TriggerPrimitive> tps;
+  ConstSpan<dunedaq::trgdataformats::TriggerActivityData> tas;
+  // TPs of TA t are taTPs[taOffsets[t] - taOffsets[0], taOffsets[t+1] - taOffsets[0]),
+  // as positions in tps
+  ConstSpan<uint32_t> taOffsets;
+  ConstSpan<uint32_t> taTPs;
+  ConstSpan<dunedaq::trgdataformats::TriggerCandidateData> tcs;
+
+  ConstSpan<uint32_t> tpsOfTA(std::size_t ta) const {
+    return ConstSpan<uint32_t>(taTPs.data() + (taOffsets[ta] - taOffsets[0]), taOffsets[ta + 1] - taOffsets[ta]);
+  }
+};
+
+struct TriggerEvent : TriggerEventID {
+  std::vector<dunedaq::trgdataformats::TriggerPrimitive> tps;
+  std::vector<dunedaq::trgdataformats::TriggerActivityData> tas;
+  std::vector<uint32_t> ta_offsets = std::vector<uint32_t>(1, 0); // TPs of TA t are ta_tps[ta_offsets[t], ta_offsets[t+1])
+  std::vector<uint32_t> ta_tps;                                   // Positions in tps
+  std::vector<dunedaq::trgdataformats::TriggerCandidateData> tcs;
+
+  void addTA(dunedaq::trgdataformats::TriggerActivityData const& ta, std::vector<uint32_t> const& tpPositions) {
+    tas.push_back(ta);
+    ta_tps.insert(ta_tps.end(), tpPositions.begin(), tpPositions.end());
+    ta_offsets.push_back(ta_tps.size());
+  }
+
+  TriggerEventView view() const {
+    TriggerEventView v;
+    static_cast<TriggerEventID&>(v) = *this;
+    v.tps = tps;
+    v.tas = tas;
+    v.taOffsets = ta_offsets;
+    v.taTPs = ta_tps;
+    v.tcs = tcs;
+    return v;
+  }
+};
+
+// TPIndex of the event, as made by PDHDTPIndexProducer
+TPIndex makeTPIndex(TriggerEventView const& event);
+inline TPIndex makeTPIndex(TriggerEvent const& event) { return makeTPIndex(event.view()); }
+
+}
+
+#endif
@@ -0,0 +1,325 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        TriggerSnapshot.cc
+//////////////////////////////////////////////////////////////////////////
+
+#include "pdhdbsmdata/Algorithms/TriggerSnapshot.h"
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+#include "cetlib_except/exception.h"
+
+namespace pdhd {
+
+using triggerprimitive_t = dunedaq::trgdataformats::TriggerPrimitive;
+using triggeractivity_t = dunedaq::trgdataformats::TriggerActivityData;
+using triggercandidate_t = dunedaq::trgdataformats::TriggerCandidateData;
+
+static_assert(std::is_trivially_copyable_v<triggerprimitive_t> && std::is_trivially_copyable_v<triggeractivity_t> &&
+              std::is_trivially_copyable_v<triggercandidate_t>, "The trigger objects are written as they are in memory");
+static_assert(alignof(triggerprimitive_t) <= 8 && alignof(triggeractivity_t) <= 8 && alignof(triggercandidate_t) <= 8,
+              "The arrays of a snapshot are aligned to 8 bytes");
+
+namespace {
+
+  // A block is written once its events hold this many TPs, whatever the number of events
+  constexpr std::size_t kMaxBlockTPs = 1 << 24;
+
+  constexpr uint64_t align8(uint64_t n) { return (n + 7) & ~uint64_t(7); }
+
+  // Offsets of the arrays of a block from its header
+  struct BlockLayout {
+    uint64_t entries, tps, tas, ta_offsets, ta_tps, tcs, size;
+  };
+
+  BlockLayout blockLayout(TriggerSnapshotBlock const& block) {
+    BlockLayout layout;
+    uint64_t pos = sizeof(TriggerSnapshotBlock);
+    layout.entries = pos;
+    pos += align8(uint64_t(block.n_events) * sizeof(TriggerSnapshotEntry));
+    layout.tps = pos;
+    pos += align8(uint64_t(block.n_tps) * sizeof(triggerprimitive_t));
+    layout.tas = pos;
+    pos += align8(uint64_t(block.n_tas) * sizeof(triggeractivity_t));
+    layout.ta_offsets = pos;
+    pos += align8((uint64_t(block.n_tas) + 1) * sizeof(uint32_t));
+    layout.ta_tps = pos;
+    pos += align8(uint64_t(block.n_ta_tps) * sizeof(uint32_t));
+    layout.tcs = pos;
+    pos += align8(uint64_t(block.n_tcs) * sizeof(triggercandidate_t));
+    layout.size = pos;
+    return layout;
+  }
+
+  template <typename T>
+  void writeArray(std::ofstream& out, std::vector<T> const& v) {
+    static constexpr char kPadding[8] = {};
+    const std::size_t bytes = v.size() * sizeof(T);
+    out.write(reinterpret_cast<const char*>(v.data()), bytes);
+    out.write(kPadding, align8(bytes) - bytes);
+  }
+
+}
+
+//-------------------------------------
+TriggerSnapshotWriter::TriggerSnapshotWriter(std::string const& fileName, std::size_t eventsPerBlock) :
+  fFileName(fileName),
+  fEventsPerBlock(std::max<std::size_t>(eventsPerBlock, 1)),
+  fOut(fileName, std::ios::binary | std::ios::trunc),
+  fTAOffsets(1, 0) {
+  if (!fOut) {
+    throw cet::exception("TriggerSnapshot") << "Cannot open " << fileName << " for writing\n";
+  }
+  TriggerSnapshotHeader header;
+  std::memcpy(header.magic, TriggerSnapshotHeader::kMagic, sizeof(header.magic));
+  header.version = TriggerSnapshotHeader::kVersion;
+  header.tp_size = sizeof(triggerprimitive_t);
+  header.ta_size = sizeof(triggeractivity_t);
+  header.tc_size = sizeof(triggercandidate_t);
+  header.reserved = 0;
+  fOut.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  fOffset = sizeof(header);
+}
+
+//-------------------------------------
+TriggerSnapshotWriter::~TriggerSnapshotWriter() {
+  if (!fOut.is_open()) return;
+  // Keep the events of the last block; the reader recovers a file without index
+  try {
+    writeBlock();
+  } catch (...) {
+  }
+}
+
+//-------------------------------------
+void TriggerSnapshotWriter::write(TriggerEventView const& event) {
+  TriggerSnapshotEntry entry;
+  entry.run = event.run;
+  entry.subrun = event.subrun;
+  entry.event = event.event;
+  entry.tp_begin = fTPs.size();
+  entry.ta_begin = fTAs.size();
+  entry.tc_begin = fTCs.size();
+  entry.time_ns = event.time_ns;
+
+  for (std::size_t ta = 0; ta < event.tas.size(); ta++) {
+    for (const auto &pos : event.tpsOfTA(ta)) {
+      if (pos >= event.tps.size()) {
+        throw cet::exception("TriggerSnapshot") << "TA " << ta << " of event " << event.event << " refers to TP " << pos
+          << " of " << event.tps.size() << "\n";
+      }
+    }
+  }
+
+  fEntries.push_back(entry);
+  fTPs.insert(fTPs.end(), event.tps.begin(), event.tps.end());
+  fTAs.insert(fTAs.end(), event.tas.begin(), event.tas.end());
+  for (std::size_t ta = 0; ta < event.tas.size(); ta++) {
+    const ConstSpan<uint32_t> positions = event.tpsOfTA(ta);
+    fTATPs.insert(fTATPs.end(), positions.begin(), positions.end());
+    fTAOffsets.push_back(fTATPs.size());
+  }
+  fTCs.insert(fTCs.end(), event.tcs.begin(), event.tcs.end());
+  fEvents++;
+
+  if (fEntries.size() >= fEventsPerBlock || fTPs.size() >= kMaxBlockTPs) writeBlock();
+}
+
+//-------------------------------------
+void TriggerSnapshotWriter::writeBlock() {
+  if (fEntries.empty()) return;
+
+  TriggerSnapshotBlock block;
+  std::memcpy(block.magic, TriggerSnapshotBlock::kMagic, sizeof(block.magic));
+  block.n_events = fEntries.size();
+  block.n_tps = fTPs.size();
+  block.n_tas = fTAs.size();
+  block.n_ta_tps = fTATPs.size();
+  block.n_tcs = fTCs.size();
+  block.reserved = 0;
+  block.size = blockLayout(block).size;
+
+  fOut.write(reinterpret_cast<const char*>(&block), sizeof(block));
+  writeArray(fOut, fEntries);
+  writeArray(fOut, fTPs);
+  writeArray(fOut, fTAs);
+  writeArray(fOut, fTAOffsets);
+  writeArray(fOut, fTATPs);
+  writeArray(fOut, fTCs);
+  fOut.flush();
+  if (!fOut) {
+    throw cet::exception("TriggerSnapshot") << "Failed to write a block of " << fEntries.size() << " events to " << fFileName << "\n";
+  }
+
+  fIndex.push_back(TriggerSnapshotIndexEntry{fOffset, fEvents - fEntries.size()});
+  fOffset += block.size;
+
+  fEntries.clear();
+  fTPs.clear();
+  fTAs.clear();
+  fTAOffsets.assign(1, 0);
+  fTATPs.clear();
+  fTCs.clear();
+}
+
+//-------------------------------------
+void TriggerSnapshotWriter::close() {
+  if (!fOut.is_open()) return;
+  writeBlock();
+
+  TriggerSnapshotTrailer trailer;
+  std::memcpy(trailer.magic, TriggerSnapshotTrailer::kMagic, sizeof(trailer.magic));
+  trailer.index_offset = fOffset;
+  trailer.n_blocks = fIndex.size();
+  trailer.n_events = fEvents;
+  fOut.write(reinterpret_cast<const char*>(fIndex.data()), fIndex.size() * sizeof(TriggerSnapshotIndexEntry));
+  fOut.write(reinterpret_cast<const char*>(&trailer), sizeof(trailer));
+  fOut.close();
+  if (!fOut) {
+    throw cet::exception("TriggerSnapshot") << "Failed to close " << fFileName << "\n";
+  }
+}
+
+//-------------------------------------
+TriggerSnapshotReader::TriggerSnapshotReader(std::string const& fileName) :
+  fFile(std::make_shared<MappedFile>(fileName)) {
+
+  const char *data = fFile->data();
+  const uint64_t size = fFile->size();
+  if (size < sizeof(TriggerSnapshotHeader)) {
+    throw cet::exception("TriggerSnapshot") << fileName << " is too small to be a trigger snapshot\n";
+  }
+  TriggerSnapshotHeader header;
+  std::memcpy(&header, data, sizeof(header));
+  if (std::memcmp(header.magic, TriggerSnapshotHeader::kMagic, sizeof(header.magic)) != 0 ||
+      header.version != TriggerSnapshotHeader::kVersion) {
+    throw cet::exception("TriggerSnapshot") << fileName << " is not a version " << TriggerSnapshotHeader::kVersion << " trigger snapshot\n";
+  }
+  if (header.tp_size != sizeof(triggerprimitive_t) || header.ta_size != sizeof(triggeractivity_t) ||
+      header.tc_size != sizeof(triggercandidate_t)) {
+    throw cet::exception("TriggerSnapshot") << fileName << " was written with other trgdataformats: TP, TA and TC sizes "
+      << header.tp_size << ", " << header.ta_size << " and " << header.tc_size << ", expected "
+      << sizeof(triggerprimitive_t) << ", " << sizeof(triggeractivity_t) << " and " << sizeof(triggercandidate_t) << "\n";
+  }
+
+  TriggerSnapshotTrailer trailer;
+  const bool hasTrailer = size >= sizeof(header) + sizeof(trailer) &&
+    std::memcmp(data + size - sizeof(trailer), TriggerSnapshotTrailer::kMagic, sizeof(trailer.magic)) == 0;
+
+  if (hasTrailer) {
+    std::memcpy(&trailer, data + size - sizeof(trailer), sizeof(trailer));
+    if (trailer.index_offset < sizeof(header) || trailer.n_blocks > size / sizeof(TriggerSnapshotIndexEntry) ||
+        trailer.index_offset + trailer.n_blocks * sizeof(TriggerSnapshotIndexEntry) + sizeof(trailer) != size) {
+      throw cet::exception("TriggerSnapshot") << fileName << " is corrupted, the index does not match the file size\n";
+    }
+    std::vector<TriggerSnapshotIndexEntry> index(trailer.n_blocks);
+    std::memcpy(index.data(), data + trailer.index_offset, index.size() * sizeof(TriggerSnapshotIndexEntry));
+    uint64_t offset = sizeof(header);
+    for (const auto &entry : index) {
+      if (entry.offset != offset || entry.first_event != fEvents) {
+        throw cet::exception("TriggerSnapshot") << fileName << " is corrupted, the index does not match the blocks\n";
+      }
+      fBlocks.push_back(readBlock(offset, fEvents));
+      offset += fBlocks.back().header->size;
+      fEvents += fBlocks.back().header->n_events;
+    }
+    if (offset != trailer.index_offset || fEvents != trailer.n_events) {
+      throw cet::exception("TriggerSnapshot") << fileName << " is corrupted, the index does not match the blocks\n";
+    }
+  } else {
+    // The writer did not close the file: read the blocks it completed
+    fComplete = false;
+    uint64_t offset = sizeof(header);
+    while (offset + sizeof(TriggerSnapshotBlock) <= size) {
+      TriggerSnapshotBlock block;
+      std::memcpy(&block, data + offset, sizeof(block));
+      if (std::memcmp(block.magic, TriggerSnapshotBlock::kMagic, sizeof(block.magic)) != 0 ||
+          block.size > size - offset) break;
+      fBlocks.push_back(readBlock(offset, fEvents));
+      offset += block.size;
+      fEvents += block.n_events;
+    }
+  }
+}
+
+//-------------------------------------
+TriggerSnapshotReader::Block TriggerSnapshotReader::readBlock(uint64_t offset, std::size_t firstEvent) const {
+  const char *data = fFile->data();
+  const uint64_t size = fFile->size();
+  if (offset + sizeof(TriggerSnapshotBlock) > size) {
+    throw cet::exception("TriggerSnapshot") << fFile->fileName() << " is truncated at byte " << offset << "\n";
+  }
+
+  Block b;
+  b.first_event = firstEvent;
+  b.header = reinterpret_cast<TriggerSnapshotBlock const*>(data + offset);
+  const TriggerSnapshotBlock &h = *b.header;
+  const BlockLayout layout = blockLayout(h);
+  if (std::memcmp(h.magic, TriggerSnapshotBlock::kMagic, sizeof(h.magic)) != 0 || h.size != layout.size ||
+      h.size > size - offset) {
+    throw cet::exception("TriggerSnapshot") << fFile->fileName() << " is corrupted, bad block at byte " << offset << "\n";
+  }
+
+  const char *base = data + offset;
+  b.entries = reinterpret_cast<TriggerSnapshotEntry const*>(base + layout.entries);
+  b.tps = reinterpret_cast<triggerprimitive_t const*>(base + layout.tps);
+  b.tas = reinterpret_cast<triggeractivity_t const*>(base + layout.tas);
+  b.ta_offsets = reinterpret_cast<uint32_t const*>(base + layout.ta_offsets);
+  b.ta_tps = reinterpret_cast<uint32_t const*>(base + layout.ta_tps);
+  b.tcs = reinterpret_cast<triggercandidate_t const*>(base + layout.tcs);
+
+  // The views handed out rely on these, so check them once here
+  bool consistent = b.ta_offsets[0] == 0 && b.ta_offsets[h.n_tas] == h.n_ta_tps;
+  for (uint32_t ta = 0; consistent && ta < h.n_tas; ta++) {
+    consistent = b.ta_offsets[ta] <= b.ta_offsets[ta + 1];
+  }
+  TriggerSnapshotEntry previous{};
+  for (uint32_t e = 0; consistent && e < h.n_events; e++) {
+    const TriggerSnapshotEntry &entry = b.entries[e];
+    const uint32_t tpEnd = e + 1 < h.n_events ? b.entries[e + 1].tp_begin : h.n_tps;
+    const uint32_t taEnd = e + 1 < h.n_events ? b.entries[e + 1].ta_begin : h.n_tas;
+    const uint32_t tcEnd = e + 1 < h.n_events ? b.entries[e + 1].tc_begin : h.n_tcs;
+    consistent = (e > 0 || (entry.tp_begin == 0 && entry.ta_begin == 0 && entry.tc_begin == 0)) &&
+      entry.tp_begin >= previous.tp_begin && entry.ta_begin >= previous.ta_begin && entry.tc_begin >= previous.tc_begin &&
+      entry.tp_begin <= tpEnd && tpEnd <= h.n_tps && entry.ta_begin <= taEnd && taEnd <= h.n_tas &&
+      entry.tc_begin <= tcEnd && tcEnd <= h.n_tcs;
+    for (uint32_t pos = consistent ? b.ta_offsets[entry.ta_begin] : 0; consistent && pos < b.ta_offsets[taEnd]; pos++) {
+      consistent = b.ta_tps[pos] < tpEnd - entry.tp_begin;
+    }
+    previous = entry;
+  }
+  if (!consistent) {
+    throw cet::exception("TriggerSnapshot") << fFile->fileName() << " is corrupted, inconsistent offsets in the block at byte "
+      << offset << "\n";
+  }
+  return b;
+}
+
+//-------------------------------------
+TriggerEventView TriggerSnapshotReader::event(std::size_t i) const {
+  const auto block = std::upper_bound(fBlocks.begin(), fBlocks.end(), i,
+      [] (std::size_t lh, Block const& rh) -> bool { return lh < rh.first_event; }) - 1;
+  const Block &b = *block;
+  const TriggerSnapshotBlock &h = *b.header;
+  const std::size_t e = i - b.first_event;
+  const TriggerSnapshotEntry &entry = b.entries[e];
+  const bool last = e + 1 == h.n_events;
+  const uint32_t tpEnd = last ? h.n_tps : b.entries[e + 1].tp_begin;
+  const uint32_t taEnd = last ? h.n_tas : b.entries[e + 1].ta_begin;
+  const uint32_t tcEnd = last ? h.n_tcs : b.entries[e + 1].tc_begin;
+
+  TriggerEventView view;
+  view.run = entry.run;
+  view.subrun = entry.subrun;
+  view.event = entry.event;
+  view.time_ns = entry.time_ns;
+  view.tps = ConstSpan<triggerprimitive_t>(b.tps + entry.tp_begin, tpEnd - entry.tp_begin);
+  view.tas = ConstSpan<triggeractivity_t>(b.tas + entry.ta_begin, taEnd - entry.ta_begin);
+  view.taOffsets = ConstSpan<uint32_t>(b.ta_offsets + entry.ta_begin, taEnd - entry.ta_begin + 1);
+  view.taTPs = ConstSpan<uint32_t>(b.ta_tps + b.ta_offsets[entry.ta_begin], b.ta_offsets[taEnd] - b.ta_offsets[entry.ta_begin]);
+  view.tcs = ConstSpan<triggercandidate_t>(b.tcs + entry.tc_begin, tcEnd - entry.tc_begin);
+  return view;
+}
+
+}
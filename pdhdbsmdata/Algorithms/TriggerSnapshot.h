@@ -0,0 +1,175 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       TriggerSnapshotWriter, TriggerSnapshotReader
+//// File:        TriggerSnapshot.h
+////
+//// Columnar snapshot of the trigger objects of many events, written by
+//// the PDHDTriggerSnapshot analyzer and replayed by pdhd_filter_replay.
+//// The writer appends the events in blocks, each with one array per
+//// kind of object, and the event index at close:
+////
+////   TriggerSnapshotHeader                        (32 bytes)
+////   per block:
+////     TriggerSnapshotBlock                       (40 bytes)
+////     TriggerSnapshotEntry events[n_events]      (32 bytes each)
+////     TriggerPrimitive tps[n_tps]
+////     TriggerActivityData tas[n_tas]
+////     uint32_t ta_offsets[n_tas + 1]             TPs of TA t are [ta_offsets[t], ta_offsets[t+1])
+////     uint32_t ta_tps[n_ta_tps]                  of ta_tps, positions in the TPs of the event
+////     TriggerCandidateData tcs[n_tcs]
+//// TriggerSnapshotIndexEntry blocks[n_blocks]     (16 bytes each)
+//// TriggerSnapshotTrailer                         (32 bytes)
+////
+//// Every array starts on an 8 byte boundary. The reader maps the file
+//// and hands out TriggerEventViews into the mapping, nothing is copied.
+//// A file without the index (a job that did not finish) is read by
+//// walking the blocks up to the first incomplete one.
+////
+//// The trigger objects are stored as the dunedaq structs in memory; the
+//// header records their sizes, so a build with different
+//// trgdataformats rejects the file instead of misreading it.
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_ALGORITHMS_TRIGGERSNAPSHOT_H
+#define PDHDBSMDATA_ALGORITHMS_TRIGGERSNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "pdhdbsmdata/Algorithms/MappedFile.h"
+#include "pdhdbsmdata/Algorithms/TriggerEvent.h"
+
+namespace pdhd {
+
+struct TriggerSnapshotHeader {
+  static constexpr char kMagic[8] = {'P', 'D', 'H', 'D', 'T', 'S', 'N', 'P'};
+  static constexpr uint32_t kVersion = 1;
+
+  char magic[8];
+  uint32_t version;
+  uint32_t tp_size; // sizeof of the dunedaq structs of the writer
+  uint32_t ta_size;
+  uint32_t tc_size;
+  uint64_t reserved;
+};
+static_assert(sizeof(TriggerSnapshotHeader) == 32, "TriggerSnapshotHeader layout must not change");
+
+struct TriggerSnapshotBlock {
+  static constexpr char kMagic[8] = {'P', 'D', 'H', 'D', 'T', 'B', 'L', 'K'};
+
+  char magic[8];
+  uint64_t size; // Bytes, this header included
+  uint32_t n_events;
+  uint32_t n_tps;
+  uint32_t n_tas;
+  uint32_t n_ta_tps;
+  uint32_t n_tcs;
+  uint32_t reserved;
+};
+static_assert(sizeof(TriggerSnapshotBlock) == 40, "TriggerSnapshotBlock layout must not change");
+
+// The objects of an event run from its begin positions in the block to
+// those of the next event
+struct TriggerSnapshotEntry {
+  uint32_t run;
+  uint32_t subrun;
+  uint32_t event;
+  uint32_t tp_begin;
+  uint32_t ta_begin;
+  uint32_t tc_begin;
+  uint64_t time_ns;
+};
+static_assert(sizeof(TriggerSnapshotEntry) == 32, "TriggerSnapshotEntry layout must not change");
+
+struct TriggerSnapshotIndexEntry {
+  uint64_t offset;      // Of the block in the file
+  uint64_t first_event; // Number of events in the blocks before it
+};
+static_assert(sizeof(TriggerSnapshotIndexEntry) == 16, "TriggerSnapshotIndexEntry layout must not change");
+
+struct TriggerSnapshotTrailer {
+  static constexpr char kMagic[8] = {'P', 'D', 'H', 'D', 'T', 'I', 'D', 'X'};
+
+  char magic[8];
+  uint64_t index_offset;
+  uint64_t n_blocks;
+  uint64_t n_events;
+};
+static_assert(sizeof(TriggerSnapshotTrailer) == 32, "TriggerSnapshotTrailer layout must not change");
+
+class TriggerSnapshotWriter {
+  public:
+    static constexpr std::size_t kDefaultEventsPerBlock = 256;
+
+    // Creates or truncates the file; throws cet::exception if it cannot be opened
+    explicit TriggerSnapshotWriter(std::string const& fileName, std::size_t eventsPerBlock = kDefaultEventsPerBlock);
+    // Writes the pending block, but not the index, if close was not called
+    ~TriggerSnapshotWriter();
+
+    // Throws cet::exception if the write fails
+    void write(TriggerEventView const& event);
+    // Writes the pending block and the index
+    void close();
+
+    std::size_t events() const { return fEvents; }
+
+  private:
+    void writeBlock();
+
+    std::string fFileName;
+    std::size_t fEventsPerBlock;
+    std::ofstream fOut;
+    uint64_t fOffset = 0;
+    std::size_t fEvents = 0;
+    std::vector<TriggerSnapshotIndexEntry> fIndex;
+
+    // The pending block
+    std::vector<TriggerSnapshotEntry> fEntries;
+    std::vector<dunedaq::trgdataformats::TriggerPrimitive> fTPs;
+    std::vector<dunedaq::trgdataformats::TriggerActivityData> fTAs;
+    std::vector<uint32_t> fTAOffsets;
+    std::vector<uint32_t> fTATPs;
+    std::vector<dunedaq::trgdataformats::TriggerCandidateData> fTCs;
+};
+
+class TriggerSnapshotReader {
+  public:
+    // Maps the file and checks every block; throws cet::exception if the
+    // file cannot be mapped, is not a snapshot or is inconsistent
+    explicit TriggerSnapshotReader(std::string const& fileName);
+
+    std::size_t size() const { return fEvents; }
+    // Views into the mapping, valid for as long as the reader exists
+    TriggerEventView event(std::size_t i) const;
+
+    // False if the file has no index and was read up to the first incomplete block
+    bool complete() const { return fComplete; }
+    std::string const& fileName() const { return fFile->fileName(); }
+
+  private:
+    struct Block {
+      std::size_t first_event;
+      TriggerSnapshotBlock const* header;
+      TriggerSnapshotEntry const* entries;
+      dunedaq::trgdataformats::TriggerPrimitive const* tps;
+      dunedaq::trgdataformats::TriggerActivityData const* tas;
+      uint32_t const* ta_offsets;
+      uint32_t const* ta_tps;
+      dunedaq::trgdataformats::TriggerCandidateData const* tcs;
+    };
+
+    // The block at offset, checked; throws cet::exception if it is inconsistent
+    Block readBlock(uint64_t offset, std::size_t firstEvent) const;
+
+    std::shared_ptr<MappedFile> fFile;
+    std::vector<Block> fBlocks;
+    std::size_t fEvents = 0;
+    bool fComplete = true;
+};
+
+}
+
+#endif
@@ -0,0 +1,310 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        VertexSelector.cc
+//////////////////////////////////////////////////////////////////////////
+
+#include "pdhdbsmdata/Algorithms/VertexSelector.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "detdataformats/trigger/TriggerPrimitive.hpp"
+
+namespace pdhd {
+
+using timestamp_t = dunedaq::trgdataformats::timestamp_t;
+using channel_t = dunedaq::trgdataformats::channel_t;
+
+//-------------------------------------
+const char* vertexCutName(VertexCut cut) {
+  switch (cut) {
+    case VertexCut::kNoTPs: return "tas_skipped_no_tps";
+    case VertexCut::kOutsideMainAPA: return "tas_rejected_outside_main_apa";
+    case VertexCut::kTimeSigma: return "tas_failed_time_sigma";
+    case VertexCut::kTimeMean: return "tas_failed_time_mean";
+    case VertexCut::kFitStatus: return "tas_failed_fit_status";
+    case VertexCut::kVertexUpstream: return "tas_rejected_vertex_upstream";
+    case VertexCut::kEnteringShower: return "tas_failed_entering_shower";
+    case VertexCut::kVertexChannel: return "tas_failed_vertex_channel";
+    case VertexCut::kUpstreamVeto: return "tas_failed_upstream_veto";
+    case VertexCut::kPassed: return "tas_passed";
+    default: return "unknown";
+  }
+}
+
+//-------------------------------------
+TPOccupancyIndex VertexSelector::apa3Occupancy(TPIndex const& tpIndex) {
+  // The APA 3 collection plane partition of the index is already in channel order
+  const TPColumns &detTPs = tpIndex.detector;
+  const auto chan_begin = detTPs.channel.begin();
+  const size_t apa3_begin = std::lower_bound(chan_begin + tpIndex.partitionBegin(3, chmap::kX), chan_begin + tpIndex.partitionEnd(3, chmap::kX), kCollectionAPA3.first) - chan_begin;
+  const size_t apa3_end = std::upper_bound(chan_begin + apa3_begin, chan_begin + tpIndex.partitionEnd(3, chmap::kX), kCollectionAPA3.last) - chan_begin;
+  return TPOccupancyIndex(kCollectionAPA3, detTPs.channel.data() + apa3_begin, detTPs.time_peak.data() + apa3_begin, apa3_end - apa3_begin);
+}
+
+//-------------------------------------
+VetoWindow VertexSelector::showerWindow(TPIndex const& tpIndex, size_t ta, VertexTAResult const& result) {
+  const timestamp_t first_tick = tpIndex.ta_time_start[ta];
+  const timestamp_t last_tick = tpIndex.ta_time_end[ta];
+  if (!result.timeFit) return {first_tick, last_tick};
+
+  // The fit is in ticks from the start of the TA
+  const double lower = result.timeFit->mean - kShowerWindowSigmas * result.timeFit->sigma;
+  const double upper = result.timeFit->mean + kShowerWindowSigmas * result.timeFit->sigma;
+  const timestamp_t start = lower > 0 ? std::min(first_tick + static_cast<timestamp_t>(lower), last_tick) : first_tick;
+  const timestamp_t end = upper > 0 ? std::min(first_tick + static_cast<timestamp_t>(upper), last_tick) : first_tick;
+  return {start, end};
+}
+
+//-------------------------------------
+VertexTAResult VertexSelector::evaluateTA(TPIndex const& tpIndex, TPOccupancyIndex const& apa3Occupancy, size_t ta,
+                                          TraceSink const& log, std::string const* diagnosticsTag) const {
+  VertexTAResult result;
+  const auto decide = [&result] (TADecision decision, VertexCut cut) {
+    result.decision = decision;
+    result.cut = cut;
+    return std::move(result);
+  };
+
+  const TPColumns &taTPs = tpIndex.ta_tps;
+
+  PDHD_TRACE(log, TraceLevel::kDebug) << "START TA " << ta << " out of " << tpIndex.nTAs();
+  // TPs of this TA are rows [ta_begin, ta_end) of taTPs, in channel order
+  const size_t ta_begin = tpIndex.taBegin(ta);
+  const size_t ta_end = tpIndex.taEnd(ta);
+
+  PDHD_TRACE(log, TraceLevel::kDebug) << "Found " << ta_end - ta_begin << " TPs in TA " << ta;
+  if (ta_begin == ta_end) {
+    PDHD_TRACE(log, TraceLevel::kWarning) << " [WARNING] TA " << ta << " has no TPs, skipping.";
+    return decide(TADecision::kSkip, VertexCut::kNoTPs);
+  }
+
+  timestamp_t first_tick = tpIndex.ta_time_start[ta];
+  timestamp_t last_tick = tpIndex.ta_time_end[ta];
+
+  timestamp_t TAWindow = last_tick - first_tick;
+  if (TAWindow < 20e3) TAWindow = 20e3;
+
+  PDHD_TRACE(log, TraceLevel::kDebug) << ">>> TAWindow = " << TAWindow;
+
+  channel_t current_chan = taTPs.channel[ta_begin];
+  
+  PDHD_TRACE(log, TraceLevel::kDebug) << "First tick = " << first_tick << ", last tick = " << last_tick;
+  PDHD_TRACE(log, TraceLevel::kDebug) << "First channel = " << current_chan;
+
+  // APA of the main collection face holding the first channel of the TA, 0 if none
+  const int apa_id = chmap::mainCollectionAPA(current_chan);
+
+  PDHD_TRACE(log, TraceLevel::kDebug) << "APA ID = " << apa_id;
+  if (apa_id == 0) {
+    PDHD_TRACE(log, TraceLevel::kInfo) << "APA ID not set to one of the main volumes so remove.";
+    return decide(TADecision::kRejectEvent, VertexCut::kOutsideMainAPA);
+  }
+
+  // APA 1, TPC 1; APA 3, TPC 2; APA 2, TPC 5; APA 4, TPC 6
+  const chmap::ChannelRange apa_chans = chmap::mainCollectionRange(apa_id);
+
+  FixedHist2D hTATPs(25, apa_chans.first, apa_chans.last, 20, 0, TAWindow);
+  for (size_t tp = ta_begin; tp < ta_end; tp++) {
+    timestamp_t filltime = taTPs.time_start[tp] - first_tick;
+    hTATPs.fill(static_cast<double>(taTPs.channel[tp]), static_cast<double>(filltime), static_cast<double>(taTPs.adc_integral[tp]));
+  }
+  const FixedHist1D hTimeProj = hTATPs.projectionY();
+
+  // >>> Shower spread in time filter
+  // Find the shower region in time using the time TP projections
+  // Get the bin with the maximum content (approximate peak position)
+  int peakBin = hTimeProj.maximumBin();
+  double peakValue = hTimeProj.binCenter(peakBin);
+  double peakHeight = hTimeProj.binContent(peakBin);
+
+  if (peakBin == hTimeProj.nBins()) {
+    PDHD_TRACE(log, TraceLevel::kWarning) << "[WARNING] Peak in time at the edge, gaussian likely to be a bad fit.";
+  }
+
+  // Fit a gaussian around peak region
+  // Define a fitting range around the peak
+  double fitRangeMin = peakValue - 5000;
+  double fitRangeMax = peakValue + 5000;
+
+  // Get range in TA bounds
+  fitRangeMin = std::max(fitRangeMin, hTimeProj.axis().xMin());
+  fitRangeMax = std::min(fitRangeMax, hTimeProj.axis().xMax());
+
+  // Gaussian in the fit range, from the log of the bin contents
+  const GaussianEstimate timeFit = estimateGaussian(hTimeProj, fitRangeMin, fitRangeMax);
+
+  double mean_time = timeFit.mean;
+  double sigma_time = timeFit.sigma;
+  PDHD_TRACE(log, TraceLevel::kDebug) << "Time: Mean = " << mean_time << ", sigma = " << sigma_time;
+
+  VertexTADiagnostics *taDiag = nullptr;
+  if (diagnosticsTag) {
+    const std::string title = "APA" + std::to_string(apa_id) + "_TATPs" + *diagnosticsTag + "_ta" + std::to_string(ta);
+    taDiag = &result.diagnostics.emplace(VertexTADiagnostics{title, hTATPs, hTimeProj, peakValue, peakHeight, fitRangeMin, fitRangeMax, timeFit, std::nullopt, std::nullopt});
+  }
+  result.timeFit = timeFit;
+ 
+  if (mean_time >= 0 && mean_time <= TAWindow) {
+    if (sigma_time > 4000) {
+      PDHD_TRACE(log, TraceLevel::kInfo) << "Too broad in time. Remove.";
+      return decide(TADecision::kFail, VertexCut::kTimeSigma);
+    }
+  } else {
+    PDHD_TRACE(log, TraceLevel::kInfo) << "Centre of shower outside time window. Remove.";
+    return decide(TADecision::kFail, VertexCut::kTimeMean);
+  }
+
+  if (timeFit.status != GaussianEstimate::kOK) {
+    PDHD_TRACE(log, TraceLevel::kWarning) << "[WARNING] Bad fit status " << timeFit.status << ", so removing.";
+    return decide(TADecision::kFail, VertexCut::kFitStatus);
+  }
+  // >>> Shower spread filter end
+  
+  int timeRangeMinBin = hTimeProj.findBin(fitRangeMin);
+  int timeRangeMaxBin = hTimeProj.findBin(fitRangeMax);
+  const FixedHist1D hChanProj = hTATPs.projectionX(timeRangeMinBin, timeRangeMaxBin);
+  if (taDiag) taDiag->chanProj = hChanProj;
+
+  // >>> Channel search for vertex start
+  double minimum_region_bin(1e9);
+  for (int ch = 2; ch <= hChanProj.nBins() - 1; ch++) {
+    double region_amp = hChanProj.binContent(ch-1) + hChanProj.binContent(ch) + hChanProj.binContent(ch+1);
+    if (region_amp < minimum_region_bin) {
+      minimum_region_bin = region_amp;
+    }
+  }
+
+  double maximum_region_bin(0);
+  for (int ch = 2; ch <= hChanProj.nBins() - 1; ch++) {
+    double region_amp = hChanProj.binContent(ch-1) + hChanProj.binContent(ch) + hChanProj.binContent(ch+1);
+    if (region_amp > maximum_region_bin) {
+      maximum_region_bin = region_amp;
+    }
+  }
+
+  // I think I only want a vertex cut in APA 3... too risky otherwise
+  if (apa_id == 3) {
+    // Minimum region is to the left - vertex in TPC volume
+    if (minimum_region_bin < maximum_region_bin) {
+      // Find max difference between adjacent bins between min and max region
+      double max_diff(0);
+      double old_diff(0);
+      int max_diff_bin = minimum_region_bin;
+      for (int ch = minimum_region_bin; ch  <= maximum_region_bin; ch++) {
+        double diff = hChanProj.binContent(ch) - hChanProj.binContent(ch-1);
+        if (old_diff < 0) {
+          old_diff = diff;   
+          continue;
+        }
+        old_diff = diff;
+        if (diff > max_diff) {
+          max_diff = diff;
+          max_diff_bin = ch;
+        }
+      }
+      // Assume that start of the shower (vertex) is 2 bins back from max difference bin
+      int vertex_chan_bin = max_diff_bin - 2;
+      double vertex_chan = hChanProj.binCenter(vertex_chan_bin);
+      PDHD_TRACE(log, TraceLevel::kDebug) << ">>> Vertex approx. at channel: " << vertex_chan;
+      result.vertexChannel = vertex_chan;
+      if (vertex_chan < (kCollectionAPA3.first + 40)) {
+        PDHD_TRACE(log, TraceLevel::kInfo) << "Vertex likely to be within the first 40 channels of APA3 collection plane. Remove.";
+        return decide(TADecision::kRejectEvent, VertexCut::kVertexUpstream);
+      }
+    } else {
+      double first_minimum_region_bin(1e9);
+      // Count back from the maximum region to find the minimum point to the left of the max region
+      for (int ch = maximum_region_bin; ch >= 1; ch--) {
+        double region_amp = hChanProj.binContent(ch-1) + hChanProj.binContent(ch) + hChanProj.binContent(ch+1);
+        if (region_amp < first_minimum_region_bin) {
+          first_minimum_region_bin = region_amp;
+        }
+      }
+
+      // If the minimum region to the left of the max region is more than half the height of the max region then remove event
+      if (hChanProj.binContent(first_minimum_region_bin) > 0.5*hChanProj.binContent(maximum_region_bin)) {
+        PDHD_TRACE(log, TraceLevel::kInfo) << "First minimum region has too many hits - shower likely entering from outside. Remove.";
+        return decide(TADecision::kFail, VertexCut::kEnteringShower);
+      }
+
+      // So the minimum to the left of the max region is small enough
+      // Now repeat the vertex channel finding from above
+      double max_diff(0);
+      double old_diff(0);
+      int max_diff_bin = minimum_region_bin;
+      for (int ch = minimum_region_bin; ch  <= maximum_region_bin; ch++) {
+        double diff = hChanProj.binContent(ch) - hChanProj.binContent(ch-1);
+        if (old_diff < 0) {
+          old_diff = diff;   
+          continue;
+        }
+        old_diff = diff;
+        if (diff > max_diff) {
+          max_diff = diff;
+          max_diff_bin = ch;
+        }
+      }
+      // Assume that start of the shower (vertex) is 2 bins back from max difference bin
+      int vertex_chan_bin = max_diff_bin - 2;
+      double vertex_chan = hChanProj.binCenter(vertex_chan_bin);
+      PDHD_TRACE(log, TraceLevel::kDebug) << ">>> Vertex approx. at channel: " << vertex_chan;
+      result.vertexChannel = vertex_chan;
+      if (vertex_chan < (kCollectionAPA3.first + 40)) {
+        PDHD_TRACE(log, TraceLevel::kInfo) << "Vertex likely to be within the first 40 channels of APA3 collection plane or outside the detector. Remove.";
+        return decide(TADecision::kFail, VertexCut::kVertexChannel);
+      }
+    }
+  }
+  // >>> Channel search for vertex end
+  
+  // >>> External muon filter start
+  // This cut only works for APA 3/4 because of the broken collection plane on APA1
+  if (apa_id == 3 || apa_id == 4) { 
+    // Get narrow region in time around shower peak
+    timestamp_t fShowerCenter = static_cast<timestamp_t>(mean_time);
+    timestamp_t fShowerUpperBound = fShowerCenter + 0.5*static_cast<timestamp_t>(sigma_time);
+    timestamp_t fShowerLowerBound = fShowerCenter - 0.5*static_cast<timestamp_t>(sigma_time);
+  
+    // Look at all TPs in APA 3 and look for track in small time window
+    // Events in with trigger APA 1 or 2 should already have passed filter
+    // Window is relative to the TA start; a lower bound that wrapped below zero selects nothing
+    const bool window_valid = fShowerLowerBound <= fShowerUpperBound;
+    const timestamp_t window_start = first_tick + fShowerLowerBound;
+    const timestamp_t window_end = first_tick + fShowerUpperBound;
+    size_t n_window_tps(0);
+    if (window_valid && taDiag) {
+      // Just want to see the number of hits in this histogram
+      FixedHist2D &hAPA3Window = taDiag->apa3Window.emplace(50, kCollectionAPA3.first, kCollectionAPA3.last, 40, fShowerLowerBound, fShowerUpperBound);
+      apa3Occupancy.forEachHit(kCollectionAPA3.first, kCollectionAPA3.last, window_start, window_end,
+          [&] (channel_t chan, timestamp_t time_peak) {
+            hAPA3Window.fill(static_cast<double>(chan), static_cast<double>(time_peak - first_tick));
+          });
+    }
+    if (window_valid) {
+      n_window_tps = apa3Occupancy.countHits(kCollectionAPA3.first, kCollectionAPA3.last, window_start, window_end);
+    }
+
+    PDHD_TRACE(log, TraceLevel::kDebug) << "fAPA3TPsInShowerWindow size = " << n_window_tps;
+
+    channel_t start_chan = kCollectionAPA3.first;
+    // Look at first 40 channels
+    channel_t end_chan = kCollectionAPA3.first + fUpstreamVetoChannels;
+    channel_t veto_threshold = 0.9 * fUpstreamVetoChannels;
+
+    int number_hits_window = window_valid ? apa3Occupancy.count(fVetoCountMode, start_chan, end_chan, window_start, window_end) : 0;
+    result.vetoCount = number_hits_window;
+    // Fail filter if more than 90% of channels in the first fUpstreamVetoChannels on APA 3 collection plane have TP hits
+    if (number_hits_window >= static_cast<int>(veto_threshold)) {
+      PDHD_TRACE(log, TraceLevel::kInfo) << "There are " << number_hits_window << " hits in first " << fUpstreamVetoChannels << " APA 3 collection plane channels so remove.";
+      return decide(TADecision::kFail, VertexCut::kUpstreamVeto);
+    } else {
+      PDHD_TRACE(log, TraceLevel::kInfo) << "There are " << number_hits_window << " hits in first " << fUpstreamVetoChannels <<  " collection plane. No external muon so pass filter!";
+    }
+    // >>> External muon filter end
+
+  }
+  // This TA passed these filters, so pass the whole event on to reconstruction
+  return decide(TADecision::kPass, VertexCut::kPassed);
+}
+
+}
@@ -0,0 +1,136 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       VertexSelector
+//// File:        VertexSelector.h
+////
+//// TA cuts of PDHDVertexFilter, kept free of art so the fused
+//// PDHDBSMSelection module makes the same decision. Each TA goes
+//// through the shower time profile, the vertex channel search (APA 3)
+//// and the upstream veto (APA 3 and 4). The event takes the first TA
+//// in TA order that passes it or rejects it outright; a TA that only
+//// fails leaves the decision to the later TAs.
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_ALGORITHMS_VERTEXSELECTOR_H
+#define PDHDBSMDATA_ALGORITHMS_VERTEXSELECTOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "pdhdbsmdata/Algorithms/FixedHist.h"
+#include "pdhdbsmdata/Algorithms/GaussianEstimator.h"
+#include "pdhdbsmdata/Algorithms/PDHDChannelMap.h"
+#include "pdhdbsmdata/Algorithms/TPOccupancyIndex.h"
+#include "pdhdbsmdata/Algorithms/TraceBuffer.h"
+#include "pdhdbsmdata/Algorithms/VetoWindowSweep.h"
+#include "pdhdbsmdata/DataProducts/TPIndex.h"
+
+namespace pdhd {
+
+// Outcome of one TA
+enum class TADecision {
+  kSkip,       // No TPs
+  kFail,       // Removed by a cut, later TAs can still pass the event
+  kPass,
+  kRejectEvent // Removed together with the event, as the filter always did for these cuts
+};
+
+// The cut that decided a TA, the cut-flow counters of the filter
+enum class VertexCut : uint8_t {
+  kNoTPs,
+  kOutsideMainAPA,
+  kTimeSigma,
+  kTimeMean,
+  kFitStatus,
+  kVertexUpstream,
+  kEnteringShower,
+  kVertexChannel,
+  kUpstreamVeto,
+  kPassed,
+  kNCuts
+};
+
+// Counter name of a cut, e.g. "tas_failed_time_sigma"
+const char* vertexCutName(VertexCut cut);
+
+// Histograms of one TA, for the diagnostics of the filter
+struct VertexTADiagnostics {
+  std::string title;
+  FixedHist2D ta;
+  FixedHist1D timeProj;
+  double peakValue;
+  double peakHeight;
+  double fitRangeMin;
+  double fitRangeMax;
+  GaussianEstimate timeFit;
+  std::optional<FixedHist1D> chanProj;
+  std::optional<FixedHist2D> apa3Window;
+};
+
+struct VertexTAResult {
+  TADecision decision = TADecision::kSkip;
+  VertexCut cut = VertexCut::kNoTPs;
+  std::optional<GaussianEstimate> timeFit;
+  std::optional<double> vertexChannel;
+  std::optional<int> vetoCount;
+  std::optional<VertexTADiagnostics> diagnostics;
+};
+
+class VertexSelector {
+  public:
+    // Main collection face of APA 3, the upstream face of the beam-side TPCs
+    static constexpr chmap::ChannelRange kCollectionAPA3 = chmap::mainCollectionRange(3);
+
+    VertexSelector(uint32_t upstreamVetoChannels, VetoCountMode vetoCountMode) :
+      fUpstreamVetoChannels(upstreamVetoChannels),
+      fVetoCountMode(vetoCountMode) {}
+
+    // (channel, time) index of the TPs on the APA 3 main collection face, for the veto windows of all TAs
+    static TPOccupancyIndex apa3Occupancy(TPIndex const& tpIndex);
+
+    // Cuts of one TA. With an event tag such as "_ev12_run29425" the TA histograms are kept
+    // in the result, titled APA<n>_TATPs<tag>_ta<ta>
+    VertexTAResult evaluateTA(TPIndex const& tpIndex, TPOccupancyIndex const& apa3Occupancy, std::size_t ta,
+                              TraceSink const& log, std::string const* diagnosticsTag = nullptr) const;
+
+    // Shower window of a TA with a time fit: the mean plus or minus kShowerWindowSigmas sigma, inside
+    // the TA time range; the whole TA time range without a fit
+    static constexpr double kShowerWindowSigmas = 3.;
+    static VetoWindow showerWindow(TPIndex const& tpIndex, std::size_t ta, VertexTAResult const& result);
+
+    // A TA with this decision decides the event, later TAs are not looked at
+    static bool decisive(TADecision decision) {
+      return decision == TADecision::kPass || decision == TADecision::kRejectEvent;
+    }
+    // Event decision after the TAs up to this one: passes if no TA has failed it yet or this one passes it
+    static void fold(TADecision decision, bool& pass) {
+      if (decision == TADecision::kPass) pass = true;
+      else if (decision == TADecision::kFail || decision == TADecision::kRejectEvent) pass = false;
+    }
+
+    // Serial decision over all TAs, calling onTA(ta, result) for each TA looked at
+    template <typename F>
+    bool select(TPIndex const& tpIndex, TPOccupancyIndex const& apa3Occupancy, TraceSink const& log, F&& onTA) const {
+      bool pass(true);
+      for (std::size_t ta = 0; ta < tpIndex.nTAs(); ta++) {
+        VertexTAResult result = evaluateTA(tpIndex, apa3Occupancy, ta, log);
+        fold(result.decision, pass);
+        const bool stop = decisive(result.decision);
+        onTA(ta, result);
+        if (stop) break;
+      }
+      return pass;
+    }
+
+    uint32_t upstreamVetoChannels() const { return fUpstreamVetoChannels; }
+    VetoCountMode vetoCountMode() const { return fVetoCountMode; }
+
+  private:
+    uint32_t fUpstreamVetoChannels;
+    VetoCountMode fVetoCountMode;
+};
+
+}
+
+#endif
@@ -0,0 +1,56 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        VetoWindowSweep.cc
+//////////////////////////////////////////////////////////////////////////
+
+#include "pdhdbsmdata/Algorithms/VetoWindowSweep.h"
+
+#include <algorithm>
+#include <numeric>
+#include <utility>
+
+namespace pdhd {
+
+//-------------------------------------
+std::vector<std::size_t> sweepVetoWindows(VetoCountMode mode, chmap::ChannelRange vetoChannels,
+                                          uint32_t const* channel, uint64_t const* time, std::size_t n,
+                                          std::vector<VetoWindow> const& windows) {
+  std::vector<std::size_t> counts(windows.size(), 0);
+
+  // (time, local channel) of the TPs on the veto channels, in time order
+  std::vector<std::pair<uint64_t, uint32_t>> tps;
+  for (std::size_t i = 0; i < n; i++) {
+    if (vetoChannels.contains(channel[i])) tps.emplace_back(time[i], channel[i] - vetoChannels.first);
+  }
+  if (tps.empty()) return counts;
+  std::sort(tps.begin(), tps.end());
+
+  std::vector<std::size_t> order(windows.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(),
+      [&] (std::size_t lh, std::size_t rh) -> bool {
+        return std::make_pair(windows[lh].start, windows[lh].end) < std::make_pair(windows[rh].start, windows[rh].end); });
+
+  // TPs [lo, hi) are inside the current window
+  std::vector<uint32_t> perChannel(vetoChannels.size(), 0);
+  std::size_t nChannels = 0;
+  auto add = [&] (std::size_t tp) { if (perChannel[tps[tp].second]++ == 0) nChannels++; };
+  auto remove = [&] (std::size_t tp) { if (--perChannel[tps[tp].second] == 0) nChannels--; };
+
+  std::size_t lo = 0, hi = 0;
+  for (const auto &w : order) {
+    if (windows[w].start > windows[w].end) continue;
+    while (lo < tps.size() && tps[lo].first < windows[w].start) {
+      if (lo < hi) remove(lo);
+      lo++;
+    }
+    hi = std::max(hi, lo);
+    while (hi < tps.size() && tps[hi].first <= windows[w].end) add(hi++);
+    // Only when this window ends before the previous one
+    while (hi > lo && tps[hi - 1].first > windows[w].end) remove(--hi);
+
+    counts[w] = (mode == VetoCountMode::kChannels) ? nChannels : hi - lo;
+  }
+  return counts;
+}
+
+}
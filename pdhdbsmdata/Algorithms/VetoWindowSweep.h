@@ -0,0 +1,37 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        VetoWindowSweep.h
+////
+//// Upstream veto counts for many time windows in one pass over the TPs.
+//// The TPs of the veto channels are put in time order once and the
+//// windows, sorted by start, slide over them with per-channel counters.
+//// When the windows all have the same width (the shower windows of
+//// PDHDExtMuonFilter) every TP enters and leaves the window once,
+//// whatever the number of windows.
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_ALGORITHMS_VETOWINDOWSWEEP_H
+#define PDHDBSMDATA_ALGORITHMS_VETOWINDOWSWEEP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "pdhdbsmdata/Algorithms/PDHDChannelMap.h"
+#include "pdhdbsmdata/Algorithms/TPOccupancyIndex.h"
+
+namespace pdhd {
+
+struct VetoWindow {
+  uint64_t start; // Ticks, both ends inclusive
+  uint64_t end;
+};
+
+// Count of each window, in the order of windows: TPs (or channels with TPs, by mode)
+// with channel in vetoChannels and time in the window
+std::vector<std::size_t> sweepVetoWindows(VetoCountMode mode, chmap::ChannelRange vetoChannels,
+                                          uint32_t const* channel, uint64_t const* time, std::size_t n,
+                                          std::vector<VetoWindow> const& windows);
+
+}
+
+#endif
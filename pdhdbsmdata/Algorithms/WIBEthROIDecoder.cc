@@ -0,0 +1,77 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        WIBEthROIDecoder.cc
+//////////////////////////////////////////////////////////////////////////
+
+#include "pdhdbsmdata/Algorithms/WIBEthROIDecoder.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "cetlib_except/exception.h"
+
+namespace pdhd {
+
+using dunedaq::fddetdataformats::WIBEthFrame;
+
+//-------------------------------------
+void WIBEthStreamWindows::set(std::size_t i, uint32_t channel, ROIChannelWindows const& windows) {
+  offline[i] = channel;
+  channels[i] = windows.window(channel);
+  if (!channels[i].empty()) span.merge(channels[i].start, channels[i].end);
+}
+
+//-------------------------------------
+std::size_t decodeWIBEthFragment(void const* payload, std::size_t size, WIBEthStreamWindows const& windows,
+                                 std::vector<ChannelWaveform>& waveforms) {
+  if (size % sizeof(WIBEthFrame) != 0) {
+    throw cet::exception("WIBEthROIDecoder") << "WIBEth payload of " << size << " bytes is not a whole number of "
+      << sizeof(WIBEthFrame) << " byte frames.\n";
+  }
+  if (windows.empty()) return 0;
+
+  // Waveform of each frame channel with a window
+  std::array<std::size_t, kWIBEthChannels> slot{};
+  for (std::size_t ch = 0; ch < kWIBEthChannels; ch++) {
+    if (windows.channels[ch].empty()) continue;
+    slot[ch] = waveforms.size();
+    waveforms.emplace_back().channel = windows.offline[ch];
+  }
+
+  const unsigned char *bytes = static_cast<const unsigned char*>(payload);
+  const std::size_t nFrames = size / sizeof(WIBEthFrame);
+  std::size_t nUnpacked = 0;
+  uint64_t previous = 0;
+  // Frames and headers are copied out, the frames in the payload need not be aligned
+  decltype(WIBEthFrame::daq_header) header;
+  WIBEthFrame frame;
+  for (std::size_t f = 0; f < nFrames; f++) {
+    const unsigned char *frameBytes = bytes + f * sizeof(WIBEthFrame);
+    std::memcpy(&header, frameBytes + offsetof(WIBEthFrame, daq_header), sizeof(header));
+    const uint64_t first = header.get_timestamp();
+    const uint64_t last = first + (kWIBEthSamples - 1) * kTicksPerSample;
+    if (first < previous) continue;
+    previous = first;
+    if (!windows.span.overlaps(first, last)) continue;
+
+    std::memcpy(&frame, frameBytes, sizeof(WIBEthFrame));
+    nUnpacked++;
+    for (std::size_t ch = 0; ch < kWIBEthChannels; ch++) {
+      const SampleRange samples = samplesInWindow(first, kWIBEthSamples, windows.channels[ch]);
+      ChannelWaveform &waveform = waveforms[slot[ch]];
+      for (std::size_t s = samples.first; s < samples.first + samples.count; s++) {
+        const uint64_t tick = first + s * kTicksPerSample;
+        if (waveform.adcs.empty()) {
+          waveform.timestamp = tick;
+        } else {
+          uint64_t expected = waveform.timestamp + waveform.adcs.size() * kTicksPerSample;
+          if (tick < expected) continue;
+          for (; expected < tick; expected += kTicksPerSample) waveform.adcs.push_back(waveform.adcs.back());
+        }
+        waveform.adcs.push_back(static_cast<short>(frame.get_adc(ch, s)));
+      }
+    }
+  }
+  return nUnpacked;
+}
+
+}
@@ -0,0 +1,57 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        WIBEthROIDecoder.h
+////
+//// Decoding of the payload of a WIBEth fragment, i.e. the bytes after
+//// the FragmentHeader, restricted to regions of interest. The payload
+//// is a sequence of WIBEthFrames of 64 channels by 64 samples of 14
+//// bits; a sample is 32 DAQ ticks and the frame timestamp is that of
+//// its first sample. Frames that overlap no window of their channels
+//// are skipped without unpacking, and of the others only the samples
+//// of each channel inside its window are unpacked.
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_ALGORITHMS_WIBETHROIDECODER_H
+#define PDHDBSMDATA_ALGORITHMS_WIBETHROIDECODER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "fddetdataformats/WIBEthFrame.hpp"
+
+#include "pdhdbsmdata/Algorithms/TPCROIs.h"
+
+namespace pdhd {
+
+constexpr std::size_t kWIBEthChannels = dunedaq::fddetdataformats::WIBEthFrame::s_num_channels;
+constexpr std::size_t kWIBEthSamples = dunedaq::fddetdataformats::WIBEthFrame::s_time_samples_per_frame;
+
+// Samples of one channel inside its window, from timestamp on every kTicksPerSample ticks
+struct ChannelWaveform {
+  uint32_t channel = 0;
+  uint64_t timestamp = 0;
+  std::vector<short> adcs;
+};
+
+// Windows of the channels of one WIBEth stream, from its frame channel map
+struct WIBEthStreamWindows {
+  std::array<TickWindow, kWIBEthChannels> channels; // By channel of the frame, empty for no ROI
+  std::array<uint32_t, kWIBEthChannels> offline{};  // Offline channel of each frame channel
+  TickWindow span;                                  // Over all channels of the stream
+
+  // Sets frame channel i to offline channel channel and its window
+  void set(std::size_t i, uint32_t channel, ROIChannelWindows const& windows);
+  bool empty() const { return span.empty(); }
+};
+
+// Appends the samples of the frames of the payload inside the windows to waveforms, one
+// waveform per frame channel with a window, in frame channel order. A sample missing between
+// frames repeats the one before it; frames out of time order are skipped. Returns the number
+// of frames unpacked. Throws cet::exception if the payload is not a whole number of frames.
+std::size_t decodeWIBEthFragment(void const* payload, std::size_t size, WIBEthStreamWindows const& windows,
+                                 std::vector<ChannelWaveform>& waveforms);
+
+}
+
+#endif
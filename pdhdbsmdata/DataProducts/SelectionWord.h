@@ -0,0 +1,45 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       SelectionWord
+//// File:        SelectionWord.h
+////
+//// Cut decisions of an event, one bit per cut, written by the filters
+//// in tag-only mode (TagOnly: true) instead of rejecting the event.
+//// PDHDSelectionRouter reads the words, so several output streams of
+//// one job can each keep the events of a different combination of cuts
+//// (spill ON and OFF, with and without the vertex cut, ...).
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_DATAPRODUCTS_SELECTIONWORD_H
+#define PDHDBSMDATA_DATAPRODUCTS_SELECTIONWORD_H
+
+#include <cstdint>
+
+namespace pdhd {
+
+// Bit positions; append new cuts, stored words keep their meaning
+enum class SelectionCut : uint8_t { kSpill, kTriggerType, kExtMuon, kVertex, kNCuts };
+
+// Names as in the Stages of PDHDBSMSelection
+inline const char* selectionCutName(SelectionCut cut) {
+  static constexpr const char* kNames[] = {"spill", "triggertype", "extmuon", "vertex"};
+  return cut < SelectionCut::kNCuts ? kNames[static_cast<unsigned>(cut)] : "unknown";
+}
+
+struct SelectionWord {
+  uint32_t evaluated = 0; // Bit per SelectionCut: the cut was applied to the event
+  uint32_t passed = 0;    // ... and passed it
+
+  static constexpr uint32_t bit(SelectionCut cut) { return uint32_t(1) << static_cast<unsigned>(cut); }
+
+  void set(SelectionCut cut, bool pass) {
+    evaluated |= bit(cut);
+    if (pass) passed |= bit(cut);
+    else passed &= ~bit(cut);
+  }
+  // Every cut applied passed the event, the decision of the filters without TagOnly
+  bool pass() const { return passed == evaluated; }
+};
+
+}
+
+#endif
@@ -0,0 +1,40 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       SpillInfo, SpillSummary
+//// File:        SpillInfo.h
+////
+//// SPS spill state of an event, written by PDHDSPSSpillFilter for every
+//// event when ProduceSpillInfo is set, so that later stages do not need
+//// to repeat the timestamp to spill matching. SpillSummary is the SubRun record of
+//// the spills and PoT seen and accepted by the filter.
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_DATAPRODUCTS_SPILLINFO_H
+#define PDHDBSMDATA_DATAPRODUCTS_SPILLINFO_H
+
+#include <cstdint>
+
+namespace pdhd {
+
+struct SpillInfo {
+  static constexpr int32_t kNoSpill = -1;
+
+  int32_t spill_index = kNoSpill;         // Last spill in the run's spill table that started before the event, kNoSpill if none
+  uint64_t spill_pot = 0;                 // PoT of that spill
+  int64_t time_since_spill_start_ms = -1; // Event time minus spill start time, -1 if there is no spill
+  bool spill_on = false;                  // Event inside the spill window of a spill above the PoT threshold
+  bool real_data = true;                  // False for simulated events, which have no spill and pass the filter
+};
+
+struct SpillSummary {
+  uint64_t events_seen = 0;     // Real data events looked at by the filter
+  uint64_t events_on = 0;       // ... of which during a spill above the PoT threshold
+  uint64_t events_accepted = 0; // ... of which passed the filter
+  uint64_t spills_on = 0;       // Distinct spills above the PoT threshold with at least one event
+  uint64_t pot_on = 0;          // PoT of those spills
+  uint64_t spills_accepted = 0; // Distinct spills with at least one accepted event
+  uint64_t pot_accepted = 0;    // PoT of those spills
+};
+
+}
+
+#endif
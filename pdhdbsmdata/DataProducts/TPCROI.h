@@ -0,0 +1,30 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       TPCROI
+//// File:        TPCROI.h
+////
+//// TPC region of interest of an event: a range of offline channels of
+//// one APA over a window of DAQ time. The TP-based filters write a
+//// std::vector<TPCROI> with ProduceROIs set, one or more per TA that
+//// passed the event, every channel over all ticks for an event passed
+//// without such a TA, and none for a rejected event, and PDHDROIDecoder
+//// turns only the waveforms inside them into raw::RawDigits.
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_DATAPRODUCTS_TPCROI_H
+#define PDHDBSMDATA_DATAPRODUCTS_TPCROI_H
+
+#include <cstdint>
+
+namespace pdhd {
+
+struct TPCROI {
+  uint32_t apa = 0;           // 1-4, numbered as in the filters
+  uint32_t channel_first = 0; // Offline channels, both ends inclusive
+  uint32_t channel_last = 0;
+  uint64_t time_start = 0;    // DAQ timestamps (16 ns ticks) as the TPs, both ends inclusive
+  uint64_t time_end = 0;
+};
+
+}
+
+#endif
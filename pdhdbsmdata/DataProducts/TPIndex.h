@@ -0,0 +1,85 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       TPIndex
+//// File:        TPIndex.h
+////
+//// Per-event index of the trigger primitives, written by
+//// PDHDTPIndexProducer and read by the TP-based filters so that the TP
+//// collection is copied, partitioned and sorted once per event.
+////
+//// The TPs are stored as columns (structure of arrays):
+////   - detector: every TP of the event, partitioned by (APA, plane) and
+////     sorted by (channel, time_peak) inside each partition. Partition p
+////     is the range [partition_offsets[p], partition_offsets[p+1]);
+////   - ta_tps: the TPs of each TA, sorted by (channel, time_peak). TA t
+////     is the range [ta_offsets[t], ta_offsets[t+1]).
+////
+//// APAs are numbered 1-4 as in the filters (APA 1: channels 0-2559,
+//// APA 3: 2560-5119, APA 2: 5120-7679, APA 4: 7680-10239) and planes
+//// 0-2 are U, V and collection.
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_DATAPRODUCTS_TPINDEX_H
+#define PDHDBSMDATA_DATAPRODUCTS_TPINDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace pdhd {
+
+struct TPColumns {
+  std::vector<uint32_t> channel;
+  std::vector<uint64_t> time_peak;
+  std::vector<uint64_t> time_start;
+  std::vector<uint32_t> adc_integral;
+  std::vector<uint32_t> source; // Position of the TP in the input TP collection
+
+  std::size_t size() const { return channel.size(); }
+  bool empty() const { return channel.empty(); }
+
+  void reserve(std::size_t n) {
+    channel.reserve(n);
+    time_peak.reserve(n);
+    time_start.reserve(n);
+    adc_integral.reserve(n);
+    source.reserve(n);
+  }
+
+  void push_back(uint32_t chan, uint64_t peak, uint64_t start, uint32_t adc, uint32_t src) {
+    channel.push_back(chan);
+    time_peak.push_back(peak);
+    time_start.push_back(start);
+    adc_integral.push_back(adc);
+    source.push_back(src);
+  }
+};
+
+struct TPIndex {
+  static constexpr unsigned kNAPAs = 4;
+  static constexpr unsigned kNPlanes = 3;
+  static constexpr unsigned kOtherPartition = kNAPAs * kNPlanes; // Channels outside the four APAs
+  static constexpr unsigned kNPartitions = kOtherPartition + 1;
+
+  static constexpr unsigned partition(unsigned apa, unsigned plane) { return (apa - 1) * kNPlanes + plane; }
+
+  TPColumns detector;
+  std::vector<uint32_t> partition_offsets = std::vector<uint32_t>(kNPartitions + 1, 0);
+
+  TPColumns ta_tps;
+  std::vector<uint32_t> ta_offsets = std::vector<uint32_t>(1, 0);
+  std::vector<uint64_t> ta_time_start; // time_start and time_end of each TA
+  std::vector<uint64_t> ta_time_end;
+
+  std::size_t nTAs() const { return ta_time_start.size(); }
+
+  std::size_t partitionBegin(unsigned apa, unsigned plane) const { return partition_offsets[partition(apa, plane)]; }
+  std::size_t partitionEnd(unsigned apa, unsigned plane) const { return partition_offsets[partition(apa, plane) + 1]; }
+
+  std::size_t taBegin(std::size_t ta) const { return ta_offsets[ta]; }
+  std::size_t taEnd(std::size_t ta) const { return ta_offsets[ta + 1]; }
+  std::size_t taSize(std::size_t ta) const { return ta_offsets[ta + 1] - ta_offsets[ta]; }
+};
+
+}
+
+#endif
@@ -0,0 +1,6 @@
+#include "canvas/Persistency/Common/Wrapper.h"
+
+#include "pdhdbsmdata/DataProducts/SelectionWord.h"
+#include "pdhdbsmdata/DataProducts/SpillInfo.h"
+#include "pdhdbsmdata/DataProducts/TPCROI.h"
+#include "pdhdbsmdata/DataProducts/TPIndex.h"
@@ -0,0 +1,433 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       PDHDBSMSelection
+//// Plugin Type: filter
+//// File:        PDHDBSMSelection_module.cc
+////
+//// The spill, trigger type, external muon and vertex cuts in one filter.
+//// Each cut is a stage (PDHDSelectionStage.h) configured with the same
+//// parameters as its filter module and deciding with the same selector,
+//// and the event passes if every stage passes it. The stages share the
+//// inputs of the event, so the TCs and the TP index are read once, and
+//// only for events that get as far as a stage that needs them.
+////
+//// The stages stop at the first rejection. Since the decision does not
+//// depend on the order, the order is tuned as the job runs: the cost and
+//// rejection rate of each stage are measured and the stages are reordered
+//// every ReorderEvery events to lower the expected cost per event
+//// (StageScheduler). With TagOnly every stage is evaluated and the word
+//// has the decision of each.
+//////////////////////////////////////////////////////////////////////////
+
+#include <array>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "art/Framework/Core/ModuleMacros.h"
+#include "art/Framework/Core/SharedFilter.h"
+#include "art/Framework/Principal/Event.h"
+#include "art/Framework/Principal/Run.h"
+#include "art/Framework/Services/Registry/ServiceHandle.h"
+#include "art/Utilities/Globals.h"
+#include "cetlib_except/exception.h"
+#include "messagefacility/MessageLogger/MessageLogger.h"
+
+#include "detdataformats/trigger/TriggerActivityData.hpp"
+#include "detdataformats/trigger/TriggerCandidateData.hpp"
+#include "detdataformats/trigger/TriggerPrimitive.hpp"
+
+#include "pdhdbsmdata/Algorithms/CutFlow.h"
+#include "pdhdbsmdata/Algorithms/ExtMuonSelector.h"
+#include "pdhdbsmdata/Algorithms/SpillSelector.h"
+#include "pdhdbsmdata/Algorithms/SpillTableIO.h"
+#include "pdhdbsmdata/Algorithms/SpillTimeline.h"
+#include "pdhdbsmdata/Algorithms/StageScheduler.h"
+#include "pdhdbsmdata/Algorithms/TCTypeSelector.h"
+#include "pdhdbsmdata/Algorithms/VertexSelector.h"
+#include "pdhdbsmdata/DataProducts/TPIndex.h"
+#include "pdhdbsmdata/PDHDCutFlow.h"
+#include "pdhdbsmdata/PDHDDecisionCache.h"
+#include "pdhdbsmdata/PDHDSelectionTag.h"
+#include "pdhdbsmdata/PDHDSelectionStage.h"
+#include "pdhdbsmdata/PDHDSPSSpillDatabase.h"
+#include "pdhdbsmdata/PDHDTrace.h"
+
+namespace pdhd {
+
+using channel_t = dunedaq::trgdataformats::channel_t;
+
+namespace {
+
+  //-------------------------------------
+  // PDHDSPSSpillFilter: spill ON or OFF from the spill table of the run
+  class SpillStage : public SelectionStage {
+    public:
+      SpillStage(fhicl::ParameterSet const& pset, CutFlow& cutFlow, std::string const& prefix) :
+        fSelector(pset.get<bool>("spill_on", true), pset.get<uint64_t>("PoT_threshold")),
+        fCursors(art::Globals::instance()->nschedules()),
+        fCutFlow(cutFlow) {
+        fCount.spillOn = cutFlow.addCounter(prefix + "events_spill_on");
+        fCount.spillOff = cutFlow.addCounter(prefix + "events_spill_off");
+      }
+
+      // Run transitions do not overlap with events
+      void beginRun(art::Run const& run) override {
+        art::ServiceHandle<PDHDSPSSpillDatabase const> spillDatabase;
+        fSpillTimeline = spillDatabase->findRun(run.run());
+        fRunChecksum = spillDatabase->checksum(run.run());
+        for (auto &cursor : fCursors) {
+          cursor.reset();
+          if (fSpillTimeline) cursor = std::make_unique<SpillTimeline::Cursor>(*fSpillTimeline);
+        }
+      }
+
+      // A simulated run has no spill table, which only the events tell
+      void check(SelectionEvent& data) const override {
+        art::Event const& evt = data.event();
+        if (!fSpillTimeline && evt.isRealData()) {
+          throw cet::exception("PDHDBSMSelection") << "No SPS spill data for run " << evt.run() << ".\n";
+        }
+      }
+
+      // The spill table and the configuration of PDHDSPSSpillDatabase
+      uint64_t runChecksum() const override { return fRunChecksum; }
+
+      bool select(SelectionEvent& data) const override {
+        art::Event const& evt = data.event();
+        if (!evt.isRealData()) return true;
+
+        SpillTimeline::Cursor *spillCursor = fCursors[data.schedule()].get();
+        uint64_t timeHigh_ns = evt.time().timeHigh() * 1e9;
+        uint64_t timeLow_ns = evt.time().timeLow();
+        const uint64_t fEventTimeStamp = (timeHigh_ns + timeLow_ns) * 1e-6; // ms, as PDHDSPSSpillFilter
+
+        const SpillDecision decision = fSelector.decide(*fSpillTimeline, spillCursor->lookup(fEventTimeStamp));
+        PDHD_TRACE(data.log(), TraceLevel::kDebug) << "Timestamp = " << fEventTimeStamp << " ms, " << (decision.on ? "Spill ON" : "Spill OFF");
+        fCutFlow.count(decision.on ? fCount.spillOn : fCount.spillOff);
+        return decision.pass;
+      }
+
+    private:
+      SpillSelector fSelector;
+      std::shared_ptr<SpillTimeline const> fSpillTimeline;
+      uint64_t fRunChecksum = 0;
+      // One per schedule, the events of a schedule arrive in time order
+      std::vector<std::unique_ptr<SpillTimeline::Cursor>> fCursors;
+      CutFlow &fCutFlow;
+      struct {
+        CutFlow::id_t spillOn, spillOff;
+      } fCount;
+  };
+
+  //-------------------------------------
+  // PDHDTriggerTypeFilter: veto on the TC types and algorithms
+  class TriggerTypeStage : public SelectionStage {
+    public:
+      TriggerTypeStage(fhicl::ParameterSet const& pset, CutFlow& cutFlow, std::string const& prefix) :
+        fSelector(TCTypeSelector::Config{
+          pset.get<std::vector<std::string>>("AcceptTypes", {}),
+          pset.get<std::vector<std::string>>("RejectTypes", {"kADCSimpleWindow"}),
+          pset.get<std::vector<std::string>>("AcceptAlgorithms", {}),
+          pset.get<std::vector<std::string>>("RejectAlgorithms", {}),
+          parseTCVetoPolicy(pset.get<std::string>("Policy", "any")),
+          pset.get<size_t>("MinVetoedTCs", 1)}),
+        fCutFlow(cutFlow) {
+        fCount.tcsChecked = cutFlow.addCounter(prefix + "tcs_checked");
+        fCount.tcsVetoed = cutFlow.addCounter(prefix + "tcs_vetoed");
+      }
+
+      bool readsTCs() const override { return true; }
+
+      void check(SelectionEvent& data) const override {
+        if (data.event().isRealData()) data.requireTCs("triggertype");
+      }
+
+      bool select(SelectionEvent& data) const override {
+        if (!data.event().isRealData()) return true;
+
+        const auto &tcs = data.triggerCandidates();
+        const TCTypeSelector::Decision decision = fSelector.decide(tcs.data(), tcs.data() + tcs.size());
+        fCutFlow.count(fCount.tcsChecked, decision.checked);
+        fCutFlow.count(fCount.tcsVetoed, decision.vetoed);
+        if (decision.reject) {
+          PDHD_TRACE(data.log(), TraceLevel::kInfo) << decision.vetoed << " of " << tcs.size() << " TCs vetoed. Removing event.";
+        }
+        return !decision.reject;
+      }
+
+    private:
+      TCTypeSelector fSelector;
+      CutFlow &fCutFlow;
+      struct {
+        CutFlow::id_t tcsChecked, tcsVetoed;
+      } fCount;
+  };
+
+  //-------------------------------------
+  // PDHDExtMuonFilter: upstream veto in the shower window of each TA
+  class ExtMuonStage : public SelectionStage {
+    public:
+      ExtMuonStage(fhicl::ParameterSet const& pset, CutFlow& cutFlow, std::string const& prefix) :
+        fSelector(pset.get<channel_t>("fUpstreamVetoChannels"), parseVetoCountMode(pset.get<std::string>("VetoCountMode", "hits"))),
+        fCutFlow(cutFlow) {
+        for (size_t cut = 0; cut < fCount.size(); cut++) {
+          fCount[cut] = cutFlow.addCounter(prefix + extMuonCutName(static_cast<ExtMuonCut>(cut)));
+        }
+      }
+
+      bool readsTPs() const override { return true; }
+
+      void check(SelectionEvent& data) const override {
+        if (data.event().isRealData()) data.requireTPs("extmuon");
+      }
+
+      bool select(SelectionEvent& data) const override {
+        if (!data.event().isRealData()) return true;
+
+        const ExtMuonDecision decision = fSelector.select(data.tpIndex(), data.log());
+        for (size_t cut = 0; cut < fCount.size(); cut++) fCutFlow.count(fCount[cut], decision.tas[cut]);
+        return decision.pass;
+      }
+
+    private:
+      ExtMuonSelector fSelector;
+      CutFlow &fCutFlow;
+      std::array<CutFlow::id_t, static_cast<size_t>(ExtMuonCut::kNCuts)> fCount;
+  };
+
+  //-------------------------------------
+  // PDHDVertexFilter: shower time profile, vertex channel and upstream veto of each TA
+  class VertexStage : public SelectionStage {
+    public:
+      VertexStage(fhicl::ParameterSet const& pset, CutFlow& cutFlow, std::string const& prefix) :
+        fSelector(pset.get<channel_t>("fUpstreamVetoChannels"), parseVetoCountMode(pset.get<std::string>("VetoCountMode", "hits"))),
+        fCutFlow(cutFlow) {
+        for (size_t cut = 0; cut < fCount.size(); cut++) {
+          fCount[cut] = cutFlow.addCounter(prefix + vertexCutName(static_cast<VertexCut>(cut)));
+        }
+      }
+
+      bool readsTPs() const override { return true; }
+
+      void check(SelectionEvent& data) const override { data.requireTPs("vertex"); }
+
+      // No check on real data, as PDHDVertexFilter
+      bool select(SelectionEvent& data) const override {
+        return fSelector.select(data.tpIndex(), data.apa3Occupancy(), data.log(), [&] (size_t, VertexTAResult const& result) {
+          fCutFlow.count(fCount[static_cast<size_t>(result.cut)]);
+        });
+      }
+
+    private:
+      VertexSelector fSelector;
+      CutFlow &fCutFlow;
+      std::array<CutFlow::id_t, static_cast<size_t>(VertexCut::kNCuts)> fCount;
+  };
+
+  //-------------------------------------
+  // A new stage is a class above and a line here
+  std::unique_ptr<SelectionStage> makeStage(std::string const& name, fhicl::ParameterSet const& pset,
+                                            CutFlow& cutFlow) {
+    const std::string prefix = name + "_";
+    if (name == "spill") return std::make_unique<SpillStage>(pset.get<fhicl::ParameterSet>("Spill"), cutFlow, prefix);
+    if (name == "triggertype") return std::make_unique<TriggerTypeStage>(pset.get<fhicl::ParameterSet>("TriggerType"), cutFlow, prefix);
+    if (name == "extmuon") return std::make_unique<ExtMuonStage>(pset.get<fhicl::ParameterSet>("ExtMuon"), cutFlow, prefix);
+    if (name == "vertex") return std::make_unique<VertexStage>(pset.get<fhicl::ParameterSet>("Vertex"), cutFlow, prefix);
+    throw cet::exception("PDHDBSMSelection") << "Unknown stage \"" << name
+      << "\", expected \"spill\", \"triggertype\", \"extmuon\" or \"vertex\".\n";
+  }
+
+}
+
+//-------------------------------------
+class PDHDBSMSelection : public art::SharedFilter {
+  public:
+    explicit PDHDBSMSelection(fhicl::ParameterSet const & pset, art::ProcessingFrame const & frame);
+    virtual ~PDHDBSMSelection() {};
+    bool filter(art::Event& e, art::ProcessingFrame const & frame) override;
+    bool beginRun(art::Run& r, art::ProcessingFrame const & frame) override;
+    bool endRun(art::Run& r, art::ProcessingFrame const & frame) override;
+    void endJob(art::ProcessingFrame const & frame) override;
+
+  private:
+    SelectionWord selectEvent(art::Event const & evt, size_t schedule);
+
+    SelectionInputs fInputs;
+    // Options common to the filters, see the header of each class
+    Tracer fTrace;
+    FilterDecisionCache fDecisionCache;
+    SelectionTag fTag;
+
+    // Created before the stages, which add their own counters
+    CutFlow fCutFlow;
+    CutFlowReport fCutFlowReport;
+    struct {
+      CutFlow::id_t eventsSeen, eventsPassed, eventsFailed, eventsCached, eventsExplored, reorders;
+      std::vector<CutFlow::id_t> evaluated, rejected; // Per stage
+    } fCount;
+    struct {
+      CutFlow::id_t event, inputs;
+      std::vector<CutFlow::id_t> stages; // Without the time spent reading the inputs
+    } fStage;
+
+    std::vector<std::string> fStageNames;
+    std::vector<SelectionCut> fStageCuts; // Bit of each stage in the SelectionWord
+    std::vector<std::unique_ptr<SelectionStage>> fStages;
+    StageScheduler fScheduler;
+};
+
+//-------------------------------------
+PDHDBSMSelection::PDHDBSMSelection(fhicl::ParameterSet const & pset, art::ProcessingFrame const &) :
+  SharedFilter(pset),
+  fInputs{pset.get<std::string>("InputTagTC", "triggerrawdecoder:daq"),
+          pset.get<std::string>("InputTagTPIndex", ""),
+          pset.get<std::string>("InputTagTP", "triggerrawdecoder:daq"),
+          pset.get<std::string>("InputTagTA", "triggerrawdecoder:daq")},
+  fTrace(pset, "PDHDBSMSelection"),
+  fDecisionCache(pset),
+  fTag(pset),
+  fCutFlowReport(pset),
+  fStageNames(pset.get<std::vector<std::string>>("Stages", {"spill", "triggertype", "extmuon", "vertex"})),
+  fScheduler(fStageNames.size(), StageScheduler::Config{
+    pset.get<bool>("AdaptiveOrder", true),
+    pset.get<uint64_t>("ReorderEvery", 1000),
+    pset.get<uint64_t>("ExploreEvery", 50),
+    pset.get<double>("StatsDecay", 0.5)}) {
+
+  fCount.eventsSeen = fCutFlow.addCounter("events_seen");
+  fCount.eventsPassed = fCutFlow.addCounter("events_passed");
+  fCount.eventsFailed = fCutFlow.addCounter("events_failed");
+  fCount.eventsCached = fCutFlow.addCounter("events_cached");
+  fCount.eventsExplored = fCutFlow.addCounter("events_explored");
+  fCount.reorders = fCutFlow.addCounter("reorders");
+  fStage.event = fCutFlow.addStage("event");
+  fStage.inputs = fCutFlow.addStage("inputs");
+
+  bool readsTCs(false), readsTPs(false);
+  for (const auto &name : fStageNames) {
+    fCount.evaluated.push_back(fCutFlow.addCounter(name + "_evaluated"));
+    fCount.rejected.push_back(fCutFlow.addCounter(name + "_rejected"));
+    fStage.stages.push_back(fCutFlow.addStage(name));
+    fStages.push_back(makeStage(name, pset, fCutFlow));
+    size_t cut = 0;
+    while (name != selectionCutName(static_cast<SelectionCut>(cut))) cut++;
+    fStageCuts.push_back(static_cast<SelectionCut>(cut));
+    readsTCs |= fStages.back()->readsTCs();
+    readsTPs |= fStages.back()->readsTPs();
+  }
+
+  if (readsTCs) consumes<std::vector<dunedaq::trgdataformats::TriggerCandidateData>>(fInputs.tcLabel);
+  if (readsTPs && !fInputs.tpIndexLabel.empty()) {
+    consumes<TPIndex>(fInputs.tpIndexLabel);
+  } else if (readsTPs) {
+    consumes<std::vector<dunedaq::trgdataformats::TriggerPrimitive>>(fInputs.tpLabel);
+    consumes<std::vector<dunedaq::trgdataformats::TriggerActivityData>>(fInputs.taLabel);
+    consumes<art::Assns<dunedaq::trgdataformats::TriggerActivityData, dunedaq::trgdataformats::TriggerPrimitive>>(fInputs.taLabel);
+  }
+  if (fTag.tagOnly()) produces<SelectionWord>();
+  async<art::InEvent>();
+}
+
+//-------------------------------------
+bool PDHDBSMSelection::beginRun(art::Run & run, art::ProcessingFrame const &) {
+  uint64_t runChecksum = 0;
+  for (auto &stage : fStages) {
+    stage->beginRun(run);
+    const uint64_t stageChecksum = stage->runChecksum();
+    if (stageChecksum != 0) runChecksum = fnv1a64(&stageChecksum, sizeof(stageChecksum), runChecksum);
+  }
+  fDecisionCache.beginRun(run, runChecksum);
+  return true;
+}
+
+//-------------------------------------
+bool PDHDBSMSelection::endRun(art::Run &, art::ProcessingFrame const &) {
+  fDecisionCache.endRun();
+  return true;
+}
+
+//-------------------------------------
+bool PDHDBSMSelection::filter(art::Event & evt, art::ProcessingFrame const & frame) {
+  const auto timer = fCutFlow.time(fStage.event);
+  // The word of a tagged event needs every stage, which the cache does not hold. A cached decision
+  // was made with the inputs of every stage checked, so only the events decided here are checked.
+  const std::optional<bool> cached = fTag.tagOnly() ? std::nullopt : fDecisionCache.lookup(evt);
+  SelectionWord word;
+  if (cached) fCutFlow.count(fCount.eventsCached);
+  else word = fTrace.traced([&] { return selectEvent(evt, frame.scheduleID().id()); });
+  const bool pass = cached ? *cached : word.pass();
+  if (!cached) fDecisionCache.store(evt, pass);
+  fCutFlow.count(fCount.eventsSeen);
+  fCutFlow.count(pass ? fCount.eventsPassed : fCount.eventsFailed);
+  return cached ? pass : fTag.put(evt, word);
+}
+
+//-------------------------------------
+SelectionWord PDHDBSMSelection::selectEvent(art::Event const & evt, size_t schedule) {
+  const int fRun = evt.run();
+  const unsigned int fEventID = evt.id().event();
+
+  PDHD_TRACE(fTrace, TraceLevel::kInfo) << "START PDHDBSMSelection for Event " << fEventID << " in Run " << fRun;
+
+  SelectionEvent data(evt, schedule, fInputs, fTrace.sink());
+  const StageScheduler::Ticket ticket = fScheduler.begin();
+  if (ticket.explore) fCutFlow.count(fCount.eventsExplored);
+
+  // Exploration events run every stage to measure the rejection rates, tagged events to fill
+  // the word; the decision is the same. The checks read the input products of the stages.
+  SelectionWord word;
+  const auto check = [&] (size_t s) {
+    const uint64_t sharedBefore = data.sharedNs();
+    fStages[s]->check(data);
+    const uint64_t sharedNs = data.sharedNs() - sharedBefore;
+    if (sharedNs > 0) fCutFlow.record(fStage.inputs, std::chrono::nanoseconds(sharedNs));
+  };
+  const auto select = [&] (size_t s) {
+    const uint64_t sharedBefore = data.sharedNs();
+    const auto start = CutFlow::clock_type::now();
+    const bool stagePass = fStages[s]->select(data);
+    const auto elapsed = CutFlow::clock_type::now() - start;
+
+    const uint64_t sharedNs = data.sharedNs() - sharedBefore;
+    const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    const uint64_t stageNs = ns > sharedNs ? ns - sharedNs : 0;
+    fCutFlow.record(fStage.stages[s], std::chrono::nanoseconds(stageNs));
+    if (sharedNs > 0) fCutFlow.record(fStage.inputs, std::chrono::nanoseconds(sharedNs));
+    fScheduler.record(s, stageNs, !stagePass, ticket.explore);
+    fCutFlow.count(fCount.evaluated[s]);
+
+    PDHD_TRACE(fTrace, TraceLevel::kDebug) << "Stage " << fStageNames[s] << (stagePass ? " passed" : " rejected") << " the event";
+    word.set(fStageCuts[s], stagePass);
+    if (!stagePass) fCutFlow.count(fCount.rejected[s]);
+    return stagePass;
+  };
+  StageScheduler::run(ticket.order, fStages.size(), ticket.explore || fTag.tagOnly(), check, select);
+  fScheduler.end(ticket);
+
+  PDHD_TRACE(fTrace, TraceLevel::kInfo) << "END PDHDBSMSelection for Event " << fEventID << " in Run " << fRun
+    << (word.pass() ? ": pass" : ": reject");
+  return word;
+}
+
+//-------------------------------------
+void PDHDBSMSelection::endJob(art::ProcessingFrame const &) {
+  fCutFlow.count(fCount.reorders, fScheduler.reorders());
+  fCutFlowReport.write(fCutFlow);
+
+  const StageScheduler::Order order = fScheduler.order();
+  const std::vector<StageScheduler::StageStats> stats = fScheduler.stats();
+  std::ostringstream summary;
+  summary << "Stage order after " << fScheduler.reorders() << " reorders:";
+  for (size_t i = 0; i < fStages.size(); i++) {
+    const size_t s = order[i];
+    summary << "\n  " << fStageNames[s] << ": " << stats[s].meanNs * 1e-3 << " us per event, rejects "
+      << stats[s].rejection * 100 << "%";
+  }
+  mf::LogInfo("PDHDBSMSelection") << summary.str();
+}
+
+DEFINE_ART_MODULE(PDHDBSMSelection)
+
+}
@@ -0,0 +1,86 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        PDHDChannelMapCheck.h
+////
+//// Check of the compile-time channel table in PDHDChannelMap.h against
+//// the channel map of the WireReadout service. Modules call it once at
+//// beginRun when CheckChannelMap is set, so a job with a geometry that
+//// does not match the table stops instead of filtering on wrong APAs.
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_PDHDCHANNELMAPCHECK_H
+#define PDHDBSMDATA_PDHDCHANNELMAPCHECK_H
+
+#include <array>
+
+#include "art/Framework/Services/Registry/ServiceHandle.h"
+#include "cetlib_except/exception.h"
+#include "larcore/Geometry/WireReadout.h"
+#include "larcorealg/Geometry/WireReadoutGeom.h"
+#include "messagefacility/MessageLogger/MessageLogger.h"
+
+#include "pdhdbsmdata/Algorithms/PDHDChannelMap.h"
+
+namespace pdhd {
+
+// The TPC of each collection face is taken from the geometry, from the
+// first channel of the face, and the faces of all APAs must be different
+// TPCs, with the main face of each APA on its beam-side TPC, 1, 2, 5 or
+// 6 (kMainTPCOfAPA). Every wire read out by a channel then has to sit in
+// the plane of the table and in a TPC of the channel's APA: the TPC of
+// its face for a collection channel, either face of the APA for an
+// induction channel.
+inline void checkChannelMap(geo::WireReadoutGeom const& wireReadout) {
+  if (wireReadout.Nchannels() != chmap::kNChannels) {
+    throw cet::exception("PDHDChannelMap") << "WireReadout has " << wireReadout.Nchannels()
+      << " channels, the PDHD channel table has " << chmap::kNChannels << ".\n";
+  }
+
+  std::array<std::array<geo::TPCID, 2>, chmap::kNAPAs> faceTPC; // By channel block and face
+  for (unsigned block = 0; block < chmap::kNAPAs; block++) {
+    for (unsigned face = 0; face < 2; face++) {
+      const uint32_t channel = block * chmap::kChannelsPerAPA + chmap::kFirstCollectionChannel + face * chmap::kChannelsPerCollectionFace;
+      const auto wires = wireReadout.ChannelToWire(channel);
+      if (wires.empty()) {
+        throw cet::exception("PDHDChannelMap") << "Collection channel " << channel << " reads out no wire in WireReadout.\n";
+      }
+      faceTPC[block][face] = wires.front().asTPCID();
+      for (unsigned other = 0; other < 2 * block + face; other++) {
+        if (faceTPC[other / 2][other % 2] == faceTPC[block][face]) {
+          throw cet::exception("PDHDChannelMap") << "Collection channel " << channel << " reads out "
+            << faceTPC[block][face].toString() << ", as another face of the PDHD channel table.\n";
+        }
+      }
+      const uint8_t apa = chmap::kAPAOfBlock[block];
+      const geo::TPCID mainTPC(0, chmap::kMainTPCOfAPA[apa]);
+      if (face == chmap::kMainFaceOfAPA[apa] && faceTPC[block][face] != mainTPC) {
+        throw cet::exception("PDHDChannelMap") << "Collection channel " << channel << " of the main face of APA " << +apa
+          << " reads out " << faceTPC[block][face].toString() << ", the PDHD channel table expects the beam-side "
+          << mainTPC.toString() << ".\n";
+      }
+    }
+  }
+
+  for (uint32_t channel = 0; channel < chmap::kNChannels; channel++) {
+    chmap::ChannelInfo const& info = chmap::channelInfo(channel);
+    auto const& tpcs = faceTPC[chmap::kBlockOfAPA[info.apa]];
+    for (auto const& wire : wireReadout.ChannelToWire(channel)) {
+      const bool planeOK = (wire.Plane == info.plane);
+      const bool tpcOK = info.isCollection() ? (wire.asTPCID() == tpcs[info.face])
+                                             : (wire.asTPCID() == tpcs[0] || wire.asTPCID() == tpcs[1]);
+      if (!planeOK || !tpcOK) {
+        throw cet::exception("PDHDChannelMap") << "Channel " << channel << " is APA " << +info.apa
+          << " plane " << +info.plane << " face " << +info.face << " in the PDHD channel table but WireReadout gives "
+          << wire.toString() << ".\n";
+      }
+    }
+  }
+  mf::LogInfo("PDHDChannelMap") << "PDHD channel table agrees with WireReadout for " << chmap::kNChannels << " channels.";
+}
+
+inline void checkChannelMap() {
+  checkChannelMap(art::ServiceHandle<geo::WireReadout const>()->Get());
+}
+
+}
+
+#endif
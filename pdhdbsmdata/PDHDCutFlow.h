@@ -0,0 +1,95 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       CutFlowReport
+//// File:        PDHDCutFlow.h
+////
+//// End-of-job output of a module's CutFlow (Algorithms/CutFlow.h), off
+//// by default. A module keeps one CutFlow for all its schedules, counts
+//// and times its events into it, and writes it at endJob. CutFlowJSON
+//// is the path of a JSON file with the counters and latencies, and
+//// CutFlowTree: true writes two TTrees in the module's TFileService
+//// directory, "cutflow" (one entry per counter) and "latency" (one
+//// entry per stage, in microseconds).
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_PDHDCUTFLOW_H
+#define PDHDBSMDATA_PDHDCUTFLOW_H
+
+#include <fstream>
+#include <string>
+
+#include "art/Framework/Services/Registry/ServiceHandle.h"
+#include "art_root_io/TFileService.h"
+#include "cetlib_except/exception.h"
+#include "fhiclcpp/ParameterSet.h"
+#include "messagefacility/MessageLogger/MessageLogger.h"
+
+#include "pdhdbsmdata/Algorithms/CutFlow.h"
+
+#include "TTree.h"
+
+namespace pdhd {
+
+class CutFlowReport {
+  public:
+    explicit CutFlowReport(fhicl::ParameterSet const& pset) :
+      fModuleLabel(pset.get<std::string>("module_label", "")),
+      fJSONPath(pset.get<std::string>("CutFlowJSON", "")),
+      fWriteTree(pset.get<bool>("CutFlowTree", false)) {}
+
+    void write(CutFlow const& cutFlow) const {
+      const std::string json = cutFlow.json(fModuleLabel);
+      if (!fJSONPath.empty()) {
+        std::ofstream out(fJSONPath);
+        if (!(out << json)) {
+          throw cet::exception("PDHDCutFlow") << "Cannot write the cut flow of " << fModuleLabel << " to " << fJSONPath << ".\n";
+        }
+        mf::LogInfo("PDHDCutFlow") << "Cut flow of " << fModuleLabel << " written to " << fJSONPath;
+      }
+      if (fWriteTree) writeTrees(cutFlow);
+    }
+
+  private:
+    static void writeTrees(CutFlow const& cutFlow) {
+      art::ServiceHandle<art::TFileService> tfs;
+
+      std::string name;
+      ULong64_t count(0);
+      TTree *counters = tfs->make<TTree>("cutflow", "Cut-flow counters");
+      counters->Branch("name", &name);
+      counters->Branch("count", &count, "count/l");
+      for (CutFlow::id_t c = 0; c < cutFlow.nCounters(); c++) {
+        name = cutFlow.counterName(c);
+        count = cutFlow.counter(c);
+        counters->Fill();
+      }
+
+      double mean(0), p50(0), p90(0), p99(0), max(0);
+      TTree *latency = tfs->make<TTree>("latency", "Stage latencies (us)");
+      latency->Branch("stage", &name);
+      latency->Branch("n", &count, "n/l");
+      latency->Branch("mean", &mean, "mean/D");
+      latency->Branch("p50", &p50, "p50/D");
+      latency->Branch("p90", &p90, "p90/D");
+      latency->Branch("p99", &p99, "p99/D");
+      latency->Branch("max", &max, "max/D");
+      for (CutFlow::id_t s = 0; s < cutFlow.nStages(); s++) {
+        LatencyHistogram const& h = cutFlow.stage(s);
+        name = cutFlow.stageName(s);
+        count = h.count();
+        mean = h.meanNs() * 1e-3;
+        p50 = h.quantileNs(0.5) * 1e-3;
+        p90 = h.quantileNs(0.9) * 1e-3;
+        p99 = h.quantileNs(0.99) * 1e-3;
+        max = h.maxNs() * 1e-3;
+        latency->Fill();
+      }
+    }
+
+    std::string fModuleLabel;
+    std::string fJSONPath;
+    bool fWriteTree;
+};
+
+}
+
+#endif
@@ -0,0 +1,140 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       FilterDecisionCache
+//// File:        PDHDDecisionCache.h
+////
+//// Decision cache of a filter module (Algorithms/DecisionCache.h), off
+//// unless DecisionCacheDir is set. Decisions of real data events are
+//// stored per run in DecisionCacheDir and looked up by subrun, event
+//// and a hash of the module configuration, so a reprocessing with the
+//// same configuration returns them without running the filter. The
+//// hash leaves out the parameters that do not change the decision
+//// (printout, cut flow, diagnostics, threading, tag-only mode, the
+//// module label), so the cache survives changes to those. A module
+//// whose decision also depends on data of the run, the spill table of
+//// the spill stage, passes its checksum to beginRun and it goes into
+//// the key, so a regenerated table is not served stale decisions.
+//// DecisionCacheMode: "readwrite" (default), "read" to never write,
+//// "write" to decide every event again and replace what is stored.
+//// New decisions are written every DecisionCacheFlushEvery decisions
+//// (0: only at the end of the run), so a killed job keeps most of them.
+//// A module that writes more than its decision, the ROIs of
+//// PDHDROIOutput.h or the word of every stage of PDHDBSMSelection in
+//// tag-only mode, stores decisions but does not look them up.
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_PDHDDECISIONCACHE_H
+#define PDHDBSMDATA_PDHDDECISIONCACHE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "art/Framework/Principal/Event.h"
+#include "art/Framework/Principal/Run.h"
+#include "fhiclcpp/ParameterSet.h"
+#include "messagefacility/MessageLogger/MessageLogger.h"
+
+#include "pdhdbsmdata/Algorithms/DecisionCache.h"
+#include "pdhdbsmdata/Algorithms/SpillTableIO.h"
+
+namespace pdhd {
+
+class FilterDecisionCache {
+  public:
+    explicit FilterDecisionCache(fhicl::ParameterSet const& pset) :
+      fModuleLabel(pset.get<std::string>("module_label", "")),
+      fConfigHash(configHash(pset)),
+      fKeyHash(fConfigHash),
+      fFlushEvery(pset.get<std::size_t>("DecisionCacheFlushEvery", 1000)) {
+      const std::string directory = pset.get<std::string>("DecisionCacheDir", "");
+      if (!directory.empty()) {
+        fCache = std::make_unique<DecisionCache>(directory, parseDecisionCacheMode(pset.get<std::string>("DecisionCacheMode", "readwrite")));
+      }
+    }
+
+    bool enabled() const { return fCache != nullptr; }
+    uint64_t configHash() const { return fConfigHash; }
+
+    // Run transitions do not overlap with events. runChecksum: of the run data the decision
+    // depends on besides the configuration, 0 if none
+    void beginRun(art::Run const& run, uint64_t runChecksum = 0) {
+      fKeyHash = keyHash(fConfigHash, runChecksum);
+      if (!fCache) return;
+      std::string error;
+      fCache->open(run.run(), &error);
+      if (!error.empty()) {
+        mf::LogWarning("PDHDDecisionCache") << fModuleLabel << ": ignoring the decision cache of run " << run.run() << ": " << error;
+      }
+      else if (fCache->loaded() > 0) {
+        mf::LogInfo("PDHDDecisionCache") << fModuleLabel << ": " << fCache->loaded() << " cached decisions for run " << run.run();
+      }
+    }
+    void endRun() {
+      if (!fCache) return;
+      const std::size_t added = fAdded.exchange(0) + fCache->flush();
+      if (added > 0) mf::LogInfo("PDHDDecisionCache") << fModuleLabel << ": " << added << " decisions added to the cache";
+    }
+
+    // Simulated events are never cached, their event numbers are not unique
+    std::optional<bool> lookup(art::Event const& evt) const {
+      if (!fCache || !evt.isRealData()) return std::nullopt;
+      return fCache->lookup(key(evt));
+    }
+    void store(art::Event const& evt, bool pass) {
+      if (!fCache || !evt.isRealData()) return;
+      const std::size_t pending = fCache->store(key(evt), pass);
+      if (fFlushEvery > 0 && pending == fFlushEvery) fAdded += fCache->flush();
+    }
+
+    // FNV-1a 64 of the configuration, without the parameters that do not change the decision
+    static uint64_t configHash(fhicl::ParameterSet const& pset) {
+      const std::string text = decisionParameters(pset).to_string();
+      return fnv1a64(text.data(), text.size());
+    }
+    // Hash in the keys of a run
+    static uint64_t keyHash(uint64_t configHash, uint64_t runChecksum) {
+      return runChecksum == 0 ? configHash : fnv1a64(&runChecksum, sizeof(runChecksum), configHash);
+    }
+
+  private:
+    DecisionKey key(art::Event const& evt) const {
+      return DecisionKey{fKeyHash, evt.subRun(), evt.id().event()};
+    }
+
+    // Also applied to the tables of the stages of PDHDBSMSelection
+    static fhicl::ParameterSet decisionParameters(fhicl::ParameterSet pset) {
+      static const std::array<const char*, 12> kIgnored = {
+        "module_label", "Debug", "TypeHistogram", "ProduceSpillInfo", "CheckChannelMap", "TagOnly",
+        "ParallelTAs", "ParallelMinTAs", "AdaptiveOrder", "ReorderEvery", "ExploreEvery", "StatsDecay"};
+      static const std::array<const char*, 4> kIgnoredPrefixes = {
+        "DecisionCache", "Trace", "CutFlow", "Diagnostics"};
+
+      for (const std::string &name : pset.get_names()) {
+        bool ignored(false);
+        for (const char *ignore : kIgnored) ignored |= name == ignore;
+        for (const char *prefix : kIgnoredPrefixes) ignored |= name.rfind(prefix, 0) == 0;
+        if (ignored) {
+          pset.erase(name);
+        }
+        else if (pset.is_key_to_table(name)) {
+          pset.put_or_replace(name, decisionParameters(pset.get<fhicl::ParameterSet>(name)));
+        }
+      }
+      return pset;
+    }
+
+    std::string fModuleLabel;
+    uint64_t fConfigHash;
+    uint64_t fKeyHash; // fConfigHash and the checksum of the run
+    std::size_t fFlushEvery;
+    std::atomic<std::size_t> fAdded{0}; // By the flushes during the run
+    std::unique_ptr<DecisionCache> fCache;
+};
+
+}
+
+#endif
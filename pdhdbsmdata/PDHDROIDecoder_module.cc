@@ -0,0 +1,216 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       PDHDROIDecoder
+//// Plugin Type: producer
+//// File:        PDHDROIDecoder_module.cc
+////
+//// Producer that decodes the TPC waveforms of the trigger record only
+//// inside the pdhd::TPCROIs written by the TP-based filters
+//// (ProduceROIs), instead of every channel of every APA. The WIBEth
+//// sources with no channel in an ROI are not read from the file, and of
+//// the others only the frames overlapping an ROI are unpacked
+//// (Algorithms/WIBEthROIDecoder.h). Each channel in an ROI gets one
+//// raw::RawDigit, with a raw::RDTimeStamp of its first sample and their
+//// Assns, as written by tpcrawdecoder. TickWindow sets the ticks kept:
+//// "event" (default) gives every channel the span of all ROIs of the
+//// event, "roi" the window of its own ROIs and "readout" the whole
+//// readout window. With KeepReadoutStart (default) the digits start at
+//// the readout start all the same and only the ticks after the window
+//// are dropped, so tick numbers, and the drift times the signal
+//// processing takes from them, are those of tpcrawdecoder. Without it
+//// the digits start at the window and only their RDTimeStamp gives the
+//// offset, which the signal processing does not read. The filters give
+//// an event they pass without the ROIs of a TA the whole detector, so
+//// only rejected events, in tag-only jobs, get empty collections.
+//// Legacy module: the raw file is shared through HDF5RawFile3Service.
+//////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "art/Framework/Core/EDProducer.h"
+#include "art/Framework/Core/ModuleMacros.h"
+#include "art/Framework/Principal/Event.h"
+#include "art/Framework/Services/Registry/ServiceHandle.h"
+#include "art/Persistency/Common/PtrMaker.h"
+#include "canvas/Persistency/Common/Assns.h"
+#include "cetlib_except/exception.h"
+
+#include "daqdataformats/Fragment.hpp"
+#include "dunecore/ChannelMap/PD2HDChannelMapService.h"
+#include "dunecore/DuneObj/DUNEHDF5FileInfo2.h"
+#include "dunecore/HDF5Utils/HDF5RawFile3Service.h"
+#include "hdf5libs/HDF5RawDataFile.hpp"
+#include "lardataobj/RawData/RawDigit.h"
+#include "lardataobj/RawData/RDTimeStamp.h"
+
+#include "pdhdbsmdata/Algorithms/CutFlow.h"
+#include "pdhdbsmdata/Algorithms/TPCROIs.h"
+#include "pdhdbsmdata/Algorithms/WIBEthROIDecoder.h"
+#include "pdhdbsmdata/DataProducts/TPCROI.h"
+#include "pdhdbsmdata/PDHDCutFlow.h"
+#include "pdhdbsmdata/PDHDTrace.h"
+
+namespace pdhd {
+
+//-------------------------------------
+class PDHDROIDecoder : public art::EDProducer {
+  public:
+    explicit PDHDROIDecoder(fhicl::ParameterSet const & pset);
+    virtual ~PDHDROIDecoder() {};
+    void produce(art::Event& e) override;
+    void endJob() override;
+
+  private:
+    void decode(art::Event & evt);
+
+    std::string fInputLabel;    // Label of the raw::DUNEHDF5FileInfo2 of the HDF5 source
+    std::vector<std::string> fInputTagsROI;
+    std::string fOutputInstance;
+    ROITickMode fTickWindow;
+    bool fKeepReadoutStart;
+    Tracer fTrace;
+
+    CutFlow fCutFlow;
+    CutFlowReport fCutFlowReport;
+    struct {
+      CutFlow::id_t events, eventsNoROIs, sourcesRead, sourcesSkipped, frames, channels, samples;
+    } fCount;
+    struct {
+      CutFlow::id_t event;
+    } fStage;
+};
+
+//-------------------------------------
+PDHDROIDecoder::PDHDROIDecoder(fhicl::ParameterSet const & pset) :
+  EDProducer(pset),
+  fInputLabel(pset.get<std::string>("InputLabel", "daq")),
+  fInputTagsROI(pset.get<std::vector<std::string>>("InputTagsROI")),
+  fOutputInstance(pset.get<std::string>("OutputInstance", "daq")),
+  fTickWindow(parseROITickMode(pset.get<std::string>("TickWindow", "event"))),
+  fKeepReadoutStart(pset.get<bool>("KeepReadoutStart", true)),
+  fTrace(pset, "PDHDROIDecoder"),
+  fCutFlowReport(pset) {
+
+  fCount.events = fCutFlow.addCounter("events_seen");
+  fCount.eventsNoROIs = fCutFlow.addCounter("events_no_rois");
+  fCount.sourcesRead = fCutFlow.addCounter("wibeth_sources_read");
+  fCount.sourcesSkipped = fCutFlow.addCounter("wibeth_sources_skipped");
+  fCount.frames = fCutFlow.addCounter("frames_unpacked");
+  fCount.channels = fCutFlow.addCounter("channels_decoded");
+  fCount.samples = fCutFlow.addCounter("samples_decoded");
+  fStage.event = fCutFlow.addStage("event");
+
+  consumes<raw::DUNEHDF5FileInfo2>(fInputLabel);
+  for (const auto &tag : fInputTagsROI) consumes<std::vector<TPCROI>>(tag);
+  produces<std::vector<raw::RawDigit>>(fOutputInstance);
+  produces<std::vector<raw::RDTimeStamp>>(fOutputInstance);
+  produces<art::Assns<raw::RawDigit, raw::RDTimeStamp>>(fOutputInstance);
+}
+
+//-------------------------------------
+void PDHDROIDecoder::produce(art::Event & evt) {
+  const auto timer = fCutFlow.time(fStage.event);
+  fTrace.traced([&] { decode(evt); });
+  fCutFlow.count(fCount.events);
+}
+
+//-------------------------------------
+void PDHDROIDecoder::decode(art::Event & evt) {
+  using dunedaq::daqdataformats::FragmentHeader;
+  using dunedaq::daqdataformats::FragmentType;
+
+  std::vector<TPCROI> rois;
+  for (const auto &tag : fInputTagsROI) {
+    std::vector<TPCROI> const& input = *evt.getValidHandle<std::vector<TPCROI>>(tag);
+    rois.insert(rois.end(), input.begin(), input.end());
+  }
+  ROIChannelWindows windows(rois, fTickWindow);
+  if (fKeepReadoutStart) windows.keepReadoutStart();
+
+  std::vector<ChannelWaveform> waveforms;
+  size_t nSources(0), nRead(0);
+  if (windows.empty()) {
+    fCutFlow.count(fCount.eventsNoROIs);
+  } else {
+    auto fileInfo = evt.getValidHandle<raw::DUNEHDF5FileInfo2>(fInputLabel);
+    const dunedaq::hdf5libs::HDF5RawDataFile::record_id_t recordID = std::make_pair(fileInfo->GetEvent(), fileInfo->GetSequence());
+    auto &rawFile = art::ServiceHandle<dune::HDF5RawFile3Service>()->GetPtr();
+    art::ServiceHandle<dune::PD2HDChannelMapService> channelMap;
+
+    for (const auto &sourceID : rawFile->get_source_ids_for_fragment_type(recordID, FragmentType::kWIBEth)) {
+      nSources++;
+      // The channels of the stream come from its geo ID, so the fragment is only read if one is in an ROI
+      const auto geoIDs = rawFile->get_geo_ids_for_source_id(recordID, sourceID);
+      if (geoIDs.empty()) continue;
+      const uint64_t geoID = *geoIDs.begin();
+      const unsigned crate = (geoID >> 16) & 0xFFFF;
+      const unsigned slot = (geoID >> 32) & 0xFFFF;
+      const unsigned stream = (geoID >> 48) & 0xFFFF;
+      const unsigned link = (stream >> 6) & 0x1;
+
+      WIBEthStreamWindows streamWindows;
+      for (size_t ch = 0; ch < kWIBEthChannels; ch++) {
+        const auto info = channelMap->GetChanInfoFromWIBElements(crate, slot, link, (stream & 0x3) * kWIBEthChannels + ch);
+        if (info.valid) streamWindows.set(ch, info.offlchan, windows);
+      }
+      if (streamWindows.empty()) {
+        fCutFlow.count(fCount.sourcesSkipped);
+        continue;
+      }
+
+      auto fragment = rawFile->get_frag_ptr(recordID, sourceID);
+      if (fragment->get_size() < sizeof(FragmentHeader)) {
+        throw cet::exception("PDHDROIDecoder") << "WIBEth fragment " << sourceID.to_string() << " of trigger record "
+          << recordID.first << "." << recordID.second << " is shorter than its header.\n";
+      }
+      const size_t nFrames = decodeWIBEthFragment(fragment->get_data(), fragment->get_size() - sizeof(FragmentHeader), streamWindows, waveforms);
+      PDHD_TRACE(fTrace, TraceLevel::kDebug) << "Fragment " << sourceID.to_string() << ": " << nFrames << " frames unpacked";
+      fCutFlow.count(fCount.sourcesRead);
+      fCutFlow.count(fCount.frames, nFrames);
+      nRead++;
+    }
+  }
+
+  // A channel whose window is outside the readout window has no samples
+  waveforms.erase(std::remove_if(waveforms.begin(), waveforms.end(), [] (ChannelWaveform const& waveform) {
+    return waveform.adcs.empty();
+  }), waveforms.end());
+  std::sort(waveforms.begin(), waveforms.end(), [] (ChannelWaveform const& a, ChannelWaveform const& b) {
+    return a.channel < b.channel;
+  });
+
+  auto digits = std::make_unique<std::vector<raw::RawDigit>>();
+  auto timestamps = std::make_unique<std::vector<raw::RDTimeStamp>>();
+  auto assns = std::make_unique<art::Assns<raw::RawDigit, raw::RDTimeStamp>>();
+  const art::PtrMaker<raw::RawDigit> digitPtr(evt, fOutputInstance);
+  const art::PtrMaker<raw::RDTimeStamp> timestampPtr(evt, fOutputInstance);
+  digits->reserve(waveforms.size());
+  timestamps->reserve(waveforms.size());
+  size_t nSamples(0);
+  for (auto &waveform : waveforms) {
+    nSamples += waveform.adcs.size();
+    const size_t samples = waveform.adcs.size();
+    digits->emplace_back(waveform.channel, samples, std::move(waveform.adcs), raw::kNone);
+    timestamps->emplace_back(waveform.timestamp);
+    assns->addSingle(digitPtr(digits->size() - 1), timestampPtr(timestamps->size() - 1));
+  }
+
+  PDHD_TRACE(fTrace, TraceLevel::kInfo) << "PDHDROIDecoder: " << digits->size() << " channels, " << nSamples << " samples from "
+    << nRead << " of " << nSources << " WIBEth sources for Event " << evt.id().event() << " in Run " << evt.run();
+  fCutFlow.count(fCount.channels, digits->size());
+  fCutFlow.count(fCount.samples, nSamples);
+  evt.put(std::move(digits), fOutputInstance);
+  evt.put(std::move(timestamps), fOutputInstance);
+  evt.put(std::move(assns), fOutputInstance);
+}
+
+//-------------------------------------
+void PDHDROIDecoder::endJob() {
+  fCutFlowReport.write(fCutFlow);
+}
+
+DEFINE_ART_MODULE(PDHDROIDecoder)
+
+}
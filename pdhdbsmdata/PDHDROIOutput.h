@@ -0,0 +1,51 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       ROIOutput
+//// File:        PDHDROIOutput.h
+////
+//// Region-of-interest output of a TP-based filter, off unless
+//// ProduceROIs is set. The filter writes the pdhd::TPCROIs of the TAs
+//// that passed the event (Algorithms/TPCROIs.h) for PDHDROIDecoder and
+//// PDHDRawDigitSlimmer: the whole detector if the event passed without
+//// any, an empty vector if it was rejected. The module declares the
+//// product if produce(). The ROIs need the TAs, so the decision cache
+//// is not read while they are produced.
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_PDHDROIOUTPUT_H
+#define PDHDBSMDATA_PDHDROIOUTPUT_H
+
+#include <memory>
+#include <vector>
+
+#include "art/Framework/Principal/Event.h"
+#include "fhiclcpp/ParameterSet.h"
+
+#include "pdhdbsmdata/Algorithms/TPCROIs.h"
+#include "pdhdbsmdata/DataProducts/TPCROI.h"
+
+namespace pdhd {
+
+class ROIOutput {
+  public:
+    explicit ROIOutput(fhicl::ParameterSet const& pset) :
+      fProduce(pset.get<bool>("ProduceROIs", false)),
+      fPadding{pset.get<uint32_t>("ROIChannelPadding", 20), pset.get<uint64_t>("ROITickPadding", 3200),
+               pset.get<bool>("ROIInductionPlanes", true)} {}
+
+    bool produce() const { return fProduce; }
+    ROIPadding const& padding() const { return fPadding; }
+
+    void put(art::Event& evt, bool pass, std::vector<TPCROI>&& rois) const {
+      if (!fProduce) return;
+      completeEventROIs(pass, rois);
+      evt.put(std::make_unique<std::vector<TPCROI>>(std::move(rois)));
+    }
+
+  private:
+    bool fProduce;
+    ROIPadding fPadding;
+};
+
+}
+
+#endif
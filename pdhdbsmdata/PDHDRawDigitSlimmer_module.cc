@@ -0,0 +1,177 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       PDHDRawDigitSlimmer
+//// Plugin Type: producer
+//// File:        PDHDRawDigitSlimmer_module.cc
+////
+//// Producer that copies the raw::RawDigits of a full TPC decoding into
+//// a slimmed collection holding only the channels and ticks of the
+//// pdhd::TPCROIs written by the TP-based filters (ProduceROIs), padded
+//// by TickPadding on each side. Each kept digit gets a raw::RDTimeStamp
+//// of its first kept sample and their Assns, as the input, so the
+//// output can drop the full collection. TickWindow sets the ticks kept
+//// as in PDHDROIDecoder. The signal processing counts ticks from the
+//// first sample and ignores the RDTimeStamp, so with KeepReadoutStart
+//// (the default) the digits keep the samples from the first one of the
+//// input and only those after the window are dropped; the timestamps
+//// are then those of the input. An event the filters passed without
+//// the ROIs of a TA has the whole detector and is copied in full;
+//// events without ROIs get empty collections. Stateless shared module.
+//////////////////////////////////////////////////////////////////////////
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "art/Framework/Core/ModuleMacros.h"
+#include "art/Framework/Core/SharedProducer.h"
+#include "art/Framework/Principal/Event.h"
+#include "art/Persistency/Common/PtrMaker.h"
+#include "canvas/Persistency/Common/Assns.h"
+#include "canvas/Persistency/Common/FindOneP.h"
+#include "cetlib_except/exception.h"
+
+#include "lardataobj/RawData/RawDigit.h"
+#include "lardataobj/RawData/RDTimeStamp.h"
+#include "lardataobj/RawData/raw.h"
+
+#include "pdhdbsmdata/Algorithms/CutFlow.h"
+#include "pdhdbsmdata/Algorithms/TPCROIs.h"
+#include "pdhdbsmdata/DataProducts/TPCROI.h"
+#include "pdhdbsmdata/PDHDCutFlow.h"
+#include "pdhdbsmdata/PDHDTrace.h"
+
+namespace pdhd {
+
+//-------------------------------------
+class PDHDRawDigitSlimmer : public art::SharedProducer {
+  public:
+    explicit PDHDRawDigitSlimmer(fhicl::ParameterSet const & pset, art::ProcessingFrame const & frame);
+    virtual ~PDHDRawDigitSlimmer() {};
+    void produce(art::Event& e, art::ProcessingFrame const & frame) override;
+    void endJob(art::ProcessingFrame const & frame) override;
+
+  private:
+    void slim(art::Event & evt) const;
+
+    std::string fInputTagRawDigits; // Digits with their Assns to the RDTimeStamps, e.g. "tpcrawdecoder:daq"
+    std::vector<std::string> fInputTagsROI;
+    std::string fOutputInstance;
+    ROITickMode fTickWindow;
+    uint64_t fTickPadding;
+    bool fKeepReadoutStart; // Keep the samples before the window, for the tick origin of the signal processing
+    Tracer fTrace;
+
+    mutable CutFlow fCutFlow;
+    CutFlowReport fCutFlowReport;
+    struct {
+      CutFlow::id_t events, eventsNoROIs, channelsIn, channelsKept, samplesIn, samplesKept;
+    } fCount;
+    struct {
+      CutFlow::id_t event;
+    } fStage;
+};
+
+//-------------------------------------
+PDHDRawDigitSlimmer::PDHDRawDigitSlimmer(fhicl::ParameterSet const & pset, art::ProcessingFrame const &) :
+  SharedProducer(pset),
+  fInputTagRawDigits(pset.get<std::string>("InputTagRawDigits")),
+  fInputTagsROI(pset.get<std::vector<std::string>>("InputTagsROI")),
+  fOutputInstance(pset.get<std::string>("OutputInstance", "daq")),
+  fTickWindow(parseROITickMode(pset.get<std::string>("TickWindow", "event"))),
+  fTickPadding(pset.get<uint64_t>("TickPadding", 0)),
+  fKeepReadoutStart(pset.get<bool>("KeepReadoutStart", true)),
+  fTrace(pset, "PDHDRawDigitSlimmer"),
+  fCutFlowReport(pset) {
+
+  fCount.events = fCutFlow.addCounter("events_seen");
+  fCount.eventsNoROIs = fCutFlow.addCounter("events_no_rois");
+  fCount.channelsIn = fCutFlow.addCounter("channels_in");
+  fCount.channelsKept = fCutFlow.addCounter("channels_kept");
+  fCount.samplesIn = fCutFlow.addCounter("samples_in");
+  fCount.samplesKept = fCutFlow.addCounter("samples_kept");
+  fStage.event = fCutFlow.addStage("event");
+
+  consumes<std::vector<raw::RawDigit>>(fInputTagRawDigits);
+  consumes<art::Assns<raw::RawDigit, raw::RDTimeStamp>>(fInputTagRawDigits);
+  for (const auto &tag : fInputTagsROI) consumes<std::vector<TPCROI>>(tag);
+  produces<std::vector<raw::RawDigit>>(fOutputInstance);
+  produces<std::vector<raw::RDTimeStamp>>(fOutputInstance);
+  produces<art::Assns<raw::RawDigit, raw::RDTimeStamp>>(fOutputInstance);
+  async<art::InEvent>();
+}
+
+//-------------------------------------
+void PDHDRawDigitSlimmer::produce(art::Event & evt, art::ProcessingFrame const &) {
+  const auto timer = fCutFlow.time(fStage.event);
+  fTrace.traced([&] { slim(evt); });
+  fCutFlow.count(fCount.events);
+}
+
+//-------------------------------------
+void PDHDRawDigitSlimmer::endJob(art::ProcessingFrame const &) {
+  fCutFlowReport.write(fCutFlow);
+}
+
+//-------------------------------------
+void PDHDRawDigitSlimmer::slim(art::Event & evt) const {
+  std::vector<TPCROI> rois;
+  for (const auto &tag : fInputTagsROI) {
+    std::vector<TPCROI> const& input = *evt.getValidHandle<std::vector<TPCROI>>(tag);
+    rois.insert(rois.end(), input.begin(), input.end());
+  }
+  ROIChannelWindows windows(rois, fTickWindow, fTickPadding);
+  if (fKeepReadoutStart) windows.keepReadoutStart();
+
+  auto digits = std::make_unique<std::vector<raw::RawDigit>>();
+  auto timestamps = std::make_unique<std::vector<raw::RDTimeStamp>>();
+  auto assns = std::make_unique<art::Assns<raw::RawDigit, raw::RDTimeStamp>>();
+  const art::PtrMaker<raw::RawDigit> digitPtr(evt, fOutputInstance);
+  const art::PtrMaker<raw::RDTimeStamp> timestampPtr(evt, fOutputInstance);
+
+  auto digitHandle = evt.getValidHandle<std::vector<raw::RawDigit>>(fInputTagRawDigits);
+  size_t nSamplesIn(0), nSamplesKept(0);
+  if (windows.empty()) {
+    fCutFlow.count(fCount.eventsNoROIs);
+  } else {
+    const art::FindOneP<raw::RDTimeStamp> findTimestamps(digitHandle, evt, fInputTagRawDigits);
+    raw::RawDigit::ADCvector_t adcs;
+    for (size_t d = 0; d < digitHandle->size(); d++) {
+      const raw::RawDigit &digit = (*digitHandle)[d];
+      nSamplesIn += digit.Samples();
+      const TickWindow &window = windows.window(digit.Channel());
+      if (window.empty()) continue;
+
+      const art::Ptr<raw::RDTimeStamp> &timestamp = findTimestamps.at(d);
+      if (timestamp.isNull()) {
+        throw cet::exception("PDHDRawDigitSlimmer") << "RawDigit of channel " << digit.Channel() << " in " << fInputTagRawDigits
+          << " has no RDTimeStamp, so its ticks cannot be matched to the ROIs.\n";
+      }
+      const SampleRange samples = samplesInWindow(timestamp->GetTimeStamp(), digit.Samples(), window);
+      if (samples.count == 0) continue;
+
+      adcs.resize(digit.Samples());
+      raw::Uncompress(digit.ADCs(), adcs, digit.GetPedestal(), digit.Compression());
+      digits->emplace_back(digit.Channel(), samples.count,
+                           raw::RawDigit::ADCvector_t(adcs.begin() + samples.first, adcs.begin() + samples.first + samples.count),
+                           raw::kNone);
+      digits->back().SetPedestal(digit.GetPedestal(), digit.GetSigma());
+      timestamps->emplace_back(timestamp->GetTimeStamp() + samples.first * kTicksPerSample, timestamp->GetFlags());
+      assns->addSingle(digitPtr(digits->size() - 1), timestampPtr(timestamps->size() - 1));
+      nSamplesKept += samples.count;
+    }
+  }
+
+  PDHD_TRACE(fTrace, TraceLevel::kInfo) << "PDHDRawDigitSlimmer: kept " << digits->size() << " of " << digitHandle->size() << " channels, "
+    << nSamplesKept << " of " << nSamplesIn << " samples for Event " << evt.id().event() << " in Run " << evt.run();
+  fCutFlow.count(fCount.channelsIn, digitHandle->size());
+  fCutFlow.count(fCount.channelsKept, digits->size());
+  fCutFlow.count(fCount.samplesIn, nSamplesIn);
+  fCutFlow.count(fCount.samplesKept, nSamplesKept);
+  evt.put(std::move(digits), fOutputInstance);
+  evt.put(std::move(timestamps), fOutputInstance);
+  evt.put(std::move(assns), fOutputInstance);
+}
+
+DEFINE_ART_MODULE(PDHDRawDigitSlimmer)
+
+}
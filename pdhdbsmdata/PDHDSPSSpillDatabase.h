@@ -0,0 +1,61 @@
+////////////////////////////////////////////////////////////////////////////////////////////////
+//// Class:       PDHDSPSSpillDatabase
+//// Plugin Type: service
+//// File:        PDHDSPSSpillDatabase.h
+//// Description: Process-wide store of the SPS spill tables. The spill data directory is
+////              indexed once at construction (spillrunNNNNNN.csv -> run NNNNNN) and the
+////              table of a run is loaded the first time it is requested. Every module and
+////              every run then shares the same immutable SpillTimeline.
+////              If a spillrunNNNNNN.spillbin cache (made with pdhd_spillcsv2bin) is present
+////              it is memory-mapped instead of parsing the .csv.
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_PDHDSPSSPILLDATABASE_H
+#define PDHDBSMDATA_PDHDSPSSPILLDATABASE_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "art/Framework/Services/Registry/ServiceDeclarationMacros.h"
+#include "canvas/Persistency/Provenance/RunID.h"
+#include "fhiclcpp/ParameterSet.h"
+
+#include "pdhdbsmdata/Algorithms/SpillDataDirectory.h"
+#include "pdhdbsmdata/Algorithms/SpillTimeline.h"
+
+namespace pdhd {
+
+class PDHDSPSSpillDatabase {
+  public:
+    explicit PDHDSPSSpillDatabase(fhicl::ParameterSet const & pset);
+
+    // Spill table of the run, or nullptr if there is no spill file for it.
+    // Thread safe; the table is parsed on the first request only.
+    std::shared_ptr<SpillTimeline const> findRun(art::RunNumber_t run) const;
+    // As findRun, but throws cet::exception if the run is not in the database
+    std::shared_ptr<SpillTimeline const> getRun(art::RunNumber_t run) const;
+    // Hash of the service configuration and the spill table of the run, 0 without a table.
+    // Part of the decision cache key of the filters that read the table.
+    uint64_t checksum(art::RunNumber_t run) const;
+
+    bool hasRun(art::RunNumber_t run) const { return fDirectory.hasRun(run); }
+    std::vector<art::RunNumber_t> runs() const { return fDirectory.runs(); }
+
+  private:
+    uint64_t fConfigHash;
+    bool fVerifyCacheSource; // Check the .spillbin checksum against the .csv before using it, not only the size
+    SpillDataDirectory fDirectory; // Run number to spill files, filled once
+
+    mutable std::mutex fCacheMutex;
+    mutable std::map<art::RunNumber_t, std::shared_ptr<SpillTimeline const>> fCache;
+};
+
+}
+
+DECLARE_ART_SERVICE(pdhd::PDHDSPSSpillDatabase, SHARED)
+
+#endif
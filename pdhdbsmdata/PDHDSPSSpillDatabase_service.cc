@@ -0,0 +1,75 @@
+////////////////////////////////////////////////////////////////////////////////////////////////
+//// Class:       PDHDSPSSpillDatabase
+//// Plugin Type: service
+//// File:        PDHDSPSSpillDatabase_service.cc
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "pdhdbsmdata/PDHDSPSSpillDatabase.h"
+
+#include "art/Framework/Services/Registry/ServiceDefinitionMacros.h"
+#include "cetlib_except/exception.h"
+#include "messagefacility/MessageLogger/MessageLogger.h"
+
+#include "pdhdbsmdata/Algorithms/SpillTableIO.h"
+
+namespace pdhd {
+
+namespace {
+
+  uint64_t hashParameters(fhicl::ParameterSet const& pset) {
+    const std::string text = pset.to_string();
+    return fnv1a64(text.data(), text.size());
+  }
+
+}
+
+//-------------------------------------
+PDHDSPSSpillDatabase::PDHDSPSSpillDatabase(fhicl::ParameterSet const & pset) :
+  fConfigHash(hashParameters(pset)),
+  fVerifyCacheSource(pset.get<bool>("VerifyCacheSource", true)),
+  fDirectory(pset.get<std::string>("SpillDataDir"),
+             pset.get<std::string>("FilePrefix", "spillrun"),
+             pset.get<bool>("UseBinaryCache", true)) {
+
+  mf::LogInfo("PDHDSPSSpillDatabase") << "Found SPS spill data for " << fDirectory.runs().size() << " runs in " << fDirectory.path();
+}
+
+//-------------------------------------
+std::shared_ptr<SpillTimeline const> PDHDSPSSpillDatabase::findRun(art::RunNumber_t run) const {
+  const SpillDataDirectory::Files *files = fDirectory.files(run);
+  if (!files) return nullptr;
+
+  std::lock_guard<std::mutex> lock(fCacheMutex);
+  auto &timeline = fCache[run];
+  if (!timeline) {
+    std::string cacheError;
+    timeline = std::make_shared<SpillTimeline const>(fDirectory.load(run, fVerifyCacheSource, &cacheError));
+    if (!cacheError.empty()) {
+      mf::LogWarning("PDHDSPSSpillDatabase") << "Ignoring the spill cache " << files->bin << ", reading " << files->csv << ": " << cacheError;
+    }
+    mf::LogInfo("PDHDSPSSpillDatabase") << "For run " << run << " there are " << timeline->size() << " SPS beam spills in "
+      << (files->bin.empty() || !cacheError.empty() ? files->csv : files->bin);
+  }
+  return timeline;
+}
+
+//-------------------------------------
+std::shared_ptr<SpillTimeline const> PDHDSPSSpillDatabase::getRun(art::RunNumber_t run) const {
+  auto timeline = findRun(run);
+  if (!timeline) {
+    throw cet::exception("PDHDSPSSpillDatabase") << "No SPS spill data for run " << run << " in " << fDirectory.path() << "\n";
+  }
+  return timeline;
+}
+
+//-------------------------------------
+uint64_t PDHDSPSSpillDatabase::checksum(art::RunNumber_t run) const {
+  const auto timeline = findRun(run);
+  if (!timeline) return 0;
+  const uint64_t table[2] = {spillTimelineChecksum(*timeline), timeline->duration()};
+  return fnv1a64(table, sizeof(table), fConfigHash);
+}
+
+}
+
+DEFINE_ART_SERVICE(pdhd::PDHDSPSSpillDatabase)
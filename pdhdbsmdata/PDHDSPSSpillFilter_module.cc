@@ -8,145 +8,232 @@
 ////              and select events that occured when the beam was ON or OFF. 
 ////              The user decides if they want ON or OFF spill events, 
 ////              as well as the PoT threshold.
+////              The spill tables come from the PDHDSPSSpillDatabase service.
 ////////////////////////////////////////////////////////////////////////////////////////////////
 
-#include <iostream>
-#include <fstream>
-#include <sstream>
 #include <vector>
 #include <string>
-#include <stdexcept>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
 
 #include "lardataobj/RawData/RawDigit.h"
 #include "lardataobj/RawData/RDTimeStamp.h"
 
-#include "art/Framework/Core/EDFilter.h" 
 #include "art/Framework/Core/ModuleMacros.h" 
+#include "art/Framework/Core/SharedFilter.h" 
 #include "art/Framework/Principal/Event.h" 
+#include "art/Framework/Principal/Run.h" 
+#include "art/Framework/Principal/SubRun.h" 
+#include "art/Framework/Services/Registry/ServiceHandle.h"
+#include "art/Utilities/Globals.h"
 #include "art_root_io/TFileService.h"
+#include "cetlib_except/exception.h"
+#include "messagefacility/MessageLogger/MessageLogger.h"
 
 #include "detdataformats/trigger/Types.hpp"
 
+#include "pdhdbsmdata/PDHDSPSSpillDatabase.h"
+#include "pdhdbsmdata/DataProducts/SpillInfo.h"
+#include "pdhdbsmdata/Algorithms/SpillSelector.h"
+#include "pdhdbsmdata/Algorithms/SpillTimeline.h"
+#include "pdhdbsmdata/Algorithms/CutFlow.h"
+#include "pdhdbsmdata/PDHDCutFlow.h"
+#include "pdhdbsmdata/PDHDSelectionTag.h"
+#include "pdhdbsmdata/PDHDTrace.h"
+
 namespace pdhd {
 
 using timestamp_t = dunedaq::trgdataformats::timestamp_t;
 
-class PDHDSPSSpillFilter : public art::EDFilter {
+class PDHDSPSSpillFilter : public art::SharedFilter {
 public:
-    explicit PDHDSPSSpillFilter(fhicl::ParameterSet const & pset);
+    explicit PDHDSPSSpillFilter(fhicl::ParameterSet const & pset, art::ProcessingFrame const & frame);
     virtual ~PDHDSPSSpillFilter() = default;
-    bool filter(art::Event& e) override;
-    void beginJob() override;
+    bool filter(art::Event& e, art::ProcessingFrame const & frame) override;
+    bool beginRun(art::Run& r, art::ProcessingFrame const & frame) override;
+    bool beginSubRun(art::SubRun& sr, art::ProcessingFrame const & frame) override;
+    bool endSubRun(art::SubRun& sr, art::ProcessingFrame const & frame) override;
+    void endJob(art::ProcessingFrame const & frame) override;
 
 private:
-    int fRun;
-    int fSubRun;
-    unsigned int fEventID;
-    uint64_t fEventTimeStamp; // Timestamp from art::Event object
+    bool selectEvent(art::Event & evt, art::ProcessingFrame const & frame);
 
     std::string fInputLabel;
-    std::string fSPSBeamData; // Name and path of input csv file for SPS beam data
-    std::ifstream fInputData;
     bool fSpillOn; // To filter for spill ON or OFF. It is set to true by default
     uint64_t fPoT_threshold;
+    bool fProduceSpillInfo; // Write SpillInfo per event and SpillSummary per SubRun
+    SpillSelector fSelector; // Spill ON/OFF decision, shared with the HDF5 prescan tool
     
-    std::vector<std::pair<timestamp_t, uint64_t>> vSpillClockPoT; // Vector to store the spill clock times and PoT values
+    std::mutex fSummaryMutex; // Guards the three members below, filled by all schedules
+    SpillSummary fSummary; // Accumulated over the current SubRun
+    std::unordered_set<std::size_t> fSpillsOn; // Spills already counted in fSummary
+    std::unordered_set<std::size_t> fSpillsAccepted;
+
+    std::shared_ptr<SpillTimeline const> fSpillTimeline; // Spill table of the current run, shared through the service
+    // One per schedule: the events of a schedule arrive in time order, so keep its last position
+    std::vector<std::unique_ptr<SpillTimeline::Cursor>> fSpillCursors;
+    // Options common to the filters, see the header of each class
+    Tracer fTrace;
+    SelectionTag fTag;
+
+    CutFlow fCutFlow;
+    CutFlowReport fCutFlowReport;
+    struct {
+        CutFlow::id_t eventsSeen, eventsPassed, eventsFailed, notRealData, spillOn, spillOff;
+    } fCount;
+    struct {
+        CutFlow::id_t event, spillLookup;
+    } fStage;
 };
 
 // Constructor of the class PDHDSPSSpillFilter
-PDHDSPSSpillFilter::PDHDSPSSpillFilter(fhicl::ParameterSet const & pset)
-    : EDFilter(pset), 
+PDHDSPSSpillFilter::PDHDSPSSpillFilter(fhicl::ParameterSet const & pset, art::ProcessingFrame const &)
+    : SharedFilter(pset), 
       fInputLabel(pset.get<std::string>("InputTag")), 
-      fSPSBeamData(pset.get<std::string>("sps_beamdata")),
       fSpillOn(pset.get<bool>("spill_on", true)),
-      fPoT_threshold(pset.get<uint64_t>("PoT_threshold")){}
-
-// Filter events according to SPS beam spill data
-bool PDHDSPSSpillFilter::filter(art::Event & evt) {
-    // Filter designed for Data only. Do not want to filter on MC
-    if (!evt.isRealData()) {
-        return true;
+      fPoT_threshold(pset.get<uint64_t>("PoT_threshold")),
+      fProduceSpillInfo(pset.get<bool>("ProduceSpillInfo", false)),
+      fSelector(fSpillOn, fPoT_threshold),
+      fSpillCursors(art::Globals::instance()->nschedules()),
+      fTrace(pset, "PDHDSPSSpillFilter"),
+      fTag(pset),
+      fCutFlowReport(pset) {
+
+    fCount.eventsSeen = fCutFlow.addCounter("events_seen");
+    fCount.eventsPassed = fCutFlow.addCounter("events_passed");
+    fCount.eventsFailed = fCutFlow.addCounter("events_failed");
+    fCount.notRealData = fCutFlow.addCounter("events_passed_not_real_data");
+    fCount.spillOn = fCutFlow.addCounter("events_spill_on");
+    fCount.spillOff = fCutFlow.addCounter("events_spill_off");
+    fStage.event = fCutFlow.addStage("event");
+    fStage.spillLookup = fCutFlow.addStage("spill_lookup");
+
+    if (fProduceSpillInfo) {
+        produces<SpillInfo>();
+        produces<SpillSummary, art::InSubRun>();
     }
+    if (fTag.tagOnly()) produces<SelectionWord>();
+    async<art::InEvent>();
+}
 
-    fRun = evt.run();
-    fSubRun = evt.subRun();
-    fEventID = evt.id().event();
-
-    std::cout << "###PDHDSPSSpillFilter###\n"
-              << "START PDHDSPSSpillFilter for Event " << fEventID << " in Run " << fRun << "\n\n";
+// Pick up the spill table of the new run. Runs without SPS data are only an error if a data event needs them
+// Run and SubRun transitions do not overlap with events, so the members can be reset here without a lock
+bool PDHDSPSSpillFilter::beginRun(art::Run & run, art::ProcessingFrame const &) {
+    fSpillTimeline = art::ServiceHandle<PDHDSPSSpillDatabase const>()->findRun(run.run());
+    for (auto &cursor : fSpillCursors) {
+        cursor.reset();
+        if (fSpillTimeline) {
+            cursor = std::make_unique<SpillTimeline::Cursor>(*fSpillTimeline);
+        }
+    }
+    return true;
+}
 
-    uint64_t timeHigh_ns = evt.time().timeHigh() * 1e9;
-    uint64_t timeLow_ns = evt.time().timeLow();
-    fEventTimeStamp = (timeHigh_ns + timeLow_ns) * 1e-6;
+bool PDHDSPSSpillFilter::beginSubRun(art::SubRun &, art::ProcessingFrame const &) {
+    fSummary = SpillSummary();
+    fSpillsOn.clear();
+    fSpillsAccepted.clear();
+    return true;
+}
 
-    std::cout << "Event " << fEventID << ", Timestamp = " << fEventTimeStamp << " ms\n";
+bool PDHDSPSSpillFilter::endSubRun(art::SubRun & sr, art::ProcessingFrame const &) {
+    if (fProduceSpillInfo) {
+        mf::LogInfo("PDHDSPSSpillFilter") << "Run " << sr.run() << " SubRun " << sr.subRun() << ": "
+                  << fSummary.events_accepted << " of " << fSummary.events_seen << " events accepted, "
+                  << fSummary.pot_accepted << " PoT in " << fSummary.spills_accepted << " accepted spills";
+        sr.put(std::make_unique<SpillSummary>(fSummary), art::subRunFragment());
+    }
+    return true;
+}
 
-    bool filter_pass = false;
+bool PDHDSPSSpillFilter::filter(art::Event & evt, art::ProcessingFrame const & frame) {
+    const auto timer = fCutFlow.time(fStage.event);
+    const bool pass = fTrace.traced([&] { return selectEvent(evt, frame); });
+    fCutFlow.count(fCount.eventsSeen);
+    fCutFlow.count(pass ? fCount.eventsPassed : fCount.eventsFailed);
+    return fTag.put(evt, SelectionCut::kSpill, pass);
+}
 
-    for (size_t spill = 0; spill < vSpillClockPoT.size(); ++spill) {
-        if (vSpillClockPoT[spill].first > fEventTimeStamp) {
-            timestamp_t spill_end = vSpillClockPoT[spill - 1].first + 4785; // 4785 ms is the duration of a spill
-            if (fEventTimeStamp < spill_end) {
-                std::cout << "Spill ON\n";
-                filter_pass = fSpillOn;
-            } else {
-                std::cout << "Spill OFF\n";
-                filter_pass = !fSpillOn;
-            }
-            break;
+// Filter events according to SPS beam spill data
+bool PDHDSPSSpillFilter::selectEvent(art::Event & evt, art::ProcessingFrame const & frame) {
+    // Filter designed for Data only. Do not want to filter on MC
+    if (!evt.isRealData()) {
+        fCutFlow.count(fCount.notRealData);
+        if (fProduceSpillInfo) {
+            auto spillInfo = std::make_unique<SpillInfo>();
+            spillInfo->real_data = false;
+            evt.put(std::move(spillInfo));
         }
+        return true;
     }
 
-    std::cout << "END PDHDSPSSpillFilter for Event " << fEventID << " in Run " << fRun << "\n\n";
-    return filter_pass;
-}
+    const int fRun = evt.run();
+    const unsigned int fEventID = evt.id().event();
 
-// Read in the SPS beam data from the .csv file and store the spill clock times and PoT in a vector
-void PDHDSPSSpillFilter::beginJob() {
-    std::cout << "SPS beam data file: " << fSPSBeamData << "\n";
-    fInputData.open(fSPSBeamData);
-
-    if (!fInputData.good()) {
-        throw std::runtime_error("Input csv file " + fSPSBeamData + " cannot be read.");
-    }
+    PDHD_TRACE(fTrace, TraceLevel::kInfo) << "###PDHDSPSSpillFilter###";
+    PDHD_TRACE(fTrace, TraceLevel::kInfo) << "START PDHDSPSSpillFilter for Event " << fEventID << " in Run " << fRun;
 
-    std::string line;
-    // Read and discard the header line
-    if (std::getline(fInputData, line)) {
-        // Optionally, you can store the header if needed
-        // std::vector<std::string> header;
-        // std::stringstream headerStream(line);
-        // std::string cell;
-        // while (std::getline(headerStream, cell, ',')) {
-        //     header.push_back(cell);
-        // }
+    SpillTimeline::Cursor *spillCursor = fSpillCursors[frame.scheduleID().id()].get();
+    if (!spillCursor) {
+        throw cet::exception("PDHDSPSSpillFilter") << "No SPS spill data for run " << fRun << ".\n";
     }
 
-    while (std::getline(fInputData, line)) {
-        std::vector<std::string> data;
-        std::stringstream lineStream(line);
-        std::string cell;
-        while (std::getline(lineStream, cell, ',')) {
-            data.push_back(cell);
+    uint64_t timeHigh_ns = evt.time().timeHigh() * 1e9;
+    uint64_t timeLow_ns = evt.time().timeLow();
+    const uint64_t fEventTimeStamp = (timeHigh_ns + timeLow_ns) * 1e-6; // Timestamp from art::Event object
+
+    PDHD_TRACE(fTrace, TraceLevel::kDebug) << "Event " << fEventID << ", Timestamp = " << fEventTimeStamp << " ms";
+
+    // Find the last spill that started before the event and check whether the event is inside its window.
+    // Spills below the PoT threshold count as OFF
+    const SpillDecision decision = [&] {
+        const auto timer = fCutFlow.time(fStage.spillLookup);
+        return fSelector.decide(*fSpillTimeline, spillCursor->lookup(fEventTimeStamp));
+    }();
+    const SpillTimeline::Lookup &spill = decision.spill;
+    const bool spill_on = decision.on;
+    const bool filter_pass = decision.pass;
+
+    PDHD_TRACE(fTrace, TraceLevel::kDebug) << (spill_on ? "Spill ON" : "Spill OFF");
+    fCutFlow.count(spill_on ? fCount.spillOn : fCount.spillOff);
+
+    if (fProduceSpillInfo) {
+        auto spillInfo = std::make_unique<SpillInfo>();
+        if (spill.spill != SpillTimeline::npos) {
+            spillInfo->spill_index = static_cast<int32_t>(spill.spill);
+            spillInfo->spill_pot = fSpillTimeline->pot(spill.spill);
+            spillInfo->time_since_spill_start_ms = static_cast<int64_t>(fEventTimeStamp - fSpillTimeline->start(spill.spill));
+        }
+        spillInfo->spill_on = spill_on;
+        evt.put(std::move(spillInfo));
+
+        std::lock_guard<std::mutex> lock(fSummaryMutex);
+        fSummary.events_seen++;
+        if (spill_on) {
+            fSummary.events_on++;
+            if (fSpillsOn.insert(spill.spill).second) {
+                fSummary.spills_on++;
+                fSummary.pot_on += fSpillTimeline->pot(spill.spill);
+            }
         }
-        
-        try {
-            timestamp_t clock = static_cast<timestamp_t>(std::stod(data[0])*1e3); // Convert the string in ms to a double and then to a timestamp_t
-            uint64_t PoT = static_cast<uint64_t>(std::stoull(data[1])); // Convert the string to an unsigned long long and then to a uint64_t
-            if (PoT >= fPoT_threshold) {
-                vSpillClockPoT.push_back(std::make_pair(clock, PoT)); // Store the spill clock time and PoT value
+        if (filter_pass) {
+            fSummary.events_accepted++;
+            if (spill_on && fSpillsAccepted.insert(spill.spill).second) {
+                fSummary.spills_accepted++;
+                fSummary.pot_accepted += fSpillTimeline->pot(spill.spill);
             }
-        } catch (const std::invalid_argument& e) {
-            // Handle the case where the string is not a valid double
-        } catch (const std::out_of_range& e) {
-            // Handle the case where the double is out of range
         }
-        
     }
 
-    std::cout << "In " << fSPSBeamData << " there are " << vSpillClockPoT.size() << " SPS beam spills.\n\n";
+    PDHD_TRACE(fTrace, TraceLevel::kInfo) << "END PDHDSPSSpillFilter for Event " << fEventID << " in Run " << fRun;
+    return filter_pass;
+}
+
+void PDHDSPSSpillFilter::endJob(art::ProcessingFrame const &) {
+    fCutFlowReport.write(fCutFlow);
 }
 
 DEFINE_ART_MODULE(PDHDSPSSpillFilter)
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,115 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       PDHDSelectionRouter
+//// Plugin Type: filter
+//// File:        PDHDSelectionRouter_module.cc
+////
+//// Selects events on the pdhd::SelectionWords written by the filters in
+//// tag-only mode. The words of SelectionWords are merged (a cut fails if
+//// it fails in any of them) and the event passes if every cut in
+//// RequirePass passed and every cut in RequireFail failed. One router
+//// per output stream, each at the end of its own trigger path, lets one
+//// job write several samples from a single decoding pass; art runs the
+//// filters and decoders shared by the paths once per event.
+//// Shared module without per-event state.
+//////////////////////////////////////////////////////////////////////////
+
+#include <string>
+#include <vector>
+
+#include "art/Framework/Core/ModuleMacros.h"
+#include "art/Framework/Core/SharedFilter.h"
+#include "art/Framework/Principal/Event.h"
+#include "cetlib_except/exception.h"
+
+#include "pdhdbsmdata/Algorithms/CutFlow.h"
+#include "pdhdbsmdata/DataProducts/SelectionWord.h"
+#include "pdhdbsmdata/PDHDCutFlow.h"
+
+namespace pdhd {
+
+namespace {
+
+  uint32_t selectionMask(std::vector<std::string> const& names) {
+    uint32_t mask(0);
+    for (const auto &name : names) {
+      size_t cut = 0;
+      while (cut < static_cast<size_t>(SelectionCut::kNCuts) && name != selectionCutName(static_cast<SelectionCut>(cut))) cut++;
+      if (cut == static_cast<size_t>(SelectionCut::kNCuts)) {
+        throw cet::exception("PDHDSelectionRouter") << "Unknown cut \"" << name
+          << "\", expected \"spill\", \"triggertype\", \"extmuon\" or \"vertex\".\n";
+      }
+      mask |= SelectionWord::bit(static_cast<SelectionCut>(cut));
+    }
+    return mask;
+  }
+
+}
+
+//-------------------------------------
+class PDHDSelectionRouter : public art::SharedFilter {
+  public:
+    explicit PDHDSelectionRouter(fhicl::ParameterSet const & pset, art::ProcessingFrame const & frame);
+    virtual ~PDHDSelectionRouter() {};
+    bool filter(art::Event& e, art::ProcessingFrame const & frame) override;
+    void endJob(art::ProcessingFrame const & frame) override;
+
+  private:
+    std::vector<std::string> fInputTags;
+    uint32_t fRequirePass;
+    uint32_t fRequireFail;
+
+    CutFlow fCutFlow;
+    CutFlowReport fCutFlowReport;
+    struct {
+      CutFlow::id_t eventsSeen, eventsPassed, eventsFailed;
+    } fCount;
+};
+
+//-------------------------------------
+PDHDSelectionRouter::PDHDSelectionRouter(fhicl::ParameterSet const & pset, art::ProcessingFrame const &) :
+  SharedFilter(pset),
+  fInputTags(pset.get<std::vector<std::string>>("SelectionWords")),
+  fRequirePass(selectionMask(pset.get<std::vector<std::string>>("RequirePass", {}))),
+  fRequireFail(selectionMask(pset.get<std::vector<std::string>>("RequireFail", {}))),
+  fCutFlowReport(pset) {
+
+  if (fRequirePass & fRequireFail) {
+    throw cet::exception("PDHDSelectionRouter") << "A cut is in both RequirePass and RequireFail.\n";
+  }
+
+  fCount.eventsSeen = fCutFlow.addCounter("events_seen");
+  fCount.eventsPassed = fCutFlow.addCounter("events_passed");
+  fCount.eventsFailed = fCutFlow.addCounter("events_failed");
+
+  for (const auto &tag : fInputTags) consumes<SelectionWord>(tag);
+  async<art::InEvent>();
+}
+
+//-------------------------------------
+bool PDHDSelectionRouter::filter(art::Event & evt, art::ProcessingFrame const &) {
+  uint32_t evaluated(0), failed(0);
+  for (const auto &tag : fInputTags) {
+    const SelectionWord &word = *evt.getValidHandle<SelectionWord>(tag);
+    evaluated |= word.evaluated;
+    failed |= word.evaluated & ~word.passed;
+  }
+  const uint32_t required = fRequirePass | fRequireFail;
+  if ((evaluated & required) != required) {
+    throw cet::exception("PDHDSelectionRouter") << "Event " << evt.id().event() << " in Run " << evt.run()
+      << ": the SelectionWords do not hold every required cut. Are the filters in tag-only mode?\n";
+  }
+
+  const bool pass = (failed & fRequirePass) == 0 && (failed & fRequireFail) == fRequireFail;
+  fCutFlow.count(fCount.eventsSeen);
+  fCutFlow.count(pass ? fCount.eventsPassed : fCount.eventsFailed);
+  return pass;
+}
+
+//-------------------------------------
+void PDHDSelectionRouter::endJob(art::ProcessingFrame const &) {
+  fCutFlowReport.write(fCutFlow);
+}
+
+DEFINE_ART_MODULE(PDHDSelectionRouter)
+
+}
@@ -0,0 +1,174 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       SelectionStage, SelectionEvent
+//// File:        PDHDSelectionStage.h
+////
+//// Stages of PDHDBSMSelection. A stage is one cut with the decision of
+//// one of the filter modules, made by the same selector of Algorithms.
+//// The stages of an event share a SelectionEvent, which reads each input
+//// the first time a stage asks for it: the TCs, the TPIndex (read, or
+//// built from the TPs and TAs) and the APA 3 occupancy index. Events that
+//// an earlier stage rejects never build the index or the occupancy of
+//// the later ones. Stages may run in any order, so a stage must not
+//// depend on another; the check of each stage makes sure its input
+//// products exist before any stage runs, so an event missing one throws
+//// whatever the order, and not only when it gets as far as that stage.
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_PDHDSELECTIONSTAGE_H
+#define PDHDBSMDATA_PDHDSELECTIONSTAGE_H
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "art/Framework/Principal/Event.h"
+#include "art/Framework/Principal/Run.h"
+#include "cetlib_except/exception.h"
+
+#include "detdataformats/trigger/TriggerActivityData.hpp"
+#include "detdataformats/trigger/TriggerCandidateData.hpp"
+#include "detdataformats/trigger/TriggerPrimitive.hpp"
+
+#include "pdhdbsmdata/Algorithms/TPOccupancyIndex.h"
+#include "pdhdbsmdata/Algorithms/TraceBuffer.h"
+#include "pdhdbsmdata/Algorithms/VertexSelector.h"
+#include "pdhdbsmdata/DataProducts/TPIndex.h"
+#include "pdhdbsmdata/PDHDTPIndexReader.h"
+
+namespace pdhd {
+
+struct SelectionInputs {
+  std::string tcLabel;      // std::vector<TriggerCandidateData>
+  std::string tpIndexLabel; // pdhd::TPIndex; if empty the index is built from the two below
+  std::string tpLabel;
+  std::string taLabel;
+};
+
+class SelectionEvent {
+  public:
+    using tc_t = dunedaq::trgdataformats::TriggerCandidateData;
+    using clock_type = std::chrono::steady_clock;
+
+    SelectionEvent(art::Event const& evt, size_t schedule, SelectionInputs const& inputs, TraceSink log) :
+      fEvent(evt),
+      fSchedule(schedule),
+      fInputs(inputs),
+      fLog(log) {}
+
+    art::Event const& event() const { return fEvent; }
+    size_t schedule() const { return fSchedule; }
+    TraceSink const& log() const { return fLog; }
+
+    std::vector<tc_t> const& triggerCandidates() {
+      if (!fTCs) {
+        const Timer timer(fSharedNs);
+        fTCs = &*fEvent.getValidHandle<std::vector<tc_t>>(fInputs.tcLabel);
+      }
+      return *fTCs;
+    }
+
+    TPIndex const& tpIndex() {
+      if (fTPIndex) return *fTPIndex;
+      const Timer timer(fSharedNs);
+      if (!fInputs.tpIndexLabel.empty()) {
+        fTPIndex = &*fEvent.getValidHandle<TPIndex>(fInputs.tpIndexLabel);
+        return *fTPIndex;
+      }
+      TPIndex &index = fBuiltTPIndex.emplace();
+      readDetectorTPs(fEvent, fInputs.tpLabel, index);
+      if (!readTATPs(fEvent, fInputs.taLabel, index).assnsValid) {
+        PDHD_TRACE(fLog, TraceLevel::kWarning) << " [WARNING] TPs not found in TA.";
+      }
+      fTPIndex = &index;
+      return index;
+    }
+
+    TPOccupancyIndex const& apa3Occupancy() {
+      if (!fAPA3Occupancy) {
+        TPIndex const& index = tpIndex();
+        const Timer timer(fSharedNs);
+        fAPA3Occupancy.emplace(VertexSelector::apa3Occupancy(index));
+      }
+      return *fAPA3Occupancy;
+    }
+
+    // For the checks of the stages: throw if the event has no TCs, or not the products of the TP index
+    void requireTCs(std::string const& stage) {
+      if (fTCs) return;
+      const Timer timer(fSharedNs);
+      auto handle = fEvent.getHandle<std::vector<tc_t>>(fInputs.tcLabel);
+      if (!handle.isValid()) throw missing(fInputs.tcLabel, stage);
+      fTCs = &*handle;
+    }
+
+    void requireTPs(std::string const& stage) {
+      if (fTPIndex) return;
+      const Timer timer(fSharedNs);
+      if (!fInputs.tpIndexLabel.empty()) {
+        auto handle = fEvent.getHandle<TPIndex>(fInputs.tpIndexLabel);
+        if (!handle.isValid()) throw missing(fInputs.tpIndexLabel, stage);
+        fTPIndex = &*handle;
+        return;
+      }
+      // The TA->TP associations may be missing, the index is then built without them
+      if (!fEvent.getHandle<std::vector<dunedaq::trgdataformats::TriggerPrimitive>>(fInputs.tpLabel).isValid()) {
+        throw missing(fInputs.tpLabel, stage);
+      }
+      if (!fEvent.getHandle<std::vector<dunedaq::trgdataformats::TriggerActivityData>>(fInputs.taLabel).isValid()) {
+        throw missing(fInputs.taLabel, stage);
+      }
+    }
+
+    // Time spent loading the inputs, so it is not charged to the stage that happened to ask first
+    uint64_t sharedNs() const { return fSharedNs; }
+
+  private:
+    class Timer {
+      public:
+        explicit Timer(uint64_t& ns) : fNs(ns), fStart(clock_type::now()) {}
+        ~Timer() { fNs += std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - fStart).count(); }
+      private:
+        uint64_t &fNs;
+        clock_type::time_point fStart;
+    };
+
+    cet::exception missing(std::string const& label, std::string const& stage) const {
+      return cet::exception("PDHDBSMSelection") << "Event " << fEvent.id() << " has no " << label
+        << " product, which the " << stage << " stage needs.\n";
+    }
+
+    art::Event const& fEvent;
+    size_t fSchedule;
+    SelectionInputs const& fInputs;
+    TraceSink fLog;
+    uint64_t fSharedNs = 0;
+
+    std::vector<tc_t> const* fTCs = nullptr;
+    TPIndex const* fTPIndex = nullptr;
+    std::optional<TPIndex> fBuiltTPIndex;
+    std::optional<TPOccupancyIndex> fAPA3Occupancy;
+};
+
+class SelectionStage {
+  public:
+    virtual ~SelectionStage() = default;
+
+    // Pass (true) or reject the event; const, the stages of concurrent events share the object
+    virtual bool select(SelectionEvent& data) const = 0;
+    virtual void beginRun(art::Run const&) {}
+    // Run on every event before the stages, whatever their order; throws if the stage cannot decide it
+    virtual void check(SelectionEvent&) const {}
+    // Checksum of the run data the decisions depend on besides the configuration, 0 if none;
+    // goes into the decision cache key. Valid after beginRun.
+    virtual uint64_t runChecksum() const { return 0; }
+
+    // Inputs the module has to declare
+    virtual bool readsTCs() const { return false; }
+    virtual bool readsTPs() const { return false; }
+};
+
+}
+
+#endif
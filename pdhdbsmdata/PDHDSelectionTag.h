@@ -0,0 +1,49 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       SelectionTag
+//// File:        PDHDSelectionTag.h
+////
+//// Tag-only mode of a filter module, off unless TagOnly is set. In
+//// tag-only mode the filter passes every event and writes its decision
+//// as a pdhd::SelectionWord instead, for PDHDSelectionRouter to select
+//// on; the module declares the product if tagOnly().
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_PDHDSELECTIONTAG_H
+#define PDHDBSMDATA_PDHDSELECTIONTAG_H
+
+#include <memory>
+
+#include "art/Framework/Principal/Event.h"
+#include "fhiclcpp/ParameterSet.h"
+
+#include "pdhdbsmdata/DataProducts/SelectionWord.h"
+
+namespace pdhd {
+
+class SelectionTag {
+  public:
+    explicit SelectionTag(fhicl::ParameterSet const& pset) :
+      fTagOnly(pset.get<bool>("TagOnly", false)) {}
+
+    bool tagOnly() const { return fTagOnly; }
+
+    // The return value of filter(): the decision, or true with the word put in the event
+    bool put(art::Event& evt, SelectionWord const& word) const {
+      if (!fTagOnly) return word.pass();
+      evt.put(std::make_unique<SelectionWord>(word));
+      return true;
+    }
+
+    bool put(art::Event& evt, SelectionCut cut, bool pass) const {
+      SelectionWord word;
+      word.set(cut, pass);
+      return put(evt, word);
+    }
+
+  private:
+    bool fTagOnly;
+};
+
+}
+
+#endif
@@ -0,0 +1,96 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       PDHDTCCompare
+//// Plugin Type: analyzer
+//// File:        PDHDTCCompare_module.cc
+////
+//// Checks that PDHDTCDecoder gives the same trigger candidates as the
+//// full trigger decoder: same number of TCs per event and the same
+//// fields, in the same order. Mismatches are printed, and with
+//// ThrowOnMismatch the job stops at the first one.
+//////////////////////////////////////////////////////////////////////////
+
+#include <string>
+#include <vector>
+
+#include "art/Framework/Core/EDAnalyzer.h"
+#include "art/Framework/Core/ModuleMacros.h"
+#include "art/Framework/Principal/Event.h"
+#include "cetlib_except/exception.h"
+#include "messagefacility/MessageLogger/MessageLogger.h"
+
+#include "detdataformats/trigger/TriggerCandidateData.hpp"
+
+#include "pdhdbsmdata/Algorithms/TCFragmentDecoder.h"
+
+namespace pdhd {
+
+using triggercandidate_t = dunedaq::trgdataformats::TriggerCandidateData;
+
+//-------------------------------------
+class PDHDTCCompare : public art::EDAnalyzer {
+  public:
+    explicit PDHDTCCompare(fhicl::ParameterSet const & pset);
+    virtual ~PDHDTCCompare() {};
+    void analyze(art::Event const & evt) override;
+    void endJob() override;
+
+  private:
+    std::string fInputTagReference; // Full trigger decoder
+    std::string fInputTagTest;      // PDHDTCDecoder
+    bool fThrowOnMismatch;
+
+    uint64_t fEvents = 0;
+    uint64_t fTCs = 0;
+    uint64_t fMismatchedEvents = 0;
+};
+
+//-------------------------------------
+PDHDTCCompare::PDHDTCCompare(fhicl::ParameterSet const & pset) :
+  EDAnalyzer(pset),
+  fInputTagReference(pset.get<std::string>("InputTagReference", "triggerrawdecoder:daq")),
+  fInputTagTest(pset.get<std::string>("InputTagTest", "tcdecoder:daq")),
+  fThrowOnMismatch(pset.get<bool>("ThrowOnMismatch", true)) {
+
+  consumes<std::vector<triggercandidate_t>>(fInputTagReference);
+  consumes<std::vector<triggercandidate_t>>(fInputTagTest);
+}
+
+//-------------------------------------
+void PDHDTCCompare::analyze(art::Event const & evt) {
+  auto const& reference = *evt.getValidHandle<std::vector<triggercandidate_t>>(fInputTagReference);
+  auto const& test = *evt.getValidHandle<std::vector<triggercandidate_t>>(fInputTagTest);
+  fEvents++;
+  fTCs += reference.size();
+
+  std::string mismatch;
+  if (reference.size() != test.size()) {
+    mismatch = std::to_string(reference.size()) + " TCs in " + fInputTagReference + " but " +
+      std::to_string(test.size()) + " in " + fInputTagTest;
+  } else {
+    for (size_t i = 0; i < reference.size(); i++) {
+      if (!sameTriggerCandidate(reference[i], test[i])) {
+        mismatch = "TC " + std::to_string(i) + " differs: type " + std::to_string(static_cast<int>(reference[i].type)) +
+          " vs " + std::to_string(static_cast<int>(test[i].type)) + ", time_candidate " +
+          std::to_string(reference[i].time_candidate) + " vs " + std::to_string(test[i].time_candidate);
+        break;
+      }
+    }
+  }
+  if (mismatch.empty()) return;
+
+  fMismatchedEvents++;
+  if (fThrowOnMismatch) {
+    throw cet::exception("PDHDTCCompare") << "Event " << evt.id() << ": " << mismatch << ".\n";
+  }
+  mf::LogWarning("PDHDTCCompare") << "Event " << evt.id() << ": " << mismatch;
+}
+
+//-------------------------------------
+void PDHDTCCompare::endJob() {
+  mf::LogInfo("PDHDTCCompare") << fEvents << " events and " << fTCs << " TCs compared, "
+    << fMismatchedEvents << " events with different TCs.";
+}
+
+DEFINE_ART_MODULE(PDHDTCCompare)
+
+}
@@ -0,0 +1,125 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       PDHDTCDecoder
+//// Plugin Type: producer
+//// File:        PDHDTCDecoder_module.cc
+////
+//// Producer that reads only the trigger candidate fragments of the
+//// trigger record and writes their TriggerCandidateData, the product
+//// PDHDTriggerTypeFilter reads. The TP and TA fragments are not read,
+//// so the trigger type veto can run before triggerrawdecoder and the
+//// TPC decoding. The TCs are the same, in the same order, as those of
+//// the full trigger decoder (check with PDHDTCCompare; the test
+//// tcdecoder_compare runs it on a written raw file).
+//// Legacy module: the raw file is shared through HDF5RawFile3Service.
+//////////////////////////////////////////////////////////////////////////
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "art/Framework/Core/EDProducer.h"
+#include "art/Framework/Core/ModuleMacros.h"
+#include "art/Framework/Principal/Event.h"
+#include "art/Framework/Services/Registry/ServiceHandle.h"
+#include "cetlib_except/exception.h"
+
+#include "daqdataformats/Fragment.hpp"
+#include "detdataformats/trigger/TriggerCandidateData.hpp"
+#include "dunecore/DuneObj/DUNEHDF5FileInfo2.h"
+#include "dunecore/HDF5Utils/HDF5RawFile3Service.h"
+#include "hdf5libs/HDF5RawDataFile.hpp"
+
+#include "pdhdbsmdata/Algorithms/CutFlow.h"
+#include "pdhdbsmdata/Algorithms/TCFragmentDecoder.h"
+#include "pdhdbsmdata/PDHDCutFlow.h"
+#include "pdhdbsmdata/PDHDTrace.h"
+
+namespace pdhd {
+
+using triggercandidate_t = dunedaq::trgdataformats::TriggerCandidateData;
+
+//-------------------------------------
+class PDHDTCDecoder : public art::EDProducer {
+  public:
+    explicit PDHDTCDecoder(fhicl::ParameterSet const & pset);
+    virtual ~PDHDTCDecoder() {};
+    void produce(art::Event& e) override;
+    void endJob() override;
+
+  private:
+    void decode(art::Event & evt);
+
+    std::string fInputLabel;    // Label of the raw::DUNEHDF5FileInfo2 of the HDF5 source
+    std::string fOutputInstance;
+    Tracer fTrace;
+
+    CutFlow fCutFlow;
+    CutFlowReport fCutFlowReport;
+    struct {
+      CutFlow::id_t events, fragments, tcs;
+    } fCount;
+    struct {
+      CutFlow::id_t event;
+    } fStage;
+};
+
+//-------------------------------------
+PDHDTCDecoder::PDHDTCDecoder(fhicl::ParameterSet const & pset) :
+  EDProducer(pset),
+  fInputLabel(pset.get<std::string>("InputLabel", "daq")),
+  fOutputInstance(pset.get<std::string>("OutputInstance", "daq")),
+  fTrace(pset, "PDHDTCDecoder"),
+  fCutFlowReport(pset) {
+
+  fCount.events = fCutFlow.addCounter("events_seen");
+  fCount.fragments = fCutFlow.addCounter("tc_fragments");
+  fCount.tcs = fCutFlow.addCounter("tcs_decoded");
+  fStage.event = fCutFlow.addStage("event");
+
+  consumes<raw::DUNEHDF5FileInfo2>(fInputLabel);
+  produces<std::vector<triggercandidate_t>>(fOutputInstance);
+}
+
+//-------------------------------------
+void PDHDTCDecoder::produce(art::Event & evt) {
+  const auto timer = fCutFlow.time(fStage.event);
+  fTrace.traced([&] { decode(evt); });
+  fCutFlow.count(fCount.events);
+}
+
+//-------------------------------------
+void PDHDTCDecoder::decode(art::Event & evt) {
+  using dunedaq::daqdataformats::FragmentHeader;
+  using dunedaq::daqdataformats::FragmentType;
+
+  auto fileInfo = evt.getValidHandle<raw::DUNEHDF5FileInfo2>(fInputLabel);
+  const dunedaq::hdf5libs::HDF5RawDataFile::record_id_t recordID = std::make_pair(fileInfo->GetEvent(), fileInfo->GetSequence());
+  auto &rawFile = art::ServiceHandle<dune::HDF5RawFile3Service>()->GetPtr();
+
+  auto tcs = std::make_unique<std::vector<triggercandidate_t>>();
+  // Only the datasets of the TC fragments are read from the file
+  for (const auto &sourceID : rawFile->get_source_ids_for_fragment_type(recordID, FragmentType::kTriggerCandidate)) {
+    auto fragment = rawFile->get_frag_ptr(recordID, sourceID);
+    if (fragment->get_size() < sizeof(FragmentHeader)) {
+      throw cet::exception("PDHDTCDecoder") << "TC fragment " << sourceID.to_string() << " of trigger record "
+        << recordID.first << "." << recordID.second << " is shorter than its header.\n";
+    }
+    const size_t nTCs = decodeTCFragment(fragment->get_data(), fragment->get_size() - sizeof(FragmentHeader), *tcs);
+    PDHD_TRACE(fTrace, TraceLevel::kDebug) << "Fragment " << sourceID.to_string() << ": " << nTCs << " TCs";
+    fCutFlow.count(fCount.fragments);
+  }
+
+  PDHD_TRACE(fTrace, TraceLevel::kInfo) << "PDHDTCDecoder: " << tcs->size() << " TCs in trigger record "
+    << recordID.first << "." << recordID.second;
+  fCutFlow.count(fCount.tcs, tcs->size());
+  evt.put(std::move(tcs), fOutputInstance);
+}
+
+//-------------------------------------
+void PDHDTCDecoder::endJob() {
+  fCutFlowReport.write(fCutFlow);
+}
+
+DEFINE_ART_MODULE(PDHDTCDecoder)
+
+}
@@ -0,0 +1,122 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       PDHDTPIndexProducer
+//// Plugin Type: producer
+//// File:        PDHDTPIndexProducer_module.cc
+////
+//// Producer that builds the per-event pdhd::TPIndex read by the
+//// TP-based filters: every TP partitioned by APA and plane and sorted
+//// by (channel, time_peak), plus the sorted TPs of each TA, stored as
+//// columns. The TP collection is then copied and sorted once per event
+//// instead of once per filter. Stateless shared module.
+//////////////////////////////////////////////////////////////////////////
+
+#include <memory>
+#include <vector>
+
+#include "art/Framework/Core/ModuleMacros.h" 
+#include "art/Framework/Core/SharedProducer.h" 
+#include "art/Framework/Principal/Event.h"
+
+#include "detdataformats/trigger/TriggerPrimitive.hpp"
+#include "detdataformats/trigger/TriggerActivityData.hpp"
+
+#include "pdhdbsmdata/DataProducts/TPIndex.h"
+#include "pdhdbsmdata/Algorithms/CutFlow.h"
+#include "pdhdbsmdata/PDHDCutFlow.h"
+#include "pdhdbsmdata/PDHDTPIndexReader.h"
+#include "pdhdbsmdata/PDHDTrace.h"
+
+namespace pdhd {
+
+using triggerprimitive_t = dunedaq::trgdataformats::TriggerPrimitive;
+using triggeractivity_t = dunedaq::trgdataformats::TriggerActivityData;
+
+//-------------------------------------
+class PDHDTPIndexProducer : public art::SharedProducer {
+  public:
+    explicit PDHDTPIndexProducer(fhicl::ParameterSet const & pset, art::ProcessingFrame const & frame);
+    virtual ~PDHDTPIndexProducer() {};
+    void produce(art::Event& e, art::ProcessingFrame const & frame) override;
+    void endJob(art::ProcessingFrame const & frame) override;
+
+  private:
+    void buildIndex(art::Event & evt) const;
+
+    std::string fInputLabelTA;
+    std::string fInputLabelTP;
+    Tracer fTrace;
+
+    mutable CutFlow fCutFlow;
+    CutFlowReport fCutFlowReport;
+    struct {
+      CutFlow::id_t events, tps, tas, noTAAssns;
+    } fCount;
+    struct {
+      CutFlow::id_t event, detectorTPs, taTPs;
+    } fStage;
+};
+
+//-------------------------------------
+PDHDTPIndexProducer::PDHDTPIndexProducer(fhicl::ParameterSet const & pset, art::ProcessingFrame const &) :
+  SharedProducer(pset), 
+  fInputLabelTA(pset.get<std::string>("InputTagTA")),
+  fInputLabelTP(pset.get<std::string>("InputTagTP")),
+  fTrace(pset, "PDHDTPIndexProducer"),
+  fCutFlowReport(pset) {
+
+  fCount.events = fCutFlow.addCounter("events_seen");
+  fCount.tps = fCutFlow.addCounter("tps_indexed");
+  fCount.tas = fCutFlow.addCounter("tas_indexed");
+  fCount.noTAAssns = fCutFlow.addCounter("events_without_ta_tp_assns");
+  fStage.event = fCutFlow.addStage("event");
+  fStage.detectorTPs = fCutFlow.addStage("detector_tps");
+  fStage.taTPs = fCutFlow.addStage("ta_tps");
+
+  consumes<std::vector<triggerprimitive_t>>(fInputLabelTP);
+  consumes<std::vector<triggeractivity_t>>(fInputLabelTA);
+  consumes<art::Assns<triggeractivity_t, triggerprimitive_t>>(fInputLabelTA);
+
+  produces<TPIndex>();
+  async<art::InEvent>();
+}
+
+//-------------------------------------
+void PDHDTPIndexProducer::produce(art::Event & evt, art::ProcessingFrame const &) {
+  const auto timer = fCutFlow.time(fStage.event);
+  fTrace.traced([&] { buildIndex(evt); });
+  fCutFlow.count(fCount.events);
+}
+
+//-------------------------------------
+void PDHDTPIndexProducer::endJob(art::ProcessingFrame const &) {
+  fCutFlowReport.write(fCutFlow);
+}
+
+//-------------------------------------
+void PDHDTPIndexProducer::buildIndex(art::Event & evt) const {
+
+  auto index = std::make_unique<TPIndex>();
+
+  // Get TPs across the detector
+  const size_t nTPs = [&] {
+    const auto timer = fCutFlow.time(fStage.detectorTPs);
+    return readDetectorTPs(evt, fInputLabelTP, *index);
+  }();
+  fCutFlow.count(fCount.tps, nTPs);
+
+  const TATPsRead taTPs = [&] {
+    const auto timer = fCutFlow.time(fStage.taTPs);
+    return readTATPs(evt, fInputLabelTA, *index);
+  }();
+  fCutFlow.count(fCount.tas, taTPs.nTAs);
+  if (!taTPs.assnsValid) {
+    PDHD_TRACE(fTrace, TraceLevel::kWarning) << " [WARNING] TPs not found in TA.";
+    fCutFlow.count(fCount.noTAAssns);
+  }
+
+  evt.put(std::move(index));
+}
+
+DEFINE_ART_MODULE(PDHDTPIndexProducer)
+
+}
@@ -0,0 +1,66 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        PDHDTPIndexReader.h
+////
+//// Fill a pdhd::TPIndex from the TPs, TAs and TA->TP associations of
+//// an art::Event. Used by PDHDTPIndexProducer, and by PDHDBSMSelection
+//// to build the index only for events that reach a TP-based cut.
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_PDHDTPINDEXREADER_H
+#define PDHDBSMDATA_PDHDTPINDEXREADER_H
+
+#include <string>
+#include <vector>
+
+#include "art/Framework/Principal/Event.h"
+#include "canvas/Persistency/Common/FindManyP.h"
+
+#include "detdataformats/trigger/TriggerActivityData.hpp"
+#include "detdataformats/trigger/TriggerPrimitive.hpp"
+
+#include "pdhdbsmdata/Algorithms/TPIndexBuilder.h"
+#include "pdhdbsmdata/DataProducts/TPIndex.h"
+
+namespace pdhd {
+
+// TPs across the detector, returns their number
+inline size_t readDetectorTPs(art::Event const& evt, std::string const& tpLabel, TPIndex& index) {
+  auto triggerPrimitiveHandle = evt.getValidHandle<std::vector<dunedaq::trgdataformats::TriggerPrimitive>>(tpLabel);
+  fillDetectorTPs(*triggerPrimitiveHandle, index);
+  return triggerPrimitiveHandle->size();
+}
+
+struct TATPsRead {
+  size_t nTAs = 0;
+  bool assnsValid = true; // False if the TAs have no TP associations, they are then indexed without TPs
+};
+
+// TAs and their TPs
+inline TATPsRead readTATPs(art::Event const& evt, std::string const& taLabel, TPIndex& index) {
+  using triggerprimitive_t = dunedaq::trgdataformats::TriggerPrimitive;
+  auto triggerActivityHandle = evt.getValidHandle<std::vector<dunedaq::trgdataformats::TriggerActivityData>>(taLabel);
+  const art::FindManyP<triggerprimitive_t> findTPsInTAs(triggerActivityHandle, evt, taLabel);
+
+  TATPsRead read;
+  read.nTAs = triggerActivityHandle->size();
+  read.assnsValid = findTPsInTAs.isValid();
+
+  std::vector<triggerprimitive_t const*> taTPs;
+  std::vector<uint32_t> taTPSource;
+  for (size_t ta = 0; ta < triggerActivityHandle->size(); ta++) {
+    taTPs.clear();
+    taTPSource.clear();
+    if (read.assnsValid) {
+      for (const auto &tp : findTPsInTAs.at(ta)) {
+        taTPs.push_back(tp.get());
+        taTPSource.push_back(static_cast<uint32_t>(tp.key()));
+      }
+    }
+    appendTA(triggerActivityHandle->at(ta), taTPs, taTPSource, index);
+  }
+  return read;
+}
+
+}
+
+#endif
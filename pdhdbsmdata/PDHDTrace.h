@@ -0,0 +1,111 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       Tracer
+//// File:        PDHDTrace.h
+////
+//// Printout of the filter modules. Messages are written with
+////   PDHD_TRACE(fTrace, TraceLevel::kDebug) << "Found " << n << " TPs";
+//// A level above PDHD_TRACE_MAX_LEVEL compiles to nothing, and a level
+//// above the module's TraceLevel costs one comparison. Enabled messages
+//// go to a ring buffer of the module per thread (TraceBuffer), never
+//// to std::cout. With TraceMode "stream" a module writes its lines as
+//// one messagefacility message at the end of each call. With "ring"
+//// the lines are only kept, and the last TraceBufferLines lines of the
+//// module on that thread are written with mf::LogError when it throws.
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_PDHDTRACE_H
+#define PDHDBSMDATA_PDHDTRACE_H
+
+#include <string>
+#include <type_traits>
+
+#include "cetlib_except/exception.h"
+#include "fhiclcpp/ParameterSet.h"
+#include "messagefacility/MessageLogger/MessageLogger.h"
+#include "tbb/enumerable_thread_specific.h"
+
+#include "pdhdbsmdata/Algorithms/TraceBuffer.h"
+
+namespace pdhd {
+
+class Tracer {
+  public:
+    enum class Mode { kStream, kRing };
+
+    static constexpr std::size_t kDefaultBufferLines = 1024;
+
+    Tracer(fhicl::ParameterSet const& pset, std::string category) :
+      fCategory(std::move(category)),
+      fLevel(parseTraceLevel(pset.get<std::string>("TraceLevel", "info"))),
+      fMode(parseMode(pset.get<std::string>("TraceMode", "stream"))),
+      fRings(TraceBuffer(pset.get<std::size_t>("TraceBufferLines", kDefaultBufferLines))) {}
+
+    bool enabled(TraceLevel level) const { return level <= fLevel; }
+    TraceLevel level() const { return fLevel; }
+
+    // Ring of this module on the calling thread. Other modules on the thread have their own, but
+    // a task of the same module run there while this call waits (e.g. stolen inside a nested
+    // tbb::parallel_for) writes into it too, so nested parallel work runs in this_task_arena::isolate
+    TraceBuffer& buffer() const { return fRings.local(); }
+
+    // The same level into the ring of this thread or into buffer, for the selectors of Algorithms
+    TraceSink sink() const { return TraceSink(buffer(), fLevel); }
+    TraceSink sink(TraceBuffer& buffer) const { return TraceSink(buffer, fLevel); }
+
+    // End of a module call: in stream mode the lines of this thread are written as one message
+    void flush() const {
+      if (fMode != Mode::kStream || buffer().empty()) return;
+      std::string text;
+      buffer().drain([&] (TraceLevel, std::string_view line) {
+        text.append(line);
+        text.push_back('\n');
+      });
+      mf::LogInfo(fCategory) << text;
+    }
+
+    // On error: the lines still held for this thread, oldest first
+    void dump() const {
+      if (buffer().empty()) return;
+      std::string text;
+      if (buffer().dropped() > 0) text = "(" + std::to_string(buffer().dropped()) + " earlier lines dropped)\n";
+      buffer().drain([&] (TraceLevel level, std::string_view line) {
+        text.append(traceLevelName(level)).append(": ").append(line);
+        text.push_back('\n');
+      });
+      mf::LogError(fCategory) << "Trace before the error:\n" << text;
+    }
+
+    // Run f(), dumping the trace if it throws and flushing it otherwise
+    template <typename F>
+    auto traced(F&& f) const -> decltype(f()) {
+      try {
+        if constexpr (std::is_void_v<decltype(f())>) {
+          f();
+          flush();
+        } else {
+          auto result = f();
+          flush();
+          return result;
+        }
+      } catch (...) {
+        dump();
+        throw;
+      }
+    }
+
+  private:
+    static Mode parseMode(std::string const& mode) {
+      if (mode == "stream") return Mode::kStream;
+      if (mode == "ring") return Mode::kRing;
+      throw cet::exception("PDHDTrace") << "Unknown TraceMode \"" << mode << "\", expected \"stream\" or \"ring\".\n";
+    }
+
+    std::string fCategory;
+    TraceLevel fLevel;
+    Mode fMode;
+    mutable tbb::enumerable_thread_specific<TraceBuffer> fRings;
+};
+
+}
+
+#endif
@@ -0,0 +1,128 @@
+////////////////////////////////////////////////////////////////////////
+//// Class:       PDHDTriggerSnapshot
+//// Plugin Type: analyzer
+//// File:        PDHDTriggerSnapshot_module.cc
+////
+//// Writes the TPs, the TAs with their TPs and the TCs of every event
+//// to a columnar trigger snapshot (Algorithms/TriggerSnapshot.h), so
+//// the filters can be replayed outside of art with pdhd_filter_replay.
+//// Legacy analyzer, art calls it for one event at a time.
+//////////////////////////////////////////////////////////////////////////
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "art/Framework/Core/EDAnalyzer.h"
+#include "art/Framework/Core/ModuleMacros.h"
+#include "art/Framework/Principal/Event.h"
+#include "canvas/Persistency/Common/FindManyP.h"
+#include "cetlib_except/exception.h"
+#include "messagefacility/MessageLogger/MessageLogger.h"
+
+#include "detdataformats/trigger/TriggerActivityData.hpp"
+#include "detdataformats/trigger/TriggerCandidateData.hpp"
+#include "detdataformats/trigger/TriggerPrimitive.hpp"
+
+#include "pdhdbsmdata/Algorithms/TriggerSnapshot.h"
+
+namespace pdhd {
+
+using triggerprimitive_t = dunedaq::trgdataformats::TriggerPrimitive;
+using triggeractivity_t = dunedaq::trgdataformats::TriggerActivityData;
+using triggercandidate_t = dunedaq::trgdataformats::TriggerCandidateData;
+
+//-------------------------------------
+class PDHDTriggerSnapshot : public art::EDAnalyzer {
+  public:
+    explicit PDHDTriggerSnapshot(fhicl::ParameterSet const & pset);
+    virtual ~PDHDTriggerSnapshot() {};
+    void beginJob() override;
+    void analyze(art::Event const & evt) override;
+    void endJob() override;
+
+  private:
+    std::string fInputTagTP;
+    std::string fInputTagTA;
+    std::string fInputTagTC; // Empty: no TCs
+    std::string fOutputFile;
+    size_t fEventsPerBlock;
+
+    std::unique_ptr<TriggerSnapshotWriter> fWriter;
+    uint64_t fTPs = 0;
+    uint64_t fEventsWithoutAssns = 0;
+};
+
+//-------------------------------------
+PDHDTriggerSnapshot::PDHDTriggerSnapshot(fhicl::ParameterSet const & pset) :
+  EDAnalyzer(pset),
+  fInputTagTP(pset.get<std::string>("InputTagTP", "triggerrawdecoder:daq")),
+  fInputTagTA(pset.get<std::string>("InputTagTA", "triggerrawdecoder:daq")),
+  fInputTagTC(pset.get<std::string>("InputTagTC", "triggerrawdecoder:daq")),
+  fOutputFile(pset.get<std::string>("OutputFile", "triggers.pdhdsnp")),
+  fEventsPerBlock(pset.get<size_t>("EventsPerBlock", TriggerSnapshotWriter::kDefaultEventsPerBlock)) {
+
+  consumes<std::vector<triggerprimitive_t>>(fInputTagTP);
+  consumes<std::vector<triggeractivity_t>>(fInputTagTA);
+  consumes<art::Assns<triggeractivity_t, triggerprimitive_t>>(fInputTagTA);
+  if (!fInputTagTC.empty()) consumes<std::vector<triggercandidate_t>>(fInputTagTC);
+}
+
+//-------------------------------------
+void PDHDTriggerSnapshot::beginJob() {
+  fWriter = std::make_unique<TriggerSnapshotWriter>(fOutputFile, fEventsPerBlock);
+}
+
+//-------------------------------------
+void PDHDTriggerSnapshot::analyze(art::Event const & evt) {
+  // The writer copies the objects into its block, the view points to the products
+  TriggerEventView event;
+  event.run = evt.run();
+  event.subrun = evt.subRun();
+  event.event = evt.id().event();
+  event.time_ns = static_cast<uint64_t>(evt.time().timeHigh()) * 1000000000ULL + evt.time().timeLow();
+
+  auto triggerPrimitiveHandle = evt.getValidHandle<std::vector<triggerprimitive_t>>(fInputTagTP);
+  event.tps = *triggerPrimitiveHandle;
+
+  auto triggerActivityHandle = evt.getValidHandle<std::vector<triggeractivity_t>>(fInputTagTA);
+  event.tas = *triggerActivityHandle;
+  std::vector<uint32_t> taOffsets(1, 0);
+  std::vector<uint32_t> taTPs;
+  const art::FindManyP<triggerprimitive_t> findTPsInTAs(triggerActivityHandle, evt, fInputTagTA);
+  for (size_t ta = 0; ta < event.tas.size(); ta++) {
+    if (findTPsInTAs.isValid()) {
+      for (const auto &tp : findTPsInTAs.at(ta)) {
+        // The span is stored as indices into the TPs of fInputTagTP, which only the keys of its Ptrs are
+        if (tp.id() != triggerPrimitiveHandle.id()) {
+          throw cet::exception("PDHDTriggerSnapshot") << "Event " << evt.id() << ": TA " << ta << " of " << fInputTagTA
+            << " is associated with TPs of product " << tp.id() << ", not with the TPs of " << fInputTagTP
+            << " (product " << triggerPrimitiveHandle.id() << ").\n";
+        }
+        taTPs.push_back(static_cast<uint32_t>(tp.key()));
+      }
+    }
+    taOffsets.push_back(taTPs.size());
+  }
+  if (!findTPsInTAs.isValid()) fEventsWithoutAssns++;
+  event.taOffsets = taOffsets;
+  event.taTPs = taTPs;
+
+  std::vector<triggercandidate_t> noTCs;
+  event.tcs = fInputTagTC.empty() ? noTCs : *evt.getValidHandle<std::vector<triggercandidate_t>>(fInputTagTC);
+
+  fWriter->write(event);
+  fTPs += event.tps.size();
+}
+
+//-------------------------------------
+void PDHDTriggerSnapshot::endJob() {
+  if (!fWriter) return;
+  fWriter->close();
+  mf::LogInfo("PDHDTriggerSnapshot") << fWriter->events() << " events and " << fTPs << " TPs written to " << fOutputFile
+    << ", " << fEventsWithoutAssns << " events without TA->TP associations.";
+}
+
+DEFINE_ART_MODULE(PDHDTriggerSnapshot)
+
+}
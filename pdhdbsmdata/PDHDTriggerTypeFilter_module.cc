@@ -4,22 +4,25 @@
 //// File:        PDHDTriggerTypeFilter_module.cc
 //// Author:      Ciaran Hasnip (CERN)
 //// Version:     2.0 (2024-12-05) by Ciaran Hasnip (CERN) & Hamza Amar Es-sghir (IFIC-Valencia)
-//// Description: Filter that removes ground shake events by looking for 
-////              Trigger Candidates with type ADCSimpleWindow.
-////              One occurrence of this TC type removes the event.
+//// Description: Filter that removes ground shake and other noise events by
+////              their Trigger Candidates. The vetoed TC types and algorithms
+////              and the policy are set in fhicl (TCTypeSelector); by default
+////              one TC of type ADCSimpleWindow removes the event.
 ////////////////////////////////////////////////////////////////////////////////////////////////
 
-#include <iostream>
+#include <array>
+#include <atomic>
 #include <utility>
 #include <set>
+#include <string>
 
 #include "lardataobj/RawData/RawDigit.h"
 #include "lardataobj/RawData/RDTimeStamp.h"
 
-#include "art/Framework/Core/EDAnalyzer.h" 
-#include "art/Framework/Core/EDFilter.h" 
 #include "art/Framework/Core/ModuleMacros.h" 
+#include "art/Framework/Core/SharedFilter.h" 
 #include "art/Framework/Principal/Event.h" 
+#include "art/Framework/Principal/SubRun.h" 
 #include "art_root_io/TFileService.h"
 
 #include "detdataformats/trigger/TriggerObjectOverlay.hpp"
@@ -27,90 +30,189 @@
 #include "detdataformats/trigger/TriggerActivityData.hpp"
 #include "detdataformats/trigger/TriggerCandidateData.hpp"
 
+#include "pdhdbsmdata/Algorithms/CutFlow.h"
+#include "pdhdbsmdata/Algorithms/TCTypeSelector.h"
+#include "pdhdbsmdata/PDHDCutFlow.h"
+#include "pdhdbsmdata/PDHDSelectionTag.h"
+#include "pdhdbsmdata/PDHDTrace.h"
+
+#include "TH1D.h"
+
 namespace pdhd {
 
 using timestamp_t = dunedaq::trgdataformats::timestamp_t;
-using type_t = dunedaq::trgdataformats::TriggerCandidateData::Type;
-
-std::map<dunedaq::trgdataformats::TriggerCandidateData::Type, std::string> map_trigger_candidate_type_names = 
-  dunedaq::trgdataformats::get_trigger_candidate_type_names();
+using triggercandidate_t = dunedaq::trgdataformats::TriggerCandidateData;
 
-class PDHDTriggerTypeFilter : public art::EDFilter {
+class PDHDTriggerTypeFilter : public art::SharedFilter {
   public:
-    explicit PDHDTriggerTypeFilter(fhicl::ParameterSet const & pset);
+    explicit PDHDTriggerTypeFilter(fhicl::ParameterSet const & pset, art::ProcessingFrame const & frame);
     virtual ~PDHDTriggerTypeFilter() {};
-    bool filter(art::Event& e) override;
-    void beginJob() override;
+    bool filter(art::Event& e, art::ProcessingFrame const & frame) override;
+    void beginJob(art::ProcessingFrame const & frame) override;
+    void endJob(art::ProcessingFrame const & frame) override;
+    bool beginSubRun(art::SubRun& sr, art::ProcessingFrame const & frame) override;
+    bool endSubRun(art::SubRun& sr, art::ProcessingFrame const & frame) override;
 
   private:
-
-    int fRun;
-    int fSubRun;
-    unsigned int fEventID;
-    uint64_t fEventTimeStamp; // Timestamp from art::Event object
+    bool selectEvent(art::Event const & evt) const;
 
     std::string fInputLabel;
-    bool fDebug;
+    bool fDebug; // Timestamp check of each TC, part of the debug printout
+    TCTypeSelector fSelector;
+    // Options common to the filters, see the header of each class
+    Tracer fTrace;
+    SelectionTag fTag;
+
+    // TCs per type code in the current SubRun, written as a histogram at endSubRun
+    bool fTypeHistogram;
+    mutable std::array<std::atomic<uint64_t>, TCTypeSelector::kMaxCode> fSubRunTypeCounts;
+
+    mutable CutFlow fCutFlow;
+    CutFlowReport fCutFlowReport;
+    struct {
+      CutFlow::id_t eventsSeen, eventsPassed, eventsFailed, notRealData, tcsSeen, tcsChecked, tcsVetoed, vetoed;
+    } fCount;
+    struct {
+      CutFlow::id_t event;
+    } fStage;
 };
 
 // Constructor of the class PDHDTriggerTypeFilter
-PDHDTriggerTypeFilter::PDHDTriggerTypeFilter(fhicl::ParameterSet const & pset):
-  EDFilter(pset), 
+PDHDTriggerTypeFilter::PDHDTriggerTypeFilter(fhicl::ParameterSet const & pset, art::ProcessingFrame const &):
+  SharedFilter(pset), 
   fInputLabel(pset.get<std::string>("InputTag")),
-  fDebug(pset.get<bool>("Debug")) {}
+  fDebug(pset.get<bool>("Debug", false)),
+  fSelector(TCTypeSelector::Config{
+    pset.get<std::vector<std::string>>("AcceptTypes", {}),
+    pset.get<std::vector<std::string>>("RejectTypes", {"kADCSimpleWindow"}),
+    pset.get<std::vector<std::string>>("AcceptAlgorithms", {}),
+    pset.get<std::vector<std::string>>("RejectAlgorithms", {}),
+    parseTCVetoPolicy(pset.get<std::string>("Policy", "any")),
+    pset.get<size_t>("MinVetoedTCs", 1)}),
+  fTrace(pset, "PDHDTriggerTypeFilter"),
+  fTag(pset),
+  fTypeHistogram(pset.get<bool>("TypeHistogram", false)),
+  fCutFlowReport(pset) {
+
+  fCount.eventsSeen = fCutFlow.addCounter("events_seen");
+  fCount.eventsPassed = fCutFlow.addCounter("events_passed");
+  fCount.eventsFailed = fCutFlow.addCounter("events_failed");
+  fCount.notRealData = fCutFlow.addCounter("events_passed_not_real_data");
+  fCount.tcsSeen = fCutFlow.addCounter("tcs_seen");
+  fCount.tcsChecked = fCutFlow.addCounter("tcs_checked");
+  fCount.tcsVetoed = fCutFlow.addCounter("tcs_vetoed");
+  fCount.vetoed = fCutFlow.addCounter("events_failed_tc_veto");
+  for (auto &count : fSubRunTypeCounts) count = 0;
+  fStage.event = fCutFlow.addStage("event");
+
+  consumes<std::vector<dunedaq::trgdataformats::TriggerCandidateData>>(fInputLabel);
+  if (fTag.tagOnly()) produces<SelectionWord>();
+  async<art::InEvent>();
+}
 
 // Filter function
-bool PDHDTriggerTypeFilter::filter(art::Event & evt) {
+bool PDHDTriggerTypeFilter::filter(art::Event & evt, art::ProcessingFrame const &) {
+  const auto timer = fCutFlow.time(fStage.event);
+  const bool pass = fTrace.traced([&] { return selectEvent(evt); });
+  fCutFlow.count(fCount.eventsSeen);
+  fCutFlow.count(pass ? fCount.eventsPassed : fCount.eventsFailed);
+  return fTag.put(evt, SelectionCut::kTriggerType, pass);
+}
+
+// Decision and printout for one event
+bool PDHDTriggerTypeFilter::selectEvent(art::Event const & evt) const {
 
   if (!evt.isRealData()) {
     //Filter is designed for Data only. Don't want to filter on MC
+    fCutFlow.count(fCount.notRealData);
     return true;
   }
  
-  fRun = evt.run();
-  fSubRun = evt.subRun();
-  fEventID = evt.id().event();
+  const int fRun = evt.run();
+  const unsigned int fEventID = evt.id().event();
   
-  std::cout << "###PDHDTriggerTypeFilter###\n"
-    << "START PDHDTriggerTypeFilter for Event " << fEventID << " in Run " << fRun << "\n\n";
+  PDHD_TRACE(fTrace, TraceLevel::kInfo) << "###PDHDTriggerTypeFilter###";
+  PDHD_TRACE(fTrace, TraceLevel::kInfo) << "START PDHDTriggerTypeFilter for Event " << fEventID << " in Run " << fRun;
 
   uint64_t timeHigh_ns = evt.time().timeHigh()*1e9;
   uint64_t timeLow_ns = evt.time().timeLow();
 
-  fEventTimeStamp = timeHigh_ns + timeLow_ns;
+  uint64_t fEventTimeStamp = timeHigh_ns + timeLow_ns; // Timestamp from art::Event object
 
-  std::cout << "Event " << fEventID << ", Timestamp = " << fEventTimeStamp << " ms\n";
+  PDHD_TRACE(fTrace, TraceLevel::kDebug) << "Event " << fEventID << ", Timestamp = " << fEventTimeStamp << " ms";
 
   fEventTimeStamp *= 1e-6;
-  std::cout << "Seconds Timestamp = " << fEventTimeStamp << "\n";
+  PDHD_TRACE(fTrace, TraceLevel::kDebug) << "Seconds Timestamp = " << fEventTimeStamp;
 
   auto triggerCandidateHandle = evt.getValidHandle<std::vector<dunedaq::trgdataformats::TriggerCandidateData>>(fInputLabel);
   const auto& triggerCandidates = *triggerCandidateHandle;
 
-  for (const auto &tc : triggerCandidates) {
+  fCutFlow.count(fCount.tcsSeen, triggerCandidates.size());
+  if (fTypeHistogram) {
+    for (const auto &tc : triggerCandidates) fSubRunTypeCounts[TCTypeSelector::slot(tc.type)].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Per-TC printout and timestamp check only; the decision below does not need them
+  for (size_t i = 0; fTrace.enabled(TraceLevel::kDebug) && i < triggerCandidates.size(); i++) {
+    const triggercandidate_t &tc = triggerCandidates[i];
     //timestamp_t trigger_time_ms = tc.time_start * 16e-6; // 16e-9 s * 1e3 time_start is the time of the first sample in the window
     timestamp_t trigger_time_ms = tc.time_end * 16e-6; // 16e-9 s * 1e3 time_end is the time of the last sample in the window
-    std::cout << "Event " << fEventID << ", Timestamp = " << fEventTimeStamp << ", TC time = " << trigger_time_ms << "\n";
+    PDHD_TRACE(fTrace, TraceLevel::kDebug) << "Event " << fEventID << ", Timestamp = " << fEventTimeStamp << ", TC time = " << trigger_time_ms;
     if (fDebug && fEventTimeStamp != trigger_time_ms) {
-      std::cout << "[WARNING] art::Event timestamp and TC timestamp do not match. Investigate!\n";
-    }
-    // Look at the algorithm type
-    type_t type_tc = tc.type;
-    std::cout << "Type: " << map_trigger_candidate_type_names[type_tc] << "\n";
-    if (type_tc == type_t::kADCSimpleWindow) {
-      std::cout << "kADCSimpleWindow Trigger Algorithm! Removing ground shake.\n";
-      return false;
+      PDHD_TRACE(fTrace, TraceLevel::kWarning) << "[WARNING] art::Event timestamp and TC timestamp do not match. Investigate!";
     }
+    PDHD_TRACE(fTrace, TraceLevel::kDebug) << "Type: " << TCTypeSelector::typeName(TCTypeSelector::slot(tc.type))
+      << ", algorithm: " << TCTypeSelector::algorithmName(TCTypeSelector::slot(tc.algorithm))
+      << (fSelector.vetoed(tc) ? ", vetoed" : "");
+  }
+
+  // One bit test per TC, stopping as soon as the policy has decided
+  const TCTypeSelector::Decision decision = fSelector.decide(triggerCandidates.data(), triggerCandidates.data() + triggerCandidates.size());
+  fCutFlow.count(fCount.tcsChecked, decision.checked);
+  fCutFlow.count(fCount.tcsVetoed, decision.vetoed);
+  if (decision.reject) {
+    PDHD_TRACE(fTrace, TraceLevel::kInfo) << decision.vetoed << " of " << triggerCandidates.size() << " TCs vetoed. Removing event.";
+    fCutFlow.count(fCount.vetoed);
+    return false;
   }
   
-  std::cout << "END PDHDTriggerTypeFilter for Event " << fEventID << " in Run " << fRun << "\n\n";
+  PDHD_TRACE(fTrace, TraceLevel::kInfo) << "END PDHDTriggerTypeFilter for Event " << fEventID << " in Run " << fRun;
 
   // If you made it here then you only had physics triggers
   return true;
 }
 
 // Begin job function
-void PDHDTriggerTypeFilter::beginJob() {}
+void PDHDTriggerTypeFilter::beginJob(art::ProcessingFrame const &) {}
+
+// End job function
+void PDHDTriggerTypeFilter::endJob(art::ProcessingFrame const &) {
+  fCutFlowReport.write(fCutFlow);
+}
+
+// SubRun transitions do not overlap with events, so the counts are reset and read here without a lock
+bool PDHDTriggerTypeFilter::beginSubRun(art::SubRun &, art::ProcessingFrame const &) {
+  for (auto &count : fSubRunTypeCounts) count = 0;
+  return true;
+}
+
+bool PDHDTriggerTypeFilter::endSubRun(art::SubRun & sr, art::ProcessingFrame const &) {
+  if (!fTypeHistogram) return true;
+
+  // One bin per type code up to the last one seen or named
+  size_t nCodes = 0;
+  for (size_t code = 0; code < TCTypeSelector::kMaxCode; code++) {
+    if (fSubRunTypeCounts[code] > 0 || TCTypeSelector::typeName(code) != std::to_string(code)) nCodes = code + 1;
+  }
+  art::ServiceHandle<art::TFileService> tfs;
+  const std::string name = "TCTypes_run" + std::to_string(sr.run()) + "_subrun" + std::to_string(sr.subRun());
+  TH1D *h = tfs->make<TH1D>(name.c_str(), ";TC type;TCs", nCodes, -0.5, nCodes - 0.5);
+  for (size_t code = 0; code < nCodes; code++) {
+    h->GetXaxis()->SetBinLabel(code + 1, TCTypeSelector::typeName(code).c_str());
+    h->SetBinContent(code + 1, fSubRunTypeCounts[code]);
+  }
+  return true;
+}
 
 DEFINE_ART_MODULE(PDHDTriggerTypeFilter)
 
@@ -6,31 +6,54 @@
 //// 
 //// Filter that finds the centre of the energy deposition shower in the
 //// energy deposited in the first 50 channels.
+//// The TA cuts are in Algorithms/VertexSelector.h.
 //////////////////////////////////////////////////////////////////////////
 
-#include <iostream>
+#include <array>
 #include <utility>
 #include <set>
 #include <numeric>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <random>
 
 #include "lardataobj/RawData/RawDigit.h"
 #include "lardataobj/RawData/RDTimeStamp.h"
 
-#include "art/Framework/Core/EDAnalyzer.h" 
-#include "art/Framework/Core/EDFilter.h" 
 #include "art/Framework/Core/ModuleMacros.h" 
+#include "art/Framework/Core/SharedFilter.h" 
 #include "art/Framework/Principal/Event.h"
-#include "canvas/Persistency/Common/FindManyP.h"
+#include "art/Framework/Principal/Run.h"
 #include "art_root_io/TFileService.h"
+#include "cetlib_except/exception.h"
+#include "messagefacility/MessageLogger/MessageLogger.h"
+
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+#include "tbb/task_arena.h"
 
 #include "detdataformats/trigger/TriggerObjectOverlay.hpp"
 #include "detdataformats/trigger/TriggerPrimitive.hpp"
 #include "detdataformats/trigger/TriggerActivityData.hpp"
 #include "detdataformats/trigger/TriggerCandidateData.hpp"
 
+#include "pdhdbsmdata/Algorithms/CutFlow.h"
+#include "pdhdbsmdata/Algorithms/FixedHist.h"
+#include "pdhdbsmdata/Algorithms/PDHDChannelMap.h"
+#include "pdhdbsmdata/Algorithms/TPOccupancyIndex.h"
+#include "pdhdbsmdata/Algorithms/VertexSelector.h"
+#include "pdhdbsmdata/DataProducts/TPIndex.h"
+#include "pdhdbsmdata/PDHDChannelMapCheck.h"
+#include "pdhdbsmdata/PDHDCutFlow.h"
+#include "pdhdbsmdata/PDHDDecisionCache.h"
+#include "pdhdbsmdata/PDHDROIOutput.h"
+#include "pdhdbsmdata/PDHDSelectionTag.h"
+#include "pdhdbsmdata/PDHDTrace.h"
+
 #include "TH1D.h"
 #include "TH2D.h"
-#include "TGraph.h"
 #include "TF1.h"
 #include "TFitResult.h"
 
@@ -40,468 +63,397 @@ using timestamp_t = dunedaq::trgdataformats::timestamp_t;
 using channel_t = dunedaq::trgdataformats::channel_t;
 using triggerprimitive_t = dunedaq::trgdataformats::TriggerPrimitive;
 
+namespace {
+
+  enum class DiagnosticsMode {
+    kOff,
+    kSampled,  // TA histograms of 1 in DiagnosticsSampleEvery events, optionally a reservoir of them
+    kAggregate // Summary histograms over the job
+  };
+
+  DiagnosticsMode parseDiagnosticsMode(std::string const& mode) {
+    if (mode == "off") return DiagnosticsMode::kOff;
+    if (mode == "sampled") return DiagnosticsMode::kSampled;
+    if (mode == "aggregate") return DiagnosticsMode::kAggregate;
+    throw cet::exception("PDHDVertexFilter") << "Unknown Diagnostics \"" << mode
+      << "\", expected \"off\", \"sampled\" or \"aggregate\".\n";
+  }
+
+  // Histograms of the TAs of a sampled event, written out as ROOT histograms
+  using EventDiagnostics = std::vector<VertexTADiagnostics>;
+
+  // Trace lines kept per TA evaluated in parallel, a TA writes about 15
+  constexpr size_t kTALogLines = 32;
+
+  struct TAResult {
+    VertexTAResult ta;
+    std::optional<TraceBuffer> log; // Trace of the TA when it is evaluated in parallel
+  };
+
+  // ROOT copies of the filter's fixed histograms for the diagnostic output
+  TH1D* bookDiagnostic(art::TFileService &tfs, std::string const& name, const char *axes, FixedHist1D const& hist) {
+    FixedAxis const& x = hist.axis();
+    TH1D *h = tfs.make<TH1D>(name.c_str(), axes, x.nBins(), x.xMin(), x.xMax());
+    h->Sumw2();
+    for (int b = 0; b < hist.nCells(); b++) {
+      h->SetBinContent(b, hist.binContent(b));
+      h->SetBinError(b, hist.binError(b));
+    }
+    return h;
+  }
+
+  TH2D* bookDiagnostic(art::TFileService &tfs, std::string const& name, const char *axes, FixedHist2D const& hist) {
+    FixedAxis const& x = hist.xAxis();
+    FixedAxis const& y = hist.yAxis();
+    TH2D *h = tfs.make<TH2D>(name.c_str(), axes, x.nBins(), x.xMin(), x.xMax(), y.nBins(), y.xMin(), y.xMax());
+    h->Sumw2();
+    for (int by = 0; by <= y.nBins() + 1; by++) {
+      for (int bx = 0; bx <= x.nBins() + 1; bx++) {
+        h->SetBinContent(bx, by, hist.binContent(bx, by));
+        h->SetBinError(bx, by, std::sqrt(hist.binSumW2(bx, by)));
+      }
+    }
+    return h;
+  }
+
+}
+
 //-------------------------------------
-class PDHDVertexFilter : public art::EDFilter {
+class PDHDVertexFilter : public art::SharedFilter {
   public:
-    explicit PDHDVertexFilter(fhicl::ParameterSet const & pset);
+    explicit PDHDVertexFilter(fhicl::ParameterSet const & pset, art::ProcessingFrame const & frame);
     virtual ~PDHDVertexFilter() {};
-    virtual bool filter(art::Event& e);
-    void beginJob();
+    bool filter(art::Event& e, art::ProcessingFrame const & frame) override;
+    void beginJob(art::ProcessingFrame const & frame) override;
+    void endJob(art::ProcessingFrame const & frame) override;
+    bool beginRun(art::Run& r, art::ProcessingFrame const & frame) override;
+    bool endRun(art::Run& r, art::ProcessingFrame const & frame) override;
 
   private:
-
-    int fRun;
-    int fSubRun;
-    unsigned int fEventID;
-
-    int fAPA_id;
-
-    std::pair<channel_t, channel_t> pCollectionAPA1IDs;
-    std::pair<channel_t, channel_t> pCollectionAPA2IDs;
-    std::pair<channel_t, channel_t> pCollectionAPA3IDs;
-    std::pair<channel_t, channel_t> pCollectionAPA4IDs;
-
-    std::vector<TH2D*> fAPA1TAHIST;
-    std::vector<TH2D*> fAPA2TAHIST;
-    std::vector<TH2D*> fAPA3TAHIST;
-    std::vector<TH2D*> fAPA4TAHIST;
-
-    std::vector<TH1D*> fAPA1_TimeProjHIST;
-    std::vector<TH1D*> fAPA2_TimeProjHIST;
-    std::vector<TH1D*> fAPA3_TimeProjHIST;
-    std::vector<TH1D*> fAPA4_TimeProjHIST;
-    
-    std::vector<TH1D*> fAPA1_ChanProjHIST;
-    std::vector<TH1D*> fAPA2_ChanProjHIST;
-    std::vector<TH1D*> fAPA3_ChanProjHIST;
-    std::vector<TH1D*> fAPA4_ChanProjHIST;
-    
-    std::vector<TH2D*> fAPA3WindowHIST;
-    
-    std::string fInputLabelTA;
-    std::string fInputLabelTP;
-    channel_t fUpstreamVetoChannels;
-    // Name and path of input csv file for SPS beam data
-    std::vector<triggerprimitive_t> fTriggerPrimitive;
+    bool selectEvent(art::Event& evt, EventDiagnostics *diagnostics, std::vector<TPCROI>& rois);
+    // All TAs on the TBB pool, stopping once the deciding TA is known
+    std::vector<TAResult> evaluateTAsParallel(TPIndex const& tpIndex, TPOccupancyIndex const& apa3Occupancy,
+                                              std::string const& eventTag, bool recordDiagnostics) const;
+    // Aggregate histograms and sampled diagnostics of a TA that the serial loop reaches
+    void recordTA(VertexTAResult& result, EventDiagnostics *diagnostics);
+    // Whether this event's TAs are recorded in sampled mode
+    bool sampleEvent();
+    // Write or keep the TAs of a sampled event
+    void storeDiagnostics(EventDiagnostics&& diagnostics);
+    void writeDiagnostics(EventDiagnostics const& diagnostics);
+    void fillAggregate(TH1D *hist, double value);
+
+    std::string fInputLabelTPIndex;
+    // Time fit, vertex and upstream veto cuts of each TA, shared with PDHDBSMSelection
+    VertexSelector fSelector;
+    bool fCheckChannelMap;
+    bool fChannelMapChecked;
+    // Evaluate the TAs of events with at least fParallelMinTAs of them concurrently
+    bool fParallelTAs;
+    size_t fParallelMinTAs;
+    // Options common to the filters, see the header of each class
+    Tracer fTrace;
+    FilterDecisionCache fDecisionCache;
+    SelectionTag fTag;
+    ROIOutput fROIs;
+
+    mutable CutFlow fCutFlow;
+    CutFlowReport fCutFlowReport;
+    struct {
+      CutFlow::id_t eventsSeen, eventsPassed, eventsFailed, eventsCached, tasSeen;
+      std::array<CutFlow::id_t, static_cast<size_t>(VertexCut::kNCuts)> tas; // By VertexCut
+    } fCount;
+    struct {
+      CutFlow::id_t event, occupancy, ta;
+    } fStage;
+
+    // TFileService output, filled only by events that are not decided from the decision cache
+    DiagnosticsMode fDiagnostics;
+    unsigned fDiagnosticsSampleEvery;
+    // Events kept in sampled mode and written at endJob, 0 writes every sampled event as it comes
+    size_t fDiagnosticsReservoirSize;
+    std::atomic<size_t> fNEventsSeen;
+
+    // Guards everything below, shared by the schedules
+    std::mutex fDiagnosticsMutex;
+    size_t fNSampled;
+    std::vector<EventDiagnostics> fReservoir;
+    std::minstd_rand fSampleRNG;
+
+    // Aggregate mode, booked at beginJob
+    TH1D *fAggTAsPerEvent;
+    TH1D *fAggMeanTime;
+    TH1D *fAggSigmaTime;
+    TH1D *fAggFitStatus;
+    TH1D *fAggVertexChannel;
+    TH1D *fAggVetoCount;
 };
 
 //-------------------------------------
-PDHDVertexFilter::PDHDVertexFilter::PDHDVertexFilter(fhicl::ParameterSet const & pset) :
-  EDFilter(pset), 
-  fInputLabelTA(pset.get<std::string>("InputTagTA")),
-  fInputLabelTP(pset.get<std::string>("InputTagTP")),
-  fUpstreamVetoChannels(pset.get<channel_t>("fUpstreamVetoChannels")) {
+PDHDVertexFilter::PDHDVertexFilter::PDHDVertexFilter(fhicl::ParameterSet const & pset, art::ProcessingFrame const &) :
+  SharedFilter(pset), 
+  fInputLabelTPIndex(pset.get<std::string>("InputTagTPIndex")),
+  fSelector(pset.get<channel_t>("fUpstreamVetoChannels"), parseVetoCountMode(pset.get<std::string>("VetoCountMode", "hits"))),
+  fCheckChannelMap(pset.get<bool>("CheckChannelMap", false)),
+  fChannelMapChecked(false),
+  fParallelTAs(pset.get<bool>("ParallelTAs", false)),
+  fParallelMinTAs(pset.get<size_t>("ParallelMinTAs", 4)),
+  fTrace(pset, "PDHDVertexFilter"),
+  fDecisionCache(pset),
+  fTag(pset),
+  fROIs(pset),
+  fCutFlowReport(pset),
+  fDiagnostics(parseDiagnosticsMode(pset.get<std::string>("Diagnostics", "off"))),
+  fDiagnosticsSampleEvery(std::max(1u, pset.get<unsigned>("DiagnosticsSampleEvery", 1))),
+  fDiagnosticsReservoirSize(pset.get<size_t>("DiagnosticsReservoirSize", 0)),
+  fNEventsSeen(0),
+  fNSampled(0),
+  fSampleRNG(20240917),
+  fAggTAsPerEvent(nullptr),
+  fAggMeanTime(nullptr),
+  fAggSigmaTime(nullptr),
+  fAggFitStatus(nullptr),
+  fAggVertexChannel(nullptr),
+  fAggVetoCount(nullptr) {
   
-  fAPA_id = 0;
-  pCollectionAPA1IDs = std::make_pair(2080, 2559);
-  pCollectionAPA2IDs = std::make_pair(7200, 7680);  
-  pCollectionAPA3IDs = std::make_pair(4160, 4639);
-  pCollectionAPA4IDs = std::make_pair(9280, 9759); 
-  
-  consumes<std::vector<triggerprimitive_t>>(fInputLabelTP);
-  consumes<std::vector<triggerprimitive_t>>(fInputLabelTA);
-  consumes<std::vector<dunedaq::trgdataformats::TriggerActivityData>>(fInputLabelTA);
-  consumes<art::Assns<dunedaq::trgdataformats::TriggerActivityData,dunedaq::trgdataformats::TriggerPrimitive>>(fInputLabelTA);
+  consumes<TPIndex>(fInputLabelTPIndex);
+  if (fTag.tagOnly()) produces<SelectionWord>();
+  if (fROIs.produce()) produces<std::vector<TPCROI>>();
+
+  fCount.eventsSeen = fCutFlow.addCounter("events_seen");
+  fCount.eventsPassed = fCutFlow.addCounter("events_passed");
+  fCount.eventsFailed = fCutFlow.addCounter("events_failed");
+  fCount.eventsCached = fCutFlow.addCounter("events_cached");
+  fCount.tasSeen = fCutFlow.addCounter("tas_seen");
+  for (size_t cut = 0; cut < fCount.tas.size(); cut++) {
+    fCount.tas[cut] = fCutFlow.addCounter(vertexCutName(static_cast<VertexCut>(cut)));
+  }
+  fStage.event = fCutFlow.addStage("event");
+  fStage.occupancy = fCutFlow.addStage("occupancy_index");
+  fStage.ta = fCutFlow.addStage("ta");
+
+  // Sampled events written as they come book histograms during the event, which the TFileService does not allow
+  // concurrently. Otherwise the TFileService is only used at beginJob and endJob.
+  if (fDiagnostics == DiagnosticsMode::kSampled && fDiagnosticsReservoirSize == 0) {
+    serialize<art::InEvent>(art::SharedResource<art::TFileService>);
+  } else {
+    async<art::InEvent>();
+  }
 } 
 
 //-------------------------------------
-void PDHDVertexFilter::beginJob() {}
-
-//-------------------------------------
-bool PDHDVertexFilter::filter(art::Event & evt) {
+void PDHDVertexFilter::beginJob(art::ProcessingFrame const &) {
+  if (fDiagnostics != DiagnosticsMode::kAggregate) return;
 
   art::ServiceHandle<art::TFileService> tfs;
-  
-  fRun = evt.run();
-  fSubRun = evt.subRun();
-  fEventID = evt.id().event();
-
-  std::cout << "###PDHDVertexFilter###"<< std::endl
-    << "START PDHDVertexFilter for Event " << fEventID << " in Run " << fRun << std::endl << std::endl;
-  
-  // Get TPs across the detector
-  auto triggerPrimitiveHandle = evt.getValidHandle<std::vector<triggerprimitive_t>>(fInputLabelTP);
-  fTriggerPrimitive = *triggerPrimitiveHandle;
-
-  std::cout << "There are " << fTriggerPrimitive.size() << " TPs across the detector." << std::endl;
-  
-  auto triggerActivityHandle = evt.getValidHandle<std::vector<dunedaq::trgdataformats::TriggerActivityData>>(fInputLabelTA);
+  fAggTAsPerEvent = tfs->make<TH1D>("TAsPerEvent", ";TAs per event;Events", 50, -0.5, 49.5);
+  fAggMeanTime = tfs->make<TH1D>("MeanTime", ";Shower mean time in TA (ticks);TAs", 100, 0, 100e3);
+  fAggSigmaTime = tfs->make<TH1D>("SigmaTime", ";Shower sigma in time (ticks);TAs", 100, 0, 10e3);
+  fAggFitStatus = tfs->make<TH1D>("FitStatus", ";Time fit status;TAs", 5, -0.5, 4.5);
+  const chmap::ChannelRange apa3 = VertexSelector::kCollectionAPA3;
+  const channel_t vetoChannels = fSelector.upstreamVetoChannels();
+  fAggVertexChannel = tfs->make<TH1D>("VertexChannel", ";APA 3 vertex channel;TAs", 48, apa3.first, apa3.last + 1);
+  fAggVetoCount = tfs->make<TH1D>("VetoCount", ";Upstream veto count;TAs", vetoChannels + 2, -0.5, vetoChannels + 1.5);
+}
 
-  std::cout << "There are " << triggerActivityHandle->size() << " TAs." << std::endl;
+//-------------------------------------
+void PDHDVertexFilter::endJob(art::ProcessingFrame const &) {
+  for (const auto &diagnostics : fReservoir) writeDiagnostics(diagnostics);
+  fReservoir.clear();
+  fCutFlowReport.write(fCutFlow);
+}
 
-  const art::FindManyP<triggerprimitive_t> findTPsInTAs(triggerActivityHandle, evt, fInputLabelTA);
-  if ( ! findTPsInTAs.isValid() ) {
-    std::cout << " [WARNING] TPs not found in TA." << std::endl;
+//-------------------------------------
+bool PDHDVertexFilter::beginRun(art::Run& r, art::ProcessingFrame const &) {
+  if (fCheckChannelMap && !fChannelMapChecked) {
+    checkChannelMap();
+    fChannelMapChecked = true;
   }
+  fDecisionCache.beginRun(r);
+  return true;
+}
 
-  // Boolean to return - if any one of the TAs passes the filters, pass the whole event
-  bool fEventPassesFilters(true);
+//-------------------------------------
+bool PDHDVertexFilter::endRun(art::Run&, art::ProcessingFrame const &) {
+  fDecisionCache.endRun();
+  return true;
+}
 
-  for (size_t ta = 0; ta < triggerActivityHandle->size(); ta++) {
-    std::cout << "START TA " << ta << " out of " << triggerActivityHandle->size() << std::endl;
-    auto fTPs = findTPsInTAs.at(ta);
+//-------------------------------------
+bool PDHDVertexFilter::sampleEvent() {
+  if (fDiagnostics != DiagnosticsMode::kSampled) return false;
+  return fNEventsSeen.fetch_add(1) % fDiagnosticsSampleEvery == 0;
+}
 
-    std::cout << "Found " << fTPs.size() << " TPs in TA " << ta << std::endl;
+//-------------------------------------
+void PDHDVertexFilter::storeDiagnostics(EventDiagnostics&& diagnostics) {
+  std::lock_guard<std::mutex> lock(fDiagnosticsMutex);
+  const size_t sampled = fNSampled++;
+  if (fDiagnosticsReservoirSize == 0) {
+    writeDiagnostics(diagnostics);
+    return;
+  }
 
-    timestamp_t first_tick = triggerActivityHandle->at(ta).time_start;
-    timestamp_t last_tick = triggerActivityHandle->at(ta).time_end;
-  
-    timestamp_t TAWindow = last_tick - first_tick;
-    if (TAWindow < 20e3) TAWindow = 20e3;
-
-    std::cout << ">>> TAWindow = " << TAWindow << std::endl;
-    // Now sort in channel number
-    std::sort(fTPs.begin(), fTPs.end(),
-        [] (const art::Ptr<triggerprimitive_t> &lh, const art::Ptr<triggerprimitive_t> &rh) -> bool { return lh->channel < rh->channel; });
-
-    channel_t current_chan = fTPs.at(0)->channel;
-    
-    std::cout << "First tick = " << first_tick << ", last tick = " << last_tick << std::endl;
-    std::cout << "First channel = " << current_chan << std::endl;
-
-    std::string title("");
-
-    if (current_chan >= pCollectionAPA1IDs.first) {
-      if (current_chan <= pCollectionAPA1IDs.second) {
-        // APA 1, TPC 1
-        fAPA_id = 1;
-        title = "APA" + std::to_string(fAPA_id) + "_TATPs_ev" + std::to_string(fEventID) + "_run" + std::to_string(fRun) + "_ta" + std::to_string(ta);
-        fAPA1TAHIST.emplace_back(tfs->make<TH2D>(title.c_str(), ";Channel Number;Time (ticks)", 25, pCollectionAPA1IDs.first, pCollectionAPA1IDs.second, 20, 0, TAWindow));
-      }
-    }
-    if (current_chan >= pCollectionAPA3IDs.first) {
-      if (current_chan <= pCollectionAPA3IDs.second) {
-        // APA 3, TPC 2
-        fAPA_id = 3;
-        title = "APA" + std::to_string(fAPA_id) + "_TATPs_ev" + std::to_string(fEventID) + "_run" + std::to_string(fRun) + "_ta" + std::to_string(ta);
-        fAPA3TAHIST.emplace_back(tfs->make<TH2D>(title.c_str(), ";Channel Number;Time (ticks)", 25, pCollectionAPA3IDs.first, pCollectionAPA3IDs.second, 20, 0, TAWindow));
-      }
-    }
-    if (current_chan >= pCollectionAPA2IDs.first) {
-      if (current_chan <= pCollectionAPA2IDs.second) {
-        // APA 2, TPC 5
-        fAPA_id = 2;
-        title = "APA" + std::to_string(fAPA_id) + "_TATPs_ev" + std::to_string(fEventID) + "_run" + std::to_string(fRun) + "_ta" + std::to_string(ta);
-        fAPA2TAHIST.emplace_back(tfs->make<TH2D>(title.c_str(), ";Channel Number;Time (ticks)", 25, pCollectionAPA2IDs.first, pCollectionAPA2IDs.second, 20, 0, TAWindow));
-      }
-    }
-    if (current_chan >= pCollectionAPA4IDs.first) {
-      if (current_chan <= pCollectionAPA4IDs.second) {
-        // APA 4, TPC 6
-        fAPA_id = 4;
-        title = "APA" + std::to_string(fAPA_id) + "_TATPs_ev" + std::to_string(fEventID) + "_run" + std::to_string(fRun) + "_ta" + std::to_string(ta);
-        fAPA4TAHIST.emplace_back(tfs->make<TH2D>(title.c_str(), ";Channel Number;Time (ticks)", 25, pCollectionAPA4IDs.first, pCollectionAPA4IDs.second, 20, 0, TAWindow));
-      }
-    }
+  // Reservoir sampling over the sampled events, so every one is kept with the same probability
+  if (fReservoir.size() < fDiagnosticsReservoirSize) {
+    fReservoir.push_back(std::move(diagnostics));
+    return;
+  }
+  const size_t slot = std::uniform_int_distribution<size_t>(0, sampled)(fSampleRNG);
+  if (slot < fDiagnosticsReservoirSize) fReservoir[slot] = std::move(diagnostics);
+}
 
-    std::cout << "APA ID = " << fAPA_id << std::endl;
-    if (fAPA_id == 0) {
-      std::cout << "APA ID not set to one of the main volumes so remove." << std::endl;
-      return false;
-    }
+//-------------------------------------
+void PDHDVertexFilter::fillAggregate(TH1D *hist, double value) {
+  if (!hist) return;
+  std::lock_guard<std::mutex> lock(fDiagnosticsMutex);
+  hist->Fill(value);
+}
 
-    for (size_t tp = 0; tp < fTPs.size(); tp++) {
-      timestamp_t filltime = fTPs.at(tp)->time_start - first_tick;
-      if (fAPA_id == 1) {
-        fAPA1TAHIST.back()->Fill(static_cast<double>(fTPs.at(tp)->channel), static_cast<double>(filltime), static_cast<double>(fTPs.at(tp)->adc_integral));       
-      } else if (fAPA_id == 2) {
-        fAPA2TAHIST.back()->Fill(static_cast<double>(fTPs.at(tp)->channel), static_cast<double>(filltime), static_cast<double>(fTPs.at(tp)->adc_integral));       
-      } else if (fAPA_id == 3) {
-        fAPA3TAHIST.back()->Fill(static_cast<double>(fTPs.at(tp)->channel), static_cast<double>(filltime), static_cast<double>(fTPs.at(tp)->adc_integral));       
-      } else if (fAPA_id == 4) {
-        fAPA4TAHIST.back()->Fill(static_cast<double>(fTPs.at(tp)->channel), static_cast<double>(filltime), static_cast<double>(fTPs.at(tp)->adc_integral));       
-      }
-    }
-     
-    std::string title_timeproj = title + "_projTime";
-    if (fAPA_id == 1) {
-      TH1D *hTimeProj = fAPA1TAHIST.back()->ProjectionY(title_timeproj.c_str());
-      fAPA1_TimeProjHIST.emplace_back(tfs->make<TH1D>(*hTimeProj));
-      delete hTimeProj;
-    } else if (fAPA_id == 2) {
-      TH1D *hTimeProj = fAPA2TAHIST.back()->ProjectionY(title_timeproj.c_str());
-      fAPA2_TimeProjHIST.emplace_back(tfs->make<TH1D>(*hTimeProj));
-      delete hTimeProj;
-    } else if (fAPA_id == 3) {
-      TH1D *hTimeProj = fAPA3TAHIST.back()->ProjectionY(title_timeproj.c_str());
-      fAPA3_TimeProjHIST.emplace_back(tfs->make<TH1D>(*hTimeProj));
-      delete hTimeProj;
-    } else if (fAPA_id == 4) {
-      TH1D *hTimeProj = fAPA4TAHIST.back()->ProjectionY(title_timeproj.c_str());
-      fAPA4_TimeProjHIST.emplace_back(tfs->make<TH1D>(*hTimeProj));
-      delete hTimeProj;
-    }
+//-------------------------------------
+void PDHDVertexFilter::writeDiagnostics(EventDiagnostics const& diagnostics) {
+  art::ServiceHandle<art::TFileService> tfs;
+  for (const auto &taDiag : diagnostics) {
+    bookDiagnostic(*tfs, taDiag.title, ";Channel Number;Time (ticks)", taDiag.ta);
+    TH1D *hTimeProj = bookDiagnostic(*tfs, taDiag.title + "_projTime", ";Time (ticks)", taDiag.timeProj);
+    // Minuit fit of the same histogram, for comparison with the estimate
+    TF1 gaussFit("gaussFit", "gaus", taDiag.fitRangeMin, taDiag.fitRangeMax);
+    gaussFit.SetParameters(taDiag.peakHeight, taDiag.peakValue, 1000); // amplitude, mean, sigma
+    TFitResultPtr r = hTimeProj->Fit(&gaussFit, "RSQ");
+    mf::LogInfo("PDHDVertexFilter") << taDiag.title << " time: Mean = " << taDiag.timeFit.mean << ", sigma = " << taDiag.timeFit.sigma
+      << ", status = " << taDiag.timeFit.status << "; Minuit: Mean = " << r->Parameter(1) << ", sigma = " << r->Parameter(2)
+      << ", status = " << static_cast<Int_t>(r);
+
+    if (taDiag.chanProj) bookDiagnostic(*tfs, taDiag.title + "_projChan", ";Channel Number", *taDiag.chanProj);
+    if (taDiag.apa3Window) bookDiagnostic(*tfs, taDiag.title + "_APA3Window", ";Channel Number;Time (ticks)", *taDiag.apa3Window);
+  }
+}
 
-    TH2D *hAPAXTAHIST;
-    TH1D *hAPAXTimeProj;
-
-    if (fAPA_id == 1) {
-      hAPAXTAHIST = fAPA1TAHIST.back();
-      hAPAXTimeProj = fAPA1_TimeProjHIST.back();
-    } else if (fAPA_id == 2) {
-      hAPAXTAHIST = fAPA2TAHIST.back();
-      hAPAXTimeProj = fAPA2_TimeProjHIST.back();
-    } else if (fAPA_id == 3) {
-      hAPAXTAHIST = fAPA3TAHIST.back();
-      hAPAXTimeProj = fAPA3_TimeProjHIST.back();
-    } else { // APA 4
-      hAPAXTAHIST = fAPA4TAHIST.back();
-      hAPAXTimeProj = fAPA4_TimeProjHIST.back();
-    }
+//-------------------------------------
+bool PDHDVertexFilter::filter(art::Event & evt, art::ProcessingFrame const &) {
+  const auto timer = fCutFlow.time(fStage.event);
+  const std::optional<bool> cached = fROIs.produce() ? std::nullopt : fDecisionCache.lookup(evt);
+  std::vector<TPCROI> rois;
+  const bool pass = cached ? *cached : fTrace.traced([&] {
+    if (!sampleEvent()) return selectEvent(evt, nullptr, rois);
+
+    EventDiagnostics diagnostics;
+    const bool pass = selectEvent(evt, &diagnostics, rois);
+    storeDiagnostics(std::move(diagnostics));
+    return pass;
+  });
+  if (cached) fCutFlow.count(fCount.eventsCached);
+  else fDecisionCache.store(evt, pass);
+  fCutFlow.count(fCount.eventsSeen);
+  fCutFlow.count(pass ? fCount.eventsPassed : fCount.eventsFailed);
+  fROIs.put(evt, pass, std::move(rois));
+  return fTag.put(evt, SelectionCut::kVertex, pass);
+}
 
-    if (!hAPAXTAHIST || !hAPAXTimeProj) {
-      std::cerr << "[ERROR] Null histogram." << std::endl;
-      fEventPassesFilters = false;
-      continue;
-      //return false;
-    }
+//-------------------------------------
+bool PDHDVertexFilter::selectEvent(art::Event & evt, EventDiagnostics *diagnostics, std::vector<TPCROI>& rois) {
 
-    // >>> Shower spread in time filter
-    // Find the shower region in time using the time TP projections
-    // Get the bin with the maximum content (approximate peak position)
-    int peakBin = hAPAXTimeProj->GetMaximumBin();
-    double peakValue = hAPAXTimeProj->GetBinCenter(peakBin);
-    double peakHeight = hAPAXTimeProj->GetBinContent(peakBin);
+  const int fRun = evt.run();
+  const unsigned int fEventID = evt.id().event();
 
-    if (peakBin == hAPAXTimeProj->GetXaxis()->GetNbins()) {
-      std::cout << "[WARNING] Peak in time at the edge, gaussian likely to be a bad fit." << std::endl;
-    }
+  PDHD_TRACE(fTrace, TraceLevel::kInfo) << "###PDHDVertexFilter###";
+  PDHD_TRACE(fTrace, TraceLevel::kInfo) << "START PDHDVertexFilter for Event " << fEventID << " in Run " << fRun;
+  
+  // TPs across the detector and in each TA, partitioned and sorted by PDHDTPIndexProducer
+  auto tpIndexHandle = evt.getValidHandle<TPIndex>(fInputLabelTPIndex);
+  const TPIndex &tpIndex = *tpIndexHandle;
+  const TPColumns &detTPs = tpIndex.detector;
 
-    // Fit a gaussian around peak region
-    // Define a fitting range around the peak
-    double fitRangeMin = peakValue - 5000;
-    double fitRangeMax = peakValue + 5000;
-
-    // Get range in TA bounds
-    fitRangeMin = std::max(fitRangeMin, hAPAXTimeProj->GetXaxis()->GetXmin());
-    fitRangeMax = std::min(fitRangeMax, hAPAXTimeProj->GetXaxis()->GetXmax());
-
-    // Define a Gaussian function for fitting
-    TF1* timeFit = new TF1("gaussFit", "gaus", fitRangeMin, fitRangeMax);
-    // Set initial parameter guesses
-    timeFit->SetParameters(peakHeight, peakValue, 1000); // amplitude, mean, sigma
-
-    // Do fit
-    TFitResultPtr r = hAPAXTimeProj->Fit(timeFit, "RS");
-
-    double mean_time = r->Parameter(1);
-    double sigma_time = r->Parameter(2);
-    std::cout << "Time: Mean = " << mean_time << ", sigma = " << sigma_time << std::endl;
-   
-    if (mean_time >= 0 && mean_time <= TAWindow) {
-      if (sigma_time > 4000) {
-        std::cout << "Too broad in time. Remove." << std::endl;
-        fEventPassesFilters = false;
-        continue;
-        //return false;
-      }
-    } else {
-      std::cout << "Centre of shower outside time window. Remove." << std::endl;
-      fEventPassesFilters = false;
-      continue;
-    }
+  PDHD_TRACE(fTrace, TraceLevel::kDebug) << "There are " << detTPs.size() << " TPs across the detector.";
+  PDHD_TRACE(fTrace, TraceLevel::kDebug) << "There are " << tpIndex.nTAs() << " TAs.";
+  fillAggregate(fAggTAsPerEvent, tpIndex.nTAs());
 
-    Int_t timeFitStatus = r;
-    if (timeFitStatus != 0) {
-      std::cout << "[WARNING] Bad fit status " << timeFitStatus << ", so removing." << std::endl;
-      fEventPassesFilters = false;
-      continue;
-      //return false;
-    }
-    // >>> Shower spread filter end
-    
-    TH1D *hAPAXChanProj;
-    int timeRangeMinBin = hAPAXTimeProj->FindFixBin(fitRangeMin);
-    int timeRangeMaxBin = hAPAXTimeProj->FindFixBin(fitRangeMax);
-    std::string title_chanproj = title + "_projChan";
-
-    if (fAPA_id == 1) {
-      TH1D *hChanProj = fAPA1TAHIST.back()->ProjectionX(title_chanproj.c_str(), timeRangeMinBin, timeRangeMaxBin);
-      fAPA1_ChanProjHIST.emplace_back(tfs->make<TH1D>(*hChanProj));
-      delete hChanProj;
-      hAPAXChanProj = fAPA1_ChanProjHIST.back();
-    } else if (fAPA_id == 2) {
-      TH1D *hChanProj = fAPA2TAHIST.back()->ProjectionX(title_chanproj.c_str(), timeRangeMinBin, timeRangeMaxBin);
-      fAPA2_ChanProjHIST.emplace_back(tfs->make<TH1D>(*hChanProj));
-      delete hChanProj;
-      hAPAXChanProj = fAPA2_ChanProjHIST.back();
-    } else if (fAPA_id == 3) {
-      TH1D *hChanProj = fAPA3TAHIST.back()->ProjectionX(title_chanproj.c_str(), timeRangeMinBin, timeRangeMaxBin);
-      fAPA3_ChanProjHIST.emplace_back(tfs->make<TH1D>(*hChanProj));
-      delete hChanProj;
-      hAPAXChanProj = fAPA3_ChanProjHIST.back();
-    } else { // Must be APA 4
-      TH1D *hChanProj = fAPA4TAHIST.back()->ProjectionX(title_chanproj.c_str(), timeRangeMinBin, timeRangeMaxBin);
-      fAPA4_ChanProjHIST.emplace_back(tfs->make<TH1D>(*hChanProj));
-      delete hChanProj;
-      hAPAXChanProj = fAPA4_ChanProjHIST.back();
-    }
+  // The APA 3 main face is indexed in (channel, time) for the upstream veto windows of all TAs
+  const TPOccupancyIndex apa3Occupancy = [&] {
+    const auto timer = fCutFlow.time(fStage.occupancy);
+    return VertexSelector::apa3Occupancy(tpIndex);
+  }();
 
-    // >>> Channel search for vertex start
-    double minimum_region_bin(1e9);
-    for (int ch = 2; ch <= hAPAXChanProj->GetXaxis()->GetNbins() - 1; ch++) {
-      double region_amp = hAPAXChanProj->GetBinContent(ch-1) + hAPAXChanProj->GetBinContent(ch) + hAPAXChanProj->GetBinContent(ch+1);
-      if (region_amp < minimum_region_bin) {
-        minimum_region_bin = region_amp;
-      }
-    }
+  // Boolean to return - if any one of the TAs passes the filters, pass the whole event
+  bool fEventPassesFilters(true);
 
-    double maximum_region_bin(0);
-    for (int ch = 2; ch <= hAPAXChanProj->GetXaxis()->GetNbins() - 1; ch++) {
-      double region_amp = hAPAXChanProj->GetBinContent(ch-1) + hAPAXChanProj->GetBinContent(ch) + hAPAXChanProj->GetBinContent(ch+1);
-      if (region_amp > maximum_region_bin) {
-        maximum_region_bin = region_amp;
-      }
+  const std::string eventTag = "_ev" + std::to_string(fEventID) + "_run" + std::to_string(fRun);
+  const size_t nTAs = tpIndex.nTAs();
+  const bool parallel = fParallelTAs && nTAs >= fParallelMinTAs;
+  std::vector<TAResult> results;
+  if (parallel) results = evaluateTAsParallel(tpIndex, apa3Occupancy, eventTag, diagnostics != nullptr);
+
+  // The TAs in order up to the first one that decides the event, either evaluated
+  // here or replayed from the parallel results
+  for (size_t ta = 0; ta < nTAs; ta++) {
+    TAResult serialResult;
+    TAResult &result = parallel ? results[ta] : serialResult;
+    if (parallel) {
+      if (result.log) fTrace.buffer().append(*result.log);
+    } else {
+      const auto timer = fCutFlow.time(fStage.ta);
+      result.ta = fSelector.evaluateTA(tpIndex, apa3Occupancy, ta, fTrace.sink(), diagnostics ? &eventTag : nullptr);
     }
-
-    // I think I only want a vertex cut in APA 3... too risky otherwise
-    if (fAPA_id == 3) {
-      // Minimum region is to the left - vertex in TPC volume
-      if (minimum_region_bin < maximum_region_bin) {
-        // Find max difference between adjacent bins between min and max region
-        double max_diff(0);
-        double old_diff(0);
-        int max_diff_bin = minimum_region_bin;
-        for (int ch = minimum_region_bin; ch  <= maximum_region_bin; ch++) {
-          double diff = hAPAXChanProj->GetBinContent(ch) - hAPAXChanProj->GetBinContent(ch-1);
-          if (old_diff < 0) {
-            old_diff = diff;   
-            continue;
-          }
-          old_diff = diff;
-          if (diff > max_diff) {
-            max_diff = diff;
-            max_diff_bin = ch;
-          }
-        }
-        // Assume that start of the shower (vertex) is 2 bins back from max difference bin
-        int vertex_chan_bin = max_diff_bin - 2;
-        double vertex_chan = hAPAXChanProj->GetBinCenter(vertex_chan_bin);
-        std::cout << ">>> Vertex approx. at channel: " << vertex_chan << std::endl;
-        if (vertex_chan < (pCollectionAPA3IDs.first + 40)) {
-          std::cout << "Vertex likely to be within the first 40 channels of APA3 collection plane. Remove." << std::endl;
-          return false;
-        }
-      } else {
-        double first_minimum_region_bin(1e9);
-        // Count back from the maximum region to find the minimum point to the left of the max region
-        for (int ch = maximum_region_bin; ch >= 1; ch--) {
-          double region_amp = hAPAXChanProj->GetBinContent(ch-1) + hAPAXChanProj->GetBinContent(ch) + hAPAXChanProj->GetBinContent(ch+1);
-          if (region_amp < first_minimum_region_bin) {
-            first_minimum_region_bin = region_amp;
-          }
-        }
-
-        // If the minimum region to the left of the max region is more than half the height of the max region then remove event
-        if (hAPAXChanProj->GetBinContent(first_minimum_region_bin) > 0.5*hAPAXChanProj->GetBinContent(maximum_region_bin)) {
-          std::cout << "First minimum region has too many hits - shower likely entering from outside. Remove." << std::endl;
-          fEventPassesFilters = false;
-          continue;
-          //return false;
-        }
-
-        // So the minimum to the left of the max region is small enough
-        // Now repeat the vertex channel finding from above
-        double max_diff(0);
-        double old_diff(0);
-        int max_diff_bin = minimum_region_bin;
-        for (int ch = minimum_region_bin; ch  <= maximum_region_bin; ch++) {
-          double diff = hAPAXChanProj->GetBinContent(ch) - hAPAXChanProj->GetBinContent(ch-1);
-          if (old_diff < 0) {
-            old_diff = diff;   
-            continue;
-          }
-          old_diff = diff;
-          if (diff > max_diff) {
-            max_diff = diff;
-            max_diff_bin = ch;
-          }
-        }
-        // Assume that start of the shower (vertex) is 2 bins back from max difference bin
-        int vertex_chan_bin = max_diff_bin - 2;
-        double vertex_chan = hAPAXChanProj->GetBinCenter(vertex_chan_bin);
-        std::cout << ">>> Vertex approx. at channel: " << vertex_chan << std::endl;
-        if (vertex_chan < (pCollectionAPA3IDs.first + 40)) {
-          std::cout << "Vertex likely to be within the first 40 channels of APA3 collection plane or outside the detector. Remove." << std::endl;
-          fEventPassesFilters = false;
-          continue;
-          //return false;
-        }
-      }
+    const TADecision decision = result.ta.decision;
+    recordTA(result.ta, diagnostics);
+    if (fROIs.produce() && decision == TADecision::kPass) {
+      const VetoWindow window = VertexSelector::showerWindow(tpIndex, ta, result.ta);
+      addTAROIs(tpIndex, ta, window.start, window.end, fROIs.padding(), rois);
     }
-    // >>> Channel search for vertex end
-    
-    // >>> External muon filter start
-    // This cut only works for APA 3/4 because of the broken collection plane on APA1
-    if (fAPA_id == 3 || fAPA_id == 4) { 
-      // Get narrow region in time around shower peak
-      timestamp_t fShowerCenter = static_cast<timestamp_t>(mean_time);
-      timestamp_t fShowerUpperBound = fShowerCenter + 0.5*static_cast<timestamp_t>(sigma_time);
-      timestamp_t fShowerLowerBound = fShowerCenter - 0.5*static_cast<timestamp_t>(sigma_time);
-    
-      std::string title_apa3window = title + "_APA3Window";
-      fAPA3WindowHIST.emplace_back(tfs->make<TH2D>(title_apa3window.c_str(), ";Channel Number;Time (ticks)", 50, pCollectionAPA3IDs.first, pCollectionAPA3IDs.second, 40, fShowerLowerBound, fShowerUpperBound));
-
-      std::vector<triggerprimitive_t> fAPA3TPsInShowerWindow;
-      for (const auto &TP : fTriggerPrimitive) {
-
-        channel_t current_chan = TP.channel;
-
-        bool fInAPA3(false);
-        if (current_chan >= pCollectionAPA3IDs.first) {
-          if (current_chan <= pCollectionAPA3IDs.second) {
-            // APA 3, TPC 2
-            fInAPA3 = true;
-          }
-        }
-        if (!fInAPA3) continue;
-        // Look at all TPs in APA 3 and look for track in small time window
-        // Events in with trigger APA 1 or 2 should already have passed filter
-        timestamp_t filltime = TP.time_peak - first_tick;
-        if (filltime <= fShowerUpperBound && filltime >= fShowerLowerBound) {
-          fAPA3TPsInShowerWindow.push_back(TP);
-          // Just want to see the number of hits in this histogram
-          fAPA3WindowHIST.back()->Fill(static_cast<double>(TP.channel), static_cast<double>(filltime));
-        }
-      }
-
-      std::cout << "fAPA3TPsInShowerWindow size = " << fAPA3TPsInShowerWindow.size() << std::endl;
 
-      // Sort TPs in APA 3 time window in channel order
-      std::sort(fAPA3TPsInShowerWindow.begin(), fAPA3TPsInShowerWindow.end(),
-          [] (const triggerprimitive_t &lh, const triggerprimitive_t &rh) -> bool { return lh.channel < rh.channel; });
+    // Found at least 1 TA that passed these filters, so pass the whole event on to reconstruction
+    VertexSelector::fold(decision, fEventPassesFilters);
+    if (VertexSelector::decisive(decision)) break;
+  }
+      
+  PDHD_TRACE(fTrace, TraceLevel::kInfo) << "END PDHDVertexFilter for Event " << fEventID << " in Run " << fRun;
 
-      int number_hits_window(0);
-      channel_t start_chan = pCollectionAPA3IDs.first;
-      // Look at first 40 channels
-      channel_t end_chan = pCollectionAPA3IDs.first + fUpstreamVetoChannels;
-      channel_t veto_threshold = 0.9 * fUpstreamVetoChannels;
+  return fEventPassesFilters;
+}
 
-      for (size_t tp_it = 0; tp_it < fAPA3TPsInShowerWindow.size(); tp_it++){
-        if (fAPA3TPsInShowerWindow.at(tp_it).channel >= start_chan && fAPA3TPsInShowerWindow.at(tp_it).channel <= end_chan) {
-          number_hits_window++;
+//-------------------------------------
+std::vector<TAResult> PDHDVertexFilter::evaluateTAsParallel(TPIndex const& tpIndex, TPOccupancyIndex const& apa3Occupancy,
+                                                            std::string const& eventTag, bool recordDiagnostics) const {
+  const size_t nTAs = tpIndex.nTAs();
+  std::vector<TAResult> results(nTAs);
+  // Lowest TA that passed or rejected the event so far; later TAs cannot change the decision and are not started.
+  // Every TA before the final value is evaluated, so the serial loop can be replayed exactly
+  std::atomic<size_t> firstDecisive(nTAs);
+
+  // Isolated: while this thread waits for the TAs it only runs TA tasks, never another event's
+  // call of a module, which would write into and flush the trace ring of the event in progress
+  tbb::this_task_arena::isolate([&] {
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, nTAs, 1), [&] (tbb::blocked_range<size_t> const& range) {
+      for (size_t ta = range.begin(); ta != range.end(); ta++) {
+        if (ta > firstDecisive.load(std::memory_order_relaxed)) continue;
+
+        TAResult &result = results[ta];
+        TraceBuffer &log = result.log.emplace(kTALogLines);
+        const auto timer = fCutFlow.time(fStage.ta);
+        result.ta = fSelector.evaluateTA(tpIndex, apa3Occupancy, ta, fTrace.sink(log), recordDiagnostics ? &eventTag : nullptr);
+
+        if (VertexSelector::decisive(result.ta.decision)) {
+          size_t current = firstDecisive.load();
+          while (ta < current && !firstDecisive.compare_exchange_weak(current, ta)) {}
         }
       }
-      // Fail filter if more than 90% of channels in the first fUpstreamVetoChannels on APA 3 collection plane have TP hits
-      if (number_hits_window >= static_cast<int>(veto_threshold)) {
-        std::cout << "There are " << number_hits_window << " hits in first " << fUpstreamVetoChannels << " APA 3 collection plane channels so remove." << std::endl;
-        fEventPassesFilters = false;
-        continue;
-        //return false;
-      } else {
-        std::cout << "There are " << number_hits_window << " hits in first " << fUpstreamVetoChannels <<  " collection plane. No external muon so pass filter!" << std::endl;
-      }
-      // >>> External muon filter end
+    });
+  });
+  return results;
+}
 
-    }
-    // Found at least 1 TA that passed these filters, so pass the whole event on to reconstruction
-    fEventPassesFilters = true;
-    break;
+//-------------------------------------
+void PDHDVertexFilter::recordTA(VertexTAResult& result, EventDiagnostics *diagnostics) {
+  fCutFlow.count(fCount.tasSeen);
+  fCutFlow.count(fCount.tas[static_cast<size_t>(result.cut)]);
+  if (result.timeFit) {
+    fillAggregate(fAggFitStatus, result.timeFit->status);
+    fillAggregate(fAggMeanTime, result.timeFit->mean);
+    fillAggregate(fAggSigmaTime, result.timeFit->sigma);
   }
-      
-  std::cout << "END PDHDVertexFilter for Event " << fEventID << " in Run " << fRun << std::endl << std::endl;
-
-  return fEventPassesFilters;
+  if (result.vertexChannel) fillAggregate(fAggVertexChannel, *result.vertexChannel);
+  if (result.vetoCount) fillAggregate(fAggVetoCount, *result.vetoCount);
+  if (diagnostics && result.diagnostics) diagnostics->push_back(std::move(*result.diagnostics));
 }
 
 DEFINE_ART_MODULE(PDHDVertexFilter)
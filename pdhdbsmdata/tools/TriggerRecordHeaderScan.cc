@@ -0,0 +1,119 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        TriggerRecordHeaderScan.cc
+//////////////////////////////////////////////////////////////////////////
+
+#include "pdhdbsmdata/tools/TriggerRecordHeaderScan.h"
+
+#include <algorithm>
+#include <cstring>
+#include <tuple>
+
+#include "hdf5.h"
+
+#include "cetlib_except/exception.h"
+
+namespace pdhd {
+
+namespace {
+
+  template <typename T>
+  T readField(const unsigned char *data, std::size_t offset) {
+    T value;
+    std::memcpy(&value, data + offset, sizeof(T));
+    return value;
+  }
+
+  // Closes an HDF5 handle when going out of scope
+  class H5Handle {
+    public:
+      H5Handle(hid_t id, herr_t (*close)(hid_t)) : fId(id), fClose(close) {}
+      ~H5Handle() { if (fId >= 0) fClose(fId); }
+      H5Handle(H5Handle const&) = delete;
+      H5Handle& operator=(H5Handle const&) = delete;
+      hid_t get() const { return fId; }
+      bool valid() const { return fId >= 0; }
+    private:
+      hid_t fId;
+      herr_t (*fClose)(hid_t);
+  };
+
+  herr_t collectRecordNames(hid_t, const char *name, const H5L_info_t *, void *names) {
+    if (std::strncmp(name, "TriggerRecord", 13) == 0) {
+      static_cast<std::vector<std::string>*>(names)->emplace_back(name);
+    }
+    return 0;
+  }
+
+}
+
+//-------------------------------------
+bool decodeTriggerRecordHeader(const unsigned char* data, std::size_t size, TriggerRecordStamp& stamp) {
+  if (size < kTriggerRecordHeaderFixedSize || readField<uint32_t>(data, 0) != kTriggerRecordHeaderMarker) {
+    return false;
+  }
+  stamp.trigger_number = readField<uint64_t>(data, 8);
+  stamp.trigger_timestamp = readField<uint64_t>(data, 16);
+  stamp.run_number = readField<uint32_t>(data, 32);
+  stamp.sequence_number = readField<uint16_t>(data, 42);
+  return true;
+}
+
+//-------------------------------------
+std::vector<TriggerRecordStamp> scanTriggerRecordHeaders(std::string const& fileName) {
+  // Errors are reported through exceptions, keep the HDF5 error stack quiet
+  H5Eset_auto2(H5E_DEFAULT, nullptr, nullptr);
+
+  H5Handle file(H5Fopen(fileName.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT), H5Fclose);
+  if (!file.valid()) {
+    throw cet::exception("TriggerRecordHeaderScan") << "Cannot open HDF5 file " << fileName << "\n";
+  }
+
+  std::vector<std::string> records;
+  H5Literate(file.get(), H5_INDEX_NAME, H5_ITER_INC, nullptr, collectRecordNames, &records);
+
+  std::vector<TriggerRecordStamp> stamps;
+  stamps.reserve(records.size());
+
+  unsigned char buffer[kTriggerRecordHeaderFixedSize];
+  for (const auto &record : records) {
+    const std::string path = record + "/RawData/TriggerRecordHeader";
+    H5Handle dataset(H5Dopen2(file.get(), path.c_str(), H5P_DEFAULT), H5Dclose);
+    if (!dataset.valid()) {
+      throw cet::exception("TriggerRecordHeaderScan") << "No " << path << " in " << fileName << "\n";
+    }
+
+    H5Handle space(H5Dget_space(dataset.get()), H5Sclose);
+    const hssize_t npoints = H5Sget_simple_extent_npoints(space.get());
+    if (npoints < static_cast<hssize_t>(kTriggerRecordHeaderFixedSize) || H5Sget_simple_extent_ndims(space.get()) != 1) {
+      throw cet::exception("TriggerRecordHeaderScan") << path << " in " << fileName << " is not a trigger record header\n";
+    }
+
+    // Read the fixed part of the header only
+    hsize_t start = 0;
+    hsize_t count = kTriggerRecordHeaderFixedSize;
+    H5Sselect_hyperslab(space.get(), H5S_SELECT_SET, &start, nullptr, &count, nullptr);
+    H5Handle memspace(H5Screate_simple(1, &count, nullptr), H5Sclose);
+
+    // Read the raw bytes with the dataset's own type: converting a signed char
+    // dataset to unsigned char would clip every byte above 127
+    H5Handle type(H5Dget_type(dataset.get()), H5Tclose);
+    if (H5Tget_size(type.get()) != 1) {
+      throw cet::exception("TriggerRecordHeaderScan") << path << " in " << fileName << " is not a byte array\n";
+    }
+
+    TriggerRecordStamp stamp;
+    if (H5Dread(dataset.get(), type.get(), memspace.get(), space.get(), H5P_DEFAULT, buffer) < 0 ||
+        !decodeTriggerRecordHeader(buffer, sizeof(buffer), stamp)) {
+      throw cet::exception("TriggerRecordHeaderScan") << "Cannot decode " << path << " in " << fileName << "\n";
+    }
+    stamps.push_back(stamp);
+  }
+
+  std::sort(stamps.begin(), stamps.end(),
+      [] (const TriggerRecordStamp &lh, const TriggerRecordStamp &rh) -> bool {
+        return std::tie(lh.trigger_number, lh.sequence_number) < std::tie(rh.trigger_number, rh.sequence_number); });
+
+  return stamps;
+}
+
+}
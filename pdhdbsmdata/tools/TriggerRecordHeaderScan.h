@@ -0,0 +1,46 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        TriggerRecordHeaderScan.h
+////
+//// Reads only the TriggerRecordHeader datasets of a raw DAQ .hdf5 file,
+//// i.e. /TriggerRecordNNNNNN.SSSS/RawData/TriggerRecordHeader, and none
+//// of the detector fragments. Only the fixed part of the header is read:
+////
+////   offset  0  uint32 marker (0x33334444)
+////   offset  4  uint32 version
+////   offset  8  uint64 trigger_number
+////   offset 16  uint64 trigger_timestamp (62.5 MHz ticks)
+////   offset 32  uint32 run_number
+////   offset 42  uint16 sequence_number
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef PDHDBSMDATA_TOOLS_TRIGGERRECORDHEADERSCAN_H
+#define PDHDBSMDATA_TOOLS_TRIGGERRECORDHEADERSCAN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace pdhd {
+
+struct TriggerRecordStamp {
+  uint32_t run_number = 0;
+  uint64_t trigger_number = 0;
+  uint16_t sequence_number = 0;
+  uint64_t trigger_timestamp = 0; // DAQ clock ticks
+};
+
+constexpr uint32_t kTriggerRecordHeaderMarker = 0x33334444;
+constexpr std::size_t kTriggerRecordHeaderFixedSize = 48;
+
+// Decode the fixed part of a serialised TriggerRecordHeader. Returns false
+// if the buffer is too short or the marker does not match.
+bool decodeTriggerRecordHeader(const unsigned char* data, std::size_t size, TriggerRecordStamp& stamp);
+
+// Stamps of all trigger records in the file, in trigger record order.
+// Throws cet::exception if the file or a header cannot be read.
+std::vector<TriggerRecordStamp> scanTriggerRecordHeaders(std::string const& fileName);
+
+}
+
+#endif
@@ -0,0 +1,261 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        filterbench.cc
+//// Executable:  pdhd_filter_bench
+////
+//// Timing of the filter kernels on synthetic events (SyntheticEvents.h)
+//// at several sizes, with the decisions kept as a reference:
+////   - spill:   SpillSelector on spill tables of 1k, 10k and 100k spills,
+////              the linear scan the filter used to do (on a sample of
+////              the lookups), binary search and the cursor, which must
+////              all agree;
+////   - extmuon: ExtMuonSelector::select;
+////   - vertex:  the APA 3 occupancy index and VertexSelector::select;
+//// the last two on events with 2k, 20k and 100k noise TPs, cycling
+//// through the topologies. For each kernel and size the number of
+//// events passed and a hash of the decisions are printed. With -o they
+//// are written to a file, and with -g they are compared with one; any
+//// difference is an error, so a faster kernel can be checked against
+//// test/filter_bench_golden.txt.
+////
+//// Usage: pdhd_filter_bench [-e events] [-l spill lookups] [-s seed] [-g golden file] [-o output file]
+//////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "pdhdbsmdata/Algorithms/ExtMuonSelector.h"
+#include "pdhdbsmdata/Algorithms/SpillSelector.h"
+#include "pdhdbsmdata/Algorithms/SpillTableIO.h"
+#include "pdhdbsmdata/Algorithms/SpillTimeline.h"
+#include "pdhdbsmdata/Algorithms/SyntheticEvents.h"
+#include "pdhdbsmdata/Algorithms/TraceBuffer.h"
+#include "pdhdbsmdata/Algorithms/VertexSelector.h"
+
+namespace {
+
+  using clock_type = std::chrono::steady_clock;
+  using pdhd::SyntheticTopology;
+
+  constexpr std::array<std::size_t, 3> kSpillSizes = {1000, 10000, 100000};
+  constexpr std::array<std::size_t, 3> kNoiseSizes = {2000, 20000, 100000};
+  constexpr std::size_t kNTopologies = static_cast<std::size_t>(SyntheticTopology::kNTopologies);
+  constexpr std::size_t kLinearLookups = 2000; // The linear scan is O(n), it is timed on a sample
+  constexpr uint32_t kVetoChannels = 40;
+  constexpr uint64_t kPoTThreshold = 1000000000000ULL;
+  constexpr uint64_t kFirstTimestamp = 106000000000000000ULL; // DAQ ticks, mid 2024
+
+  void usage(const char *name) {
+    std::cerr << "Usage: " << name << " [-e events] [-l spill lookups] [-s seed] [-g golden file] [-o output file]\n";
+  }
+
+  double elapsed(clock_type::time_point start) {
+    return std::chrono::duration<double>(clock_type::now() - start).count();
+  }
+
+  // Decisions of one kernel at one size, as a line of the golden file
+  struct Decisions {
+    std::string kernel;
+    std::size_t size;
+    std::vector<uint8_t> pass;
+
+    std::string line() const {
+      std::size_t passed(0);
+      for (const auto &p : pass) passed += p;
+      char hash[17];
+      std::snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(pdhd::fnv1a64(pass.data(), pass.size())));
+      std::ostringstream out;
+      out << kernel << " " << size << " " << pass.size() << " " << passed << " " << hash;
+      return out.str();
+    }
+  };
+
+  // The scan of the spill table PDHDSPSSpillFilter did before SpillTimeline, with its edges fixed
+  pdhd::SpillTimeline::Lookup linearLookup(pdhd::SpillTimeline const& timeline, pdhd::spilltime_t t_ms) {
+    std::size_t upper = 0;
+    while (upper < timeline.size() && timeline.start(upper) <= t_ms) upper++;
+    pdhd::SpillTimeline::Lookup lookup;
+    if (upper > 0) {
+      lookup.spill = upper - 1;
+      lookup.on = t_ms < timeline.end(lookup.spill);
+    }
+    return lookup;
+  }
+
+  Decisions benchSpill(std::size_t nSpills, std::size_t nLookups, uint64_t seed, bool &agree) {
+    pdhd::SyntheticRandom random(seed);
+    const pdhd::SpillTimeline timeline(pdhd::makeSyntheticSpills(random, nSpills, pdhd::daqTicksToMs(kFirstTimestamp)));
+    const pdhd::SpillSelector selector(true, kPoTThreshold);
+
+    // Event times over the whole table, increasing with a jitter as they come from the DAQ
+    const pdhd::spilltime_t span = timeline.end(timeline.size() - 1) - timeline.start(0);
+    std::vector<pdhd::spilltime_t> times(nLookups);
+    for (std::size_t i = 0; i < nLookups; i++) times[i] = timeline.start(0) + span * i / nLookups + random.uniform(0, 2000) - 1000;
+
+    Decisions decisions{"spill", nSpills, std::vector<uint8_t>(nLookups)};
+    std::vector<uint8_t> searched(nLookups);
+    auto start = clock_type::now();
+    for (std::size_t i = 0; i < nLookups; i++) searched[i] = selector.decide(timeline, times[i]).pass;
+    const double searchTime = elapsed(start);
+
+    pdhd::SpillTimeline::Cursor cursor(timeline);
+    start = clock_type::now();
+    for (std::size_t i = 0; i < nLookups; i++) decisions.pass[i] = selector.decide(timeline, cursor.lookup(times[i])).pass;
+    const double cursorTime = elapsed(start);
+
+    const std::size_t stride = std::max<std::size_t>(1, nLookups / kLinearLookups);
+    std::size_t nLinear(0);
+    start = clock_type::now();
+    for (std::size_t i = 0; i < nLookups; i += stride, nLinear++) {
+      agree &= selector.decide(timeline, linearLookup(timeline, times[i])).pass == searched[i];
+    }
+    const double linearTime = elapsed(start);
+
+    agree &= searched == decisions.pass;
+    std::cout << "spill    " << nSpills << " spills: linear scan " << linearTime * 1e9 / nLinear
+      << " ns/lookup, binary search " << searchTime * 1e9 / nLookups
+      << " ns/lookup, cursor " << cursorTime * 1e9 / nLookups << " ns/lookup\n";
+    return decisions;
+  }
+
+  void benchTPs(std::size_t nNoise, std::size_t nEvents, uint64_t seed, std::vector<Decisions>& results) {
+    pdhd::SyntheticConfig config;
+    config.noiseTPs = nNoise;
+    pdhd::SyntheticEventGenerator generator(seed + nNoise, config);
+
+    std::vector<pdhd::TPIndex> indices;
+    std::vector<SyntheticTopology> topologies;
+    double indexTime(0);
+    std::size_t nTPs(0);
+    for (std::size_t e = 0; e < nEvents; e++) {
+      const auto topology = static_cast<SyntheticTopology>(e % kNTopologies);
+      const pdhd::SyntheticEvent event = generator.generate(topology, kFirstTimestamp + e * 62500000);
+      nTPs += event.tps.size();
+      const auto start = clock_type::now();
+      indices.push_back(pdhd::makeTPIndex(event));
+      indexTime += elapsed(start);
+      topologies.push_back(topology);
+    }
+
+    pdhd::TraceBuffer buffer(16);
+    const pdhd::TraceSink log(buffer, pdhd::TraceLevel::kOff);
+
+    Decisions extMuon{"extmuon", nNoise, std::vector<uint8_t>(nEvents)};
+    const pdhd::ExtMuonSelector extMuonSelector(kVetoChannels, pdhd::VetoCountMode::kHits);
+    auto start = clock_type::now();
+    for (std::size_t e = 0; e < nEvents; e++) extMuon.pass[e] = extMuonSelector.select(indices[e], log).pass;
+    const double extMuonTime = elapsed(start);
+
+    Decisions vertex{"vertex", nNoise, std::vector<uint8_t>(nEvents)};
+    const pdhd::VertexSelector vertexSelector(kVetoChannels, pdhd::VetoCountMode::kHits);
+    start = clock_type::now();
+    for (std::size_t e = 0; e < nEvents; e++) {
+      const pdhd::TPOccupancyIndex occupancy = pdhd::VertexSelector::apa3Occupancy(indices[e]);
+      vertex.pass[e] = vertexSelector.select(indices[e], occupancy, log, [] (std::size_t, pdhd::VertexTAResult const&) {});
+    }
+    const double vertexTime = elapsed(start);
+
+    const double perEvent = 1e6 / nEvents;
+    std::cout << "events   " << nNoise << " noise TPs, " << nTPs / nEvents << " TPs per event: TP index " << indexTime * perEvent << " us/event\n"
+      << "extmuon  " << extMuonTime * perEvent << " us/event\n"
+      << "vertex   " << vertexTime * perEvent << " us/event\n";
+    for (std::size_t t = 0; t < kNTopologies; t++) {
+      std::size_t n(0), extMuonPassed(0), vertexPassed(0);
+      for (std::size_t e = 0; e < nEvents; e++) {
+        if (static_cast<std::size_t>(topologies[e]) != t) continue;
+        n++;
+        extMuonPassed += extMuon.pass[e];
+        vertexPassed += vertex.pass[e];
+      }
+      std::cout << "  " << pdhd::syntheticTopologyName(static_cast<SyntheticTopology>(t)) << ": " << n << " events, extmuon passed "
+        << extMuonPassed << ", vertex passed " << vertexPassed << "\n";
+    }
+
+    results.push_back(std::move(extMuon));
+    results.push_back(std::move(vertex));
+  }
+
+}
+
+int main(int argc, char **argv) {
+  std::size_t nEvents = 200;
+  std::size_t nLookups = 100000;
+  uint64_t seed = 20241016;
+  std::string goldenFile, outputFile;
+
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if ((arg == "-e" || arg == "-l" || arg == "-s") && i + 1 < argc) {
+      const uint64_t value = std::stoull(argv[++i]);
+      if (arg == "-e") nEvents = value;
+      else if (arg == "-l") nLookups = value;
+      else seed = value;
+    } else if ((arg == "-g" || arg == "-o") && i + 1 < argc) {
+      (arg == "-g" ? goldenFile : outputFile) = argv[++i];
+    } else {
+      usage(argv[0]);
+      return arg == "-h" || arg == "--help" ? 0 : 1;
+    }
+  }
+  if (nEvents == 0 || nLookups == 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::vector<Decisions> results;
+  bool spillAgree(true);
+  for (const auto &nSpills : kSpillSizes) results.push_back(benchSpill(nSpills, nLookups, seed, spillAgree));
+  for (const auto &nNoise : kNoiseSizes) benchTPs(nNoise, nEvents, seed, results);
+
+  std::vector<std::string> lines;
+  std::cout << "\nkernel size events passed hash\n";
+  for (const auto &result : results) {
+    lines.push_back(result.line());
+    std::cout << lines.back() << "\n";
+  }
+
+  if (!outputFile.empty()) {
+    std::ofstream out(outputFile);
+    out << "# pdhd_filter_bench -e " << nEvents << " -l " << nLookups << " -s " << seed << "\n"
+        << "# kernel size events passed hash\n";
+    for (const auto &line : lines) out << line << "\n";
+    if (!out) {
+      std::cerr << "[ERROR] Failed to write " << outputFile << "\n";
+      return 1;
+    }
+  }
+
+  int status(0);
+  if (!spillAgree) {
+    std::cerr << "[ERROR] Spill decisions differ between the linear scan, the binary search and the cursor.\n";
+    status = 2;
+  }
+  if (!goldenFile.empty()) {
+    std::ifstream in(goldenFile);
+    if (!in) {
+      std::cerr << "[ERROR] Cannot open " << goldenFile << "\n";
+      return 1;
+    }
+    std::vector<std::string> golden;
+    for (std::string line; std::getline(in, line);) {
+      if (!line.empty() && line[0] != '#') golden.push_back(line);
+    }
+    for (std::size_t i = 0; i < std::max(golden.size(), lines.size()); i++) {
+      const std::string expected = i < golden.size() ? golden[i] : "(none)";
+      const std::string found = i < lines.size() ? lines[i] : "(none)";
+      if (expected != found) {
+        std::cerr << "[ERROR] Decisions differ from " << goldenFile << ": expected \"" << expected << "\", found \"" << found << "\"\n";
+        status = 2;
+      }
+    }
+    if (status == 0) std::cout << "Decisions match " << goldenFile << "\n";
+  }
+  return status;
+}
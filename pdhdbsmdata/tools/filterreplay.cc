@@ -0,0 +1,366 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        filterreplay.cc
+//// Executable:  pdhd_filter_replay
+////
+//// Replay of the filter chain outside of art, on trigger snapshots
+//// written by the PDHDTriggerSnapshot analyzer (or on synthetic events).
+//// The cuts are the selectors of the filter modules, applied in the
+//// given order until one rejects the event:
+////   spill        SpillSelector, needs --spill-data
+////   triggertype  TCTypeSelector with the "any" policy
+////   extmuon      ExtMuonSelector
+////   vertex       VertexSelector
+//// The snapshots are mapped and the cuts read the objects of each event
+//// in place. The events are taken in batches and the batches are decided
+//// event by event on the TBB pool, whose threads steal events from each
+//// other, so uneven events do not leave cores idle. At the end the events and
+//// rejections per cut and the rates are printed; -o writes the decision
+//// of every event.
+////
+//// Usage: pdhd_filter_replay [options] snapshot files...
+//////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "tbb/blocked_range.h"
+#include "tbb/global_control.h"
+#include "tbb/info.h"
+#include "tbb/parallel_for.h"
+
+#include "cetlib_except/exception.h"
+
+#include "pdhdbsmdata/Algorithms/ExtMuonSelector.h"
+#include "pdhdbsmdata/Algorithms/SpillDataDirectory.h"
+#include "pdhdbsmdata/Algorithms/SpillSelector.h"
+#include "pdhdbsmdata/Algorithms/SyntheticEvents.h"
+#include "pdhdbsmdata/Algorithms/TCTypeSelector.h"
+#include "pdhdbsmdata/Algorithms/TraceBuffer.h"
+#include "pdhdbsmdata/Algorithms/TriggerSnapshot.h"
+#include "pdhdbsmdata/Algorithms/VertexSelector.h"
+
+namespace {
+
+  using clock_type = std::chrono::steady_clock;
+
+  enum class Cut : uint8_t { kSpill, kTriggerType, kExtMuon, kVertex };
+  constexpr const char* kCutNames[] = {"spill", "triggertype", "extmuon", "vertex"};
+  constexpr uint8_t kPassed = 0xFF; // Rejected-by of an event that passes
+
+  void usage(const char *name) {
+    std::cerr << "Usage: " << name << " [options] snapshot files...\n"
+      << "  -j N                 threads (default: all cores)\n"
+      << "  -c cuts              comma-separated cuts in order (default: triggertype,extmuon,vertex,\n"
+      << "                       with spill first if --spill-data is given)\n"
+      << "  -b N                 events per batch (default 4096)\n"
+      << "  -o file              write \"run subrun event pass rejected_by\" per event\n"
+      << "  --spill-data dir     SPS spill tables (spillrunNNNNNN.csv/.spillbin)\n"
+      << "  --spill-off          select events outside the spills\n"
+      << "  --pot-threshold PoT  minimum PoT of a spill (default 1e12)\n"
+      << "  --reject-types list  comma-separated TC types that veto (default kADCSimpleWindow)\n"
+      << "  --veto-channels N    upstream veto channels (default 40)\n"
+      << "  --veto-mode mode     \"hits\" or \"channels\" (default hits)\n"
+      << "  --synthetic N        replay N synthetic events instead of snapshot files\n"
+      << "  --write-synthetic f  also write the synthetic events to the snapshot f\n";
+  }
+
+  // Whole argument as a number
+  template <typename T>
+  bool parseNumber(std::string const& arg, T& value) {
+    const auto result = std::from_chars(arg.data(), arg.data() + arg.size(), value);
+    return result.ec == std::errc() && result.ptr == arg.data() + arg.size();
+  }
+
+  std::vector<std::string> splitList(std::string const& list) {
+    std::vector<std::string> items;
+    std::istringstream in(list);
+    for (std::string item; std::getline(in, item, ',');) {
+      if (!item.empty()) items.push_back(item);
+    }
+    return items;
+  }
+
+  double elapsed(clock_type::time_point start) {
+    return std::chrono::duration<double>(clock_type::now() - start).count();
+  }
+
+  // The cuts of the chain, shared read-only by the threads
+  class FilterChain {
+    public:
+      FilterChain(std::vector<Cut> cuts, std::unique_ptr<pdhd::SpillDataDirectory> spillData, pdhd::SpillSelector spill,
+                  pdhd::TCTypeSelector triggerType, pdhd::ExtMuonSelector extMuon, pdhd::VertexSelector vertex) :
+        fCuts(std::move(cuts)),
+        fSpillData(std::move(spillData)),
+        fSpill(spill),
+        fTriggerType(std::move(triggerType)),
+        fExtMuon(extMuon),
+        fVertex(vertex) {}
+
+      std::vector<Cut> const& cuts() const { return fCuts; }
+
+      // Load the spill tables of the runs of the batch, before it is decided
+      void prepare(std::vector<pdhd::TriggerEventView> const& events, std::size_t n) {
+        if (!fSpillData) return;
+        for (std::size_t e = 0; e < n; e++) {
+          if (fTimelines.count(events[e].run)) continue;
+          if (!fSpillData->hasRun(events[e].run)) {
+            throw cet::exception("pdhd_filter_replay") << "No SPS spill data for run " << events[e].run << " in " << fSpillData->path() << "\n";
+          }
+          std::string cacheError;
+          fTimelines.emplace(events[e].run, fSpillData->load(events[e].run, true, &cacheError));
+          if (!cacheError.empty()) std::cerr << "[WARNING] Spill cache of run " << events[e].run << " ignored: " << cacheError;
+        }
+      }
+
+      // Position in cuts() of the cut that rejects the event, kPassed if none
+      uint8_t decide(pdhd::TriggerEventView const& event) const {
+        pdhd::TraceBuffer buffer(1);
+        const pdhd::TraceSink log(buffer, pdhd::TraceLevel::kOff);
+        std::optional<pdhd::TPIndex> index;
+        for (std::size_t c = 0; c < fCuts.size(); c++) {
+          bool pass(true);
+          switch (fCuts[c]) {
+            case Cut::kSpill:
+              pass = fSpill.decide(fTimelines.at(event.run), event.time_ns / 1000000).pass;
+              break;
+            case Cut::kTriggerType:
+              pass = !fTriggerType.decide(event.tcs.data(), event.tcs.data() + event.tcs.size()).reject;
+              break;
+            case Cut::kExtMuon:
+              if (!index) index = pdhd::makeTPIndex(event);
+              pass = fExtMuon.select(*index, log).pass;
+              break;
+            case Cut::kVertex:
+              if (!index) index = pdhd::makeTPIndex(event);
+              pass = fVertex.select(*index, pdhd::VertexSelector::apa3Occupancy(*index), log,
+                                    [] (std::size_t, pdhd::VertexTAResult const&) {});
+              break;
+          }
+          if (!pass) return c;
+        }
+        return kPassed;
+      }
+
+    private:
+      std::vector<Cut> fCuts;
+      std::unique_ptr<pdhd::SpillDataDirectory> fSpillData;
+      std::map<uint32_t, pdhd::SpillTimeline> fTimelines;
+      pdhd::SpillSelector fSpill;
+      pdhd::TCTypeSelector fTriggerType;
+      pdhd::ExtMuonSelector fExtMuon;
+      pdhd::VertexSelector fVertex;
+  };
+
+  // Events from the snapshot files in order, or synthetic ones
+  class EventSource {
+    public:
+      EventSource(std::vector<std::string> files, std::size_t nSynthetic, std::string const& syntheticSnapshot) :
+        fFiles(std::move(files)),
+        fNSynthetic(nSynthetic),
+        fGenerator(20241016) {
+        if (!syntheticSnapshot.empty()) fSyntheticSnapshot = std::make_unique<pdhd::TriggerSnapshotWriter>(syntheticSnapshot);
+      }
+
+      // Views of the next events, valid until the next call; the number of events, 0 at the end
+      std::size_t fill(std::vector<pdhd::TriggerEventView>& batch) {
+        if (fNSynthetic > 0) return fillSynthetic(batch);
+        // Unmap the files of the previous batch but the one being read
+        if (fReaders.size() > 1) fReaders.erase(fReaders.begin(), fReaders.end() - 1);
+        std::size_t n = 0;
+        while (n < batch.size()) {
+          if (fReaders.empty() || fNextEvent == fReaders.back()->size()) {
+            if (fNextFile == fFiles.size()) break;
+            fReaders.push_back(std::make_unique<pdhd::TriggerSnapshotReader>(fFiles[fNextFile++]));
+            fNextEvent = 0;
+            if (!fReaders.back()->complete()) {
+              std::cerr << "[WARNING] " << fReaders.back()->fileName() << " has no index, the writer did not close it; "
+                << fReaders.back()->size() << " events recovered.\n";
+            }
+            continue;
+          }
+          batch[n++] = fReaders.back()->event(fNextEvent++);
+        }
+        return n;
+      }
+
+      void close() {
+        if (fSyntheticSnapshot) fSyntheticSnapshot->close();
+      }
+
+    private:
+      std::size_t fillSynthetic(std::vector<pdhd::TriggerEventView>& batch) {
+        fSynthetic.resize(batch.size());
+        std::size_t n = 0;
+        for (; n < batch.size() && fGenerated < fNSynthetic; n++) {
+          const auto topology = static_cast<pdhd::SyntheticTopology>(fGenerated % static_cast<std::size_t>(pdhd::SyntheticTopology::kNTopologies));
+          pdhd::SyntheticEvent &event = fSynthetic[n];
+          event = fGenerator.generate(topology, 106000000000000000ULL + fGenerated * 62500000);
+          event.run = 1;
+          event.subrun = 1;
+          event.event = ++fGenerated;
+          batch[n] = event.view();
+          if (fSyntheticSnapshot) fSyntheticSnapshot->write(batch[n]);
+        }
+        return n;
+      }
+
+      std::vector<std::string> fFiles;
+      std::size_t fNextFile = 0;
+      std::vector<std::unique_ptr<pdhd::TriggerSnapshotReader>> fReaders;
+      std::size_t fNextEvent = 0;
+      std::size_t fNSynthetic;
+      std::size_t fGenerated = 0;
+      pdhd::SyntheticEventGenerator fGenerator;
+      std::vector<pdhd::SyntheticEvent> fSynthetic;
+      std::unique_ptr<pdhd::TriggerSnapshotWriter> fSyntheticSnapshot;
+  };
+
+}
+
+int main(int argc, char **argv) {
+  std::size_t nThreads = tbb::info::default_concurrency();
+  std::size_t batchSize = 4096;
+  std::size_t nSynthetic = 0;
+  std::string cutList, outputFile, spillData, syntheticSnapshot;
+  bool spillOn(true);
+  uint64_t potThreshold = 1000000000000ULL;
+  std::vector<std::string> rejectTypes = {"kADCSimpleWindow"};
+  uint32_t vetoChannels = 40;
+  std::string vetoMode = "hits";
+  std::vector<std::string> files;
+
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+    bool valid(true);
+    if (arg == "-h" || arg == "--help") {
+      usage(argv[0]);
+      return 0;
+    }
+    else if (arg == "-j" && hasValue) valid = parseNumber(argv[++i], nThreads);
+    else if (arg == "-c" && hasValue) cutList = argv[++i];
+    else if (arg == "-b" && hasValue) valid = parseNumber(argv[++i], batchSize);
+    else if (arg == "-o" && hasValue) outputFile = argv[++i];
+    else if (arg == "--spill-data" && hasValue) spillData = argv[++i];
+    else if (arg == "--spill-off") spillOn = false;
+    else if (arg == "--pot-threshold" && hasValue) valid = pdhd::parsePoT(argv[++i], potThreshold);
+    else if (arg == "--reject-types" && hasValue) rejectTypes = splitList(argv[++i]);
+    else if (arg == "--veto-channels" && hasValue) valid = parseNumber(argv[++i], vetoChannels);
+    else if (arg == "--veto-mode" && hasValue) vetoMode = argv[++i];
+    else if (arg == "--synthetic" && hasValue) valid = parseNumber(argv[++i], nSynthetic);
+    else if (arg == "--write-synthetic" && hasValue) syntheticSnapshot = argv[++i];
+    else if (!arg.empty() && arg[0] != '-') files.push_back(arg);
+    else {
+      usage(argv[0]);
+      return 1;
+    }
+    if (!valid) {
+      std::cerr << "[ERROR] Invalid " << arg << " \"" << argv[i] << "\"\n";
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if ((files.empty() && nSynthetic == 0) || nThreads == 0 || batchSize == 0) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (cutList.empty()) cutList = spillData.empty() ? "triggertype,extmuon,vertex" : "spill,triggertype,extmuon,vertex";
+
+  try {
+    std::vector<Cut> cuts;
+    for (const auto &name : splitList(cutList)) {
+      std::size_t c = 0;
+      while (c < std::size(kCutNames) && name != kCutNames[c]) c++;
+      if (c == std::size(kCutNames)) {
+        std::cerr << "[ERROR] Unknown cut \"" << name << "\".\n";
+        return 1;
+      }
+      cuts.push_back(static_cast<Cut>(c));
+    }
+
+    std::unique_ptr<pdhd::SpillDataDirectory> spillDirectory;
+    if (std::find(cuts.begin(), cuts.end(), Cut::kSpill) != cuts.end()) {
+      if (spillData.empty()) {
+        std::cerr << "[ERROR] The spill cut needs --spill-data.\n";
+        return 1;
+      }
+      spillDirectory = std::make_unique<pdhd::SpillDataDirectory>(spillData);
+    }
+
+    pdhd::TCTypeSelector::Config tcConfig;
+    tcConfig.rejectTypes = rejectTypes;
+    const pdhd::VetoCountMode countMode = pdhd::parseVetoCountMode(vetoMode);
+    FilterChain chain(cuts, std::move(spillDirectory), pdhd::SpillSelector(spillOn, potThreshold), pdhd::TCTypeSelector(tcConfig),
+                      pdhd::ExtMuonSelector(vetoChannels, countMode), pdhd::VertexSelector(vetoChannels, countMode));
+
+    const tbb::global_control threads(tbb::global_control::max_allowed_parallelism, nThreads);
+    EventSource source(files, nSynthetic, syntheticSnapshot);
+    std::ofstream decisionsOut;
+    if (!outputFile.empty()) decisionsOut.open(outputFile);
+
+    std::vector<pdhd::TriggerEventView> batch(batchSize);
+    std::vector<uint8_t> rejectedBy(batchSize);
+    std::vector<std::size_t> rejected(cuts.size(), 0);
+    std::size_t nEvents(0), nPassed(0), nTPs(0);
+    double readTime(0), decideTime(0);
+    const auto start = clock_type::now();
+
+    while (true) {
+      auto stageStart = clock_type::now();
+      const std::size_t n = source.fill(batch);
+      chain.prepare(batch, n);
+      readTime += elapsed(stageStart);
+      if (n == 0) break;
+
+      stageStart = clock_type::now();
+      tbb::parallel_for(tbb::blocked_range<std::size_t>(0, n, 1), [&] (tbb::blocked_range<std::size_t> const& range) {
+        for (std::size_t e = range.begin(); e != range.end(); e++) rejectedBy[e] = chain.decide(batch[e]);
+      });
+      decideTime += elapsed(stageStart);
+
+      for (std::size_t e = 0; e < n; e++) {
+        nTPs += batch[e].tps.size();
+        if (rejectedBy[e] == kPassed) nPassed++;
+        else rejected[rejectedBy[e]]++;
+        if (decisionsOut.is_open()) {
+          decisionsOut << batch[e].run << " " << batch[e].subrun << " " << batch[e].event << " " << (rejectedBy[e] == kPassed)
+            << " " << (rejectedBy[e] == kPassed ? "-" : kCutNames[static_cast<std::size_t>(cuts[rejectedBy[e]])]) << "\n";
+        }
+      }
+      nEvents += n;
+    }
+    source.close();
+    const double totalTime = elapsed(start);
+
+    std::cout << nEvents << " events, " << (nEvents ? nTPs / nEvents : 0) << " TPs per event, " << nThreads << " threads\n";
+    std::size_t reaching = nEvents;
+    for (std::size_t c = 0; c < cuts.size(); c++) {
+      std::cout << "  " << kCutNames[static_cast<std::size_t>(cuts[c])] << ": " << reaching << " events, "
+        << rejected[c] << " rejected\n";
+      reaching -= rejected[c];
+    }
+    std::cout << "  passed: " << nPassed << "\n"
+      << "Read " << readTime << " s, decide " << decideTime << " s, total " << totalTime << " s\n"
+      << "Rate " << nEvents / totalTime << " events/s (" << nEvents / decideTime << " events/s deciding)\n";
+    if (decisionsOut.is_open() && !decisionsOut) {
+      std::cerr << "[ERROR] Failed to write " << outputFile << "\n";
+      return 1;
+    }
+  }
+  catch (cet::exception const& e) {
+    std::cerr << "[ERROR] " << e.explain_self();
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,157 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        hdf5prescan.cc
+//// Executable:  pdhd_hdf5_prescan
+////
+//// Spill selection of raw .hdf5 files before decoding. Only the trigger
+//// record headers are read; each record is matched to the SPS spills
+//// with the same SpillSelector as PDHDSPSSpillFilter and the selected
+//// records are written as
+////   - an EventIDFilter configuration (--fcl), to put first in the
+////     decoder job's trigger path, and/or
+////   - a plain text list of every record and its decision (--list).
+////
+//// Usage: pdhd_hdf5_prescan --spill-data DIR [--spill-off] [--pot-threshold POT]
+////                          [--fcl selected.fcl] [--list records.txt] file.hdf5 [file.hdf5 ...]
+//////////////////////////////////////////////////////////////////////////
+
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cetlib_except/exception.h"
+
+#include "pdhdbsmdata/Algorithms/SpillDataDirectory.h"
+#include "pdhdbsmdata/Algorithms/SpillSelector.h"
+#include "pdhdbsmdata/Algorithms/SpillTimeline.h"
+#include "pdhdbsmdata/tools/TriggerRecordHeaderScan.h"
+
+namespace {
+
+  void usage(const char *name) {
+    std::cerr << "Usage: " << name << " --spill-data DIR [--spill-off] [--pot-threshold POT]\n"
+      << "       [--fcl selected.fcl] [--list records.txt] file.hdf5 [file.hdf5 ...]\n"
+      << "  --spill-data DIR     directory with the spillrunNNNNNN.csv/.spillbin tables\n"
+      << "  --spill-off          select events outside the spills (default: during the spills)\n"
+      << "  --pot-threshold POT  minimum spill PoT for a spill to count as ON (default 1e12)\n"
+      << "  --fcl FILE           write the selected events as an EventIDFilter configuration\n"
+      << "  --list FILE          write every trigger record with its spill decision\n";
+  }
+
+}
+
+int main(int argc, char **argv) {
+  std::string spillDataDir;
+  std::string fclName;
+  std::string listName;
+  bool spillOn(true);
+  uint64_t potThreshold(1e12);
+  std::vector<std::string> inputs;
+
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if (arg == "-h" || arg == "--help") {
+      usage(argv[0]);
+      return 0;
+    } else if (arg == "--spill-data" && has_value) {
+      spillDataDir = argv[++i];
+    } else if (arg == "--spill-off") {
+      spillOn = false;
+    } else if (arg == "--pot-threshold" && has_value) {
+      if (!pdhd::parsePoT(argv[++i], potThreshold)) {
+        std::cerr << "[ERROR] Invalid --pot-threshold \"" << argv[i] << "\"\n";
+        usage(argv[0]);
+        return 1;
+      }
+    } else if (arg == "--fcl" && has_value) {
+      fclName = argv[++i];
+    } else if (arg == "--list" && has_value) {
+      listName = argv[++i];
+    } else if (!arg.empty() && arg[0] == '-') {
+      usage(argv[0]);
+      return 1;
+    } else {
+      inputs.push_back(arg);
+    }
+  }
+
+  if (spillDataDir.empty() || inputs.empty()) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  const pdhd::SpillSelector selector(spillOn, potThreshold);
+
+  std::ofstream list;
+  if (!listName.empty()) {
+    list.open(listName);
+    list << "# run trigger_number sequence_number timestamp_ticks time_ms spill_index spill_on selected\n";
+  }
+
+  std::vector<std::string> selectedIDs;
+  std::size_t nRecords(0);
+
+  try {
+    const pdhd::SpillDataDirectory spillData(spillDataDir);
+    std::map<uint32_t, std::unique_ptr<pdhd::SpillTimeline>> timelines;
+
+    for (const auto &input : inputs) {
+      const std::vector<pdhd::TriggerRecordStamp> stamps = pdhd::scanTriggerRecordHeaders(input);
+      std::size_t nSelected(0);
+
+      for (const auto &stamp : stamps) {
+        auto &timeline = timelines[stamp.run_number];
+        if (!timeline) {
+          std::string cacheError;
+          timeline = std::make_unique<pdhd::SpillTimeline>(spillData.load(stamp.run_number, true, &cacheError));
+          if (!cacheError.empty()) std::cerr << "[WARNING] Spill cache of run " << stamp.run_number << " ignored: " << cacheError;
+        }
+
+        const pdhd::spilltime_t time_ms = pdhd::daqTicksToMs(stamp.trigger_timestamp);
+        const pdhd::SpillDecision decision = selector.decide(*timeline, time_ms);
+
+        if (decision.pass) {
+          // The decoder numbers events by trigger number, the SubRun is left open
+          const std::string id = std::to_string(stamp.run_number) + ":*:" + std::to_string(stamp.trigger_number);
+          if (selectedIDs.empty() || selectedIDs.back() != id) selectedIDs.push_back(id);
+          nSelected++;
+        }
+        if (list.is_open()) {
+          const long spill_index = decision.spill.spill == pdhd::SpillTimeline::npos ? -1 : static_cast<long>(decision.spill.spill);
+          list << stamp.run_number << " " << stamp.trigger_number << " " << stamp.sequence_number << " "
+            << stamp.trigger_timestamp << " " << time_ms << " " << spill_index << " "
+            << decision.on << " " << decision.pass << "\n";
+        }
+      }
+
+      nRecords += stamps.size();
+      std::cout << input << ": " << nSelected << " of " << stamps.size() << " trigger records selected\n";
+    }
+  } catch (const cet::exception &e) {
+    std::cerr << "[ERROR] " << e.what();
+    return 2;
+  }
+
+  if (!fclName.empty()) {
+    std::ofstream fcl(fclName);
+    fcl << "# Written by pdhd_hdf5_prescan: " << selectedIDs.size() << " of " << nRecords
+      << " trigger records with spill_on: " << (spillOn ? "true" : "false") << "\n"
+      << "BEGIN_PROLOG\n\n"
+      << "pdhd_prescan_eventlist: {\n"
+      << "  module_type: \"EventIDFilter\"\n"
+      << "  idsToMatch: [";
+    for (std::size_t i = 0; i < selectedIDs.size(); i++) {
+      fcl << (i == 0 ? "\n    \"" : ",\n    \"") << selectedIDs[i] << "\"";
+    }
+    fcl << "\n  ]\n}\n\nEND_PROLOG\n";
+    if (!fcl) {
+      std::cerr << "[ERROR] Failed to write " << fclName << "\n";
+      return 2;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,134 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        occupancybench.cc
+//// Executable:  pdhd_occupancy_bench
+////
+//// Timing of the upstream veto count on synthetic APA 3 collection
+//// plane TPs: the filters' old scan (copy the TPs in the time window,
+//// sort them and count the first channels) against TPOccupancyIndex
+//// (build once per event, then one query per window). Both must give
+//// the same counts.
+////
+//// Usage: pdhd_occupancy_bench [-n TPs per event] [-e events] [-w windows per event]
+//////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "pdhdbsmdata/Algorithms/PDHDChannelMap.h"
+#include "pdhdbsmdata/Algorithms/TPOccupancyIndex.h"
+
+namespace {
+
+  using clock_type = std::chrono::steady_clock;
+  using pdhd::TPOccupancyIndex;
+
+  constexpr pdhd::chmap::ChannelRange kAPA3 = pdhd::chmap::mainCollectionRange(3);
+  constexpr uint32_t kVetoChannels = 40;
+  constexpr uint64_t kHalfWindow = 5000;
+  constexpr uint64_t kReadout = 500000; // Ticks of TPs around the trigger, 8 ms
+
+  void usage(const char *name) {
+    std::cerr << "Usage: " << name << " [-n TPs per event] [-e events] [-w windows per event]\n";
+  }
+
+  struct Event {
+    std::vector<uint32_t> channel;   // Sorted by channel as in the TPIndex partition
+    std::vector<uint64_t> time_peak;
+    std::vector<uint64_t> centres;   // Shower window centres
+  };
+
+  Event makeEvent(std::mt19937_64 &rng, std::size_t nTPs, std::size_t nWindows) {
+    std::uniform_int_distribution<uint32_t> chan(kAPA3.first, kAPA3.last);
+    std::uniform_int_distribution<uint64_t> time(0, kReadout);
+    std::vector<std::pair<uint32_t, uint64_t>> tps(nTPs);
+    for (auto &tp : tps) tp = {chan(rng), time(rng)};
+    // An upstream muon: a hit on each of the first channels at one time
+    const uint64_t muon = time(rng);
+    for (uint32_t ch = 0; ch < kVetoChannels && ch < nTPs; ch++) tps[ch] = {kAPA3.first + ch, muon + ch};
+    std::sort(tps.begin(), tps.end());
+
+    Event event;
+    for (const auto &tp : tps) {
+      event.channel.push_back(tp.first);
+      event.time_peak.push_back(tp.second);
+    }
+    for (std::size_t w = 0; w < nWindows; w++) event.centres.push_back(w == 0 ? muon : time(rng));
+    return event;
+  }
+
+  // The filters' scan before TPOccupancyIndex
+  std::size_t scanCount(Event const& event, uint64_t lower, uint64_t upper) {
+    std::vector<uint32_t> inWindow;
+    for (std::size_t tp = 0; tp < event.channel.size(); tp++) {
+      if (event.time_peak[tp] <= upper && event.time_peak[tp] >= lower) inWindow.push_back(event.channel[tp]);
+    }
+    std::sort(inWindow.begin(), inWindow.end());
+    return std::count_if(inWindow.begin(), inWindow.end(),
+        [] (uint32_t ch) { return ch >= kAPA3.first && ch <= kAPA3.first + kVetoChannels; });
+  }
+
+}
+
+int main(int argc, char **argv) {
+  std::size_t nTPs = 20000;
+  std::size_t nEvents = 200;
+  std::size_t nWindows = 8;
+
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if ((arg == "-n" || arg == "-e" || arg == "-w") && i + 1 < argc) {
+      const std::size_t value = std::stoul(argv[++i]);
+      (arg == "-n" ? nTPs : arg == "-e" ? nEvents : nWindows) = value;
+    } else {
+      usage(argv[0]);
+      return arg == "-h" || arg == "--help" ? 0 : 1;
+    }
+  }
+
+  std::mt19937_64 rng(20240917);
+  std::vector<Event> events;
+  for (std::size_t e = 0; e < nEvents; e++) events.push_back(makeEvent(rng, nTPs, nWindows));
+
+  std::size_t scanTotal(0), indexTotal(0), channelTotal(0);
+
+  auto start = clock_type::now();
+  for (const auto &event : events) {
+    for (const auto &centre : event.centres) scanTotal += scanCount(event, centre - std::min(centre, kHalfWindow), centre + kHalfWindow);
+  }
+  const double scanTime = std::chrono::duration<double>(clock_type::now() - start).count();
+
+  start = clock_type::now();
+  for (const auto &event : events) {
+    const TPOccupancyIndex index(kAPA3, event.channel.data(), event.time_peak.data(), event.channel.size());
+    for (const auto &centre : event.centres) {
+      indexTotal += index.countHits(kAPA3.first, kAPA3.first + kVetoChannels, centre - std::min(centre, kHalfWindow), centre + kHalfWindow);
+    }
+  }
+  const double indexTime = std::chrono::duration<double>(clock_type::now() - start).count();
+
+  start = clock_type::now();
+  for (const auto &event : events) {
+    const TPOccupancyIndex index(kAPA3, event.channel.data(), event.time_peak.data(), event.channel.size());
+    for (const auto &centre : event.centres) {
+      channelTotal += index.countChannels(kAPA3.first, kAPA3.first + kVetoChannels, centre - std::min(centre, kHalfWindow), centre + kHalfWindow);
+    }
+  }
+  const double channelTime = std::chrono::duration<double>(clock_type::now() - start).count();
+
+  const double perEvent = 1e6 / nEvents;
+  std::cout << nEvents << " events, " << nTPs << " TPs and " << nWindows << " veto windows per event\n"
+    << "  scan and sort:          " << scanTime * perEvent << " us/event, " << scanTotal << " hits\n"
+    << "  occupancy index, hits:  " << indexTime * perEvent << " us/event, " << indexTotal << " hits\n"
+    << "  occupancy index, chans: " << channelTime * perEvent << " us/event, " << channelTotal << " channels\n";
+
+  if (scanTotal != indexTotal) {
+    std::cerr << "[ERROR] Hit counts differ between the scan and the occupancy index.\n";
+    return 2;
+  }
+  return 0;
+}
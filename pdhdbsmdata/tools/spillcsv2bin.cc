@@ -0,0 +1,76 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        spillcsv2bin.cc
+//// Executable:  pdhd_spillcsv2bin
+////
+//// Convert IFBeam SPS spill .csv files into .spillbin caches that the
+//// PDHDSPSSpillDatabase service maps at startup without parsing.
+////
+//// Usage: pdhd_spillcsv2bin [-o output.spillbin] input.csv [input.csv ...]
+////        Without -o each cache is written next to its .csv.
+//////////////////////////////////////////////////////////////////////////
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cetlib_except/exception.h"
+
+#include "pdhdbsmdata/Algorithms/SpillTableIO.h"
+
+namespace {
+
+  void usage(const char *name) {
+    std::cerr << "Usage: " << name << " [-o output.spillbin] input.csv [input.csv ...]\n"
+      << "  Without -o each cache is written next to its .csv with the .spillbin extension.\n";
+  }
+
+}
+
+int main(int argc, char **argv) {
+  std::string output;
+  std::vector<std::string> inputs;
+
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "-h" || arg == "--help") {
+      usage(argv[0]);
+      return 0;
+    } else if (arg == "-o" && i + 1 < argc) {
+      output = argv[++i];
+    } else {
+      inputs.push_back(arg);
+    }
+  }
+
+  if (inputs.empty() || (!output.empty() && inputs.size() != 1)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  try {
+    for (const auto &input : inputs) {
+      const std::string binName = output.empty() ? std::filesystem::path(input).replace_extension(".spillbin").string() : output;
+
+      const pdhd::SpillSourceStamp stamp = pdhd::spillSourceStamp(input);
+      std::size_t skipped(0);
+      const pdhd::SpillTimeline timeline = pdhd::readSpillCSV(input, &skipped);
+      pdhd::writeSpillBin(timeline, stamp, binName);
+
+      // Read the cache back so a bad file never reaches the grid
+      const pdhd::SpillTimeline check = pdhd::readSpillBin(binName);
+      if (check.size() != timeline.size()) {
+        std::cerr << "[ERROR] " << binName << " has " << check.size() << " spills, expected " << timeline.size() << "\n";
+        return 2;
+      }
+
+      std::cout << input << " -> " << binName << ": " << timeline.size() << " spills (" << skipped
+        << " rows without a time skipped), source checksum " << std::hex << stamp.checksum << std::dec << "\n";
+    }
+  } catch (const cet::exception &e) {
+    std::cerr << "[ERROR] " << e.what();
+    return 2;
+  }
+
+  return 0;
+}
@@ -0,0 +1,151 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        timefitbench.cc
+//// Executable:  pdhd_timefit_bench
+////
+//// Per-TA cost of the PDHDVertexFilter shower time fit on synthetic TAs:
+//// the old path (TH2D, ProjectionY, Minuit "gaus" fit, ProjectionX)
+//// against FixedHist2D with estimateGaussian. Also counts the TAs where
+//// the two disagree on the time cuts (mean in the TA window, sigma
+//// at most 4000 ticks, fit status).
+////
+//// Usage: pdhd_timefit_bench [-t TAs] [-n TPs per TA]
+//////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "TF1.h"
+#include "TFitResult.h"
+#include "TH1D.h"
+#include "TH2D.h"
+
+#include "pdhdbsmdata/Algorithms/FixedHist.h"
+#include "pdhdbsmdata/Algorithms/GaussianEstimator.h"
+#include "pdhdbsmdata/Algorithms/PDHDChannelMap.h"
+
+namespace {
+
+  using clock_type = std::chrono::steady_clock;
+
+  constexpr pdhd::chmap::ChannelRange kAPA3 = pdhd::chmap::mainCollectionRange(3);
+  constexpr double kTAWindow = 20000;
+
+  void usage(const char *name) {
+    std::cerr << "Usage: " << name << " [-t TAs] [-n TPs per TA]\n";
+  }
+
+  struct TA {
+    std::vector<double> channel;
+    std::vector<double> time;   // Relative to the TA start
+    std::vector<double> adc;
+  };
+
+  // A shower with a random centre and spread in time, some wider than the 4000 tick cut
+  TA makeTA(std::mt19937_64 &rng, std::size_t nTPs) {
+    std::uniform_real_distribution<double> centre(2000, 18000);
+    std::uniform_real_distribution<double> spread(300, 6000);
+    std::uniform_real_distribution<double> chan(kAPA3.first, kAPA3.last);
+    std::uniform_real_distribution<double> adc(50, 2000);
+    std::normal_distribution<double> time(centre(rng), spread(rng));
+
+    TA ta;
+    for (std::size_t tp = 0; tp < nTPs; tp++) {
+      ta.channel.push_back(chan(rng));
+      ta.time.push_back(std::max(0., time(rng)));
+      ta.adc.push_back(adc(rng));
+    }
+    return ta;
+  }
+
+  struct Decision {
+    double mean;
+    double sigma;
+    int status;
+    double chanSum; // Keeps the channel projection from being optimised away
+    bool pass() const { return status == 0 && mean >= 0 && mean <= kTAWindow && sigma <= 4000; }
+  };
+
+  Decision rootFit(TA const& ta) {
+    TH2D hTA("hTA", "", 25, kAPA3.first, kAPA3.last, 20, 0, kTAWindow);
+    for (std::size_t tp = 0; tp < ta.time.size(); tp++) hTA.Fill(ta.channel[tp], ta.time[tp], ta.adc[tp]);
+    TH1D *hTime = hTA.ProjectionY("hTime");
+    const int peakBin = hTime->GetMaximumBin();
+    const double peakValue = hTime->GetBinCenter(peakBin);
+    const double fitMin = std::max(peakValue - 5000, hTime->GetXaxis()->GetXmin());
+    const double fitMax = std::min(peakValue + 5000, hTime->GetXaxis()->GetXmax());
+    TF1 gaussFit("gaussFit", "gaus", fitMin, fitMax);
+    gaussFit.SetParameters(hTime->GetBinContent(peakBin), peakValue, 1000);
+    TFitResultPtr r = hTime->Fit(&gaussFit, "RSQN");
+    TH1D *hChan = hTA.ProjectionX("hChan", hTime->FindFixBin(fitMin), hTime->FindFixBin(fitMax));
+    const Decision decision{r->Parameter(1), r->Parameter(2), static_cast<Int_t>(r), hChan->GetBinContent(1)};
+    delete hChan;
+    delete hTime;
+    return decision;
+  }
+
+  Decision fixedFit(TA const& ta) {
+    pdhd::FixedHist2D hTA(25, kAPA3.first, kAPA3.last, 20, 0, kTAWindow);
+    for (std::size_t tp = 0; tp < ta.time.size(); tp++) hTA.fill(ta.channel[tp], ta.time[tp], ta.adc[tp]);
+    const pdhd::FixedHist1D hTime = hTA.projectionY();
+    const double peakValue = hTime.binCenter(hTime.maximumBin());
+    const double fitMin = std::max(peakValue - 5000, hTime.axis().xMin());
+    const double fitMax = std::min(peakValue + 5000, hTime.axis().xMax());
+    const pdhd::GaussianEstimate fit = pdhd::estimateGaussian(hTime, fitMin, fitMax);
+    const pdhd::FixedHist1D hChan = hTA.projectionX(hTime.findBin(fitMin), hTime.findBin(fitMax));
+    return {fit.mean, fit.sigma, fit.status, hChan.binContent(1)};
+  }
+
+}
+
+int main(int argc, char **argv) {
+  std::size_t nTAs = 2000;
+  std::size_t nTPs = 200;
+
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if ((arg == "-t" || arg == "-n") && i + 1 < argc) {
+      (arg == "-t" ? nTAs : nTPs) = std::stoul(argv[++i]);
+    } else {
+      usage(argv[0]);
+      return arg == "-h" || arg == "--help" ? 0 : 1;
+    }
+  }
+
+  // Keep the ROOT histograms out of gDirectory, as they are deleted here
+  TH1::AddDirectory(false);
+
+  std::mt19937_64 rng(20240917);
+  std::vector<TA> tas;
+  for (std::size_t ta = 0; ta < nTAs; ta++) tas.push_back(makeTA(rng, nTPs));
+
+  std::vector<Decision> rootDecisions, fixedDecisions;
+  rootDecisions.reserve(nTAs);
+  fixedDecisions.reserve(nTAs);
+
+  auto start = clock_type::now();
+  for (const auto &ta : tas) rootDecisions.push_back(rootFit(ta));
+  const double rootTime = std::chrono::duration<double>(clock_type::now() - start).count();
+
+  start = clock_type::now();
+  for (const auto &ta : tas) fixedDecisions.push_back(fixedFit(ta));
+  const double fixedTime = std::chrono::duration<double>(clock_type::now() - start).count();
+
+  std::size_t rootPass(0), fixedPass(0), differ(0);
+  for (std::size_t ta = 0; ta < nTAs; ta++) {
+    rootPass += rootDecisions[ta].pass();
+    fixedPass += fixedDecisions[ta].pass();
+    differ += rootDecisions[ta].pass() != fixedDecisions[ta].pass();
+  }
+
+  const double perTA = 1e6 / nTAs;
+  std::cout << nTAs << " TAs with " << nTPs << " TPs each\n"
+    << "  TH2D and Minuit fit:         " << rootTime * perTA << " us/TA, " << rootPass << " pass the time cuts\n"
+    << "  FixedHist2D and estimate:    " << fixedTime * perTA << " us/TA, " << fixedPass << " pass the time cuts\n"
+    << "  TAs with different decisions: " << differ << "\n";
+  return 0;
+}
@@ -0,0 +1,187 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        DecisionCache_test.cc
+////
+//// Decisions stored by one DecisionCache, flushed at the end of the run
+//// and reopened by another, as by a second job on the same raw files:
+//// every stored key is found with its decision, and keys of another
+//// configuration hash, subrun or run miss. Then the modes, the merge of
+//// a second flush, files that must be ignored and replaced (another
+//// version, another byte order, a corrupted payload), the hash of
+//// FilterDecisionCache, which must change with a cut but not with the
+//// printout or the cut-flow output, nor without a checksum of the run,
+//// and flushes during a run, which a killed job must not lose.
+//////////////////////////////////////////////////////////////////////////
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "fhiclcpp/ParameterSet.h"
+
+#include "pdhdbsmdata/Algorithms/DecisionCache.h"
+#include "pdhdbsmdata/PDHDDecisionCache.h"
+
+namespace {
+
+  using pdhd::DecisionCache;
+  using pdhd::DecisionCacheMode;
+  using pdhd::DecisionKey;
+
+  constexpr uint32_t kRun = 27345;
+  const std::string kDirectory = "decisioncache_test";
+
+  bool decision(uint32_t subrun, uint32_t event) { return (subrun * 31 + event) % 3 == 0; }
+
+  // Overwrite bytes of the cache file of kRun
+  void patch(std::size_t offset, void const* bytes, std::size_t size) {
+    std::fstream file(DecisionCache::fileName(kDirectory, kRun), std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(offset);
+    file.write(static_cast<const char*>(bytes), size);
+  }
+
+  // The file of kRun is reported and ignored, and replaced at the next flush
+  void checkReplaced(uint64_t config) {
+    DecisionCache cache(kDirectory, DecisionCacheMode::kReadWrite);
+    std::string error;
+    cache.open(kRun, &error);
+    assert(!error.empty());
+    assert(cache.loaded() == 0);
+    cache.store({config, 1, 1}, true);
+    assert(cache.flush() == 1);
+    assert(pdhd::DecisionTable::read(DecisionCache::fileName(kDirectory, kRun)).size() == 1);
+  }
+
+}
+
+int main() {
+  std::filesystem::remove_all(kDirectory);
+  const uint64_t config = 0x1234567890abcdefULL;
+  const uint64_t otherConfig = config + 1;
+
+  // First job: no file yet, every event is decided and stored, out of key order
+  {
+    DecisionCache cache(kDirectory, DecisionCacheMode::kReadWrite);
+    std::string error;
+    cache.open(kRun, &error);
+    assert(error.empty() && cache.loaded() == 0);
+    for (uint32_t event = 500; event-- > 0;) cache.store({config, 1 + event % 3, event}, decision(1 + event % 3, event));
+    assert(!cache.lookup({config, 1, 3}));
+    assert(cache.flush() == 500);
+  }
+
+  // Second job: the decisions are found, other configurations, subruns and runs miss
+  {
+    DecisionCache cache(kDirectory, DecisionCacheMode::kReadWrite);
+    cache.open(kRun);
+    assert(cache.loaded() == 500);
+    for (uint32_t event = 0; event < 500; event++) {
+      const uint32_t subrun = 1 + event % 3;
+      const std::optional<bool> pass = cache.lookup({config, subrun, event});
+      assert(pass && *pass == decision(subrun, event));
+      assert(!cache.lookup({otherConfig, subrun, event}));
+      assert(!cache.lookup({config, subrun + 3, event}));
+    }
+    cache.open(kRun + 1);
+    assert(cache.loaded() == 0 && !cache.lookup({config, 1, 3}));
+
+    // The other configuration is merged into the file of kRun, an event decided again replaces its decision
+    cache.open(kRun);
+    cache.store({otherConfig, 1, 3}, true);
+    cache.store({config, 1, 3}, !decision(1, 3));
+    assert(cache.flush() == 1);
+  }
+  {
+    DecisionCache cache(kDirectory, DecisionCacheMode::kRead);
+    cache.open(kRun);
+    assert(cache.loaded() == 501);
+    assert(*cache.lookup({otherConfig, 1, 3}));
+    assert(*cache.lookup({config, 1, 3}) == !decision(1, 3));
+    // Read mode never writes
+    cache.store({config, 9, 9}, true);
+    assert(cache.flush() == 0);
+  }
+
+  // Write mode decides every event again
+  {
+    DecisionCache cache(kDirectory, DecisionCacheMode::kWrite);
+    cache.open(kRun);
+    assert(!cache.lookup({config, 1, 0}));
+    cache.store({config, 1, 0}, true);
+    assert(cache.flush() == 0); // Replaces a stored decision, adds none
+  }
+  assert(pdhd::DecisionTable::read(DecisionCache::fileName(kDirectory, kRun)).size() == 501);
+
+  // Another version, another byte order, a corrupted payload
+  const uint32_t version = pdhd::DecisionCacheHeader::kVersion - 1;
+  patch(offsetof(pdhd::DecisionCacheHeader, version), &version, sizeof(version));
+  checkReplaced(config);
+  const uint32_t swapped = 0x04030201; // kByteOrder as read on a host of the other byte order
+  patch(offsetof(pdhd::DecisionCacheHeader, byte_order), &swapped, sizeof(swapped));
+  checkReplaced(config);
+  const unsigned char flip = 0xff;
+  patch(sizeof(pdhd::DecisionCacheHeader) + sizeof(DecisionKey), &flip, sizeof(flip));
+  checkReplaced(config);
+
+  // The configuration hash: a cut changes it, the printout and cut-flow output do not
+  fhicl::ParameterSet pset;
+  pset.put<std::string>("module_label", "extmuonfilter");
+  pset.put<int>("VetoThreshold", 40);
+  pset.put<std::string>("TraceLevel", "info");
+  pset.put<bool>("CutFlowTree", false);
+  fhicl::ParameterSet printout = pset;
+  printout.put_or_replace<std::string>("TraceLevel", "debug");
+  printout.put_or_replace<bool>("CutFlowTree", true);
+  printout.put_or_replace<std::string>("module_label", "extmuonfilter2");
+  fhicl::ParameterSet cut = pset;
+  cut.put_or_replace<int>("VetoThreshold", 41);
+  const uint64_t hash = pdhd::FilterDecisionCache::configHash(pset);
+  assert(pdhd::FilterDecisionCache::configHash(printout) == hash);
+  assert(pdhd::FilterDecisionCache::configHash(cut) != hash);
+
+  // ... so the decisions stored with one cut are not returned for another
+  {
+    DecisionCache cache(kDirectory, DecisionCacheMode::kReadWrite);
+    cache.open(kRun);
+    cache.store({hash, 2, 7}, true);
+    cache.flush();
+    cache.open(kRun);
+    assert(cache.lookup({pdhd::FilterDecisionCache::configHash(printout), 2, 7}));
+    assert(!cache.lookup({pdhd::FilterDecisionCache::configHash(cut), 2, 7}));
+
+    // ... nor for another spill table
+    assert(pdhd::FilterDecisionCache::keyHash(hash, 0) == hash);
+    const uint64_t spillKey = pdhd::FilterDecisionCache::keyHash(hash, 0x5151);
+    assert(spillKey != hash && spillKey != pdhd::FilterDecisionCache::keyHash(hash, 0x5152));
+    cache.store({spillKey, 2, 8}, true);
+    cache.flush();
+    cache.open(kRun);
+    assert(cache.lookup({spillKey, 2, 8}));
+    assert(!cache.lookup({hash, 2, 8}) && !cache.lookup({pdhd::FilterDecisionCache::keyHash(hash, 0x5152), 2, 8}));
+  }
+
+  // Flushes during the run: each writes what is pending, the table mapped at the start stays
+  {
+    DecisionCache cache(kDirectory, DecisionCacheMode::kReadWrite);
+    cache.open(kRun + 2);
+    for (uint32_t event = 0; event < 10; event++) assert(cache.store({config, 1, event}, decision(1, event)) == event + 1);
+    assert(cache.flush() == 10);
+    assert(cache.store({config, 1, 10}, decision(1, 10)) == 1);
+    assert(cache.loaded() == 0 && !cache.lookup({config, 1, 0}));
+    assert(pdhd::DecisionTable::read(DecisionCache::fileName(kDirectory, kRun + 2)).size() == 10);
+    assert(cache.flush() == 1);
+  }
+  {
+    DecisionCache cache(kDirectory, DecisionCacheMode::kRead);
+    cache.open(kRun + 2);
+    assert(cache.loaded() == 11 && *cache.lookup({config, 1, 10}) == decision(1, 10));
+    assert(cache.store({config, 1, 11}, true) == 0);
+  }
+
+  std::filesystem::remove_all(kDirectory);
+  return 0;
+}
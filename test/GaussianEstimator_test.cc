@@ -0,0 +1,191 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        GaussianEstimator_test.cc
+////
+//// estimateGaussian against the minimum of the chi2 that the Minuit
+//// "gaus" fit of PDHDVertexFilter minimised, found here by a separate
+//// Levenberg-Marquardt fit on the same bins from the filter's start
+//// values. On exact Gaussians both must give the true parameters. On
+//// synthetic TAs, histogrammed as in the filter, every fit with its
+//// minimum inside the fit range must give the same mean and sigma to
+//// within kTolerance ticks, and a time-cut decision (mean in the TA
+//// window, sigma at most 4000 ticks, status) may only differ when the
+//// mean or sigma is within kTolerance of its cut. Fits without such a
+//// minimum run off along a flat chi2 valley, far outside the TA
+//// window, and fail the mean cut both ways. pdhd_timefit_bench makes
+//// the same comparison against ROOT's own fit.
+//////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "pdhdbsmdata/Algorithms/FixedHist.h"
+#include "pdhdbsmdata/Algorithms/GaussianEstimator.h"
+
+namespace {
+
+  constexpr double kTAWindow = 20000;
+  constexpr double kSigmaCut = 4000;
+  constexpr std::size_t kNTAs = 2000;
+  constexpr double kTolerance = 2.;      // Ticks, on the mean and sigma of the two fits
+
+  struct Fit {
+    double amplitude, mean, sigma;
+    int status;
+    bool pass() const { return status == 0 && mean >= 0 && mean <= kTAWindow && std::abs(sigma) <= kSigmaCut; }
+  };
+
+  // Same weights and bins as TH1::Fit(gaus, "R"): bins 1..N with centre in [xmin, xmax] and content
+  double chi2(pdhd::FixedHist1D const& h, double xmin, double xmax, const double p[3]) {
+    double sum = 0.;
+    for (int b = 1; b <= h.nBins(); b++) {
+      const double x = h.binCenter(b);
+      if (x < xmin || x > xmax || h.binContent(b) <= 0.) continue;
+      const double model = p[0] * std::exp(-0.5 * std::pow((x - p[1]) / p[2], 2));
+      sum += std::pow(h.binContent(b) - model, 2) / h.binSumW2(b);
+    }
+    return sum;
+  }
+
+  // Levenberg-Marquardt minimum of the chi2 from the start values of the filter's fit
+  Fit referenceFit(pdhd::FixedHist1D const& h, double xmin, double xmax) {
+    const int peak = h.maximumBin();
+    double p[3] = {h.binContent(peak), h.binCenter(peak), 1000.};
+    int nBins = 0;
+    for (int b = 1; b <= h.nBins(); b++) nBins += h.binCenter(b) >= xmin && h.binCenter(b) <= xmax && h.binContent(b) > 0.;
+    if (nBins < 3) return {p[0], p[1], p[2], 1};
+
+    double lambda = 1e-3;
+    double current = chi2(h, xmin, xmax, p);
+    for (int it = 0; it < 500; it++) {
+      double jtj[3][3] = {}, jtr[3] = {};
+      for (int b = 1; b <= h.nBins(); b++) {
+        const double x = h.binCenter(b);
+        if (x < xmin || x > xmax || h.binContent(b) <= 0.) continue;
+        const double z = (x - p[1]) / p[2];
+        const double g = std::exp(-0.5 * z * z);
+        const double model = p[0] * g;
+        const double d[3] = {g, model * z / p[2], model * z * z / p[2]};
+        const double w = 1. / h.binSumW2(b);
+        for (int r = 0; r < 3; r++) {
+          jtr[r] += w * d[r] * (h.binContent(b) - model);
+          for (int c = 0; c < 3; c++) jtj[r][c] += w * d[r] * d[c];
+        }
+      }
+      // Solve (JtJ + lambda diag) dp = Jtr by Gaussian elimination
+      double a[3][4];
+      for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 3; c++) a[r][c] = jtj[r][c] + (r == c ? lambda * jtj[r][r] : 0.);
+        a[r][3] = jtr[r];
+      }
+      bool singular = false;
+      for (int k = 0; k < 3 && !singular; k++) {
+        if (a[k][k] == 0.) {
+          singular = true;
+          break;
+        }
+        for (int r = k + 1; r < 3; r++) {
+          const double f = a[r][k] / a[k][k];
+          for (int c = k; c < 4; c++) a[r][c] -= f * a[k][c];
+        }
+      }
+      if (singular) return {p[0], p[1], p[2], 3};
+      double dp[3];
+      for (int r = 2; r >= 0; r--) {
+        dp[r] = a[r][3];
+        for (int c = r + 1; c < 3; c++) dp[r] -= a[r][c] * dp[c];
+        dp[r] /= a[r][r];
+      }
+
+      const double trial[3] = {p[0] + dp[0], p[1] + dp[1], p[2] + dp[2]};
+      const double next = chi2(h, xmin, xmax, trial);
+      if (std::isfinite(next) && next <= current) {
+        const bool converged = current - next < 1e-9 * (1. + current);
+        std::copy(trial, trial + 3, p);
+        current = next;
+        lambda = std::max(lambda / 10., 1e-12);
+        if (converged) return {p[0], p[1], p[2], 0};
+      } else {
+        lambda *= 10.;
+        if (lambda > 1e12) return {p[0], p[1], p[2], 0}; // No step lowers the chi2, at the minimum
+      }
+    }
+    return {p[0], p[1], p[2], 4};
+  }
+
+  // Small deterministic generator, the same TAs on every platform
+  struct Random {
+    uint64_t state;
+    double uniform() {
+      state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+      return ((state >> 11) + 0.5) / 9007199254740992.;
+    }
+    double uniform(double lo, double hi) { return lo + (hi - lo) * uniform(); }
+    double normal(double mean, double sigma) {
+      return mean + sigma * std::sqrt(-2. * std::log(uniform())) * std::cos(6.283185307179586 * uniform());
+    }
+  };
+
+}
+
+int main() {
+  // Exact Gaussians, with unit errors, give the true parameters
+  for (double sigma : {1500., 2500., 4000.}) {
+    pdhd::FixedHist1D h(20, 0, kTAWindow);
+    for (int b = 1; b <= h.nBins(); b++) {
+      const double x = h.binCenter(b);
+      h.addBinContent(b, 1000. * std::exp(-0.5 * std::pow((x - 9300.) / sigma, 2)), 1.);
+    }
+    const pdhd::GaussianEstimate estimate = pdhd::estimateGaussian(h, 0, kTAWindow);
+    assert(estimate.status == pdhd::GaussianEstimate::kOK);
+    assert(std::abs(estimate.mean - 9300.) < 1e-6 * 9300.);
+    assert(std::abs(estimate.sigma - sigma) < 1e-6 * sigma);
+    assert(std::abs(estimate.amplitude - 1000.) < 1e-6 * 1000.);
+  }
+
+  // Too few bins
+  pdhd::FixedHist1D twoBins(20, 0, kTAWindow);
+  twoBins.fill(5500.);
+  twoBins.fill(6500.);
+  assert(pdhd::estimateGaussian(twoBins, 0, kTAWindow).status == pdhd::GaussianEstimate::kTooFewBins);
+
+  // Synthetic TAs: ADC-weighted TP times of one shower, as the time projection of the filter
+  Random random{20240917};
+  std::size_t different(0), nPass(0), nCompared(0);
+  for (std::size_t ta = 0; ta < kNTAs; ta++) {
+    const double centre = random.uniform(2000, 18000);
+    const double spread = random.uniform(300, 6000);
+    pdhd::FixedHist1D h(20, 0, kTAWindow);
+    for (int tp = 0; tp < 200; tp++) h.fill(std::max(0., random.normal(centre, spread)), random.uniform(50, 2000));
+
+    const double peak = h.binCenter(h.maximumBin());
+    const double fitMin = std::max(peak - 5000, h.axis().xMin());
+    const double fitMax = std::min(peak + 5000, h.axis().xMax());
+    const pdhd::GaussianEstimate estimate = pdhd::estimateGaussian(h, fitMin, fitMax);
+    const Fit fixed{estimate.amplitude, estimate.mean, estimate.sigma, estimate.status};
+    const Fit reference = referenceFit(h, fitMin, fitMax);
+    nPass += reference.pass();
+
+    // A minimum inside the fit range is found by both fits
+    if (reference.status == 0 && reference.mean >= fitMin && reference.mean <= fitMax) {
+      assert(fixed.status == 0);
+      assert(std::abs(fixed.mean - reference.mean) < kTolerance);
+      assert(std::abs(fixed.sigma - std::abs(reference.sigma)) < kTolerance);
+      nCompared++;
+    } else {
+      assert(!reference.pass() && !fixed.pass());
+    }
+    if (fixed.pass() != reference.pass()) {
+      const bool nearCut = std::abs(reference.mean) < kTolerance || std::abs(reference.mean - kTAWindow) < kTolerance ||
+                           std::abs(std::abs(reference.sigma) - kSigmaCut) < kTolerance;
+      assert(nearCut);
+      different++;
+    }
+  }
+  std::cout << kNTAs << " TAs, " << nPass << " pass the chi2 fit time cuts, " << nCompared << " with the minimum in the fit range, "
+    << different << " decisions differ\n";
+  return 0;
+}
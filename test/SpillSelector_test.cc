@@ -0,0 +1,53 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        SpillSelector_test.cc
+////
+//// parsePoT, the --pot-threshold of pdhd_hdf5_prescan and
+//// pdhd_filter_replay: integers and floating-point numbers up to 2^64
+//// are read, anything else (trailing characters, signs, blanks,
+//// negative, infinite or too large values) is refused and leaves the
+//// threshold as it was. The threshold then decides spill ON and OFF.
+//////////////////////////////////////////////////////////////////////////
+
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "pdhdbsmdata/Algorithms/SpillSelector.h"
+#include "pdhdbsmdata/Algorithms/SpillTimeline.h"
+
+namespace {
+
+  bool parsesTo(std::string const& arg, uint64_t expected) {
+    uint64_t pot = 7;
+    return pdhd::parsePoT(arg, pot) && pot == expected;
+  }
+
+}
+
+int main() {
+  assert(parsesTo("1e12", 1000000000000ULL));
+  assert(parsesTo("3.5e11", 350000000000ULL));
+  assert(parsesTo("1000000000000", 1000000000000ULL));
+  assert(parsesTo("0", 0));
+  assert(parsesTo("12.9", 12));
+  assert(parsesTo("1.8e19", 18000000000000000000ULL));
+
+  const std::vector<std::string> bad = {"", "1e12abc", "abc", " 1e12", "1e12 ", "+1e12", "-1", "-0.5",
+                                        "inf", "nan", "1.9e19", "1e400"};
+  for (std::string const& arg : bad) {
+    uint64_t pot = 7;
+    assert(!pdhd::parsePoT(arg, pot));
+    assert(pot == 7);
+  }
+
+  // A spill at the threshold is ON, one below it is OFF
+  const pdhd::SpillTimeline timeline({{1000, 1000000000000ULL}, {10000, 999999999999ULL}}, 4800);
+  uint64_t threshold = 0;
+  assert(pdhd::parsePoT("1e12", threshold));
+  const pdhd::SpillSelector spillOn(true, threshold);
+  assert(spillOn.decide(timeline, 2000).pass);
+  assert(!spillOn.decide(timeline, 11000).on && !spillOn.decide(timeline, 11000).pass);
+  assert(pdhd::SpillSelector(false, threshold).decide(timeline, 11000).pass);
+  return 0;
+}
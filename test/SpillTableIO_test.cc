@@ -0,0 +1,152 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        SpillTableIO_test.cc
+////
+//// Parses a spill table, writes its .spillbin and reads it back through
+//// SpillDataDirectory, then checks that a malformed csv line throws and
+//// that a cache of another version or byte order, a truncated one, one
+//// with a spill count past its size and a stale one are ignored for the
+//// csv, and only throw without it. The checksum of a table is the same
+//// from the csv and the cache.
+//////////////////////////////////////////////////////////////////////////
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "cetlib_except/exception.h"
+
+#include "pdhdbsmdata/Algorithms/SpillDataDirectory.h"
+#include "pdhdbsmdata/Algorithms/SpillTableIO.h"
+
+namespace {
+
+  using pdhd::SpillTimeline;
+
+  const std::string kCSV = "spillrun000042.csv";
+  const std::string kBin = "spillrun000042.spillbin";
+
+  // IFBeam layout: header, spills out of order, a reading without a logging time, CRLF line ends
+  const std::string kTable =
+    "LOG_TIMESTAMP,SPS.T2:INTENSITY,XTIM.SX.WE-CT:Acquisition:acqC,UTC_DATE,CEST_DATE\n"
+    "1728063384.99,3165712600000.0,4455,2024-10-04 17:36:24.99+00:00,2024-10-04 19:36:24.99+02:00\n"
+    "1728063370.59,3238953800000.0,4455,2024-10-04 17:36:10.59+00:00,2024-10-04 19:36:10.59+02:00\r\n"
+    ",3100000000000.0,4455,,\n"
+    "\n"
+    "1728063399.39, 850000000.0 ,4455,2024-10-04 17:36:39.39+00:00,2024-10-04 19:36:39.39+02:00\n";
+
+  void writeText(std::string const& fileName, std::string const& text) {
+    std::ofstream out(fileName, std::ios::binary | std::ios::trunc);
+    out << text;
+  }
+
+  std::string readBytes(std::string const& fileName) {
+    std::ifstream in(fileName, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+
+  bool throws(void (*f)()) {
+    try {
+      f();
+    }
+    catch (cet::exception const&) {
+      return true;
+    }
+    return false;
+  }
+
+  void checkTable(SpillTimeline const& timeline) {
+    assert(timeline.size() == 3);
+    assert(timeline.start(0) == 1728063370590ULL && timeline.pot(0) == 3238953800000ULL);
+    assert(timeline.start(1) == 1728063384990ULL && timeline.pot(1) == 3165712600000ULL);
+    assert(timeline.start(2) == 1728063399390ULL && timeline.pot(2) == 850000000ULL);
+  }
+
+  // Load the run from the directory, return whether the cache was ignored
+  bool loadIgnoringCache(SpillTimeline& timeline) {
+    std::string cacheError;
+    timeline = pdhd::SpillDataDirectory(".").load(42, true, &cacheError);
+    return !cacheError.empty();
+  }
+
+}
+
+int main() {
+  // Parse, skipping the reading without a time
+  std::size_t skipped(0);
+  checkTable(pdhd::parseSpillCSV(kTable, "table", &skipped));
+  assert(skipped == 1);
+
+  // A malformed line throws
+  assert(throws([] { pdhd::parseSpillCSV(kTable + "1728063414.0,lots,4455,,\n"); }));
+  assert(throws([] { pdhd::parseSpillCSV(kTable + "1728063414.0\n"); }));
+  assert(throws([] { pdhd::parseSpillCSV(kTable + "-1.0,1e12,4455,,\n"); }));
+
+  // Write the cache, the directory reads it back
+  writeText(kCSV, kTable);
+  pdhd::writeSpillBin(pdhd::readSpillCSV(kCSV), pdhd::spillSourceStamp(kCSV), kBin);
+  checkTable(pdhd::readSpillBin(kBin));
+  const uint64_t tableChecksum = pdhd::spillTimelineChecksum(pdhd::parseSpillCSV(kTable));
+  assert(pdhd::readSpillBinHeader(kBin).payload_checksum == tableChecksum);
+  assert(pdhd::spillTimelineChecksum(pdhd::readSpillBin(kBin)) == tableChecksum);
+  SpillTimeline timeline;
+  assert(!loadIgnoringCache(timeline));
+  checkTable(timeline);
+  const std::string cache = readBytes(kBin);
+
+  // A cache of an older version, another byte order or without the magic is ignored for the csv
+  const std::size_t versionOffset = offsetof(pdhd::SpillBinHeader, version);
+  const std::size_t byteOrderOffset = offsetof(pdhd::SpillBinHeader, byte_order);
+  for (std::size_t offset : {std::size_t(0), versionOffset, byteOrderOffset}) {
+    std::string bad = cache;
+    bad[offset] ^= 0x01;
+    writeText(kBin, bad);
+    assert(throws([] { pdhd::readSpillBin(kBin); }));
+    assert(loadIgnoringCache(timeline));
+    checkTable(timeline);
+  }
+
+  // So is a truncated cache, cut in the header or in the arrays, and a corrupted one
+  for (std::size_t size : {sizeof(pdhd::SpillBinHeader) - 8, cache.size() - 8}) {
+    writeText(kBin, cache.substr(0, size));
+    assert(throws([] { pdhd::readSpillBin(kBin); }));
+    assert(loadIgnoringCache(timeline));
+    checkTable(timeline);
+  }
+  std::string corrupted = cache;
+  corrupted[sizeof(pdhd::SpillBinHeader) + 3] ^= 0x10;
+  writeText(kBin, corrupted);
+  assert(throws([] { pdhd::readSpillBin(kBin); }));
+  assert(loadIgnoringCache(timeline));
+  checkTable(timeline);
+  // A spill count whose array size wraps around to the size of the file
+  std::string overflowing = cache;
+  const uint64_t wrapping = 3 + (uint64_t(1) << 60);
+  std::memcpy(&overflowing[offsetof(pdhd::SpillBinHeader, n_spills)], &wrapping, sizeof(wrapping));
+  writeText(kBin, overflowing);
+  assert(throws([] { pdhd::readSpillBin(kBin); }));
+  assert(loadIgnoringCache(timeline));
+  checkTable(timeline);
+
+  // A stale cache is ignored without an error
+  writeText(kBin, cache);
+  writeText(kCSV, kTable + "1728063414.0,1e12,4455,,\n");
+  assert(!loadIgnoringCache(timeline));
+  assert(timeline.size() == 4);
+  assert(pdhd::spillTimelineChecksum(timeline) != tableChecksum);
+
+  // Without the csv, a cache that cannot be read throws
+  std::filesystem::remove(kCSV);
+  writeText(kBin, cache.substr(0, cache.size() - 8));
+  assert(throws([] { pdhd::SpillDataDirectory(".").load(42); }));
+  writeText(kBin, cache);
+  checkTable(pdhd::SpillDataDirectory(".").load(42));
+  std::filesystem::remove(kBin);
+  return 0;
+}
@@ -0,0 +1,85 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        SpillTimeline_test.cc
+////
+//// SpillTimeline::Cursor against the binary search of the timeline:
+//// lookups in time order, backward jumps of every size, and times
+//// before the first and after the last spill.
+//////////////////////////////////////////////////////////////////////////
+
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "pdhdbsmdata/Algorithms/SpillTimeline.h"
+
+namespace {
+
+  using pdhd::SpillTimeline;
+  using pdhd::spilltime_t;
+
+  void checkSame(SpillTimeline const& timeline, SpillTimeline::Cursor& cursor, spilltime_t t_ms) {
+    const SpillTimeline::Lookup expected = timeline.lookup(t_ms);
+    const SpillTimeline::Lookup found = cursor.lookup(t_ms);
+    assert(found.spill == expected.spill);
+    assert(found.on == expected.on);
+  }
+
+}
+
+int main() {
+  // Spills every 20 s from t = 100000 ms, given out of order
+  constexpr std::size_t kN = 200;
+  constexpr spilltime_t kFirst = 100000;
+  constexpr spilltime_t kPeriod = 20000;
+  std::vector<std::pair<spilltime_t, uint64_t>> spills;
+  for (std::size_t i = kN; i-- > 0;) spills.emplace_back(kFirst + i * kPeriod, i);
+  const SpillTimeline timeline(spills);
+  assert(timeline.size() == kN);
+  for (std::size_t i = 0; i < kN; i++) assert(timeline.start(i) == kFirst + i * kPeriod && timeline.pot(i) == i);
+
+  // Before the first spill
+  SpillTimeline::Cursor cursor(timeline);
+  assert(cursor.lookup(0).spill == SpillTimeline::npos);
+  assert(!cursor.lookup(kFirst - 1).on);
+
+  // In order, inside and between the spills and on their edges
+  for (std::size_t i = 0; i < kN; i++) {
+    const spilltime_t start = timeline.start(i);
+    for (spilltime_t t : {start, start + 1, timeline.end(i) - 1, timeline.end(i), start + kPeriod - 1}) {
+      const SpillTimeline::Lookup lookup = cursor.lookup(t);
+      assert(lookup.spill == i);
+      assert(lookup.on == (t < timeline.end(i)));
+    }
+  }
+
+  // After the last spill: ON until its end, then OFF
+  assert(cursor.lookup(timeline.end(kN - 1) - 1).on);
+  assert(cursor.lookup(timeline.end(kN - 1)).spill == kN - 1);
+  assert(!cursor.lookup(timeline.end(kN - 1)).on);
+  assert(cursor.lookup(~spilltime_t(0)).spill == kN - 1);
+
+  // Backward jumps of every size from the end, then back before the first spill
+  for (std::size_t back = 1; back <= kN; back++) {
+    SpillTimeline::Cursor jump(timeline);
+    checkSame(timeline, jump, timeline.end(kN - 1) + 1);
+    checkSame(timeline, jump, timeline.start(kN - back) + 10);
+    checkSame(timeline, jump, timeline.start(kN - back) - 10);
+  }
+  checkSame(timeline, cursor, kFirst - 1);
+  checkSame(timeline, cursor, kFirst);
+
+  // Mixed forward and backward jumps
+  uint64_t state = 12345;
+  for (std::size_t i = 0; i < 10000; i++) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    checkSame(timeline, cursor, (state >> 33) % (kFirst + (kN + 1) * kPeriod));
+  }
+
+  // An empty timeline has no spill
+  const SpillTimeline empty;
+  SpillTimeline::Cursor emptyCursor(empty);
+  assert(emptyCursor.lookup(kFirst).spill == SpillTimeline::npos);
+  assert(!emptyCursor.lookup(kFirst).on);
+  return 0;
+}
@@ -0,0 +1,113 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        StageScheduler_test.cc
+////
+//// StageScheduler::run with stages that read their input lazily, as the
+//// stages of PDHDBSMSelection: for every set of rejecting stages, with
+//// each stage in turn missing its input, the event must pass, be
+//// rejected or throw the same way under every order of the stages, with
+//// and without running all of them. Without the checks, an event missing
+//// an input would throw or be rejected depending on the order.
+//////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "cetlib_except/exception.h"
+
+#include "pdhdbsmdata/Algorithms/StageScheduler.h"
+
+namespace {
+
+  using pdhd::StageScheduler;
+
+  constexpr std::size_t kStages = 4;
+  constexpr std::size_t kNone = kStages;
+
+  enum class Outcome { kPass, kReject, kThrow };
+
+  struct Event {
+    std::vector<bool> rejects = std::vector<bool>(kStages, false);
+    std::size_t missing = kNone; // Stage whose input the event does not have
+  };
+
+  // A stage throws when it reads an input the event does not have, as getValidHandle
+  void read(Event const& event, std::size_t s) {
+    if (s == event.missing) throw cet::exception("StageScheduler_test") << "No input of stage " << s << ".\n";
+  }
+
+  Outcome run(Event const& event, std::vector<std::size_t> const& order, bool runAll, bool checks,
+              std::size_t* selected = nullptr) {
+    StageScheduler::Order packed{};
+    for (std::size_t i = 0; i < order.size(); i++) packed[i] = static_cast<uint8_t>(order[i]);
+    std::size_t nSelected = 0;
+    Outcome outcome;
+    try {
+      const bool pass = StageScheduler::run(packed, kStages, runAll,
+        [&] (std::size_t s) { if (checks) read(event, s); },
+        [&] (std::size_t s) {
+          nSelected++;
+          read(event, s);
+          return !event.rejects[s];
+        });
+      outcome = pass ? Outcome::kPass : Outcome::kReject;
+    } catch (cet::exception const&) {
+      outcome = Outcome::kThrow;
+    }
+    if (selected) *selected = nSelected;
+    return outcome;
+  }
+
+  // The outcome if it is the same for every order; false otherwise
+  bool sameForEveryOrder(Event const& event, bool runAll, bool checks, Outcome& outcome) {
+    std::vector<std::size_t> order(kStages);
+    for (std::size_t s = 0; s < kStages; s++) order[s] = s;
+    outcome = run(event, order, runAll, checks);
+    while (std::next_permutation(order.begin(), order.end())) {
+      if (run(event, order, runAll, checks) != outcome) return false;
+    }
+    return true;
+  }
+
+}
+
+int main() {
+  for (unsigned rejecting = 0; rejecting < (1u << kStages); rejecting++) {
+    for (std::size_t missing = 0; missing <= kNone; missing++) {
+      Event event;
+      for (std::size_t s = 0; s < kStages; s++) event.rejects[s] = rejecting & (1u << s);
+      event.missing = missing;
+
+      for (bool runAll : {false, true}) {
+        Outcome outcome;
+        assert(sameForEveryOrder(event, runAll, true, outcome));
+        if (missing != kNone) assert(outcome == Outcome::kThrow);
+        else assert(outcome == (rejecting ? Outcome::kReject : Outcome::kPass));
+      }
+    }
+  }
+
+  // Without the checks, a rejection by a stage in front hides the missing input of a later one
+  Event event;
+  event.rejects[0] = true;
+  event.missing = 3;
+  Outcome outcome;
+  assert(!sameForEveryOrder(event, false, false, outcome));
+  assert(run(event, {0, 1, 2, 3}, false, false) == Outcome::kReject);
+  assert(run(event, {3, 0, 1, 2}, false, false) == Outcome::kThrow);
+  // With runAll every stage runs, so the missing input is read anyway
+  assert(sameForEveryOrder(event, true, false, outcome) && outcome == Outcome::kThrow);
+
+  // The stages stop at the first rejection, unless all of them run
+  event.missing = kNone;
+  event.rejects = {false, true, false, true};
+  std::size_t selected = 0;
+  assert(run(event, {0, 1, 2, 3}, false, true, &selected) == Outcome::kReject && selected == 2);
+  assert(run(event, {3, 2, 1, 0}, false, true, &selected) == Outcome::kReject && selected == 1);
+  assert(run(event, {3, 2, 1, 0}, true, true, &selected) == Outcome::kReject && selected == kStages);
+  event.rejects = {false, false, false, false};
+  assert(run(event, {2, 0, 3, 1}, false, true, &selected) == Outcome::kPass && selected == kStages);
+  return 0;
+}
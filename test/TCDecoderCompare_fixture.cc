@@ -0,0 +1,151 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        TCDecoderCompare_fixture.cc
+////
+//// Writes the raw DAQ file of tcdecoder_compare_test.sh with the hdf5libs
+//// writer, in the layout HDF5RawInput3 reads: trigger records of one to
+//// three TC fragments from different trigger source IDs, each a payload
+//// of TriggerCandidate overlays with 0 to several input TAs after the
+//// FragmentHeader, as the DAQ writes them. Prints the number of records
+//// and of TCs, which the compare job must report.
+////
+//// Usage: TCDecoderCompare_fixture <output .hdf5>
+//////////////////////////////////////////////////////////////////////////
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "daqdataformats/ComponentRequest.hpp"
+#include "daqdataformats/Fragment.hpp"
+#include "daqdataformats/SourceID.hpp"
+#include "daqdataformats/TriggerRecord.hpp"
+#include "detdataformats/DetID.hpp"
+#include "detdataformats/trigger/TriggerObjectOverlay.hpp"
+#include "hdf5libs/HDF5RawDataFile.hpp"
+#include "hdf5libs/hdf5filelayout/Structs.hpp"
+#include "hdf5libs/hdf5rawdatafile/Structs.hpp"
+
+namespace {
+
+  using namespace dunedaq;
+  using trgdataformats::TriggerActivityData;
+  using trgdataformats::TriggerCandidate;
+  using trgdataformats::TriggerCandidateData;
+
+  constexpr daqdataformats::run_number_t kRun = 42;
+  constexpr std::size_t kRecords = 6;
+
+  struct Random {
+    uint64_t state;
+    uint64_t next() {
+      state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+      return state >> 17;
+    }
+  };
+
+  // nTCs TCs around the trigger timestamp, through the overlays
+  std::vector<unsigned char> makePayload(std::size_t nTCs, uint64_t timestamp, Random& random) {
+    std::vector<unsigned char> bytes;
+    for (std::size_t i = 0; i < nTCs; i++) {
+      const uint64_t nInputs = random.next() % 4;
+      const std::size_t offset = bytes.size();
+      bytes.resize(offset + sizeof(TriggerCandidate) + nInputs * sizeof(TriggerActivityData));
+
+      TriggerCandidate tc;
+      tc.data = TriggerCandidateData{};
+      tc.data.time_start = timestamp - random.next() % 5000;
+      tc.data.time_end = timestamp + random.next() % 5000;
+      tc.data.time_candidate = timestamp;
+      tc.data.detid = 3;
+      tc.data.type = static_cast<TriggerCandidateData::Type>(random.next() % 13);
+      tc.data.algorithm = static_cast<TriggerCandidateData::Algorithm>(random.next() % 12);
+      tc.n_inputs = nInputs;
+      std::memcpy(&bytes[offset], &tc, sizeof(TriggerCandidate));
+      for (uint64_t ta = 0; ta < nInputs; ta++) {
+        TriggerActivityData input{};
+        input.time_start = tc.data.time_start;
+        input.channel_start = random.next() % 10240;
+        input.adc_integral = random.next();
+        std::memcpy(&bytes[offset + sizeof(TriggerCandidate) + ta * sizeof(TriggerActivityData)], &input, sizeof(input));
+      }
+    }
+    return bytes;
+  }
+
+  // The layout of the ProtoDUNE-HD raw files; without detector readout no path parameters are needed
+  hdf5libs::hdf5filelayout::FileLayoutParams layoutParams() {
+    hdf5libs::hdf5filelayout::FileLayoutParams params;
+    params.record_name_prefix = "TriggerRecord";
+    params.digits_for_record_number = 6;
+    params.digits_for_sequence_number = 4;
+    params.record_header_dataset_name = "TriggerRecordHeader";
+    params.raw_data_group_name = "RawData";
+    return params;
+  }
+
+}
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " <output .hdf5>\n";
+    return 1;
+  }
+  const std::string fileName = argv[1];
+  std::filesystem::remove(fileName);
+
+  Random random{29425};
+  std::size_t nTCs(0);
+  {
+    // No detector readout in the file, so no geo IDs to map
+    hdf5libs::HDF5RawDataFile file(fileName, kRun, 0, "tcdecoder_compare_fixture", layoutParams(),
+                                   hdf5libs::hdf5rawdatafile::SrcIDGeoIDMap());
+    for (daqdataformats::trigger_number_t record = 1; record <= kRecords; record++) {
+      const daqdataformats::timestamp_t timestamp = 106000000000000000ULL + record * 62500000ULL;
+      const std::size_t nFragments = 1 + record % 3;
+
+      std::vector<daqdataformats::ComponentRequest> components;
+      for (std::size_t f = 0; f < nFragments; f++) {
+        components.push_back({daqdataformats::SourceID(daqdataformats::SourceID::Subsystem::kTrigger, 10 + f),
+                              timestamp - 5000, timestamp + 5000});
+      }
+      daqdataformats::TriggerRecordHeader header(components);
+      header.set_trigger_number(record);
+      header.set_trigger_timestamp(timestamp);
+      header.set_run_number(kRun);
+      header.set_sequence_number(0);
+      header.set_max_sequence_number(0);
+      header.set_element_id(daqdataformats::SourceID(daqdataformats::SourceID::Subsystem::kTRBuilder, 0));
+      daqdataformats::TriggerRecord triggerRecord(header);
+
+      // Source IDs out of order, as the fragments can arrive
+      for (std::size_t f = nFragments; f-- > 0;) {
+        const std::size_t n = 1 + (record + f) % 4;
+        std::vector<unsigned char> payload = makePayload(n, timestamp, random);
+        nTCs += n;
+
+        daqdataformats::FragmentHeader fragmentHeader;
+        fragmentHeader.trigger_number = record;
+        fragmentHeader.trigger_timestamp = timestamp;
+        fragmentHeader.window_begin = timestamp - 5000;
+        fragmentHeader.window_end = timestamp + 5000;
+        fragmentHeader.run_number = kRun;
+        fragmentHeader.sequence_number = 0;
+        fragmentHeader.fragment_type = static_cast<daqdataformats::fragment_type_t>(daqdataformats::FragmentType::kTriggerCandidate);
+        fragmentHeader.detector_id = static_cast<uint16_t>(detdataformats::DetID::Subdetector::kDAQ);
+        fragmentHeader.element_id = daqdataformats::SourceID(daqdataformats::SourceID::Subsystem::kTrigger, 10 + f);
+
+        auto fragment = std::make_unique<daqdataformats::Fragment>(payload.data(), payload.size());
+        fragment->set_header_fields(fragmentHeader);
+        triggerRecord.add_fragment(std::move(fragment));
+      }
+      file.write(triggerRecord);
+    }
+  } // Closed and renamed from its in-progress name
+
+  std::cout << kRecords << " " << nTCs << "\n";
+  return 0;
+}
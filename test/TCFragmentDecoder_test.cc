@@ -0,0 +1,123 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        TCFragmentDecoder_test.cc
+////
+//// decodeTCFragment on generated payloads: TCs of 0 to several input
+//// TAs filled in through the TriggerCandidate overlays, as the DAQ
+//// writes them, must come back as the TriggerCandidateData they were
+//// generated with. The decoder must also read them from an unaligned
+//// copy, append to TCs already in the list, and throw on a payload cut
+//// anywhere inside a TC. The comparison with the full trigger decoder
+//// on a raw file is tcdecoder_compare_test.sh.
+//////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "cetlib_except/exception.h"
+#include "detdataformats/trigger/TriggerObjectOverlay.hpp"
+
+#include "pdhdbsmdata/Algorithms/TCFragmentDecoder.h"
+
+namespace {
+
+  using dunedaq::trgdataformats::TriggerActivityData;
+  using dunedaq::trgdataformats::TriggerCandidate;
+  using dunedaq::trgdataformats::TriggerCandidateData;
+
+  struct Random {
+    uint64_t state;
+    uint64_t next() {
+      state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+      return state >> 17;
+    }
+  };
+
+  struct Payload {
+    std::vector<uint64_t> words; // 8-byte words, so that the TCs are aligned as in a fragment
+    std::size_t size = 0;
+    std::vector<TriggerCandidateData> tcs; // As generated
+    std::vector<std::size_t> ends;         // Offset of the end of each TC
+
+    void const* data() const { return words.data(); }
+  };
+
+  // nTCs TCs written through the overlays
+  Payload makePayload(std::size_t nTCs, Random& random) {
+    Payload payload;
+    for (std::size_t i = 0; i < nTCs; i++) {
+      const uint64_t nInputs = i % 4 == 0 ? 0 : random.next() % 6;
+      const std::size_t tcSize = sizeof(TriggerCandidate) + nInputs * sizeof(TriggerActivityData);
+      payload.words.resize((payload.size + tcSize + 7) / 8);
+      unsigned char *bytes = reinterpret_cast<unsigned char*>(payload.words.data()) + payload.size;
+
+      TriggerCandidateData data;
+      data.time_start = random.next();
+      data.time_end = data.time_start + random.next() % 10000;
+      data.time_candidate = data.time_start + random.next() % 1000;
+      data.detid = random.next() % 16;
+      data.type = static_cast<TriggerCandidateData::Type>(random.next() % 13);
+      data.algorithm = static_cast<TriggerCandidateData::Algorithm>(random.next() % 12);
+
+      TriggerCandidate *tc = reinterpret_cast<TriggerCandidate*>(bytes);
+      tc->data = data;
+      tc->n_inputs = nInputs;
+      TriggerActivityData *inputs = reinterpret_cast<TriggerActivityData*>(bytes + sizeof(TriggerCandidate));
+      for (uint64_t ta = 0; ta < nInputs; ta++) {
+        inputs[ta] = TriggerActivityData();
+        inputs[ta].time_start = random.next();
+        inputs[ta].channel_start = random.next() % 10240;
+        inputs[ta].adc_integral = random.next();
+      }
+      payload.size += tcSize;
+      payload.tcs.push_back(data);
+      payload.ends.push_back(payload.size);
+    }
+    return payload;
+  }
+
+  void checkSame(std::vector<TriggerCandidateData> const& generated, std::vector<TriggerCandidateData> const& decoded,
+                 std::size_t first = 0) {
+    assert(decoded.size() == first + generated.size());
+    for (std::size_t i = 0; i < generated.size(); i++) assert(pdhd::sameTriggerCandidate(decoded[first + i], generated[i]));
+  }
+
+  bool throws(void const* payload, std::size_t size) {
+    std::vector<TriggerCandidateData> tcs;
+    try {
+      pdhd::decodeTCFragment(payload, size, tcs);
+    } catch (cet::exception const&) {
+      return true;
+    }
+    return false;
+  }
+
+}
+
+int main() {
+  Random random{17};
+  for (std::size_t nTCs : {0, 1, 2, 7, 100}) {
+    const Payload payload = makePayload(nTCs, random);
+
+    std::vector<TriggerCandidateData> tcs;
+    assert(pdhd::decodeTCFragment(payload.data(), payload.size, tcs) == nTCs);
+    checkSame(payload.tcs, tcs);
+
+    // From an odd address, and after the TCs of another fragment
+    std::vector<unsigned char> unaligned(payload.size + 1);
+    std::memcpy(unaligned.data() + 1, payload.data(), payload.size);
+    assert(pdhd::decodeTCFragment(unaligned.data() + 1, payload.size, tcs) == nTCs);
+    checkSame(payload.tcs, tcs, nTCs);
+  }
+
+  // A payload cut inside the header of a TC or inside its input TAs throws, a cut between TCs does not
+  const Payload payload = makePayload(4, random);
+  assert(payload.ends.size() == 4 && payload.ends.back() == payload.size);
+  for (std::size_t cut = 1; cut < payload.size; cut++) {
+    const bool betweenTCs = std::find(payload.ends.begin(), payload.ends.end(), cut) != payload.ends.end();
+    assert(throws(payload.data(), cut) == !betweenTCs);
+  }
+  return 0;
+}
@@ -0,0 +1,141 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        TCTypeSelector_test.cc
+////
+//// TCTypeSelector on short lists of TCs: the "any", "all" and "count"
+//// policies and how many TCs each one looks at, reject and accept lists
+//// of types and algorithms given by name or numeric code, the shared
+//// slot of codes past kMaxCode, and the errors on unknown names, bad
+//// numbers and unknown policies.
+//////////////////////////////////////////////////////////////////////////
+
+#include <cassert>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "cetlib_except/exception.h"
+
+#include "pdhdbsmdata/Algorithms/TCTypeSelector.h"
+
+namespace {
+
+  using pdhd::TCTypeSelector;
+  using pdhd::TCVetoPolicy;
+  using tc_t = TCTypeSelector::tc_t;
+  using Type = tc_t::Type;
+  using Algorithm = tc_t::Algorithm;
+
+  tc_t makeTC(Type type, Algorithm algorithm = Algorithm::kUnknown) {
+    tc_t tc;
+    tc.type = type;
+    tc.algorithm = algorithm;
+    return tc;
+  }
+
+  TCTypeSelector::Decision decide(TCTypeSelector const& selector, std::vector<tc_t> const& tcs) {
+    return selector.decide(tcs.data(), tcs.data() + tcs.size());
+  }
+
+  TCTypeSelector::Config rejectADC(TCVetoPolicy policy, std::size_t minVetoed = 1) {
+    TCTypeSelector::Config config;
+    config.rejectTypes = {"kADCSimpleWindow"};
+    config.policy = policy;
+    config.minVetoed = minVetoed;
+    return config;
+  }
+
+  bool throws(TCTypeSelector::Config const& config) {
+    try {
+      TCTypeSelector selector(config);
+    }
+    catch (cet::exception const&) {
+      return true;
+    }
+    return false;
+  }
+
+}
+
+int main() {
+  const tc_t adc = makeTC(Type::kADCSimpleWindow, Algorithm::kADCSimpleWindow);
+  const tc_t muon = makeTC(Type::kHorizontalMuon, Algorithm::kHorizontalMuon);
+  const tc_t timing = makeTC(Type::kTiming, Algorithm::kHSIEventToTriggerCandidate);
+
+  // "any": the first vetoed TC rejects the event, and no TC after it is looked at
+  const TCTypeSelector any(rejectADC(TCVetoPolicy::kAny));
+  assert(any.vetoed(adc) && !any.vetoed(muon) && !any.vetoed(timing));
+  TCTypeSelector::Decision decision = decide(any, {muon, adc, muon, adc});
+  assert(decision.reject && decision.checked == 2 && decision.vetoed == 1);
+  decision = decide(any, {muon, timing});
+  assert(!decision.reject && decision.checked == 2 && decision.vetoed == 0);
+  assert(!decide(any, {}).reject);
+
+  // "all": only an event whose TCs are all vetoed, and not an event without TCs
+  const TCTypeSelector all(rejectADC(TCVetoPolicy::kAll));
+  assert(decide(all, {adc, adc, adc}).reject);
+  decision = decide(all, {adc, muon, adc});
+  assert(!decision.reject && decision.checked == 2 && decision.vetoed == 1);
+  assert(!decide(all, {}).reject);
+
+  // "count": rejected at MinVetoedTCs vetoed TCs, a count of 0 is taken as 1
+  const TCTypeSelector count(rejectADC(TCVetoPolicy::kCount, 3));
+  assert(count.minVetoed() == 3);
+  assert(!decide(count, {adc, muon, adc}).reject);
+  decision = decide(count, {adc, muon, adc, adc, muon});
+  assert(decision.reject && decision.checked == 4 && decision.vetoed == 3);
+  assert(TCTypeSelector(rejectADC(TCVetoPolicy::kCount, 0)).minVetoed() == 1);
+  assert(TCTypeSelector(rejectADC(TCVetoPolicy::kAny, 5)).minVetoed() == 1);
+
+  // Numeric codes select the same TCs as the names
+  TCTypeSelector::Config numeric = rejectADC(TCVetoPolicy::kAny);
+  numeric.rejectTypes = {std::to_string(static_cast<int>(Type::kADCSimpleWindow))};
+  const TCTypeSelector byCode(numeric);
+  assert(byCode.vetoed(adc) && !byCode.vetoed(muon));
+
+  // Algorithms: a rejected algorithm vetoes TCs of any type
+  TCTypeSelector::Config algorithms;
+  algorithms.rejectAlgorithms = {"kHorizontalMuon"};
+  const TCTypeSelector byAlgorithm(algorithms);
+  assert(byAlgorithm.vetoed(muon) && byAlgorithm.vetoed(makeTC(Type::kTiming, Algorithm::kHorizontalMuon)));
+  assert(!byAlgorithm.vetoed(adc) && !byAlgorithm.vetoed(timing));
+
+  // Accept lists veto every other code, codes past kMaxCode included
+  TCTypeSelector::Config accept;
+  accept.acceptTypes = {"kTiming", "7"};
+  const TCTypeSelector acceptOnly(accept);
+  assert(!acceptOnly.vetoed(timing) && !acceptOnly.vetoed(muon) && acceptOnly.vetoed(adc));
+  const tc_t large = makeTC(static_cast<Type>(200));
+  assert(TCTypeSelector::slot(large.type) == TCTypeSelector::kMaxCode - 1);
+  assert(acceptOnly.vetoed(large));
+  assert(!any.vetoed(large));
+
+  // Names of the codes, and the number of a code without a name
+  assert(TCTypeSelector::typeName(static_cast<std::size_t>(Type::kADCSimpleWindow)) == "kADCSimpleWindow");
+  assert(TCTypeSelector::algorithmName(static_cast<std::size_t>(Algorithm::kBundle)) == "kBundle");
+  assert(TCTypeSelector::typeName(50) == "50");
+
+  // Bad input: unknown names, a type name given as an algorithm, malformed and out of range numbers
+  const std::vector<std::string> badCodes = {"kNoSuchType", "ADCSimpleWindow", "6x", "+6", "-1", " 6", "",
+                                             std::to_string(TCTypeSelector::kMaxCode - 1), "99999999999999999999999"};
+  for (std::string const& bad : badCodes) {
+    TCTypeSelector::Config config;
+    config.rejectTypes = {bad};
+    assert(throws(config));
+  }
+  TCTypeSelector::Config typeAsAlgorithm;
+  typeAsAlgorithm.rejectAlgorithms = {"kTiming"};
+  assert(throws(typeAsAlgorithm));
+
+  for (const char *policy : {"any", "all", "count"}) pdhd::parseTCVetoPolicy(policy);
+  for (const char *policy : {"Any", "most", ""}) {
+    bool threw = false;
+    try {
+      pdhd::parseTCVetoPolicy(policy);
+    }
+    catch (cet::exception const&) {
+      threw = true;
+    }
+    assert(threw);
+  }
+  return 0;
+}
@@ -0,0 +1,133 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        TPOccupancyIndex_test.cc
+////
+//// countHits, countChannels and forEachHit of TPOccupancyIndex against
+//// a count of every TP, on random TPs given out of channel order and
+//// with TPs outside the indexed channels. Windows start and end inside
+//// bins, on bin edges, inside a single bin and outside the TPs, and a
+//// long event checks that the bins are widened to kMaxTimeBins.
+//////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <set>
+#include <vector>
+
+#include "pdhdbsmdata/Algorithms/PDHDChannelMap.h"
+#include "pdhdbsmdata/Algorithms/TPOccupancyIndex.h"
+
+namespace {
+
+  using pdhd::TPOccupancyIndex;
+  using channel_t = TPOccupancyIndex::channel_t;
+  using tick_t = TPOccupancyIndex::tick_t;
+
+  constexpr pdhd::chmap::ChannelRange kRange = {1000, 1199};
+
+  struct TPs {
+    std::vector<channel_t> channel;
+    std::vector<tick_t> time;
+  };
+
+  uint64_t next(uint64_t& state) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return state >> 33;
+  }
+
+  // TPs on channels around the range, in random order, at times in [t0, t0 + span)
+  TPs randomTPs(uint64_t& state, std::size_t n, tick_t t0, tick_t span) {
+    TPs tps;
+    for (std::size_t i = 0; i < n; i++) {
+      tps.channel.push_back(kRange.first - 20 + next(state) % (kRange.size() + 40));
+      tps.time.push_back(t0 + next(state) % span);
+    }
+    return tps;
+  }
+
+  void check(TPOccupancyIndex const& index, TPs const& tps, channel_t c0, channel_t c1, tick_t t0, tick_t t1) {
+    std::size_t hits(0);
+    std::set<channel_t> channels;
+    for (std::size_t i = 0; i < tps.channel.size(); i++) {
+      const channel_t c = tps.channel[i];
+      if (!kRange.contains(c) || c < c0 || c > c1 || tps.time[i] < t0 || tps.time[i] > t1) continue;
+      hits++;
+      channels.insert(c);
+    }
+    assert(index.countHits(c0, c1, t0, t1) == hits);
+    assert(index.countChannels(c0, c1, t0, t1) == channels.size());
+    assert(index.count(pdhd::VetoCountMode::kHits, c0, c1, t0, t1) == hits);
+    assert(index.count(pdhd::VetoCountMode::kChannels, c0, c1, t0, t1) == channels.size());
+
+    std::size_t visited(0);
+    index.forEachHit(c0, c1, t0, t1, [&] (channel_t c, tick_t t) {
+      assert(c >= c0 && c <= c1 && kRange.contains(c) && t >= t0 && t <= t1);
+      visited++;
+    });
+    assert(visited == hits);
+  }
+
+}
+
+int main() {
+  uint64_t state = 2024;
+  constexpr tick_t kStart = 100000000;
+
+  // About 40 bins of the default width
+  const TPs tps = randomTPs(state, 20000, kStart, 40 * 4096);
+  const TPOccupancyIndex index(kRange, tps.channel.data(), tps.time.data(), tps.channel.size());
+  assert(index.timeBinWidth() == 4096);
+  assert(index.nTimeBins() <= 40);
+  std::size_t inRange(0);
+  for (const auto &c : tps.channel) inRange += kRange.contains(c);
+  assert(index.size() == inRange);
+
+  // Random windows, most of them starting and ending inside a bin
+  for (std::size_t i = 0; i < 2000; i++) {
+    const channel_t c0 = kRange.first - 10 + next(state) % (kRange.size() + 20);
+    const channel_t c1 = c0 + next(state) % 60;
+    const tick_t t0 = kStart - 5000 + next(state) % (42 * 4096);
+    const tick_t t1 = t0 + next(state) % (8 * 4096);
+    check(index, tps, c0, c1, t0, t1);
+  }
+
+  // Windows inside one bin, on bin edges, the whole event, outside the TPs and empty
+  const tick_t origin = tps.time.empty() ? kStart : *std::min_element(tps.time.begin(), tps.time.end());
+  for (tick_t b = 0; b < 40; b += 3) {
+    const tick_t edge = origin + b * 4096;
+    check(index, tps, kRange.first, kRange.last, edge + 100, edge + 2000);
+    check(index, tps, kRange.first, kRange.last, edge, edge + 4095);
+    check(index, tps, kRange.first + 50, kRange.first + 99, edge, edge + 3 * 4096 - 1);
+    check(index, tps, kRange.first + 50, kRange.first + 99, edge - 1, edge + 3 * 4096);
+  }
+  check(index, tps, 0, ~channel_t(0), 0, ~tick_t(0));
+  check(index, tps, kRange.first, kRange.last, 0, kStart - 1);
+  check(index, tps, kRange.first, kRange.last, kStart + 50 * 4096, ~tick_t(0));
+  check(index, tps, kRange.last + 1, kRange.last + 100, kStart, kStart + 40 * 4096);
+  check(index, tps, kRange.first + 10, kRange.first + 20, kStart + 5000, kStart + 4999);
+  check(index, tps, kRange.first + 20, kRange.first + 10, kStart, kStart + 40 * 4096);
+
+  // A long event: the bins are widened so at most kMaxTimeBins cover it
+  const TPs longTPs = randomTPs(state, 5000, kStart, 1000 * 4096);
+  const TPOccupancyIndex longIndex(kRange, longTPs.channel.data(), longTPs.time.data(), longTPs.channel.size());
+  assert(longIndex.nTimeBins() <= TPOccupancyIndex::kMaxTimeBins);
+  assert(longIndex.timeBinWidth() > 4096);
+  for (std::size_t i = 0; i < 500; i++) {
+    const channel_t c0 = kRange.first + next(state) % kRange.size();
+    const tick_t t0 = kStart + next(state) % (1000 * 4096);
+    check(longIndex, longTPs, c0, c0 + next(state) % 40, t0, t0 + next(state) % (20 * 4096));
+  }
+
+  // TPs all on one tick, and no TPs in the range
+  const TPs sameTick = {{1000, 1001, 1001, 1199, 999}, {kStart, kStart, kStart, kStart, kStart}};
+  const TPOccupancyIndex tickIndex(kRange, sameTick.channel.data(), sameTick.time.data(), sameTick.channel.size());
+  assert(tickIndex.nTimeBins() == 1);
+  check(tickIndex, sameTick, kRange.first, kRange.last, kStart, kStart);
+  check(tickIndex, sameTick, kRange.first, kRange.last, kStart + 1, kStart + 10);
+
+  const TPs outside = {{10, 20}, {kStart, kStart}};
+  const TPOccupancyIndex emptyIndex(kRange, outside.channel.data(), outside.time.data(), outside.channel.size());
+  assert(emptyIndex.empty() && emptyIndex.nTimeBins() == 0);
+  check(emptyIndex, outside, kRange.first, kRange.last, 0, ~tick_t(0));
+  return 0;
+}
@@ -0,0 +1,123 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        TriggerRecordHeaderScan_test.cc
+////
+//// Writes a small raw DAQ .hdf5 file with the C API, with the trigger
+//// record headers in signed char datasets as the DAQ writes them, and a
+//// spill table for its run, then checks what pdhd_hdf5_prescan reads:
+//// the stamps of scanTriggerRecordHeaders, in trigger record order, and
+//// their SpillSelector decisions.
+//////////////////////////////////////////////////////////////////////////
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "hdf5.h"
+
+#include "pdhdbsmdata/Algorithms/SpillDataDirectory.h"
+#include "pdhdbsmdata/Algorithms/SpillSelector.h"
+#include "pdhdbsmdata/tools/TriggerRecordHeaderScan.h"
+
+namespace {
+
+  constexpr uint32_t kRun = 42;
+  constexpr uint64_t kTicksPerMs = 62500;
+
+  struct Record {
+    uint64_t trigger_number;
+    uint16_t sequence_number;
+    uint64_t time_ms;
+    bool selected; // With the spills below, spill ON and 1e12 PoT threshold
+  };
+
+  // The fixed part of the header and a few bytes of component requests after it
+  std::vector<unsigned char> headerBytes(Record const& record) {
+    std::vector<unsigned char> bytes(pdhd::kTriggerRecordHeaderFixedSize + 24, 0xfe);
+    const uint32_t marker = pdhd::kTriggerRecordHeaderMarker;
+    const uint32_t version = 4;
+    const uint64_t timestamp = record.time_ms * kTicksPerMs;
+    std::memcpy(&bytes[0], &marker, sizeof(marker));
+    std::memcpy(&bytes[4], &version, sizeof(version));
+    std::memcpy(&bytes[8], &record.trigger_number, sizeof(record.trigger_number));
+    std::memcpy(&bytes[16], &timestamp, sizeof(timestamp));
+    std::memcpy(&bytes[32], &kRun, sizeof(kRun));
+    std::memcpy(&bytes[42], &record.sequence_number, sizeof(record.sequence_number));
+    return bytes;
+  }
+
+  void writeFixture(std::string const& fileName, std::vector<Record> const& records) {
+    const hid_t file = H5Fcreate(fileName.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    assert(file >= 0);
+    for (const auto &record : records) {
+      char name[64];
+      std::snprintf(name, sizeof(name), "TriggerRecord%06llu.%04u",
+                    static_cast<unsigned long long>(record.trigger_number), static_cast<unsigned>(record.sequence_number));
+      const hid_t group = H5Gcreate2(file, name, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+      const hid_t rawData = H5Gcreate2(group, "RawData", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+      const std::vector<unsigned char> bytes = headerBytes(record);
+      const hsize_t size = bytes.size();
+      const hid_t space = H5Screate_simple(1, &size, nullptr);
+      const hid_t dataset = H5Dcreate2(rawData, "TriggerRecordHeader", H5T_NATIVE_SCHAR, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+      assert(dataset >= 0);
+      assert(H5Dwrite(dataset, H5T_NATIVE_SCHAR, H5S_ALL, H5S_ALL, H5P_DEFAULT, bytes.data()) >= 0);
+      H5Dclose(dataset);
+      H5Sclose(space);
+      H5Gclose(rawData);
+      H5Gclose(group);
+    }
+    H5Fclose(file);
+  }
+
+}
+
+int main() {
+  // Spills of 4785 ms at 1000 s and 1030 s, and one below the PoT threshold at 1060 s
+  {
+    std::ofstream csv("spillrun000042.csv");
+    csv << "time,intensity\n1000.0,5e12\n1030.0,3e12\n1060.0,1e11\n";
+  }
+
+  // Written out of trigger number order, with one record split in two sequences
+  const std::vector<Record> records = {
+    {4, 0, 1031000, true},   // Inside the second spill
+    {1, 0, 999000, false},   // Before the first spill
+    {2, 0, 1001000, true},   // Inside the first spill
+    {3, 1, 1004784, true},   // Last ms of the first spill
+    {3, 0, 1004785, false},  // Just after it
+    {5, 0, 1061000, false},  // Inside the spill below threshold
+    {6, 0, 2000000, false},  // After the last spill
+  };
+  writeFixture("prescan_fixture.hdf5", records);
+
+  const std::vector<pdhd::TriggerRecordStamp> stamps = pdhd::scanTriggerRecordHeaders("prescan_fixture.hdf5");
+  assert(stamps.size() == records.size());
+  for (std::size_t i = 1; i < stamps.size(); i++) {
+    assert(stamps[i - 1].trigger_number < stamps[i].trigger_number ||
+           (stamps[i - 1].trigger_number == stamps[i].trigger_number && stamps[i - 1].sequence_number < stamps[i].sequence_number));
+  }
+
+  const pdhd::SpillDataDirectory spillData(".");
+  const pdhd::SpillTimeline timeline = spillData.load(kRun);
+  const pdhd::SpillSelector selector(true, 1000000000000ULL);
+  for (const auto &record : records) {
+    const pdhd::TriggerRecordStamp *stamp = nullptr;
+    for (const auto &s : stamps) {
+      if (s.trigger_number == record.trigger_number && s.sequence_number == record.sequence_number) stamp = &s;
+    }
+    assert(stamp);
+    assert(stamp->run_number == kRun);
+    assert(stamp->trigger_timestamp == record.time_ms * kTicksPerMs);
+    assert(pdhd::daqTicksToMs(stamp->trigger_timestamp) == record.time_ms);
+    assert(selector.decide(timeline, pdhd::daqTicksToMs(stamp->trigger_timestamp)).pass == record.selected);
+  }
+
+  // Not a trigger record header
+  unsigned char garbage[pdhd::kTriggerRecordHeaderFixedSize] = {};
+  pdhd::TriggerRecordStamp stamp;
+  assert(!pdhd::decodeTriggerRecordHeader(garbage, sizeof(garbage), stamp));
+  return 0;
+}
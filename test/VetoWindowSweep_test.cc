@@ -0,0 +1,155 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        VetoWindowSweep_test.cc
+////
+//// sweepVetoWindows against a count of every window, in both count
+//// modes, with windows whose end shrinks from one to the next and
+//// empty (start > end) windows. Then the two event decisions of
+//// ExtMuonSelector that changed with the sweep: a TA off the main
+//// collection faces is skipped rather than removing the event, and an
+//// event without any APA 3/4 shower window is removed.
+//////////////////////////////////////////////////////////////////////////
+
+#include <cassert>
+#include <cstdint>
+#include <set>
+#include <vector>
+
+#include "pdhdbsmdata/Algorithms/ExtMuonSelector.h"
+#include "pdhdbsmdata/Algorithms/PDHDChannelMap.h"
+#include "pdhdbsmdata/Algorithms/TraceBuffer.h"
+#include "pdhdbsmdata/Algorithms/TriggerEvent.h"
+#include "pdhdbsmdata/Algorithms/VetoWindowSweep.h"
+
+namespace {
+
+  using pdhd::VetoCountMode;
+  using pdhd::VetoWindow;
+
+  constexpr pdhd::chmap::ChannelRange kVeto = {100, 139};
+
+  std::size_t countWindow(VetoCountMode mode, std::vector<uint32_t> const& channel, std::vector<uint64_t> const& time, VetoWindow w) {
+    std::size_t hits(0);
+    std::set<uint32_t> channels;
+    for (std::size_t i = 0; i < channel.size(); i++) {
+      if (!kVeto.contains(channel[i]) || time[i] < w.start || time[i] > w.end) continue;
+      hits++;
+      channels.insert(channel[i]);
+    }
+    return mode == VetoCountMode::kChannels ? channels.size() : hits;
+  }
+
+  void checkSweep(std::vector<uint32_t> const& channel, std::vector<uint64_t> const& time, std::vector<VetoWindow> const& windows) {
+    for (VetoCountMode mode : {VetoCountMode::kHits, VetoCountMode::kChannels}) {
+      const std::vector<std::size_t> counts = pdhd::sweepVetoWindows(mode, kVeto, channel.data(), time.data(), channel.size(), windows);
+      assert(counts.size() == windows.size());
+      for (std::size_t w = 0; w < windows.size(); w++) assert(counts[w] == countWindow(mode, channel, time, windows[w]));
+    }
+  }
+
+  dunedaq::trgdataformats::TriggerPrimitive makeTP(uint32_t channel, uint64_t time) {
+    dunedaq::trgdataformats::TriggerPrimitive tp;
+    tp.channel = channel;
+    tp.time_start = time;
+    tp.time_peak = time;
+    tp.adc_integral = 1000;
+    return tp;
+  }
+
+  // A TA of n TPs on consecutive channels from first, all at time
+  void addTA(pdhd::TriggerEvent& event, uint32_t first, uint32_t n, uint64_t time) {
+    dunedaq::trgdataformats::TriggerActivityData ta;
+    ta.time_start = time;
+    ta.time_end = time + 1000;
+    ta.channel_start = first;
+    ta.channel_end = first + n - 1;
+    std::vector<uint32_t> positions;
+    for (uint32_t i = 0; i < n; i++) {
+      positions.push_back(event.tps.size());
+      event.tps.push_back(makeTP(first + i, time));
+    }
+    event.addTA(ta, positions);
+  }
+
+  pdhd::ExtMuonDecision select(pdhd::TriggerEvent const& event) {
+    pdhd::TraceBuffer buffer(16);
+    const pdhd::TraceSink log(buffer, pdhd::TraceLevel::kOff);
+    const pdhd::ExtMuonSelector selector(40, VetoCountMode::kHits);
+    return selector.select(pdhd::makeTPIndex(event), log);
+  }
+
+}
+
+int main() {
+  // TPs on and around the veto channels, several per channel
+  std::vector<uint32_t> channel;
+  std::vector<uint64_t> time;
+  for (uint32_t i = 0; i < 400; i++) {
+    channel.push_back(90 + (i * 7) % 60);
+    time.push_back((i * 37) % 1000);
+  }
+
+  // Shrinking ends: each window ends before the one before it, the last one inside all others
+  checkSweep(channel, time, {{0, 900}, {100, 800}, {200, 300}, {250, 260}});
+  // Same start, shrinking and growing ends, and a window of one tick
+  checkSweep(channel, time, {{100, 900}, {100, 200}, {100, 950}, {370, 370}});
+  // Empty windows count nothing and do not disturb the others
+  checkSweep(channel, time, {{500, 400}, {0, 999}, {600, 599}, {300, 700}});
+  // Windows given out of start order, and windows past all TPs
+  checkSweep(channel, time, {{700, 800}, {0, 50}, {5000, 6000}, {400, 450}, {999, 2000}});
+  // No TPs on the veto channels
+  checkSweep(std::vector<uint32_t>(10, 50), std::vector<uint64_t>(10, 100), {{0, 1000}});
+
+  // Random windows
+  uint64_t state = 2024;
+  std::vector<VetoWindow> windows;
+  for (std::size_t w = 0; w < 500; w++) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    const uint64_t start = (state >> 33) % 1100;
+    const uint64_t width = (state >> 20) % 300;
+    windows.push_back({start, (state & 15) == 0 ? start - 1 : start + width});
+  }
+  checkSweep(channel, time, windows);
+
+  constexpr uint64_t kTime = 1000000;
+  const pdhd::chmap::ChannelRange apa3 = pdhd::chmap::mainCollectionRange(3);
+  const pdhd::chmap::ChannelRange apa4 = pdhd::chmap::mainCollectionRange(4);
+  const uint32_t offFace = pdhd::chmap::planeRange(1, pdhd::chmap::kU).first;
+  assert(pdhd::chmap::mainCollectionAPA(offFace) == pdhd::chmap::kNoAPA);
+
+  // A TA off the main faces is skipped, the quiet APA 4 TA after it passes the event
+  {
+    pdhd::TriggerEvent event;
+    addTA(event, offFace, 20, kTime);
+    addTA(event, apa4.first + 100, 20, kTime);
+    const pdhd::ExtMuonDecision decision = select(event);
+    assert(decision.pass);
+    assert(decision.tas[static_cast<std::size_t>(pdhd::ExtMuonCut::kOutsideMainAPA)] == 1);
+    assert(decision.passedTAs == std::vector<std::size_t>{1});
+  }
+  // ... and fails it when the upstream veto channels fire in its window
+  {
+    pdhd::TriggerEvent event;
+    addTA(event, offFace, 20, kTime);
+    addTA(event, apa4.first + 100, 20, kTime);
+    addTA(event, apa3.first, 40, kTime);
+    const pdhd::ExtMuonDecision decision = select(event);
+    assert(!decision.pass);
+    assert(decision.tas[static_cast<std::size_t>(pdhd::ExtMuonCut::kUpstreamVeto)] == 2);
+  }
+  // Only TAs off the main faces: no shower window, the event is removed
+  {
+    pdhd::TriggerEvent event;
+    addTA(event, offFace, 20, kTime);
+    addTA(event, offFace + 100, 20, kTime);
+    const pdhd::ExtMuonDecision decision = select(event);
+    assert(decision.decided && !decision.pass);
+    assert(decision.windows.empty());
+    assert(decision.tas[static_cast<std::size_t>(pdhd::ExtMuonCut::kOutsideMainAPA)] == 2);
+  }
+  // No TAs at all
+  {
+    const pdhd::ExtMuonDecision decision = select(pdhd::TriggerEvent());
+    assert(decision.decided && !decision.pass);
+  }
+  return 0;
+}
@@ -0,0 +1,195 @@
+////////////////////////////////////////////////////////////////////////
+//// File:        WIBEthROIDecoder_test.cc
+////
+//// samplesInWindow against the samples whose tick is in the window,
+//// for windows on and between sample ticks. Then decodeWIBEthFragment
+//// on a fragment of generated frames: the samples of each ROI channel
+//// inside its window and nothing else, the frames past every window
+//// left packed, samples missing between frames or in a frame out of
+//// time order filled with the one before, an unaligned payload, a
+//// payload that is not whole frames, and with keepReadoutStart the
+//// readout start as the first sample of every channel, as in a full
+//// decoding. Last the ROIs of an event passed without a TA with ROIs,
+//// which must decode every channel over the whole readout, and of a
+//// rejected event.
+//////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "cetlib_except/exception.h"
+
+#include "pdhdbsmdata/Algorithms/TPCROIs.h"
+#include "pdhdbsmdata/Algorithms/WIBEthROIDecoder.h"
+
+namespace {
+
+  using dunedaq::fddetdataformats::WIBEthFrame;
+  using pdhd::kTicksPerSample;
+  using pdhd::kWIBEthSamples;
+  using pdhd::TickWindow;
+
+  constexpr uint64_t kReadoutStart = 106000000000000000ULL;
+  constexpr uint64_t kFrameTicks = kWIBEthSamples * kTicksPerSample;
+  constexpr std::size_t kNFrames = 5;
+  constexpr uint32_t kFirstChannel = 4160; // Offline channel of frame channel 0
+
+  uint16_t adc(std::size_t ch, uint64_t tick) { return (ch * 131 + (tick - kReadoutStart) / kTicksPerSample) & 0x3FFF; }
+
+  // Frames f of the readout, in the given order
+  std::vector<unsigned char> makePayload(std::vector<std::size_t> const& frames) {
+    std::vector<unsigned char> payload(frames.size() * sizeof(WIBEthFrame));
+    for (std::size_t i = 0; i < frames.size(); i++) {
+      WIBEthFrame frame{};
+      const uint64_t first = kReadoutStart + frames[i] * kFrameTicks;
+      frame.set_timestamp(first);
+      for (std::size_t ch = 0; ch < pdhd::kWIBEthChannels; ch++) {
+        for (std::size_t s = 0; s < kWIBEthSamples; s++) frame.set_adc(ch, s, adc(ch, first + s * kTicksPerSample));
+      }
+      std::memcpy(&payload[i * sizeof(WIBEthFrame)], &frame, sizeof(frame));
+    }
+    return payload;
+  }
+
+  pdhd::WIBEthStreamWindows streamWindows(pdhd::ROIChannelWindows const& windows) {
+    pdhd::WIBEthStreamWindows stream;
+    for (std::size_t ch = 0; ch < pdhd::kWIBEthChannels; ch++) stream.set(ch, kFirstChannel + ch, windows);
+    return stream;
+  }
+
+  pdhd::TPCROI roi(uint32_t first, uint32_t last, uint64_t start, uint64_t end) {
+    return {3, kFirstChannel + first, kFirstChannel + last, start, end};
+  }
+
+  // Every sample of the readout from the first one in window to the last one, one per kTicksPerSample
+  void checkWaveform(pdhd::ChannelWaveform const& waveform, std::size_t ch, TickWindow window) {
+    const uint64_t end = std::min(window.end, kReadoutStart + kNFrames * kFrameTicks - 1);
+    const uint64_t first = window.start <= kReadoutStart ? kReadoutStart
+      : kReadoutStart + (window.start - kReadoutStart + kTicksPerSample - 1) / kTicksPerSample * kTicksPerSample;
+    assert(waveform.channel == kFirstChannel + ch);
+    assert(waveform.timestamp == first);
+    assert(waveform.adcs.size() == (end - first) / kTicksPerSample + 1);
+    for (std::size_t s = 0; s < waveform.adcs.size(); s++) assert(waveform.adcs[s] == adc(ch, first + s * kTicksPerSample));
+  }
+
+}
+
+int main() {
+  // samplesInWindow: a waveform of 64 samples from tick 1000
+  constexpr uint64_t kStart = 1000;
+  using Range = pdhd::SampleRange;
+  auto same = [] (Range a, Range b) { return a.first == b.first && a.count == b.count; };
+  assert(same(pdhd::samplesInWindow(kStart, 64, {kStart, kStart + 63 * kTicksPerSample}), {0, 64}));
+  assert(same(pdhd::samplesInWindow(kStart, 64, {0, ~uint64_t(0)}), {0, 64}));
+  assert(same(pdhd::samplesInWindow(kStart, 64, {kStart + 1, kStart + 64}), {1, 2}));
+  assert(pdhd::samplesInWindow(kStart, 64, {kStart + 1, kStart + 31}).count == 0); // Between two samples
+  assert(pdhd::samplesInWindow(kStart, 64, {0, kStart - 1}).count == 0);
+  assert(pdhd::samplesInWindow(kStart, 64, {kStart + 63 * kTicksPerSample + 1, kStart + 100000}).count == 0);
+  assert(pdhd::samplesInWindow(kStart, 64, TickWindow()).count == 0);
+  assert(pdhd::samplesInWindow(kStart, 0, {0, ~uint64_t(0)}).count == 0);
+  for (uint64_t start = kStart - 40; start < kStart + 2200; start += 7) {
+    for (uint64_t end = start; end < kStart + 2200; end += 13) {
+      const Range range = pdhd::samplesInWindow(kStart, 64, {start, end});
+      std::size_t first(64), count(0);
+      for (std::size_t s = 0; s < 64; s++) {
+        const uint64_t tick = kStart + s * kTicksPerSample;
+        if (tick < start || tick > end) continue;
+        if (count++ == 0) first = s;
+      }
+      assert(range.count == count && (count == 0 || range.first == first));
+    }
+  }
+
+  // A fragment of 5 frames. ROIs inside frames 2 and 3 on frame channels 1-3 and 10, and inside frame 0
+  // on channel 20, off sample ticks
+  const std::vector<pdhd::TPCROI> rois = {
+    roi(1, 3, kReadoutStart + 2 * kFrameTicks + 100, kReadoutStart + 3 * kFrameTicks + 500),
+    roi(10, 10, kReadoutStart + 2 * kFrameTicks + 100, kReadoutStart + 3 * kFrameTicks + 500),
+    roi(20, 20, kReadoutStart + 7, kReadoutStart + 300)};
+  const std::vector<std::size_t> channels = {1, 2, 3, 10, 20};
+  const std::vector<unsigned char> payload = makePayload({0, 1, 2, 3, 4});
+
+  {
+    const pdhd::ROIChannelWindows windows(rois, pdhd::ROITickMode::kROI);
+    std::vector<pdhd::ChannelWaveform> waveforms;
+    // Frame 4 is after every window
+    assert(pdhd::decodeWIBEthFragment(payload.data(), payload.size(), streamWindows(windows), waveforms) == 4);
+    assert(waveforms.size() == channels.size());
+    for (std::size_t i = 0; i < channels.size(); i++) checkWaveform(waveforms[i], channels[i], windows.window(kFirstChannel + channels[i]));
+
+    // The same from an odd address
+    std::vector<unsigned char> unaligned(payload.size() + 1);
+    std::memcpy(unaligned.data() + 1, payload.data(), payload.size());
+    std::vector<pdhd::ChannelWaveform> fromUnaligned;
+    pdhd::decodeWIBEthFragment(unaligned.data() + 1, payload.size(), streamWindows(windows), fromUnaligned);
+    for (std::size_t i = 0; i < channels.size(); i++) assert(fromUnaligned[i].adcs == waveforms[i].adcs);
+
+    // Not a whole number of frames
+    bool threw(false);
+    try {
+      pdhd::decodeWIBEthFragment(payload.data(), payload.size() - 1, streamWindows(windows), waveforms);
+    } catch (cet::exception const&) {
+      threw = true;
+    }
+    assert(threw);
+  }
+
+  // Keeping the readout start: every ROI channel starts at the first sample of the fragment,
+  // and in "event" mode all end at the end of the last ROI
+  {
+    pdhd::ROIChannelWindows windows(rois, pdhd::ROITickMode::kEvent);
+    windows.keepReadoutStart();
+    assert(windows.span().start == 0);
+    std::vector<pdhd::ChannelWaveform> waveforms;
+    assert(pdhd::decodeWIBEthFragment(payload.data(), payload.size(), streamWindows(windows), waveforms) == 4);
+    assert(waveforms.size() == channels.size());
+    for (std::size_t i = 0; i < channels.size(); i++) {
+      checkWaveform(waveforms[i], channels[i], {0, kReadoutStart + 3 * kFrameTicks + 500});
+      assert(waveforms[i].timestamp == kReadoutStart);
+    }
+  }
+
+  // Frame 1 missing, and then out of time order after frame 2: its samples repeat the last one of frame 0
+  for (const auto &frames : {std::vector<std::size_t>{0, 2, 3, 4}, std::vector<std::size_t>{0, 2, 1, 3, 4}}) {
+    pdhd::ROIChannelWindows windows(rois, pdhd::ROITickMode::kROI);
+    windows.keepReadoutStart();
+    const std::vector<unsigned char> gapPayload = makePayload(frames);
+    std::vector<pdhd::ChannelWaveform> waveforms;
+    pdhd::decodeWIBEthFragment(gapPayload.data(), gapPayload.size(), streamWindows(windows), waveforms);
+    const pdhd::ChannelWaveform &waveform = waveforms[0];
+    assert(waveform.timestamp == kReadoutStart);
+    assert(waveform.adcs.size() == (3 * kFrameTicks + 500) / kTicksPerSample + 1);
+    for (std::size_t s = 0; s < waveform.adcs.size(); s++) {
+      const uint64_t tick = kReadoutStart + s * kTicksPerSample;
+      const bool missing = s >= kWIBEthSamples && s < 2 * kWIBEthSamples;
+      assert(waveform.adcs[s] == adc(channels[0], missing ? kReadoutStart + (kWIBEthSamples - 1) * kTicksPerSample : tick));
+    }
+  }
+
+  // An event passed without the ROIs of a TA: every channel of the detector, all frames in full
+  for (pdhd::ROITickMode mode : {pdhd::ROITickMode::kEvent, pdhd::ROITickMode::kROI}) {
+    std::vector<pdhd::TPCROI> passed;
+    pdhd::completeEventROIs(true, passed);
+    pdhd::ROIChannelWindows windows(passed, mode);
+    windows.keepReadoutStart();
+    assert(windows.nChannels() == pdhd::chmap::kNChannels);
+    for (uint32_t channel = 0; channel < pdhd::chmap::kNChannels; channel++) {
+      assert(windows.window(channel).start == 0 && windows.window(channel).end == ~uint64_t(0));
+    }
+    std::vector<pdhd::ChannelWaveform> waveforms;
+    assert(pdhd::decodeWIBEthFragment(payload.data(), payload.size(), streamWindows(windows), waveforms) == kNFrames);
+    assert(waveforms.size() == pdhd::kWIBEthChannels);
+    for (std::size_t ch = 0; ch < pdhd::kWIBEthChannels; ch++) checkWaveform(waveforms[ch], ch, {0, ~uint64_t(0)});
+  }
+
+  // The ROIs of a TA are kept as they are, a rejected event has none
+  std::vector<pdhd::TPCROI> passed(rois);
+  pdhd::completeEventROIs(true, passed);
+  assert(passed.size() == rois.size());
+  pdhd::completeEventROIs(false, passed);
+  assert(passed.empty());
+  return 0;
+}
@@ -0,0 +1,59 @@
+#!/bin/bash
+########################################################################
+# Snapshot format round trip of pdhd_filter_replay: synthetic events are
+# replayed and written to a snapshot, the snapshot is replayed, and the
+# decisions (-o) of both must be the same. Then copies of the snapshot
+# cut at several points, as left by a job that did not finish: each must
+# give the events of the blocks written before the cut, with the same
+# decisions, and say that it was recovered.
+#
+# Usage: filter_replay_snapshot_test.sh [path of pdhd_filter_replay]
+########################################################################
+
+set -u
+
+replay=${1:-pdhd_filter_replay}
+nEvents=2000
+eventsPerBlock=256 # TriggerSnapshotWriter::kDefaultEventsPerBlock
+nBlocks=$(( (nEvents + eventsPerBlock - 1) / eventsPerBlock ))
+indexBytes=$(( nBlocks * 16 + 32 )) # Index entries and trailer
+
+fail() {
+  echo "FAIL: $*"
+  exit 1
+}
+
+"${replay}" -j 2 --synthetic ${nEvents} --write-synthetic synthetic.pdhdtrg -o synthetic.txt > /dev/null ||
+  fail "synthetic replay failed"
+[ "$(wc -l < synthetic.txt)" -eq ${nEvents} ] || fail "synthetic replay decided $(wc -l < synthetic.txt) events"
+
+"${replay}" -j 2 -o replayed.txt synthetic.pdhdtrg > /dev/null || fail "replay of the snapshot failed"
+cmp -s synthetic.txt replayed.txt || fail "the snapshot replay decided differently"
+
+# check_cut <bytes kept> <events expected, or "blocks" for any whole number of blocks>
+check_cut() {
+  local bytes=$1 expected=$2
+  head -c "${bytes}" synthetic.pdhdtrg > truncated.pdhdtrg
+  "${replay}" -j 2 -o truncated.txt truncated.pdhdtrg > /dev/null 2> truncated.err ||
+    fail "replay of the snapshot cut at ${bytes} bytes failed: $(cat truncated.err)"
+  grep -q "events recovered" truncated.err || fail "the snapshot cut at ${bytes} bytes was not reported as recovered"
+  local n
+  n=$(wc -l < truncated.txt)
+  if [ "${expected}" = blocks ]; then
+    [ $(( n % eventsPerBlock )) -eq 0 ] && [ "${n}" -gt 0 ] && [ "${n}" -lt ${nEvents} ] ||
+      fail "the snapshot cut at ${bytes} bytes gave ${n} events, not a whole number of blocks"
+  else
+    [ "${n}" -eq "${expected}" ] || fail "the snapshot cut at ${bytes} bytes gave ${n} events, expected ${expected}"
+  fi
+  head -n "${n}" synthetic.txt | cmp -s - truncated.txt || fail "the snapshot cut at ${bytes} bytes decided differently"
+}
+
+size=$(stat -c %s synthetic.pdhdtrg)
+check_cut $(( size - 32 )) ${nEvents}                                            # Trailer lost, every block complete
+check_cut $(( size - indexBytes )) ${nEvents}                                    # Index lost
+check_cut $(( size - indexBytes - 1 )) $(( (nBlocks - 1) * eventsPerBlock ))     # Last block incomplete
+check_cut $(( size / 2 )) blocks                                                 # Cut in the middle
+check_cut 32 0                                                                   # Header only
+
+rm -f synthetic.pdhdtrg truncated.pdhdtrg
+echo "PASS"
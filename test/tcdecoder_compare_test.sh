@@ -0,0 +1,30 @@
+#!/bin/bash
+########################################################################
+# PDHDTCDecoder against the full trigger decoder on a raw file written
+# by TCDecoderCompare_fixture: lar runs both on every trigger record and
+# PDHDTCCompare throws at the first event where the TC lists differ.
+# The summary of PDHDTCCompare must then count every record and every
+# TC of the fixture, so that an empty product on both sides fails.
+#
+# Usage: tcdecoder_compare_test.sh <TCDecoderCompare_fixture> <job .fcl>
+########################################################################
+
+set -u
+
+fixture=$1
+fcl=$2
+
+fail() {
+  echo "FAIL: $*"
+  exit 1
+}
+
+counts=$("${fixture}" tcdecoder_fixture.hdf5) || fail "the fixture could not be written"
+read -r nRecords nTCs <<< "${counts}"
+
+lar -c "${fcl}" -s tcdecoder_fixture.hdf5 > lar.log 2>&1 || fail "lar failed: $(tail -n 20 lar.log)"
+grep -q "${nRecords} events and ${nTCs} TCs compared, 0 events with different TCs" lar.log ||
+  fail "expected ${nRecords} events and ${nTCs} TCs compared: $(grep -A1 'TCs compared' lar.log)"
+
+rm -f tcdecoder_fixture.hdf5
+echo "PASS"